@@ -0,0 +1,203 @@
+/**
+ * Audio Output
+ * I2S (DMAリングバッファ) への音声出力エンジン
+ *
+ * - 専用の producer タスクが音源から1ブロックずつ取り出して i2s_write() する。
+ *   DMAのリングが埋まっていれば i2s_write() が待つので、それがそのまま流量制御になる
+ * - 音源は fill コールバック。scratch に書くか、*out を既存のサンプル列に向ける。
+ *   フラッシュ上のPCMクリップは *out を直接向けるのでコピーしない (ゼロコピー)
+ * - 再生していない間もDMAはゼロを流し続ける (tx_desc_auto_clear)。
+ *   次の再生は今鳴っているDMAバッファの次から始まるので、
+ *   開始までの遅延は 最初のブロックを作る時間 + 最大 AUDIO_DMA_BUF_LEN サンプル (8ms)
+ * - setSink() で I2S の代わりに任意の出力 (WAVファイルなど) へ書ける
+ * - renderToWav() は音源をタスクを使わずにWAVファイルへ書き出す (音の確認用)
+ * - DMAに渡すブロックごとにその場でRMSを計算し (コピーなし)、
+ *   そのブロックが実際に鳴る時刻と一緒に記録する。getEnvelope() は
+ *   「今鳴っている音」の大きさを返すので、口パクがDMAの遅れ分ずれない
+ *
+ * 形式は 16kHz / 16bit / モノラル。
+ */
+
+#ifndef AUDIO_OUTPUT_H
+#define AUDIO_OUTPUT_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#define AUDIO_SAMPLE_RATE       16000
+#define AUDIO_DMA_BUF_COUNT     6       // 6 × 8ms = 48ms ぶん先に積める
+#define AUDIO_DMA_BUF_LEN       128     // サンプル (8ms)
+#define AUDIO_BLOCK_SAMPLES     128     // 1回の fill で作る最大サンプル数
+#define AUDIO_QUEUE_LEN         8
+#define AUDIO_TASK_STACK_SIZE   4096
+#define AUDIO_TASK_PRIORITY     5       // タッチ (3) やLLMワーカー (1) より上
+#define AUDIO_TASK_CORE         0
+#define AUDIO_VOLUME_MAX        256
+#define AUDIO_TONE_FADE_SAMPLES 80      // トーンの両端のフェード (5ms, プチノイズ防止)
+#define AUDIO_ENVELOPE_SLOTS    16      // 2のべき乗 (DMAに積める数より多く)
+
+// 音源: 最大 max_samples を返す。0 を返したら終わり
+// scratch に書いて *out = scratch にするか、*out を既存のデータに向ける
+typedef size_t (*AudioFillFn)(void* ctx, int16_t* scratch, size_t max_samples, const int16_t** out);
+
+// I2S の代わりに書き出す先
+typedef void (*AudioSinkFn)(void* ctx, const int16_t* samples, size_t count);
+
+// フラッシュ上の16bit PCM (const 配列をそのまま再生する)
+struct PcmSource {
+    const int16_t* data;
+    size_t count;
+    size_t pos;
+
+    void begin(const int16_t* samples, size_t n) { data = samples; count = n; pos = 0; }
+    static size_t fill(void* ctx, int16_t* scratch, size_t max_samples, const int16_t** out);
+};
+
+// IMA ADPCM (4bit, 下位ニブルが先)。PCMの1/4の容量
+struct AdpcmSource {
+    const uint8_t* data;
+    size_t count;           // サンプル数
+    size_t pos;
+    int32_t predictor;
+    int8_t step_index;
+
+    void begin(const uint8_t* adpcm, size_t samples, int16_t initial = 0, int8_t index = 0) {
+        data = adpcm; count = samples; pos = 0; predictor = initial; step_index = index;
+    }
+    static size_t fill(void* ctx, int16_t* scratch, size_t max_samples, const int16_t** out);
+};
+
+// 正弦波のトーン (かわいい効果音用)
+struct ToneSource {
+    uint32_t phase;
+    uint32_t step;          // 1サンプルあたりの位相 (2^32 = 1周)
+    uint32_t remaining;     // 残りサンプル数
+    uint32_t total;
+    int16_t amplitude;
+
+    void begin(uint16_t freq_hz, uint16_t duration_ms, int16_t amp = 8000);
+    static size_t fill(void* ctx, int16_t* scratch, size_t max_samples, const int16_t** out);
+};
+
+struct AudioStats {
+    uint32_t plays;
+    uint32_t blocks;
+    uint32_t samples;
+    uint32_t late_blocks;       // 作るのに1ブロックの再生時間以上かかった
+    uint32_t starts;            // 開始遅延を測った回数
+    uint32_t start_sum_us;      // play() から最初のブロックをDMAに渡すまで
+    uint32_t start_max_us;
+    uint32_t fill_max_us;
+    uint32_t delay_max_us;      // 書き込んでから鳴るまで (DMAに積まれている分)
+    uint32_t since_ms;
+};
+
+// ブロックごとの音量 (鳴る時刻つき)
+struct AudioEnvelopeSlot {
+    uint32_t start_us;      // このブロックが鳴り始める時刻 (推定)
+    uint16_t duration_us;
+    uint16_t rms;           // 0..32767
+};
+
+class AudioOutput {
+private:
+    enum SourceKind : uint8_t {
+        SOURCE_CALLBACK,
+        SOURCE_PCM,
+        SOURCE_ADPCM,
+        SOURCE_TONE
+    };
+
+    // キューに流す要素 (組み込みの音源は状態ごと渡す)
+    struct Request {
+        SourceKind kind;
+        uint32_t generation;
+        uint32_t queued_us;
+        bool measure_start;     // すぐ鳴らすべきもの (開始遅延を測る)
+        AudioFillFn fn;
+        void* ctx;
+        union {
+            PcmSource pcm;
+            AdpcmSource adpcm;
+            ToneSource tone;
+        };
+    };
+
+    TaskHandle_t task_handle;
+    QueueHandle_t request_queue;
+    bool i2s_ready;
+    int port;
+
+    AudioSinkFn sink;
+    void* sink_ctx;
+
+    volatile uint32_t generation;   // stop() で進める (古いリクエストは捨てる)
+    volatile bool playing;
+    volatile uint16_t volume;
+
+    // 音量 (書き込みは producer タスク、読み出しはUI)
+    AudioEnvelopeSlot envelope[AUDIO_ENVELOPE_SLOTS];
+    std::atomic<uint32_t> envelope_head;
+    uint32_t play_end_us;           // 書き込み済みの音が鳴り終わる時刻 (推定)
+
+    Request current;                // producer タスクだけが触る
+    int16_t scratch[AUDIO_BLOCK_SAMPLES];
+    int16_t gain_buf[AUDIO_BLOCK_SAMPLES];
+    AudioStats stats;
+
+public:
+    AudioOutput();
+    ~AudioOutput();
+
+    // I2S とタスクを起動
+    bool begin(int bclk, int lrck, int dout,
+               BaseType_t core = AUDIO_TASK_CORE,
+               UBaseType_t priority = AUDIO_TASK_PRIORITY);
+
+    // 今の再生を止めて鳴らす (play*) / 今の再生のあとに鳴らす (enqueue*)
+    bool play(AudioFillFn fn, void* ctx);
+    bool playPcm(const int16_t* samples, size_t count);
+    bool playAdpcm(const uint8_t* data, size_t samples);
+    bool playTone(uint16_t freq_hz, uint16_t duration_ms);
+    bool enqueue(AudioFillFn fn, void* ctx);
+    bool enqueueTone(uint16_t freq_hz, uint16_t duration_ms);
+
+    void stop();
+    bool isPlaying() { return playing || (request_queue && uxQueueMessagesWaiting(request_queue) > 0); }
+
+    TaskHandle_t getTaskHandle() { return task_handle; }
+
+    void setVolume(uint16_t v) { volume = v > AUDIO_VOLUME_MAX ? AUDIO_VOLUME_MAX : v; }
+    uint16_t getVolume() { return volume; }
+
+    // I2S の代わりに書き出す (nullptr で I2S に戻す)
+    void setSink(AudioSinkFn fn, void* ctx) { sink_ctx = ctx; sink = fn; }
+
+    // 音源をWAVファイルに書き出す (タスクを使わない)。書いたサンプル数を返す
+    static size_t renderToWav(AudioFillFn fn, void* ctx, File& file,
+                              uint32_t sample_rate = AUDIO_SAMPLE_RATE);
+
+    // 指定時刻 (既定は今) に鳴っている音のRMS。鳴っていなければ 0
+    uint16_t getEnvelope(uint32_t at_us);
+    uint16_t getEnvelope() { return getEnvelope(micros()); }
+    // 今書き込むと何us後に鳴るか
+    uint32_t getOutputDelayUs();
+
+    const AudioStats& getStats() { return stats; }
+    void printStats();
+    void resetStats();
+
+private:
+    static uint16_t blockRms(const int16_t* samples, size_t count);
+    void recordEnvelope(const int16_t* samples, size_t count);
+    bool submit(Request& req, bool interrupt);
+    void write(const int16_t* samples, size_t count);
+    static void taskEntry(void* param);
+    void taskLoop();
+};
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * Kirby-style Character
+ * 顔のオブジェクト構築と表情アニメーション
+ *
+ * LVGLだけに依存する (時刻はLVGLのタイマーとアニメーション、乱数は lv_rand())。
+ * Arduino APIを使わないので、LVGLとこのファイルだけで描画を再現できる。
+ * スプライトのアトラス (FaceSprites) は呼び出し側で用意して渡す。
+ */
+
+#ifndef CHARACTER_H
+#define CHARACTER_H
+
+#include <lvgl.h>
+#include "face_sprites.h"
+#include "lip_sync.h"
+
+// アニメーション状態
+typedef enum {
+    ANIM_IDLE,
+    ANIM_BLINK,
+    ANIM_HAPPY,
+    ANIM_SURPRISE,
+    ANIM_TALK
+} AnimState;
+
+// タイミング (ms)
+#define BLINK_CLOSE_MS          60      // 閉じる (ease-in)
+#define BLINK_OPEN_MS           110     // 開ける (同じ曲線を逆に)
+#define BLINK_MIN_INTERVAL_MS   2000
+#define BLINK_MAX_INTERVAL_MS   5000
+#define TALK_CYCLE_MS           150     // 口を開ける/閉じるそれぞれの時間
+#define ANIM_IDLE_RETURN_MS     2000    // 表情を保つ時間
+// 開き具合の最大値 (ANIM_OPEN_MAX) と口パクの設定は lip_sync.h
+
+extern AnimState current_anim;
+
+// キャラクターを現在の画面に作る (sprites が nullptr ならウィジェットで描く)
+void create_kirby_character(FaceSprites* sprites);
+
+// 表情の切り替え
+void show_eyes(EyeState state);
+void show_mouth(MouthState state);
+
+// アニメーション
+void start_animation(AnimState anim);
+void blink_animation();
+void talk_animation();
+void surprise_animation();
+void reset_to_idle();
+
+// 話すアニメーションを音に合わせる (nullptr なら一定の周期で口を動かす)。
+// 話し始めてから fn がずっと TALK_LEVEL_SILENT を返す間も一定の周期で動かす
+void set_talk_level_source(TalkLevelFn fn, void *ctx);
+
+#endif
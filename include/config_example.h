@@ -44,6 +44,16 @@
 #define LOCAL_SERVER_URL  "http://192.168.1.100:11434/api/generate"
 #define LOCAL_MODEL       "tinyllama"
 
+// ----- バックエンドルーター設定 -----
+// コメントを外すと ローカルサーバー → OpenAI → TinyLLM → ルールベース の順に
+// 応答時間の予算内で自動的に切り替える (遅い・落ちているサーバーはスキップ)
+// #define USE_LLM_ROUTER
+#define LLM_LATENCY_BUDGET_MS  8000
+
+// ----- 応答キャッシュ設定 -----
+// コメントを外すと応答キャッシュをフラッシュ(NVS)にも保存し、再起動後も再利用
+// #define LLM_CACHE_FLASH
+
 // ===== オーディオ設定 =====
 #define DEFAULT_VOLUME    15  // 0-21
 #define ENABLE_AUDIO          // この行をコメントアウトすると音声機能無効
@@ -0,0 +1,78 @@
+/**
+ * Conversation History
+ * トークン予算つきの会話履歴 (リングバッファ)
+ *
+ * 以前は String 配列を毎ターンずらしていたため、ヒープの確保/解放が続き、
+ * 長い会話ではプロンプト(と送信データ)が MAX_HISTORY 件ぶん膨らんでいた。
+ *
+ * - スロットは init() で一度だけ確保し (PSRAM優先)、以後はコピーのみ
+ * - 合計トークン数が予算を超えたら古いターンから追い出す
+ * - 追い出したターンは「以前の話題」として短い要約に残す (予算の1/4まで)
+ *
+ * トークン数は推定値: ASCIIは約4文字で1トークン、それ以外は1文字1トークン
+ */
+
+#ifndef CONVERSATION_HISTORY_H
+#define CONVERSATION_HISTORY_H
+
+#include <Arduino.h>
+
+// 履歴設定
+#define HISTORY_MAX_TURNS      8
+#define HISTORY_SLOT_SIZE      256   // 1メッセージの最大バイト数 (超えたら切り詰め)
+#define HISTORY_TOKEN_BUDGET   384   // 履歴全体 (要約を含む) のトークン上限
+#define HISTORY_SUMMARY_SIZE   160   // 要約の最大バイト数
+#define HISTORY_TOPIC_BYTES    24    // 要約に残す1話題あたりの最大バイト数
+
+class ConversationHistory {
+private:
+    struct Turn {
+        uint16_t tokens;
+        char user[HISTORY_SLOT_SIZE];
+        char assistant[HISTORY_SLOT_SIZE];
+    };
+
+    Turn* turns;            // リングバッファ (PSRAM)
+    int max_turns;
+    int head;               // 最も古いターンの位置
+    int count;
+    uint16_t token_budget;
+    uint16_t total_tokens;  // ターンの合計 (要約を除く)
+
+    char summary[HISTORY_SUMMARY_SIZE];
+    uint16_t summary_tokens;
+
+public:
+    ConversationHistory();
+    ~ConversationHistory();
+
+    bool init(int num_turns = HISTORY_MAX_TURNS,
+              uint16_t budget = HISTORY_TOKEN_BUDGET);
+
+    void add(const char* user_msg, const char* assistant_msg);
+    void clear();
+
+    // i = 0 が最も古いターン
+    int size() { return count; }
+    const char* user(int i) { return turns[(head + i) % max_turns].user; }
+    const char* assistant(int i) { return turns[(head + i) % max_turns].assistant; }
+    uint16_t turnTokens(int i) { return turns[(head + i) % max_turns].tokens; }
+
+    // 残り予算 budget に収まる最も古いターンの番号 (新しい方から数える)
+    int firstTurnWithin(uint16_t budget);
+
+    const char* getSummary() { return summary; }
+    bool hasSummary() { return summary[0] != '\0'; }
+    uint16_t getTokens() { return total_tokens + summary_tokens; }
+    uint16_t getBudget() { return token_budget; }
+
+    static uint16_t estimateTokens(const char* text);
+
+private:
+    void evictOldest();
+    void appendTopic(const char* text);
+    void dropOldestTopic();
+    static size_t copyUtf8(char* dst, const char* src, size_t dst_size);
+};
+
+#endif
@@ -1,6 +1,29 @@
 /**
  * Display Driver for ESP32-S3-Touch-LCD-1.85
  * GC9A01 360x360 Round LCD
+ *
+ * LVGLのフラッシュはSPI DMAで非同期に転送する:
+ * - flush_cb はDMA転送を開始してすぐ lv_disp_flush_ready() を返す
+ * - 次のフラッシュの先頭で前回の転送完了を待つ (dmaWait)
+ * - LVGLはダブルバッファのもう一方に次のバンドを描画できるので、
+ *   描画とSPI転送が重なる
+ * - 内部RAMのバッファからは直接DMA転送する
+ * - PSRAMのバッファや全画面バッファ (direct_mode) からは、内部RAMの
+ *   小さなバウンスバッファ2枚に交互にコピーしながら転送する
+ * - 色はLVGL側でバイトスワップ済み (LV_COLOR_16_SWAP = 1)
+ *
+ * 丸型パネルのクリッピング (DISPLAY_ROUND_CLIP):
+ * - 円の外側 (四隅の約21%) は見えないので送らない
+ * - 行ごとの表示範囲を表にしておき、数行ずつのストリップ単位で
+ *   表示範囲だけをアドレスウィンドウに設定して転送する
+ *   (バッファ内で詰め直してから送るので、追加のメモリは不要)
+ * - rounder_cb で無効領域を横方向だけ円の内側に縮め、見えない部分は描画させない
+ *   (規則は round_clip.h。縦を縮めるとLVGLのバンドが1行になるので変えない)
+ *
+ * 描画バッファの構成 (DisplayConfig):
+ * - バンドの行数、置き場所 (内部RAM / PSRAM)、ダブルバッファの有無
+ * - full_frame: 画面全体のバッファ (PSRAM) に変更部分だけを直接描画
+ * - setupLVGL() で実行中にも切り替えられる (startBenchmark() / benchmarkConfigs() で比較)
  */
 
 #ifndef DISPLAY_DRIVER_H
@@ -23,6 +46,50 @@
 #define SCREEN_WIDTH  360
 #define SCREEN_HEIGHT 360
 
+// 1 = DMAで非同期フラッシュ, 0 = pushColorsで同期フラッシュ (比較用)
+#ifndef DISPLAY_USE_DMA
+#define DISPLAY_USE_DMA 1
+#endif
+
+// 1 = 円の外側を転送・描画しない
+#ifndef DISPLAY_ROUND_CLIP
+#define DISPLAY_ROUND_CLIP 1
+#endif
+#define DISPLAY_CLIP_STRIP_ROWS 4   // 1ウィンドウにまとめる行数 (小さいほど削減量が多い)
+#define DISPLAY_CLIP_MARGIN     1   // 円の縁に残す余白(px)
+
+// 描画バッファの既定値
+#ifndef DISPLAY_BAND_LINES
+#define DISPLAY_BAND_LINES      60
+#endif
+#define DISPLAY_BOUNCE_LINES    8   // バウンスバッファ1枚の行数
+
+enum DisplayBufferLocation {
+    DISPLAY_BUF_INTERNAL,   // DMA可能な内部RAM (速いがWiFi/TLSと取り合い)
+    DISPLAY_BUF_PSRAM       // PSRAM (内部RAMを空けられる、転送時にコピーが入る)
+};
+
+struct DisplayConfig {
+    uint16_t band_lines;                // 部分描画バッファの行数 (full_frameでは無視)
+    DisplayBufferLocation location;
+    bool double_buffer;                 // false なら描画と転送が重ならない (DMA完了を待って返す)
+    bool full_frame;                    // 画面全体のバッファ (常にPSRAM)
+};
+
+// フラッシュ統計 (FPSとCPU負荷の計測用)
+struct DisplayFlushStats {
+    uint32_t frames;        // 最後のバンドまで送った回数
+    uint32_t flushes;       // flush_cb の呼び出し回数
+    uint32_t bytes;         // 転送したバイト数
+    uint32_t clipped_bytes; // 円の外側で送らずに済んだバイト数
+    uint32_t refreshes;     // LVGLの再描画回数 (無効領域があったもの)
+    uint32_t rendered_px;   // LVGLが描画した画素数
+    uint32_t render_ms;     // LVGLの描画時間 (フラッシュ待ちを含む)
+    uint32_t busy_us;       // flush_cb 内で費やした時間 (待ちを含む)
+    uint32_t wait_us;       // 前回のDMA完了待ちの時間
+    uint32_t since_ms;      // 計測開始時刻
+};
+
 class DisplayDriver {
 private:
     TFT_eSPI* tft;
@@ -40,12 +107,46 @@ public:
     void clearScreen();
     
     TFT_eSPI* getTFT() { return tft; }
+    bool isDMAEnabled();
+    
+    // LVGL以外からTFTに描画する前に呼ぶ (DMA完了を待ってトランザクションを閉じる)
+    static void waitFlush();
+    
+    // LVGLのディスプレイを登録 (2回目以降はバッファを差し替え)。
+    // 確保できなければ既定の構成に戻し、それも無理なら描画を止めて false
+    static bool setupLVGL(const DisplayConfig& config);
+    static DisplayConfig defaultConfig();
+    static const DisplayConfig& getConfig();
+    
+    // 構成ごとの全画面再描画FPSと残りヒープを計測 (終わったら元の構成に戻す)
+    // startBenchmark() のあと benchmarkStep() を1回呼ぶごとに1フレーム描く。
+    // false が返ったら終わり。benchmarkConfigs() は最後までまとめて実行する
+    static bool startBenchmark(int frames = 30);
+    static bool benchmarkStep();
+    static bool isBenchmarking();
+    static void benchmarkConfigs(int frames = 30);
     
     // LVGL flush callback
     static void lvgl_flush_cb(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p);
     
+    // LVGL rounder callback (無効領域を円の内側に縮める)
+    static void lvgl_rounder_cb(lv_disp_drv_t *disp, lv_area_t *area);
+    
+    // LVGL monitor callback (再描画ごとの画素数と時間)
+    static void lvgl_monitor_cb(lv_disp_drv_t *disp, uint32_t time, uint32_t px);
+    
+    // フラッシュ統計
+    static void getFlushStats(DisplayFlushStats* out);
+    static void resetFlushStats();
+    static void printFlushStats();
+    
 private:
     void setupBacklight();
+    void buildSpanTable();
+    static void pushArea(int32_t x, int32_t y, uint32_t w, uint32_t h, uint16_t* data);
+    static void flushStrips(const lv_area_t *area, lv_color_t *src, uint32_t stride, bool in_place);
+    static bool allocBuffers(const DisplayConfig& config, lv_color_t* bufs[2]);
+    static void freeBuffers(lv_color_t* bufs[2]);
 };
 
 #endif
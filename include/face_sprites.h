@@ -0,0 +1,101 @@
+/**
+ * Face Sprites
+ * 目と口の表情をRGB565のアトラスに事前描画しておき、lv_imgで貼り替える
+ *
+ * 目や口を lv_obj のサイズ変更で表現すると、フレームごとに
+ * アンチエイリアス付きの円・角丸矩形・頬の半透明合成を描き直すことになる。
+ * 起動時に全状態を lv_canvas でPSRAM上のアトラスへ一度だけ描き、
+ * 以後は不透明なRGB565画像を貼るだけにする (LVGLは画像より下を描かないので
+ * 1フレームの描画は行単位のコピーになる)。
+ *
+ * - 各パーツのセルは全状態で同じサイズ (切り替え時に無効化されるのはセルだけ)
+ * - セルには顔の地の色と頬も描き込んであるので、不透明のまま重ねられる
+ * - 描画結果はSPIFFSに保存し、次回からはファイルを読むだけ
+ */
+
+#ifndef FACE_SPRITES_H
+#define FACE_SPRITES_H
+
+#include <lvgl.h>
+
+// 顔のジオメトリ (顔の中心からのオフセット)
+#define FACE_SIZE           280
+#define FACE_COLOR          0xFFB4D5
+#define FACE_BORDER_COLOR   0xFF8AC7
+#define EYE_COLOR           0x1A1A4D
+#define MOUTH_COLOR         0xD84A6F
+#define CHEEK_COLOR         0xFF80AB
+#define EYE_OFFSET_X        45
+#define EYE_OFFSET_Y        -20
+#define MOUTH_OFFSET_Y      40
+#define CHEEK_OFFSET_X      90
+#define CHEEK_OFFSET_Y      20
+#define CHEEK_WIDTH         50
+#define CHEEK_HEIGHT        40
+
+// セルサイズ (全状態の最大サイズ + 余白)
+#define EYE_CELL_W          59
+#define EYE_CELL_H          79
+#define MOUTH_CELL_W        49
+#define MOUTH_CELL_H        49
+
+#define FACE_ATLAS_PATH     "/face_atlas.bin"
+#define FACE_ATLAS_MAGIC    "FACE"
+#define FACE_ATLAS_VERSION  1       // ジオメトリを変えたら上げる
+
+enum EyeState {
+    EYE_OPEN,
+    EYE_CLOSED,
+    EYE_WIDE,
+    EYE_STATE_COUNT
+};
+
+enum MouthState {
+    MOUTH_CLOSED,
+    MOUTH_TALK_1,       // 少し開く
+    MOUTH_TALK_2,
+    MOUTH_TALK_3,       // 大きく開く
+    MOUTH_WIDE,         // 驚き
+    MOUTH_STATE_COUNT
+};
+
+struct SpriteShape {
+    lv_coord_t w;
+    lv_coord_t h;
+};
+
+class FaceSprites {
+private:
+    lv_color_t* pixels;     // アトラス本体 (PSRAM)
+    size_t pixel_count;
+
+    lv_img_dsc_t eye_dsc[2][EYE_STATE_COUNT];   // [0] = 左, [1] = 右
+    lv_img_dsc_t mouth_dsc[MOUTH_STATE_COUNT];
+
+public:
+    FaceSprites();
+    ~FaceSprites();
+
+    // アトラスを用意 (キャッシュファイルがあれば読み込み、なければ描画して保存)
+    bool init(const char* cache_path = FACE_ATLAS_PATH);
+
+    const lv_img_dsc_t* eye(bool left, EyeState state) { return &eye_dsc[left ? 0 : 1][state]; }
+    const lv_img_dsc_t* mouth(MouthState state) { return &mouth_dsc[state]; }
+
+    // 各状態の形 (ウィジェットで描く場合にも使う)
+    static SpriteShape eyeShape(EyeState state);
+    static SpriteShape mouthShape(MouthState state);
+
+    size_t getMemoryUsage() { return pixel_count * sizeof(lv_color_t); }
+
+private:
+    void layoutCells();
+    void render();
+    void renderCell(lv_obj_t* canvas, const lv_img_dsc_t* dsc,
+                    lv_coord_t cell_x, lv_coord_t cell_y,
+                    SpriteShape shape, uint32_t color, bool highlight);
+    bool loadCache(const char* path);
+    bool saveCache(const char* path);
+};
+
+#endif
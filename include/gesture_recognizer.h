@@ -0,0 +1,103 @@
+/**
+ * Gesture Recognizer
+ * タッチ座標の列からスワイプと回転 (円周ドラッグ) をソフトウェアで判定する
+ *
+ * CST816Sのジェスチャーコードは指を離してから報告され、種類も固定。
+ * 座標を直接見れば、スワイプは指が一定距離・速度を超えた時点で確定でき、
+ * 丸い画面の縁をなぞる回転も取れる。
+ *
+ * - 直近 GESTURE_RING_SIZE 件のサンプルを固定長リングに保持 (ヒープ不使用)
+ * - 座標は直近 GESTURE_SMOOTH_SAMPLES 件の平均で平滑化
+ * - 速度は GESTURE_VELOCITY_WINDOW_MS 前の平滑化座標との差 (px/s)
+ * - 角度は 1周 = 65536 の整数 (差を int16_t にすると自然に折り返す)
+ * - 浮動小数点は使わない
+ *
+ * 1回のタッチで判定するのはスワイプか回転のどちらか一方。
+ * スワイプは1回だけ、回転は GESTURE_ROTATE_STEP_DEG ごとに通知する。
+ * 時刻は呼び出し側が渡す (micros)。ハードウェアには依存しない。
+ */
+
+#ifndef GESTURE_RECOGNIZER_H
+#define GESTURE_RECOGNIZER_H
+
+#include <stdint.h>
+#include "touch_state.h"
+
+// 判定パラメータ
+#define GESTURE_RING_SIZE           16      // 2のべき乗
+#define GESTURE_SMOOTH_SAMPLES      3
+#define GESTURE_VELOCITY_WINDOW_MS  60
+#define GESTURE_SWIPE_MIN_DIST      40      // px
+#define GESTURE_SWIPE_MIN_VELOCITY  250     // px/s
+#define GESTURE_SWIPE_STRAIGHTNESS  2       // 主軸の移動量が副軸のこの倍以上
+#define GESTURE_ROTATE_MIN_RADIUS   70      // 中心からこれより外側でなぞった場合だけ
+#define GESTURE_ROTATE_STEP_DEG     30
+#define GESTURE_CENTER_X            180
+#define GESTURE_CENTER_Y            180
+
+// ソフトウェアで判定するジェスチャー (スワイプはチップと同じコード)
+#define GESTURE_ROTATE_CW    0x20
+#define GESTURE_ROTATE_CCW   0x21
+
+struct GestureEvent {
+    uint8_t gesture;
+    uint16_t x;             // 判定時の平滑化座標
+    uint16_t y;
+    int16_t vx;             // px/s
+    int16_t vy;
+    int16_t angle_deg;      // 回転: このタッチでの累積角度 (時計回りが正)
+    uint32_t elapsed_ms;    // 触れてから判定までの時間
+};
+
+class GestureRecognizer {
+private:
+    struct Sample {
+        int16_t x;          // 平滑化済み
+        int16_t y;
+        uint32_t t_us;
+    };
+
+    Sample ring[GESTURE_RING_SIZE];
+    int16_t raw_x[GESTURE_SMOOTH_SAMPLES];
+    int16_t raw_y[GESTURE_SMOOTH_SAMPLES];
+    uint32_t count;         // このタッチのサンプル数
+
+    bool active;
+    bool swiped;            // このタッチはスワイプとして確定済み
+    bool rotating;          // このタッチは回転として確定済み
+    int16_t start_x;
+    int16_t start_y;
+    uint32_t start_us;
+    uint16_t last_angle;
+    int32_t angle_accum;    // 次の通知までの回転量
+    int32_t angle_total;
+
+    // 統計
+    uint32_t swipes;
+    uint32_t rotations;
+    uint32_t swipe_ms_sum;  // 触れてからスワイプ確定までの時間
+
+public:
+    GestureRecognizer();
+
+    void reset();
+
+    // サンプルを1件入力 (ジェスチャーを判定したら out に入れて true)
+    bool feed(const TouchPoint& sample, uint32_t now_us, GestureEvent* out);
+
+    uint32_t getSwipeCount() const { return swipes; }
+    uint32_t getRotateCount() const { return rotations; }
+    uint32_t getAverageSwipeMs() const { return swipes ? swipe_ms_sum / swipes : 0; }
+    void resetStats() { swipes = rotations = swipe_ms_sum = 0; }
+
+    // 中心から見た (dx, dy) の角度 (1周 = 65536, +x軸が0, 時計回りに増える)
+    static uint16_t angleOf(int32_t dx, int32_t dy);
+
+private:
+    const Sample& latest() const { return ring[(count - 1) & (GESTURE_RING_SIZE - 1)]; }
+    bool checkSwipe(const Sample& now, GestureEvent* out);
+    bool checkRotate(const Sample& now, GestureEvent* out);
+    void velocity(const Sample& now, int16_t* vx, int16_t* vy) const;
+};
+
+#endif
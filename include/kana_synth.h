@@ -0,0 +1,143 @@
+/**
+ * Kana Synth
+ * かなを読み上げる小さなフォルマント合成器 (AudioOutput の音源)
+ *
+ * 辞書も波形データも持たず、声帯パルスとノイズを共振器 (F1-F3) に通して
+ * モーラ (かな1文字ぶんの音) を作る。RAMは1インスタンス2KB程度。
+ *
+ * - feed() で受け取ったテキストはその場でモーラ列に変換してキューに積む。
+ *   合成は AudioOutput のタスクが fill() を呼んだときに少しずつ行うので、
+ *   最初のフレーズを積んだ時点で話し始め、後続のテキストは話している間に足せる
+ * - feed() / finish() / reset() は1つのタスク (loop) から、fill() は再生タスクから呼ぶ
+ *   (モーラのキューはロックなしのSPSC)
+ * - ひらがな・カタカナ・長音・句読点を読む。漢字と英字は読みが分からないので
+ *   それらしい「むにゃむにゃ」のモーラにする (口が止まらないように)
+ * - 「？」で終わるフレーズは語尾を上げる
+ *
+ *   synth.reset();
+ *   synth.feed("こんにちは、");
+ *   audio->play(KanaSynth::fill, &synth);
+ *   synth.feed("カービィだよ！");
+ *   synth.finish();
+ */
+
+#ifndef KANA_SYNTH_H
+#define KANA_SYNTH_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "audio_output.h"
+
+#define KANA_QUEUE_SIZE         256     // モーラ (2のべき乗)
+#define KANA_MORA_MS            115     // 1モーラの長さ
+#define KANA_SHORT_PAUSE_MS     160     // 、
+#define KANA_LONG_PAUSE_MS      320     // 。！？
+#define KANA_PITCH_HZ           290     // 基本の声の高さ
+#define KANA_CONTROL_SAMPLES    32      // パラメータを更新する間隔 (2ms)
+
+// モーラ (子音 + 母音 + 長さ)
+struct KanaMora {
+    uint8_t consonant;
+    uint8_t vowel;
+    uint8_t flags;
+    uint8_t length;         // 10ms単位
+};
+
+struct KanaSynthStats {
+    uint32_t morae;
+    uint32_t samples;           // 作ったサンプル数 (無音待ちを除く)
+    uint32_t starved_samples;   // テキスト待ちで無音を出した数
+    uint32_t synth_us;          // 合成にかかった時間
+    uint32_t first_audio_us;    // reset() から最初の音を作るまで
+    uint32_t dropped;           // キューが満杯で捨てたモーラ
+};
+
+class KanaSynth {
+public:
+    KanaSynth();
+
+    // 読み上げを最初からやり直す (キューは再生タスク側で空にする)
+    void reset();
+
+    // UTF-8テキストを追加 (途中で切れた文字は次の feed() につなげる)
+    void feed(const char* text);
+    void feed(const String& text) { feed(text.c_str()); }
+
+    // これ以上テキストは来ない (キューを読み終えたら fill() が 0 を返す)
+    void finish();
+
+    bool isSpeaking();
+
+    // AudioFillFn
+    static size_t fill(void* ctx, int16_t* scratch, size_t max_samples, const int16_t** out);
+
+    // テキストを再生せずに合成して、実時間比を表示する
+    static void benchmark(const char* text);
+
+    const KanaSynthStats& getStats() { return stats; }
+    void printStats();
+
+private:
+    // 2次の共振器 (Klatt型, 直流ゲイン1)
+    struct Resonator {
+        float a, b, c;
+        float y1, y2;
+
+        void set(float freq, float bw);
+        inline float process(float x) {
+            float y = a * x + b * y1 + c * y2;
+            y2 = y1;
+            y1 = y;
+            return y;
+        }
+    };
+
+    // ---- feed 側 (loop) ----
+    KanaMora queue[KANA_QUEUE_SIZE];
+    std::atomic<uint32_t> queue_head;
+    std::atomic<uint32_t> queue_tail;
+    std::atomic<uint32_t> reset_seq;    // reset() のたびに進める
+    std::atomic<uint32_t> reset_to;     // reset() 時点の head (ここまでを捨てる)
+    std::atomic<bool> finished;
+    uint8_t utf8_pending[4];            // 途中で切れたUTF-8
+    uint8_t utf8_len;
+    bool has_last;                      // 直前のモーラがまだキューに積まれていない
+    KanaMora last;                      // (小書きかな・長音で書き換えるため1つ遅らせる)
+    uint32_t reset_us;
+
+    // ---- fill 側 (再生タスク) ----
+    uint32_t seen_reset;
+    bool active;
+    KanaMora mora;
+    uint32_t mora_pos;                  // モーラ内のサンプル位置
+    uint32_t mora_len;
+    uint16_t phrase_index;              // フレーズ内の何モーラ目か
+    bool first_audio;
+
+    float f0, f0_target;
+    float glottal_phase;
+    float glottal_prev;
+    float voice_amp, voice_step;
+    float noise_amp, noise_step;
+    float asp_amp, asp_step;            // 声道を通すノイズ (は行)
+    float formant[3];
+    float formant_target[3];
+    uint32_t noise_seed;
+    uint16_t control_left;
+
+    Resonator f1, f2, f3;
+    Resonator fric;                     // 摩擦音・破裂音のノイズ用
+
+    KanaSynthStats stats;
+
+    void push(const KanaMora& m);
+    void flushLast();
+    void addCodepoint(uint32_t cp);
+    void addPause(uint16_t ms, bool question);
+
+    bool nextMora();
+    void control();
+    size_t render(int16_t* out, size_t count);
+};
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * Lip Sync
+ * 音の大きさから口の開き具合を決める
+ *
+ * - audio_talk_level() は AudioOutput の「いま鳴っている音」のRMSを
+ *   開き具合 (0..ANIM_OPEN_MAX) にする。描画が画面に出るまでの分 (LIPSYNC_LEAD_MS) だけ先の音を見る
+ * - 何も鳴っていなければ TALK_LEVEL_SILENT を返す。
+ *   話すアニメーションは、その間に音が出ていなければ一定の周期で口を動かす (考え中など)
+ * - lipsync_follow() は LIPSYNC_PERIOD_MS ごとに呼んで、開くときはすぐ、閉じるときはゆっくり追う
+ *
+ * LVGLには依存しない (character.cpp のタイマーから呼ぶ)。
+ */
+
+#ifndef LIP_SYNC_H
+#define LIP_SYNC_H
+
+#include <stdint.h>
+
+#define ANIM_OPEN_MAX           1000    // 開き具合の最大値 (補間の分解能)
+
+#define LIPSYNC_PERIOD_MS       16      // 音量を見る間隔
+#define LIPSYNC_RELEASE_MS      90      // 全開から閉じるまでの最短時間 (開くのは即座)
+#define LIPSYNC_RMS_FLOOR       300     // これ以下は閉じる (無音・息)
+#define LIPSYNC_RMS_FULL        6000    // これ以上は全開
+#define LIPSYNC_LEAD_MS         12      // 描画と転送にかかる時間
+
+#define TALK_LEVEL_SILENT       -1      // 音が出ていない
+
+// 今の音量を口の開き具合 (0..ANIM_OPEN_MAX) で返す。音が出ていなければ TALK_LEVEL_SILENT
+typedef int32_t (*TalkLevelFn)(void *ctx);
+
+// RMS (0..32767) → 開き具合
+inline int32_t lipsync_level(int32_t rms) {
+    if (rms <= LIPSYNC_RMS_FLOOR) {
+        return 0;
+    }
+    if (rms >= LIPSYNC_RMS_FULL) {
+        return ANIM_OPEN_MAX;
+    }
+    return (rms - LIPSYNC_RMS_FLOOR) * ANIM_OPEN_MAX / (LIPSYNC_RMS_FULL - LIPSYNC_RMS_FLOOR);
+}
+
+// 1周期ぶん口を動かす: 大きくなったらすぐ開き、小さくなったら1周期に決まった量だけ閉じる
+inline int32_t lipsync_follow(int32_t level, int32_t current) {
+    if (level < 0) level = 0;
+    if (level > ANIM_OPEN_MAX) level = ANIM_OPEN_MAX;
+    if (level >= current) {
+        return level;
+    }
+    int32_t release = ANIM_OPEN_MAX * LIPSYNC_PERIOD_MS / LIPSYNC_RELEASE_MS;
+    return current - release > level ? current - release : level;
+}
+
+// TalkLevelFn (ctx は AudioOutput*)
+int32_t audio_talk_level(void *ctx);
+
+#endif
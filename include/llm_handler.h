@@ -23,6 +23,13 @@
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include "tiny_llm.h"
+#include "response_cache.h"
+#include "conversation_history.h"
+#include "text_builder.h"
+#include "trace.h"
+#if ENABLE_TRACE
+#include <WiFiClientSecure.h>
+#endif
 
 // LLM統合タイプ
 enum LLMType {
@@ -32,7 +39,31 @@ enum LLMType {
     LLM_CLOUD_GEMINI,    // Google Gemini
     LLM_LOCAL_SERVER,    // ローカルサーバー (Ollama等)
     LLM_TINY_LOCAL,      // ESP32上の超軽量モデル(TinyLLM)
-    LLM_RULE_BASED       // ルールベース応答(高速・軽量)
+    LLM_RULE_BASED,      // ルールベース応答(高速・軽量)
+    LLM_AUTO_ROUTE       // 複数バックエンドを順に試す (addRouteで設定)
+};
+
+// ルーター設定
+#define MAX_LLM_ROUTES          4
+#define DEFAULT_LATENCY_BUDGET  8000   // 1回の応答に許す合計時間(ms)
+#define MIN_ROUTE_ATTEMPT_MS    300    // 残り時間がこれ未満なら次を試さない
+#define ROUTE_BACKOFF_MS        5000   // 失敗時の一時スキップ時間(連続失敗で倍増)
+
+// プロンプト/リクエストボディ用バッファ (PSRAMに一度だけ確保)
+#define PROMPT_BUFFER_SIZE      6144
+#define REQUEST_BUFFER_SIZE     8192
+
+// バックエンドごとのルート情報
+struct LLMRoute {
+    LLMType type;
+    String endpoint;
+    String api_key;
+    String model;
+    uint32_t deadline_ms;     // このバックエンドに許す最大時間
+    uint32_t avg_latency_ms;  // 応答時間の移動平均 (0 = 未計測)
+    uint16_t failures;        // 連続失敗回数
+    uint32_t skip_until;      // この時刻(millis)まで使わない
+    uint32_t successes;
 };
 
 class LLMHandler {
@@ -44,19 +75,41 @@ private:
     
     WiFiClient wifi_client;
     HTTPClient http_client;
+    #if ENABLE_TRACE
+    WiFiClientSecure tls_client;    // DNS/TLSを分けて計測するため自前で接続する
+    #endif
     
-    // 会話履歴 (メモリ制約のため最近のN件のみ)
-    static const int MAX_HISTORY = 5;
-    String conversation_history[MAX_HISTORY * 2]; // user, assistant pairs
-    int history_count;
+    // 会話履歴 (トークン予算つきリングバッファ、古いターンは要約に回す)
+    ConversationHistory history;
+    
+    // プロンプトとリクエストボディの組み立て先 (毎回のString確保を避ける)
+    TextBuilder prompt_builder;
+    TextBuilder body_builder;
     
     // キャラクター設定
     String system_prompt;
+    uint32_t persona_hash;  // 応答キャッシュのキーに使う
     
     // ローカルLLMエンジン
     TinyLLM* tiny_llm;
     SimpleResponder* simple_responder;
     
+    // 応答キャッシュ
+    ResponseCache* response_cache;
+    
+    // 直前のリクエストが失敗したか (エラー応答はキャッシュしない)
+    bool request_failed;
+    
+    // 生成中のトークンの通知先 (TinyLLMだけ。クラウドは応答がそろってから返る)
+    TinyLLMTokenFn token_fn;
+    void* token_ctx;
+    
+    // バックエンドルーター
+    LLMRoute routes[MAX_LLM_ROUTES];
+    int route_count;
+    uint32_t latency_budget_ms;
+    uint32_t request_timeout_ms;  // 0 = 各バックエンドの既定値
+    
 public:
     LLMHandler();
     ~LLMHandler();
@@ -75,24 +128,52 @@ public:
     // 会話処理
     String chat(const String& user_message);
     void clearHistory();
+    void abort();  // 実行中の推論を中断 (別タスクから呼び出し可)
+    void clearAbort();  // 中断フラグを下ろす (ワーカーが次の要求の前に呼ぶ)
+    // chat() の生成途中のテキストを受け取る (chat() を呼ぶタスクで呼ばれる)
+    void setTokenCallback(TinyLLMTokenFn fn, void* ctx) { token_fn = fn; token_ctx = ctx; }
     
     // ローカルLLM管理
     bool initTinyLLM();
     bool initSimpleResponder();
     bool loadTinyModel(const char* path);
+    bool enableIntentSearch(const char* vectors_path = INTENT_VECTORS_PATH);  // TinyLLMの埋め込みでルールを引く
+    SimpleResponder* getSimpleResponder() { return simple_responder; }
+    
+    // バックエンドルーター (LLM_AUTO_ROUTE用、追加した順に試す)
+    bool addRoute(LLMType type, const String& endpoint = "",
+                  const String& key = "", const String& model = "",
+                  uint32_t deadline_ms = 5000);
+    void clearRoutes();
+    void setLatencyBudget(uint32_t budget_ms);
+    void printRouteStats();
+    
+    // 応答キャッシュ
+    bool initResponseCache(int entries = RESPONSE_CACHE_ENTRIES,
+                           uint32_t ttl_ms = RESPONSE_CACHE_TTL_MS,
+                           bool flash_tier = false);
+    ResponseCache* getResponseCache() { return response_cache; }
     
     // プリセットプロンプト
     void setupKirbyPersonality();
     void setupCuteAssistant();
     
 private:
+    String dispatch(LLMType type, const String& message);
+    String processRouted(const String& message);
+    bool routeNeedsWiFi(LLMType type);
+    void updateRouteStats(LLMRoute& route, uint32_t elapsed, bool failed);
+    
+    bool beginHttp();
     String sendCloudRequest(const String& message);
     String sendLocalRequest(const String& message);
     String processTinyLocal(const String& message);
     String processRuleBased(const String& message);
     
     void addToHistory(const String& user_msg, const String& assistant_msg);
-    String buildPrompt(const String& current_message);
+    int historyStart(const String& current_message);
+    const char* buildPrompt(const String& current_message);
+    bool buildCloudBody(const String& message);
     
     // JSON処理
     String parseOpenAIResponse(const String& response);
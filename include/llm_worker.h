@@ -0,0 +1,98 @@
+/**
+ * Asynchronous LLM Worker
+ * LLMHandler::chat を専用のFreeRTOSタスクで実行する非同期パイプライン
+ *
+ * loop() (コア1) から chat() を直接呼ぶと、HTTPタイムアウト(15-30秒)の間
+ * lv_timer_handler() やタッチ処理が止まってしまう。
+ * リクエストはキューに積み、もう一方のコア(コア0)のワーカーで処理し、
+ * 結果は結果キュー経由でUIループに返す。
+ *
+ * - submit()    : リクエストを投入 (ノンブロッキング)
+ * - poll()      : 結果を取り出す (ノンブロッキング、loop()から毎回呼ぶ)
+ * - cancelAll() : 待機中/実行中のリクエストをキャンセル
+ *
+ * TinyLLMの生成中は、句読点で区切ったフレーズを partial の結果として先に返す。
+ * 最後の結果 (partial = false) は応答全体で、streamed バイトまではもう返したもの。
+ * 読み上げ側は最初のフレーズで話し始め、最後の結果で残りを足して終える。
+ */
+
+#ifndef LLM_WORKER_H
+#define LLM_WORKER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "llm_handler.h"
+
+// ワーカー設定
+#define LLM_WORKER_QUEUE_LEN   4
+#define LLM_WORKER_MSG_SIZE    256     // ユーザーメッセージ最大バイト数
+#define LLM_WORKER_REPLY_SIZE  512     // 応答最大バイト数
+#define LLM_WORKER_STACK_SIZE  12288   // HTTPS + JSON処理に十分なスタック
+#define LLM_WORKER_PRIORITY    1
+#define LLM_WORKER_CORE        0       // loop()はコア1で動くので反対側
+#define LLM_WORKER_PHRASE_MAX  96      // 句読点がなくてもこのバイト数で区切る
+
+// キューに流す要素はStringを含まない固定長構造体
+// (Stringはヒープを指すため、タスク間でmemcpyすると壊れる)
+struct LLMRequest {
+    uint32_t id;
+    char message[LLM_WORKER_MSG_SIZE];
+};
+
+struct LLMResult {
+    uint32_t id;
+    uint32_t elapsed_ms;
+    bool partial;           // 生成途中のフレーズ (response はそのフレーズだけ)
+    uint16_t streamed;      // 最後の結果で、先頭から何バイトをフレーズとして返したか
+    char response[LLM_WORKER_REPLY_SIZE];
+};
+
+class LLMWorker {
+private:
+    LLMHandler* llm;
+    TaskHandle_t task_handle;
+    QueueHandle_t request_queue;
+    QueueHandle_t result_queue;
+
+    uint32_t next_id;
+    volatile uint32_t cancel_before;   // このID以下のリクエストは破棄
+    volatile uint32_t active_id;       // 処理中のID (0 = 待機中)
+
+    // 生成途中のテキスト (ワーカータスクだけが触る)
+    char stream_text[LLM_WORKER_REPLY_SIZE];
+    uint16_t stream_len;
+    uint16_t stream_sent;              // フレーズとして結果キューに入れた長さ
+
+public:
+    LLMWorker();
+    ~LLMWorker();
+
+    // ワーカータスク起動
+    bool begin(LLMHandler* handler,
+               BaseType_t core = LLM_WORKER_CORE,
+               UBaseType_t priority = LLM_WORKER_PRIORITY);
+
+    // リクエスト投入 (キューが満杯なら0を返す)
+    uint32_t submit(const String& message);
+
+    // 完了した結果を1件取り出す (なければfalse)
+    bool poll(LLMResult* result);
+
+    // 待機中・処理中のリクエストをすべてキャンセル
+    void cancelAll();
+
+    bool isBusy();
+    int pendingCount();
+    TaskHandle_t getTaskHandle() { return task_handle; }
+
+private:
+    static void taskEntry(void* arg);
+    static void onToken(void* ctx, const char* text);
+    void run();
+    void sendPhrase();
+    bool isCancelled(uint32_t id) { return id <= cancel_before; }
+};
+
+#endif
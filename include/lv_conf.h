@@ -11,11 +11,37 @@
 #define LV_COLOR_DEPTH 16
 
 /* Swap the 2 bytes of RGB565 color. Useful if the display has an 8-bit interface (e.g. SPI) */
-#define LV_COLOR_16_SWAP 0
+/* SPIへそのままDMA転送できるようにLVGL側で上位バイトを先に並べる */
+#define LV_COLOR_16_SWAP 1
 
 /* Memory settings */
+/* LV_MEM_IN_PSRAM=1 でLVGLのヒープをPSRAMに置く (内部RAMを描画バッファに回せる) */
+#ifndef LV_MEM_IN_PSRAM
+#define LV_MEM_IN_PSRAM 0
+#endif
+#if LV_MEM_IN_PSRAM
+#define LV_MEM_CUSTOM 1
+#define LV_MEM_CUSTOM_INCLUDE <esp32-hal-psram.h>
+#define LV_MEM_CUSTOM_ALLOC ps_malloc
+#define LV_MEM_CUSTOM_FREE free
+#define LV_MEM_CUSTOM_REALLOC ps_realloc
+#else
 #define LV_MEM_CUSTOM 0
-#define LV_MEM_SIZE (128U * 1024U)  /* 128KB for LVGL */
+#ifndef LV_MEM_SIZE_KB
+#define LV_MEM_SIZE_KB 128
+#endif
+#define LV_MEM_SIZE (LV_MEM_SIZE_KB * 1024U)
+#endif
+
+/* Tick: Arduinoのmillis()をLVGLの時刻にする (lv_tick_inc不要) */
+/* ホストテストでは lv_tick_inc() で進める (描画結果を時刻に依存させない) */
+#ifdef ARDUINO
+#define LV_TICK_CUSTOM 1
+#define LV_TICK_CUSTOM_INCLUDE "Arduino.h"
+#define LV_TICK_CUSTOM_SYS_TIME_EXPR (millis())
+#else
+#define LV_TICK_CUSTOM 0
+#endif
 
 /* Display settings */
 #define LV_HOR_RES_MAX 360
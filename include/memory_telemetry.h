@@ -0,0 +1,98 @@
+/**
+ * Memory Telemetry
+ * 内部ヒープ・PSRAM・LVGLヒープ・タスクスタックを定期的に記録する
+ *
+ * 数日動かしてから落ちるような断片化やリークを、デバッガなしで追うためのもの。
+ * - 短期履歴: MEM_TELEMETRY_PERIOD_MS ごとのサンプルを MEM_SHORT_HISTORY 件
+ * - 長期履歴: 短期 MEM_LONG_EVERY 件ごとに、その間の最悪値を MEM_LONG_HISTORY 件
+ *   (既定で 1分 × 120件 と 15分 × 192件 = 2日分)
+ * - 'm' コマンドで履歴と傾向 (1時間あたりの増減、断片化率) を出力
+ *
+ * sample() と snapshot() は lv_mem_monitor() を呼ぶのでLVGLと同じタスク (loop) から呼ぶ。
+ * 出力 (dump) は snapshot() の写しだけを読むので、時間のかかる表示は別タスクでよい。
+ */
+
+#ifndef MEMORY_TELEMETRY_H
+#define MEMORY_TELEMETRY_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define MEM_TELEMETRY_PERIOD_MS 60000
+#define MEM_SHORT_HISTORY       120
+#define MEM_LONG_EVERY          15
+#define MEM_LONG_HISTORY        192
+#define MEM_MAX_TASKS           6       // loop, llm, touch, audio, serial_job + 予備
+
+struct MemorySample {
+    uint32_t uptime_s;
+    uint32_t heap_free;         // 内部RAM (bytes)
+    uint32_t heap_largest;      // 内部RAMの最大連続ブロック
+    uint32_t heap_min;          // 起動以来の最小空き
+    uint16_t psram_free_kb;
+    uint16_t psram_largest_kb;
+    uint32_t lv_free;           // LVGLヒープの空き
+    uint8_t lv_used_pct;
+    uint8_t lv_frag_pct;
+    uint16_t stack_free[MEM_MAX_TASKS];     // スタックの残り最小値 (bytes)
+};
+
+// dump() で出力する写し (履歴は古い順に並べ直す)
+struct MemorySnapshot {
+    MemorySample now;
+    MemorySample short_history[MEM_SHORT_HISTORY];
+    MemorySample long_history[MEM_LONG_HISTORY];
+    uint32_t n_short;
+    uint32_t n_long;
+};
+
+class MemoryTelemetry {
+private:
+    struct TaskEntry {
+        const char* name;
+        TaskHandle_t handle;
+    };
+
+    TaskEntry tasks[MEM_MAX_TASKS];
+    int num_tasks;
+
+    MemorySample* short_history;    // PSRAM (内部RAMを測るのに内部RAMを使わない)
+    MemorySample* long_history;
+    uint32_t short_count;       // これまでのサンプル数 (位置 = count % SIZE)
+    uint32_t long_count;
+    MemorySample window_worst;  // 長期履歴に入れる前の最悪値
+
+    MemorySnapshot* snap;       // PSRAM
+    volatile bool snap_busy;    // 写しを取ってから出力し終わるまで
+
+public:
+    MemoryTelemetry();
+    ~MemoryTelemetry();
+
+    // 履歴バッファ確保
+    bool begin();
+
+    // スタックを監視するタスク (nullptr なら呼び出し元のタスク)
+    bool addTask(const char* name, TaskHandle_t handle = nullptr);
+
+    // 1件記録 (定期的に呼ぶ)
+    void sample();
+    bool latest(MemorySample* out);
+
+    // 現在値と履歴を写す (loop から)。バッファがないか前の写しをまだ出力中なら false
+    bool snapshot();
+    // 写しの履歴と傾向をシリアルに出力して手放す (どのタスクからでもよい)
+    void dump();
+    void releaseSnapshot() { snap_busy = false; }
+
+private:
+    void capture(MemorySample* s);
+    static void mergeWorst(MemorySample* worst, const MemorySample& s);
+    void printHeader();
+    void printCurrent(const MemorySample& now);
+    void printSample(const MemorySample& s);
+    void printTrend(const char* label, const MemorySample& first, const MemorySample& last);
+};
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * Pattern Matcher (Aho-Corasick)
+ * SimpleResponderのルールパターンを1パスで照合するオートマトン
+ *
+ * ルールごとに toLowerCase() + indexOf() を繰り返すと
+ * O(ルール数 × 入力長) の時間と大量の一時Stringが必要になる。
+ * 全パターンを一度だけオートマトンにコンパイルし、入力を1回走査するだけで
+ * 含まれているすべてのパターンを列挙する。
+ *
+ * UTF-8について:
+ *   バイト単位で照合するが、UTF-8は自己同期的な符号化なので
+ *   文字の途中から誤ってマッチすることはない (日本語パターンもそのまま使える)。
+ *   ASCIIのみ大文字小文字を区別しない (String::toLowerCase と同じ)。
+ *
+ * 構築後のテーブルはコンパクトな配列 (PSRAM) で、照合中はヒープを使わない。
+ */
+
+#ifndef PATTERN_MATCHER_H
+#define PATTERN_MATCHER_H
+
+#include <Arduino.h>
+#include <vector>
+
+class PatternMatcher {
+public:
+    // マッチ通知 (pattern_id は addPattern() に渡したID)
+    typedef void (*MatchCallback)(uint16_t pattern_id, void* ctx);
+
+private:
+    // 構築済みテーブル
+    struct State {
+        uint32_t first_edge;    // edges[] の開始位置
+        uint16_t edge_count;
+        uint16_t out_count;     // この状態で終わるパターン数
+        uint32_t out_first;     // outputs[] の開始位置
+        int32_t fail;           // 失敗遷移
+        int32_t dict_link;      // 出力を持つ最も近い接尾辞状態 (-1 = なし)
+    };
+
+    // 遷移: 上位8bit = 入力バイト, 下位24bit = 遷移先 (byteでソート済み)
+    uint32_t* edges;
+    State* states;
+    uint16_t* outputs;
+    int32_t root_next[256];     // ルートからの遷移は直接引く
+
+    int num_states;
+    int num_edges;
+    int num_outputs;
+    bool compiled;
+
+    // 構築中のトライ
+    struct BuildNode {
+        std::vector<std::pair<uint8_t, int32_t>> next;
+        std::vector<uint16_t> out;
+    };
+    std::vector<BuildNode> trie;
+
+public:
+    PatternMatcher();
+    ~PatternMatcher();
+
+    void clear();
+
+    // パターン追加 (build()前に呼ぶ)
+    bool addPattern(const char* pattern, uint16_t pattern_id);
+
+    // トライからオートマトンを構築し、コンパクトなテーブルに変換
+    bool build();
+
+    // text 中に現れるパターンをすべて通知 (同じパターンが複数回通知されることもある)
+    void match(const char* text, MatchCallback callback, void* ctx) const;
+
+    bool isCompiled() const { return compiled; }
+    int getStateCount() const { return num_states; }
+    size_t getMemoryUsage() const;
+
+    static inline uint8_t foldCase(uint8_t c) {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+private:
+    int32_t next(int32_t state, uint8_t c) const;
+    void freeTables();
+};
+
+#endif
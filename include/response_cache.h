@@ -0,0 +1,98 @@
+/**
+ * Response Cache for LLMHandler
+ * 繰り返されるプロンプトへの応答キャッシュ
+ *
+ * 「こんにちは」のような定番の挨拶のたびにクラウドへ往復したり
+ * TinyLLMで推論したりするのは無駄なので、
+ * 正規化したユーザーメッセージ + ペルソナ(システムプロンプト)のハッシュを
+ * キーにしたLRUキャッシュで応答を再利用する。
+ *
+ * - 1段目: PSRAM上の固定長エントリ (LRU + TTL)
+ * - 2段目: フラッシュ(NVS)上のダイレクトマップ領域 (オプション、再起動後も有効)
+ */
+
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <Arduino.h>
+
+// キャッシュ設定
+#define RESPONSE_CACHE_ENTRIES     32
+#define RESPONSE_CACHE_KEY_SIZE    128                    // 正規化後のメッセージ
+#define RESPONSE_CACHE_VALUE_SIZE  384                    // 応答
+#define RESPONSE_CACHE_TTL_MS      (30UL * 60UL * 1000UL) // 30分
+#define RESPONSE_CACHE_FLASH_SLOTS 16
+#define RESPONSE_CACHE_FLASH_TTL_S (24UL * 60UL * 60UL)   // 1日 (時刻同期済みの場合のみ)
+
+class ResponseCache {
+private:
+    struct Entry {
+        uint32_t hash;              // キー文字列のハッシュ
+        uint32_t persona;           // システムプロンプトのハッシュ
+        uint32_t created_ms;
+        uint32_t last_used;         // LRU用の使用順カウンタ
+        uint32_t origin_latency_ms; // 元の応答にかかった時間
+        bool valid;
+        char key[RESPONSE_CACHE_KEY_SIZE];
+        char value[RESPONSE_CACHE_VALUE_SIZE];
+    };
+
+    // フラッシュ段のレコード (NVSのblobとして保存)
+    struct FlashRecord {
+        uint32_t hash;
+        uint32_t persona;
+        uint32_t saved_epoch;       // 0 = 時刻未同期
+        uint32_t origin_latency_ms;
+        char key[RESPONSE_CACHE_KEY_SIZE];
+        char value[RESPONSE_CACHE_VALUE_SIZE];
+    };
+
+    Entry* entries;                 // PSRAM
+    int capacity;
+    uint32_t ttl_ms;
+    uint32_t use_counter;
+    bool flash_tier;
+
+    // 統計
+    uint32_t hits;
+    uint32_t flash_hits;
+    uint32_t misses;
+    uint64_t saved_ms;
+
+public:
+    ResponseCache();
+    ~ResponseCache();
+
+    bool init(int num_entries = RESPONSE_CACHE_ENTRIES,
+              uint32_t ttl = RESPONSE_CACHE_TTL_MS,
+              bool use_flash = false);
+
+    // 見つかれば out に応答を入れて true。origin_latency_ms は元の応答時間
+    bool lookup(const String& message, uint32_t persona_hash,
+                String& out, uint32_t* origin_latency_ms);
+    void store(const String& message, uint32_t persona_hash,
+               const String& response, uint32_t latency_ms);
+    void clear();
+
+    // 統計
+    void recordSaving(uint32_t origin_latency_ms, uint32_t hit_latency_ms);
+    float getHitRate();
+    uint32_t getHits() { return hits; }
+    uint32_t getMisses() { return misses; }
+    uint32_t getSavedMs() { return (uint32_t)saved_ms; }
+    void printStats();
+
+    static uint32_t hashString(const char* str);
+
+private:
+    // 空白・句読点を除去し、ASCIIは小文字化 (out_size に入りきらなければ false)
+    static bool normalize(const String& input, char* out, size_t out_size);
+    Entry* find(const char* key, uint32_t hash, uint32_t persona);
+    Entry* victim();
+
+    bool loadFromFlash(const char* key, uint32_t hash, uint32_t persona,
+                       String& out, uint32_t* origin_latency_ms);
+    void saveToFlash(const Entry* entry);
+};
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * Round Clip
+ * 丸型パネルの行ごとの表示範囲と、LVGLの無効領域をその内側に縮める規則
+ *
+ * - round_clip_build() は各行の円の内側 [x0, x1] (+ 余白) を表にする
+ * - round_clip_area() は rounder_cb から呼び、領域を横方向だけ縮める。
+ *   縦 (y1, y2) は変えない: LVGLは rounder の結果の高さからバンドの行数を決める
+ *   (get_max_row() が {0, 0, 0, max_row - 1} を渡して確かめる) ので、
+ *   縦を縮めると1行ずつの描画になってしまう
+ *
+ * LVGLの型だけに依存する (DisplayDriver とホストテストの画面で共有)。
+ */
+
+#ifndef ROUND_CLIP_H
+#define ROUND_CLIP_H
+
+#include <lvgl.h>
+#include <math.h>
+#include <stdint.h>
+
+// 画素の中心が円内に入る範囲 + 余白
+inline void round_clip_build(int16_t* span_x0, int16_t* span_x1,
+                             int32_t width, int32_t height, int32_t margin) {
+    const float cx = width / 2.0f;
+    const float cy = height / 2.0f;
+    const float r = width / 2.0f;
+
+    for (int32_t y = 0; y < height; y++) {
+        float dy = y + 0.5f - cy;
+        float d2 = r * r - dy * dy;
+        float half = d2 > 0 ? sqrtf(d2) : 0.0f;
+        int32_t x0 = (int32_t)ceilf(cx - 0.5f - half) - margin;
+        int32_t x1 = (int32_t)floorf(cx - 0.5f + half) + margin;
+        span_x0[y] = (int16_t)(x0 < 0 ? 0 : (x0 > width - 1 ? width - 1 : x0));
+        span_x1[y] = (int16_t)(x1 < 0 ? 0 : (x1 > width - 1 ? width - 1 : x1));
+    }
+}
+
+// 領域の行の表示範囲を合わせたものに x1/x2 を縮める (交わらなければそのまま)
+inline void round_clip_area(lv_area_t* area, const int16_t* span_x0, const int16_t* span_x1,
+                            int32_t height) {
+    int32_t y1 = area->y1 < 0 ? 0 : area->y1;
+    int32_t y2 = area->y2 > height - 1 ? height - 1 : area->y2;
+
+    int32_t x0 = INT16_MAX;
+    int32_t x1 = -1;
+    for (int32_t y = y1; y <= y2; y++) {
+        if (span_x0[y] < x0) x0 = span_x0[y];
+        if (span_x1[y] > x1) x1 = span_x1[y];
+    }
+
+    // 円の外の無効領域は捨てられない (描画は一瞬で終わるので縮めなくてよい)
+    if (x0 > area->x2 || x1 < area->x1) {
+        return;
+    }
+    if (area->x1 < x0) area->x1 = x0;
+    if (area->x2 > x1) area->x2 = x1;
+}
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * Loop Scheduler
+ * loop() の中で動く協調型のデッドライン駆動スケジューラ
+ *
+ * LVGLはスレッドセーフではないので、UI・シリアルコマンド・LLM応答の受け取りは
+ * すべて同じタスク (loop) で動かす。各処理を周期と優先度つきのタスクとして登録し、
+ * 期限が来たものから優先度順に1回ずつ実行する。
+ *
+ * - タスクは次に呼んでほしいまでの時間を返せる (0なら登録した周期)
+ * - 次の期限は「前回の期限 + 周期」(遅れても周期がずれない)。
+ *   1周期以上遅れたら今から数え直す
+ * - runOnce() は次の期限までの時間を返すので、その間 loop() は眠れる
+ * - タスクごとに開始の遅れ (ジッター) と実行時間を計測
+ *
+ * タスクの中でブロックすると他のタスクがすべて遅れる。
+ * 時間のかかる処理は別のFreeRTOSタスク (LLMWorker, タッチタスク, シリアルのジョブ) に任せるか、
+ * 描画ベンチマークのように1回ずつ小さく区切って呼んでもらう。
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define SCHED_MAX_TASKS     8
+
+class LoopScheduler {
+public:
+    // 戻り値: 次に呼ぶまでの時間(ms)。0なら登録した周期
+    typedef uint32_t (*TaskFn)(void* ctx);
+
+private:
+    struct Task {
+        const char* name;
+        TaskFn fn;
+        void* ctx;
+        uint32_t period_ms;
+        uint8_t priority;       // 大きいほど先に実行
+        uint32_t deadline_us;
+
+        // 統計
+        uint32_t runs;
+        uint32_t late_sum_us;
+        uint32_t late_max_us;
+        uint32_t run_sum_us;
+        uint32_t run_max_us;
+    };
+
+    Task tasks[SCHED_MAX_TASKS];
+    int num_tasks;
+    uint32_t stats_since_ms;
+
+public:
+    LoopScheduler();
+
+    // タスク登録 (戻り値はタスク番号, 失敗時は-1)
+    int addTask(const char* name, TaskFn fn, void* ctx, uint32_t period_ms, uint8_t priority);
+
+    // 次の実行を今すぐにする (イベントが来たときなど)
+    void wake(int task_id);
+
+    // 期限が来たタスクを優先度順に実行し、次の期限までの時間(ms)を返す
+    uint32_t runOnce();
+
+    void printStats();
+    void resetStats();
+
+private:
+    static bool isDue(uint32_t deadline_us, uint32_t now_us) {
+        return (int32_t)(now_us - deadline_us) >= 0;
+    }
+};
+
+#endif
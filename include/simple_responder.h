@@ -0,0 +1,182 @@
+/**
+ * Simple Responder
+ * ルールベースの高速応答エンジン (TinyLLM/クラウドのフォールバック)
+ *
+ * ルールDB:
+ * - ルールは64件単位のチャンクに格納し、文字列はPSRAM上のアリーナに詰める
+ *   (追加してもルール全体を再確保しない)
+ * - 照合用のAho-Corasickオートマトンは、追加されたルールが
+ *   RULE_REBUILD_THRESHOLD 件を超えていれば次の照合の前にまとめて再構築する
+ *   (それまでの新しいルールは線形に照合。addRule() を続けて呼んでも再構築は1回)
+ * - SPIFFS/SDからバイナリ(.bin)またはJSON Lines形式で数千件を読み込める
+ *
+ * 部分一致 (完全一致するルールがない場合):
+ * - UTF-8をコードポイント単位で読み、文字バイグラムの転置索引から候補を引く
+ *   (1文字のパターンは1文字で索引)
+ * - スコア = 共通するバイグラム数 / パターンのバイグラム数 × 0.5 × 優先度
+ * - 入力と1つもバイグラムを共有しないルールは走査しない
+ *
+ * 埋め込みモード (enableEmbedding):
+ * - TinyLLMのトークン埋め込みを平均した int8 ベクトルで入力を表し、
+ *   各ルールのパターンから作った意図ベクトルと最近傍探索 (int8内積)
+ * - 意図ベクトルはSPIFFSに保存しておき、起動時はファイルから読むだけ
+ *   "SRIV" u16 version(=1) u16 dim u32 count
+ *   count × { u8 pattern_len, pattern, int8[dim] }
+ * - キーワードで完全一致しなかった言い換えを generate() なしで拾う
+ *
+ * バイナリ形式 (リトルエンディアン):
+ *   "SRDB" u16 version(=1) u16 reserved u32 count
+ *   count × { u8 pattern_len, pattern, u16 response_len, response, u16 priority×1000 }
+ *
+ * JSON Lines形式 (1行1ルール):
+ *   {"p": "こんにちは", "r": "やっほー!", "w": 1.0}
+ */
+
+#ifndef SIMPLE_RESPONDER_H
+#define SIMPLE_RESPONDER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "pattern_matcher.h"
+
+// ルールDB設定
+#define RULE_CHUNK_SIZE         64
+#define MAX_RULE_CHUNKS         256      // 最大 16384 ルール
+#define RULE_ARENA_BLOCK_SIZE   16384    // 文字列アリーナのブロックサイズ
+#define MAX_RULE_ARENA_BLOCKS   128
+#define RULE_REBUILD_THRESHOLD  32       // 未索引ルールがこの件数を超えていたら照合前に再構築
+#define RULE_DB_MAGIC           "SRDB"
+#define RULE_DB_VERSION         1
+#define MAX_QUERY_GRAMS         256      // 入力から取り出すn-gramの上限
+#define RULE_TOP_K              4
+#define INTENT_DB_MAGIC         "SRIV"
+#define INTENT_DB_VERSION       1
+#define INTENT_VECTORS_PATH     "/intents.bin"
+#define INTENT_MIN_SIMILARITY   0.80f    // これ未満の最近傍は採用しない
+
+class TinyLLM;
+
+// 簡易的なルールベース応答（フォールバック）
+class SimpleResponder {
+private:
+    struct Rule {
+        const char* pattern;    // 小文字化済み (アリーナ内)
+        const char* response;   // アリーナ内
+        float priority;
+        uint16_t gram_count;    // パターンのn-gram数 (重複なし)
+    };
+
+    Rule* chunks[MAX_RULE_CHUNKS];
+    int num_rules;
+    int indexed_rules;          // オートマトンに登録済みのルール数
+
+    // 文字列アリーナ
+    char* arena_blocks[MAX_RULE_ARENA_BLOCKS];
+    int arena_count;
+    size_t arena_used;          // 最後のブロックの使用量
+    size_t arena_total;
+
+    // 全ルールのパターンをコンパイルしたオートマトン
+    PatternMatcher matcher;
+
+    // n-gram転置索引 (CSR形式, キーはソート済み)
+    uint64_t* gram_keys;
+    uint32_t* gram_offsets;     // gram_keys[i] のルールは postings[gram_offsets[i] .. gram_offsets[i+1])
+    uint16_t* postings;
+    int num_grams;
+    size_t num_postings;
+
+    // 照合用の作業領域 (ロック中のみ使用)
+    uint16_t* hit_counts;       // ルールごとの共通n-gram数
+    uint16_t* touched;          // hit_counts が0でないルール
+    uint64_t query_grams[MAX_QUERY_GRAMS];
+    uint64_t scratch_grams[MAX_QUERY_GRAMS];
+
+    // 埋め込みモード
+    TinyLLM* embedder;          // 所有しない
+    int8_t* intent_vectors;     // [num_intents, intent_dim]
+    uint16_t* intent_rules;     // ベクトルに対応するルール
+    float* intent_inv_norms;    // 1 / |v|
+    int num_intents;
+    int intent_dim;
+    float intent_threshold;
+
+    // 応答(ワーカータスク)と読み込み(loop)が別タスクから呼ばれるため
+    SemaphoreHandle_t lock;
+
+public:
+    struct Candidate {
+        int rule;
+        float score;
+    };
+
+    SimpleResponder();
+    ~SimpleResponder();
+
+    void init();
+    String respond(const String& input);
+    void addRule(const String& pattern, const String& response, float priority = 1.0f);
+
+    // ルールDBの読み込み (既存のルールに追加)
+    bool loadRulesFromSPIFFS(const char* path);
+    bool loadRulesFromSD(const char* path);
+    void clearRules();
+    void rebuildIndex();
+
+    // 部分一致スコアの上位k件 (スコア降順, 戻り値は件数)
+    int findCandidates(const String& input, Candidate* out, int k = RULE_TOP_K);
+    const char* getRuleResponse(int rule_index);
+
+    // 埋め込みモード (意図ベクトルをファイルから読み、なければ計算して保存)
+    bool enableEmbedding(TinyLLM* llm, const char* vectors_path = INTENT_VECTORS_PATH);
+    void disableEmbedding();
+    bool isEmbeddingEnabled() { return embedder && num_intents > 0; }
+    void setIntentThreshold(float similarity) { intent_threshold = similarity; }
+
+    int getRuleCount() { return num_rules; }
+    int getIndexedRuleCount() { return indexed_rules; }
+    size_t getMemoryUsage();
+    void printStats();
+
+    // 照合速度と部分一致の精度を計測 (シリアルに出力)
+    void benchmark(int iterations = 1000);
+    static void benchmarkScaling(int num_patterns, int iterations = 200);
+
+private:
+    Rule& rule(int i) { return chunks[i / RULE_CHUNK_SIZE][i % RULE_CHUNK_SIZE]; }
+    bool appendRule(const char* pattern, size_t pattern_len,
+                    const char* response, size_t response_len, float priority);
+    char* storeString(const char* text, size_t len);
+
+    bool loadRules(File& file);
+    bool loadBinary(File& file);
+    bool loadJsonLines(File& file);
+
+    bool compile();
+    void indexPendingRules();
+    bool buildGramIndex();
+    void freeGramIndex();
+    size_t gramIndexBytes();
+    int findBestRule(const String& input, float* best_score);
+    int scoreCandidates(const String& input, Candidate* out, int k);
+    int lookupGram(uint64_t key);
+    static void onMatch(uint16_t rule_id, void* ctx);
+
+    bool allocIntents(int count, int dim);
+    void freeIntents();
+    bool loadIntentVectors(const char* path);
+    bool saveIntentVectors(const char* path);
+    bool buildIntentVectors();
+    void finishIntent(int i);
+    int nearestIntent(const String& input, float* similarity);
+    static int32_t dotInt8(const int8_t* a, const int8_t* b, int n);
+
+    // UTF-8文字列からn-gramキーを取り出す (ソート・重複除去済み)
+    //   for_query = true : 入力用 (1文字 + 2文字をすべて)
+    //   for_query = false: パターン用 (2文字, 1文字だけのパターンは1文字)
+    static int extractGrams(const char* text, uint64_t* out, int max, bool for_query);
+};
+
+#endif
@@ -0,0 +1,49 @@
+/**
+ * Text Builder
+ * 事前確保したバッファに文字列を組み立てるビルダー
+ *
+ * String の += や "User: " + message + "\n" のような一時オブジェクトは
+ * そのたびにヒープを確保/解放し、長時間稼働でヒープが断片化する。
+ * プロンプトやリクエストボディは init() で一度だけ確保した
+ * バッファ (PSRAM優先) に直接書き込む。
+ *
+ * 容量を超えた場合は切り詰めて overflowed() が true になる。
+ */
+
+#ifndef TEXT_BUILDER_H
+#define TEXT_BUILDER_H
+
+#include <Arduino.h>
+
+class TextBuilder {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t len;
+    bool overflow;
+
+public:
+    TextBuilder();
+    ~TextBuilder();
+
+    bool init(size_t size);
+    void clear();
+
+    TextBuilder& append(const char* text);
+    TextBuilder& append(const char* text, size_t n);
+    TextBuilder& append(const String& text) { return append(text.c_str(), text.length()); }
+    TextBuilder& append(char c);
+    TextBuilder& appendInt(int32_t value);
+
+    // JSON文字列としてエスケープして追加 (appendJsonStringは前後の"も付ける)
+    TextBuilder& appendJsonEscaped(const char* text);
+    TextBuilder& appendJsonString(const char* text);
+
+    const char* c_str() const { return buffer ? buffer : ""; }
+    size_t length() const { return len; }
+    size_t getCapacity() const { return capacity; }
+    bool overflowed() const { return overflow; }
+    bool isReady() const { return buffer != nullptr; }
+};
+
+#endif
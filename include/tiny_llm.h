@@ -20,6 +20,8 @@
 #include <FS.h>
 #include <SD.h>
 #include <SPIFFS.h>
+#include "text_builder.h"
+#include "simple_responder.h"
 
 // モデル設定
 #define MAX_SEQ_LENGTH 128
@@ -28,10 +30,14 @@
 #define HIDDEN_DIM 256
 #define NUM_HEADS 4
 #define NUM_LAYERS 2
+#define PROMPT_MAX_BYTES 2048
 
 // 量子化設定
 #define USE_INT8_QUANTIZATION
 
+// 生成したトークンの文字列を受け取る (生成ループの中で呼ばれる)
+typedef void (*TinyLLMTokenFn)(void* ctx, const char* text);
+
 class TinyLLM {
 private:
     // モデルパラメータ（PSRAM上）
@@ -57,10 +63,23 @@ private:
     float* attention_output;
     int16_t* token_ids;
     
+    // chat()用のプロンプトバッファ
+    TextBuilder prompt_builder;
+    
     // キャッシュ
     float* kv_cache;
     int cache_length;
     
+    size_t allocated_bytes;     // allocPSRAM() で確保した合計
+    
+    // 生成中断フラグ (別タスクから書き込まれる)
+    volatile bool abort_requested;
+    uint32_t deadline_at;  // 生成を打ち切る時刻(millis)、0 = なし
+    
+    // トークンごとの通知 (応答をフレーズ単位で先に読み上げるため)
+    TinyLLMTokenFn token_fn;
+    void* token_ctx;
+    
 public:
     TinyLLM();
     ~TinyLLM();
@@ -71,15 +90,26 @@ public:
     bool loadModelFromSPIFFS(const char* path);
     
     // 推論
-    String generate(const String& prompt, int max_tokens = 50);
+    String generate(const char* prompt, int max_tokens = 50);
+    String generate(const String& prompt, int max_tokens = 50) {
+        return generate(prompt.c_str(), max_tokens);
+    }
     String chat(const String& message, const String& context = "");
     
     // トークナイザー
     int* tokenize(const String& text, int* length);
     String detokenize(int* tokens, int length);
     
+    // 文の埋め込み: トークン埋め込みの平均をint8 [EMBED_DIM] に量子化
+    // (コサイン類似度用なので、スケールは最大絶対値=127に正規化)
+    bool embed(const char* text, int8_t* out);
+    
     // ユーティリティ
     void clearCache();
+    void abort() { abort_requested = true; }
+    void clearAbort() { abort_requested = false; }  // 次の要求を受け付ける直前に呼ぶ
+    void setDeadline(uint32_t at_millis) { deadline_at = at_millis; }
+    void setTokenCallback(TinyLLMTokenFn fn, void* ctx) { token_fn = fn; token_ctx = ctx; }
     size_t getMemoryUsage();
     bool isModelLoaded() { return model_loaded; }
     
@@ -94,6 +124,10 @@ private:
     // メモリ管理
     bool allocateMemory();
     void freeMemory();
+    void* allocPSRAM(size_t size);
+    
+    // 事前確保したバッファにトークン化 (ヒープ確保なし)
+    int tokenizeInto(const char* text, int16_t* out, int max_length);
     
     // ヘルパー
     float dequantize(int8_t value, float scale);
@@ -112,28 +146,4 @@ namespace TinyLLMPrompts {
         "Keep responses brief and friendly.";
 }
 
-// 簡易的なルールベース応答（フォールバック）
-class SimpleResponder {
-private:
-    struct Rule {
-        String pattern;
-        String response;
-        float priority;
-    };
-    
-    Rule* rules;
-    int num_rules;
-    
-public:
-    SimpleResponder();
-    ~SimpleResponder();
-    
-    void init();
-    String respond(const String& input);
-    void addRule(const String& pattern, const String& response, float priority = 1.0f);
-    
-private:
-    float matchScore(const String& input, const String& pattern);
-};
-
 #endif
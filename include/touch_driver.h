@@ -1,6 +1,21 @@
 /**
  * Touch Driver for ESP32-S3-Touch-LCD-1.85
  * CST816S Capacitive Touch Controller
+ *
+ * 割り込みモード (startInterruptMode):
+ * - CST816Sはタッチ中だけ TOUCH_INT を周期的にLowにする
+ * - ISRはタスク通知を送るだけで、I2Cの読み出しは専用タスクで行う
+ * - 読んだ座標はロックフリーのSPSCキューに積み、LVGLの read_cb が取り出す
+ *   (指が離れている間はI2Cに一切アクセスしない)
+ * - 離したときの割り込みを取りこぼしても、タッチ中に割り込みが
+ *   TOUCH_RELEASE_TIMEOUT_MS 来なければ1回だけ読み直して離したことを確認する
+ * - タッチコールバックは取り出し側 (popEvent を呼んだタスク) で呼ばれる
+ *
+ * コールバックとゲッターはデバウンス済みの状態 (TouchStateMachine) を返す。
+ * 押した・離した・ジェスチャーをそれぞれ1回だけ通知する。
+ *
+ * スワイプと回転は座標列からソフトウェアで判定する (GestureRecognizer)。
+ * 有効な間はチップのスワイプコードは無視する (クリック・長押しはチップのまま)。
  */
 
 #ifndef TOUCH_DRIVER_H
@@ -8,6 +23,11 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "touch_state.h"
+#include "gesture_recognizer.h"
 
 // Touch I2C
 #define TOUCH_SDA  4
@@ -16,28 +36,66 @@
 #define TOUCH_RST  8
 #define TOUCH_ADDR 0x15
 
-// Touch info
-struct TouchPoint {
-    uint16_t x;
-    uint16_t y;
-    bool touched;
-    uint8_t gesture;
+// 割り込みモード設定
+#define TOUCH_QUEUE_SIZE          16      // 2のべき乗
+#define TOUCH_TASK_STACK_SIZE     3072
+#define TOUCH_TASK_PRIORITY       3       // LVGL (loop) より上
+#define TOUCH_TASK_CORE           1
+#define TOUCH_RELEASE_TIMEOUT_MS  60
+
+// キューに流すイベント
+struct TouchEvent {
+    TouchPoint point;
+    uint32_t irq_us;        // 割り込みの時刻 (micros)
 };
 
-// Gesture definitions
-#define GESTURE_NONE         0x00
-#define GESTURE_SWIPE_UP     0x01
-#define GESTURE_SWIPE_DOWN   0x02
-#define GESTURE_SWIPE_LEFT   0x03
-#define GESTURE_SWIPE_RIGHT  0x04
-#define GESTURE_SINGLE_CLICK 0x05
-#define GESTURE_DOUBLE_CLICK 0x0B
-#define GESTURE_LONG_PRESS   0x0C
+// 入力遅延とI2Cの使用状況 (getStats() で取るスナップショット)
+struct TouchStats {
+    uint32_t interrupts;
+    uint32_t reads;             // I2C読み出し回数
+    uint32_t read_errors;
+    uint32_t timeout_reads;     // 離したことの確認で読んだ回数
+    uint32_t events;            // キューから取り出した数
+    uint32_t dropped;           // キューが満杯で捨てた数
+    uint32_t i2c_us;            // I2Cを使っていた時間の合計
+    uint32_t latency_sum_us;    // 割り込みから read_cb が受け取るまで
+    uint32_t latency_max_us;
+    uint32_t since_ms;          // 計測開始時刻
+};
 
 class TouchDriver {
 private:
     TwoWire* wire;
-    TouchPoint current_point;
+    TouchPoint current_point;       // 最後に読んだ生のサンプル
+    TouchStateMachine touch_state;  // デバウンス済みの状態 (読み出し側)
+    GestureRecognizer recognizer;
+    GestureEvent last_gesture;
+    bool software_gestures;
+    
+    // 割り込みモード
+    TaskHandle_t task_handle;
+    volatile uint32_t irq_us;
+    TouchEvent queue[TOUCH_QUEUE_SIZE];
+    std::atomic<uint32_t> queue_head;   // 書き込み側 (タッチタスク) だけが進める
+    std::atomic<uint32_t> queue_tail;   // 読み出し側 (LVGL) だけが進める
+    
+    // 統計: ISR・タッチタスク・popEvent (loop) が書き、シリアルのタスクが読んでリセットする。
+    // カウンタはそれぞれアトミックに足す (割り込みを止めずに済む)
+    struct Counters {
+        std::atomic<uint32_t> interrupts;       // ISR
+        std::atomic<uint32_t> reads;            // ここから i2c_us まではI2Cを読むタスク
+        std::atomic<uint32_t> read_errors;
+        std::atomic<uint32_t> timeout_reads;
+        std::atomic<uint32_t> dropped;
+        std::atomic<uint32_t> i2c_us;
+        std::atomic<uint32_t> events;           // ここから下は popEvent
+        std::atomic<uint32_t> latency_sum_us;
+        std::atomic<uint32_t> latency_max_us;
+        std::atomic<uint32_t> since_ms;
+    } counters;
+    // TouchStateMachine と GestureRecognizer の統計は読み出し側のタスクだけが触るので、
+    // リセットは要求だけしておき、次に状態を更新するときに行う
+    std::atomic<bool> reset_requested;
     
 public:
     TouchDriver();
@@ -47,18 +105,45 @@ public:
     bool read();
     TouchPoint getPoint();
     
+    // TOUCH_INT の割り込みでI2Cを読むタスクを起動
+    bool startInterruptMode(BaseType_t core = TOUCH_TASK_CORE,
+                            UBaseType_t priority = TOUCH_TASK_PRIORITY);
+    bool isInterruptMode() { return task_handle != nullptr; }
+    TaskHandle_t getTaskHandle() { return task_handle; }
+    
+    // キューから1件取り出して状態を更新 (なければデバウンスだけ進めてfalse)
+    bool popEvent(TouchPoint* point);
+    bool hasEvent() { return queue_tail.load(std::memory_order_relaxed) != queue_head.load(std::memory_order_acquire); }
+    
+    void getStats(TouchStats* out);
+    void printStats();
+    void resetStats();
+    
     bool isTouched();
     uint16_t getX();
     uint16_t getY();
     uint8_t getGesture();
     
-    // Callback for touch events
-    typedef void (*TouchCallback)(TouchPoint point);
+    // Callback for touch events (押した/離した/ジェスチャーごとに1回)
+    typedef void (*TouchCallback)(TouchEdge edge, TouchPoint point);
     void setTouchCallback(TouchCallback callback);
+    void setDebounce(uint32_t down_ms, uint32_t up_ms) { touch_state.setDebounce(down_ms, up_ms); }
+    
+    // ソフトウェアのジェスチャー判定 (既定で有効)
+    void setSoftwareGestures(bool enable) { software_gestures = enable; recognizer.reset(); }
+    // 最後にソフトウェアで判定したジェスチャー (速度・角度つき)
+    const GestureEvent& getLastGesture() { return last_gesture; }
     
 private:
     TouchCallback touch_callback;
+    static void onEdge(TouchEdge edge, const TouchPoint& point, void* ctx);
+    void processSample(TouchPoint sample, uint32_t now_us);
+    void applyStatsReset();
     void reset();
+    void pushEvent(uint32_t irq_time);
+    static void IRAM_ATTR onInterrupt(void* arg);
+    static void taskEntry(void* arg);
+    void taskLoop();
     uint8_t readRegister(uint8_t reg);
     void writeRegister(uint8_t reg, uint8_t value);
 };
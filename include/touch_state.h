@@ -0,0 +1,101 @@
+/**
+ * Touch State Machine
+ * タッチのサンプル列から「押した / 離した / ジェスチャー」を1回ずつ取り出す
+ *
+ * CST816Sはタッチ中ずっと同じ状態とジェスチャー (長押しなど) を報告し続けるので、
+ * サンプルごとにコールバックすると1回の長押しで何十回も反応してしまう。
+ * 状態の変化 (エッジ) だけを通知し、短い接触の途切れはデバウンスでまとめる。
+ *
+ * - DOWN    : 押された (down_ms 続いたら確定)
+ * - GESTURE : 1回のタッチの中で新しいジェスチャーコードが現れた (同じコードは1回だけ)
+ * - UP      : 離された (up_ms 離れたままなら確定、その前に触れたら押したまま扱い)
+ *
+ * 時刻は呼び出し側が渡す (micros)。ハードウェアには依存しない。
+ */
+
+#ifndef TOUCH_STATE_H
+#define TOUCH_STATE_H
+
+#include <stdint.h>
+
+// デバウンスの既定値
+#define TOUCH_DEBOUNCE_DOWN_MS  0       // 押した瞬間に反応する
+#define TOUCH_DEBOUNCE_UP_MS    40      // これより短い途切れは押したままとみなす
+
+// Gesture definitions (CST816S)
+#define GESTURE_NONE         0x00
+#define GESTURE_SWIPE_UP     0x01
+#define GESTURE_SWIPE_DOWN   0x02
+#define GESTURE_SWIPE_LEFT   0x03
+#define GESTURE_SWIPE_RIGHT  0x04
+#define GESTURE_SINGLE_CLICK 0x05
+#define GESTURE_DOUBLE_CLICK 0x0B
+#define GESTURE_LONG_PRESS   0x0C
+
+// Touch info
+struct TouchPoint {
+    uint16_t x;
+    uint16_t y;
+    bool touched;
+    uint8_t gesture;
+};
+
+enum TouchEdge {
+    TOUCH_EDGE_DOWN,
+    TOUCH_EDGE_UP,
+    TOUCH_EDGE_GESTURE
+};
+
+class TouchStateMachine {
+public:
+    typedef void (*EdgeCallback)(TouchEdge edge, const TouchPoint& point, void* ctx);
+
+private:
+    enum State {
+        STATE_IDLE,
+        STATE_DOWN_PENDING,     // 触れたがデバウンス中
+        STATE_PRESSED,
+        STATE_UP_PENDING        // 離れたがデバウンス中
+    };
+
+    State state;
+    uint32_t state_since_us;
+    uint32_t down_us;
+    uint32_t up_us;
+    uint8_t last_gesture;       // このタッチで通知済みのジェスチャー
+    TouchPoint point;           // 確定した状態と最後の座標
+
+    EdgeCallback callback;
+    void* callback_ctx;
+
+    // 統計
+    uint32_t edges;
+    uint32_t suppressed;        // 通知しなかった重複ジェスチャー
+    uint32_t bounces;           // 途切れをまとめた回数
+
+public:
+    TouchStateMachine();
+
+    void setDebounce(uint32_t down_ms, uint32_t up_ms);
+    void setCallback(EdgeCallback cb, void* ctx);
+    void reset();
+
+    // サンプルを1件入力
+    void feed(const TouchPoint& sample, uint32_t now_us);
+    // サンプルが来なくてもデバウンスを確定させる (定期的に呼ぶ)
+    void update(uint32_t now_us);
+
+    bool isPressed() const { return state == STATE_PRESSED || state == STATE_UP_PENDING; }
+    const TouchPoint& getPoint() const { return point; }
+
+    uint32_t getEdgeCount() const { return edges; }
+    uint32_t getSuppressedCount() const { return suppressed; }
+    uint32_t getBounceCount() const { return bounces; }
+    void resetStats() { edges = suppressed = bounces = 0; }
+
+private:
+    void emit(TouchEdge edge);
+    void enter(State next, uint32_t now_us);
+};
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * Trace
+ * ホットパスの区間計測と Chrome trace-event 形式での書き出し
+ *
+ * 1回のやり取り (タッチ → LLM → 描画) の遅延がどこで使われているかを見るため、
+ * 区間の開始時刻と長さを固定長のリングバッファ (PSRAM) に記録する。
+ * 'x' コマンドでシリアルにJSONを出力し、chrome://tracing や Perfetto で開く。
+ *
+ * - 長さはCPUのサイクルカウンタで測る (開始時刻は全コア共通の micros)。
+ *   カウンタは240MHzで約17秒で一周するので、それより長い区間は micros で記録
+ * - 記録はロックなし (書き込み位置をアトミックに進めるだけ)。
+ *   バッファが一周したら古いものから上書き
+ * - 各スロットには何番目のイベントかを最後に書く。書き出し側は前後で番号を確かめ、
+ *   書きかけ・上書き中のスロットは捨てる (もう一方のコアが書いていても壊れた行を出さない)
+ * - 名前は文字列リテラルを渡す (ポインタだけを記録する)
+ * - ENABLE_TRACE=0 (既定) ではマクロは空になり、コストはゼロ
+ *
+ *   TRACE_SCOPE("lv_flush");              // スコープの終わりまで
+ *   TRACE_SCOPE_ARG("layer", layer);      // 数値を1つ添える
+ *   TRACE_BEGIN(dns, "http_dns"); ... TRACE_END(dns);
+ *   TRACE_INSTANT("touch_event", x);      // 時刻だけ
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#ifndef ENABLE_TRACE
+#define ENABLE_TRACE 0
+#endif
+
+#define TRACE_RING_SIZE     4096    // 2のべき乗 (20 bytes × 4096 = 80KB)
+#define TRACE_CYCLE_LIMIT_US 10000000   // これより長い区間はサイクル数を使わない
+
+struct TraceEvent {
+    const char* name;
+    uint32_t ts_us;
+    uint32_t dur;           // サイクル数 (dur_in_us なら us), 0xFFFFFFFF = 瞬間イベント
+    uint16_t arg;
+    uint8_t core;
+    uint8_t dur_in_us;
+    std::atomic<uint32_t> seq;  // 書き終えたイベントの番号 + 1 (0 = 書き込み中)
+};
+
+class Trace {
+public:
+    // バッファ確保 (失敗したら記録しない)
+    static bool begin();
+    static void clear();
+    static void setEnabled(bool enable);
+    static bool isEnabled() { return enabled; }
+
+    static void complete(const char* name, uint32_t ts_us, uint32_t cycles, uint16_t arg);
+    static void completeUs(const char* name, uint32_t ts_us, uint32_t dur_us, uint16_t arg);
+    static void instant(const char* name, uint16_t arg);
+
+    // 記録済みのイベントを Chrome trace-event JSON で出力
+    static void exportJson(Print& out);
+
+private:
+    static volatile bool enabled;
+    static void record(const char* name, uint32_t ts_us, uint32_t dur, bool dur_in_us, uint16_t arg);
+};
+
+#if ENABLE_TRACE
+
+// スコープの区間
+class TraceScope {
+private:
+    const char* name;
+    uint32_t ts_us;
+    uint32_t start_cycles;
+    uint16_t arg;
+
+public:
+    inline TraceScope(const char* n, uint16_t a = 0) : name(n), arg(a) {
+        ts_us = micros();
+        start_cycles = ESP.getCycleCount();
+    }
+    inline ~TraceScope() {
+        end();
+    }
+    inline void end() {
+        if (name) {
+            uint32_t cycles = ESP.getCycleCount() - start_cycles;
+            uint32_t us = micros() - ts_us;
+            if (us < TRACE_CYCLE_LIMIT_US) {
+                Trace::complete(name, ts_us, cycles, arg);
+            } else {
+                Trace::completeUs(name, ts_us, us, arg);
+            }
+            name = nullptr;
+        }
+    }
+};
+
+#define TRACE_CONCAT_(a, b)         a##b
+#define TRACE_CONCAT(a, b)          TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)           TraceScope TRACE_CONCAT(_trace_scope_, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, arg)  TraceScope TRACE_CONCAT(_trace_scope_, __LINE__)(name, (uint16_t)(arg))
+#define TRACE_BEGIN(var, name)      TraceScope _trace_##var(name)
+#define TRACE_END(var)              _trace_##var.end()
+#define TRACE_INSTANT(name, arg)    Trace::instant(name, (uint16_t)(arg))
+
+#else
+
+#define TRACE_SCOPE(name)           do {} while (0)
+#define TRACE_SCOPE_ARG(name, arg)  do {} while (0)
+#define TRACE_BEGIN(var, name)      do {} while (0)
+#define TRACE_END(var)              do {} while (0)
+#define TRACE_INSTANT(name, arg)    do {} while (0)
+
+#endif
+
+#endif
@@ -7,14 +7,14 @@
 #include <Arduino.h>
 #include "esp_sr_iface.h"
 #include "esp_sr_models.h"
-#include "Audio.h"
+#include "audio_output.h"
 
 // Wake word: "Hi ESP"
 // Commands: various cute responses
 
 class VoiceHandler {
 private:
-    Audio* audio;
+    AudioOutput* audio;
     bool is_awake;
     uint32_t awake_time;
     
@@ -23,7 +23,7 @@ private:
     const esp_mn_iface_t *multinet;
     
 public:
-    VoiceHandler(Audio* audioPtr);
+    VoiceHandler(AudioOutput* audioPtr);
     ~VoiceHandler();
     
     bool init();
@@ -50,7 +50,7 @@ private:
 };
 
 // Cute sound generation
-void generateCuteBeep(Audio* audio, int frequency, int duration);
-void generateCuteChirp(Audio* audio);
+void generateCuteBeep(AudioOutput* audio, int frequency, int duration);
+void generateCuteChirp(AudioOutput* audio);
 
 #endif
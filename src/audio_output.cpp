@@ -0,0 +1,509 @@
+#include "audio_output.h"
+#include <driver/i2s.h>
+
+// DMAのリング全体の長さ (これより先の音は書き込めない)
+#define AUDIO_RING_US   ((uint32_t)(AUDIO_DMA_BUF_COUNT + 2) * AUDIO_DMA_BUF_LEN * 1000000 / AUDIO_SAMPLE_RATE)
+
+// ===== 音源 =====
+
+size_t PcmSource::fill(void* ctx, int16_t* scratch, size_t max_samples, const int16_t** out) {
+    PcmSource* s = (PcmSource*)ctx;
+    size_t n = s->count - s->pos;
+    if (n > max_samples) {
+        n = max_samples;
+    }
+    // フラッシュ (メモリマップ) をそのままDMAへ渡す
+    *out = s->data + s->pos;
+    s->pos += n;
+    return n;
+}
+
+static const int8_t ADPCM_INDEX_TABLE[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int16_t ADPCM_STEP_TABLE[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+size_t AdpcmSource::fill(void* ctx, int16_t* scratch, size_t max_samples, const int16_t** out) {
+    AdpcmSource* s = (AdpcmSource*)ctx;
+    size_t n = s->count - s->pos;
+    if (n > max_samples) {
+        n = max_samples;
+    }
+
+    int32_t predictor = s->predictor;
+    int8_t index = s->step_index;
+    for (size_t i = 0; i < n; i++) {
+        size_t p = s->pos + i;
+        uint8_t code = (s->data[p >> 1] >> ((p & 1) * 4)) & 0x0F;
+
+        int32_t step = ADPCM_STEP_TABLE[index];
+        int32_t diff = step >> 3;
+        if (code & 4) diff += step;
+        if (code & 2) diff += step >> 1;
+        if (code & 1) diff += step >> 2;
+        predictor += (code & 8) ? -diff : diff;
+        if (predictor > 32767) predictor = 32767;
+        if (predictor < -32768) predictor = -32768;
+
+        index += ADPCM_INDEX_TABLE[code];
+        if (index < 0) index = 0;
+        if (index > 88) index = 88;
+
+        scratch[i] = (int16_t)predictor;
+    }
+    s->predictor = predictor;
+    s->step_index = index;
+    s->pos += n;
+
+    *out = scratch;
+    return n;
+}
+
+void ToneSource::begin(uint16_t freq_hz, uint16_t duration_ms, int16_t amp) {
+    phase = 0;
+    step = (uint32_t)(((uint64_t)freq_hz << 32) / AUDIO_SAMPLE_RATE);
+    total = (uint32_t)duration_ms * AUDIO_SAMPLE_RATE / 1000;
+    remaining = total;
+    amplitude = amp;
+}
+
+size_t ToneSource::fill(void* ctx, int16_t* scratch, size_t max_samples, const int16_t** out) {
+    ToneSource* s = (ToneSource*)ctx;
+    size_t n = s->remaining;
+    if (n > max_samples) {
+        n = max_samples;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        // 放物線で近似した正弦波 (t: -π..π を -32768..32767 で表す)
+        int32_t t = (int32_t)s->phase >> 16;
+        int32_t y = (t * (32768 - abs(t))) >> 13;
+        if (y > 32767) y = 32767;
+
+        // 両端をフェードしてクリックを防ぐ
+        uint32_t done = s->total - s->remaining;
+        uint32_t edge = min(done, s->remaining);
+        int32_t amp = s->amplitude;
+        if (edge < AUDIO_TONE_FADE_SAMPLES) {
+            amp = amp * (int32_t)edge / AUDIO_TONE_FADE_SAMPLES;
+        }
+
+        scratch[i] = (int16_t)((y * amp) >> 15);
+        s->phase += s->step;
+        s->remaining--;
+    }
+
+    *out = scratch;
+    return n;
+}
+
+// ===== 出力エンジン =====
+
+AudioOutput::AudioOutput() {
+    task_handle = nullptr;
+    request_queue = nullptr;
+    i2s_ready = false;
+    port = I2S_NUM_0;
+    sink = nullptr;
+    sink_ctx = nullptr;
+    generation = 0;
+    playing = false;
+    volume = AUDIO_VOLUME_MAX;
+    memset(envelope, 0, sizeof(envelope));
+    envelope_head.store(0);
+    play_end_us = 0;
+    memset(&current, 0, sizeof(current));
+    memset(&stats, 0, sizeof(stats));
+}
+
+AudioOutput::~AudioOutput() {
+    if (task_handle) {
+        vTaskDelete(task_handle);
+    }
+    if (request_queue) {
+        vQueueDelete(request_queue);
+    }
+    if (i2s_ready) {
+        i2s_driver_uninstall((i2s_port_t)port);
+    }
+}
+
+bool AudioOutput::begin(int bclk, int lrck, int dout, BaseType_t core, UBaseType_t priority) {
+    if (task_handle) {
+        return true;
+    }
+
+    i2s_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
+    config.sample_rate = AUDIO_SAMPLE_RATE;
+    config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;  // モノラル (S3は両チャンネルに同じ値を出す)
+    config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+    config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+    config.dma_buf_count = AUDIO_DMA_BUF_COUNT;
+    config.dma_buf_len = AUDIO_DMA_BUF_LEN;
+    config.use_apll = false;
+    config.tx_desc_auto_clear = true;   // 書くものがなければ無音
+
+    if (i2s_driver_install((i2s_port_t)port, &config, 0, nullptr) != ESP_OK) {
+        Serial.println("オーディオ: I2Sドライバの初期化失敗");
+        return false;
+    }
+
+    i2s_pin_config_t pins;
+    memset(&pins, 0, sizeof(pins));
+    pins.mck_io_num = I2S_PIN_NO_CHANGE;
+    pins.bck_io_num = bclk;
+    pins.ws_io_num = lrck;
+    pins.data_out_num = dout;
+    pins.data_in_num = I2S_PIN_NO_CHANGE;
+    if (i2s_set_pin((i2s_port_t)port, &pins) != ESP_OK) {
+        Serial.println("オーディオ: I2Sピン設定失敗");
+        i2s_driver_uninstall((i2s_port_t)port);
+        return false;
+    }
+    i2s_zero_dma_buffer((i2s_port_t)port);
+    i2s_ready = true;
+
+    request_queue = xQueueCreate(AUDIO_QUEUE_LEN, sizeof(Request));
+    if (!request_queue) {
+        Serial.println("オーディオ: キュー作成失敗");
+        return false;
+    }
+
+    BaseType_t ok = xTaskCreatePinnedToCore(
+        taskEntry, "audio", AUDIO_TASK_STACK_SIZE,
+        this, priority, &task_handle, core);
+    if (ok != pdPASS) {
+        Serial.println("オーディオ: タスク作成失敗");
+        task_handle = nullptr;
+        return false;
+    }
+
+    resetStats();
+    Serial.printf("オーディオ起動 (%dHz, DMA %d×%d, core %d)\n",
+                  AUDIO_SAMPLE_RATE, AUDIO_DMA_BUF_COUNT, AUDIO_DMA_BUF_LEN, (int)core);
+    return true;
+}
+
+bool AudioOutput::submit(Request& req, bool interrupt) {
+    if (!request_queue) {
+        return false;
+    }
+    if (interrupt) {
+        stop();
+    }
+
+    req.generation = generation;
+    req.queued_us = micros();
+    req.measure_start = interrupt || !isPlaying();
+
+    if (xQueueSend(request_queue, &req, 0) != pdTRUE) {
+        Serial.println("オーディオ: キューが満杯です");
+        return false;
+    }
+    return true;
+}
+
+bool AudioOutput::play(AudioFillFn fn, void* ctx) {
+    Request req;
+    memset(&req, 0, sizeof(req));
+    req.kind = SOURCE_CALLBACK;
+    req.fn = fn;
+    req.ctx = ctx;
+    return submit(req, true);
+}
+
+bool AudioOutput::enqueue(AudioFillFn fn, void* ctx) {
+    Request req;
+    memset(&req, 0, sizeof(req));
+    req.kind = SOURCE_CALLBACK;
+    req.fn = fn;
+    req.ctx = ctx;
+    return submit(req, false);
+}
+
+bool AudioOutput::playPcm(const int16_t* samples, size_t count) {
+    Request req;
+    memset(&req, 0, sizeof(req));
+    req.kind = SOURCE_PCM;
+    req.pcm.begin(samples, count);
+    return submit(req, true);
+}
+
+bool AudioOutput::playAdpcm(const uint8_t* data, size_t samples) {
+    Request req;
+    memset(&req, 0, sizeof(req));
+    req.kind = SOURCE_ADPCM;
+    req.adpcm.begin(data, samples);
+    return submit(req, true);
+}
+
+bool AudioOutput::playTone(uint16_t freq_hz, uint16_t duration_ms) {
+    Request req;
+    memset(&req, 0, sizeof(req));
+    req.kind = SOURCE_TONE;
+    req.tone.begin(freq_hz, duration_ms);
+    return submit(req, true);
+}
+
+bool AudioOutput::enqueueTone(uint16_t freq_hz, uint16_t duration_ms) {
+    Request req;
+    memset(&req, 0, sizeof(req));
+    req.kind = SOURCE_TONE;
+    req.tone.begin(freq_hz, duration_ms);
+    return submit(req, false);
+}
+
+void AudioOutput::stop() {
+    // 世代を進めると、再生中のものはブロックの境目で、キューに残ったものは取り出し時に捨てられる
+    generation++;
+    if (request_queue) {
+        xQueueReset(request_queue);
+    }
+}
+
+void AudioOutput::write(const int16_t* samples, size_t count) {
+    uint16_t v = volume;
+    if (v < AUDIO_VOLUME_MAX) {
+        // 音量を変えるときだけコピーする
+        for (size_t i = 0; i < count; i++) {
+            gain_buf[i] = (int16_t)(((int32_t)samples[i] * v) >> 8);
+        }
+        samples = gain_buf;
+    }
+
+    recordEnvelope(samples, count);
+
+    if (sink) {
+        sink(sink_ctx, samples, count);
+        return;
+    }
+    if (i2s_ready) {
+        // DMAのリングに空きができるまで待つ (これが再生のペースになる)
+        size_t written = 0;
+        i2s_write((i2s_port_t)port, samples, count * sizeof(int16_t), &written, portMAX_DELAY);
+    }
+}
+
+uint16_t AudioOutput::blockRms(const int16_t* samples, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        int32_t v = samples[i];
+        sum += (uint32_t)(v * v);
+    }
+    uint32_t mean = (uint32_t)(sum / count);
+
+    // 整数の平方根 (ビットごとに決める)
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > mean) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (mean >= root + bit) {
+            mean -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root > 32767 ? 32767 : (uint16_t)root;
+}
+
+void AudioOutput::recordEnvelope(const int16_t* samples, size_t count) {
+    uint32_t now = micros();
+    uint32_t duration = (uint32_t)count * 1000000 / AUDIO_SAMPLE_RATE;
+
+    // 書き込み済みの音の後ろにつながる。DMAが空なら今鳴っているバッファ (無音) の次から
+    // (どこまで鳴っているかは分からないので半分で見積もる)
+    // (micros は約71分で一周するので、DMAに積める長さより先なら古い値とみなす)
+    uint32_t earliest = now + (uint32_t)AUDIO_DMA_BUF_LEN * 500000 / AUDIO_SAMPLE_RATE;
+    uint32_t ahead = play_end_us - earliest;
+    uint32_t start = ahead < AUDIO_RING_US ? play_end_us : earliest;
+    play_end_us = start + duration;
+
+    uint32_t head = envelope_head.load(std::memory_order_relaxed);
+    AudioEnvelopeSlot& slot = envelope[head & (AUDIO_ENVELOPE_SLOTS - 1)];
+    slot.start_us = start;
+    slot.duration_us = duration;
+    slot.rms = blockRms(samples, count);
+    envelope_head.store(head + 1, std::memory_order_release);
+
+    uint32_t delay = start - now;
+    if (delay > stats.delay_max_us) stats.delay_max_us = delay;
+}
+
+uint16_t AudioOutput::getEnvelope(uint32_t at_us) {
+    // 新しい順に探す (書き込み中の一番古いスロットは既に鳴り終わっているので読まない)
+    uint32_t head = envelope_head.load(std::memory_order_acquire);
+    uint32_t n = head < AUDIO_ENVELOPE_SLOTS - 1 ? head : AUDIO_ENVELOPE_SLOTS - 1;
+    for (uint32_t i = 1; i <= n; i++) {
+        const AudioEnvelopeSlot& slot = envelope[(head - i) & (AUDIO_ENVELOPE_SLOTS - 1)];
+        int32_t offset = (int32_t)(at_us - slot.start_us);
+        if (offset >= 0) {
+            return offset < slot.duration_us ? slot.rms : 0;
+        }
+    }
+    return 0;
+}
+
+uint32_t AudioOutput::getOutputDelayUs() {
+    uint32_t ahead = play_end_us - micros();
+    return ahead < AUDIO_RING_US ? ahead : 0;
+}
+
+void AudioOutput::taskEntry(void* param) {
+    ((AudioOutput*)param)->taskLoop();
+}
+
+void AudioOutput::taskLoop() {
+    const uint32_t block_us = (uint32_t)AUDIO_BLOCK_SAMPLES * 1000000 / AUDIO_SAMPLE_RATE;
+
+    while (true) {
+        if (xQueueReceive(request_queue, &current, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (current.generation != generation) {
+            continue;
+        }
+
+        // 組み込みの音源はタスク側にコピーした状態を使う
+        switch (current.kind) {
+            case SOURCE_PCM:
+                current.fn = PcmSource::fill;
+                current.ctx = &current.pcm;
+                break;
+            case SOURCE_ADPCM:
+                current.fn = AdpcmSource::fill;
+                current.ctx = &current.adpcm;
+                break;
+            case SOURCE_TONE:
+                current.fn = ToneSource::fill;
+                current.ctx = &current.tone;
+                break;
+            default:
+                break;
+        }
+
+        playing = true;
+        stats.plays++;
+        bool first = current.measure_start;
+
+        while (current.generation == generation) {
+            uint32_t start = micros();
+            const int16_t* out = scratch;
+            size_t n = current.fn(current.ctx, scratch, AUDIO_BLOCK_SAMPLES, &out);
+            uint32_t fill_us = micros() - start;
+            if (n == 0) {
+                break;
+            }
+
+            write(out, n);
+
+            stats.blocks++;
+            stats.samples += n;
+            if (fill_us > stats.fill_max_us) stats.fill_max_us = fill_us;
+            if (fill_us > block_us) stats.late_blocks++;
+            if (first) {
+                uint32_t start_us = micros() - current.queued_us;
+                stats.starts++;
+                stats.start_sum_us += start_us;
+                if (start_us > stats.start_max_us) stats.start_max_us = start_us;
+                first = false;
+            }
+        }
+
+        playing = false;
+    }
+}
+
+static void writeLE16(File& file, uint16_t v) {
+    uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) };
+    file.write(b, 2);
+}
+
+static void writeLE32(File& file, uint32_t v) {
+    uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    file.write(b, 4);
+}
+
+size_t AudioOutput::renderToWav(AudioFillFn fn, void* ctx, File& file, uint32_t sample_rate) {
+    if (!fn || !file) {
+        return 0;
+    }
+
+    // ヘッダ (長さは最後に書き直す)
+    size_t header_pos = file.position();
+    file.write((const uint8_t*)"RIFF", 4);
+    writeLE32(file, 0);
+    file.write((const uint8_t*)"WAVEfmt ", 8);
+    writeLE32(file, 16);
+    writeLE16(file, 1);                 // PCM
+    writeLE16(file, 1);                 // モノラル
+    writeLE32(file, sample_rate);
+    writeLE32(file, sample_rate * 2);
+    writeLE16(file, 2);
+    writeLE16(file, 16);
+    file.write((const uint8_t*)"data", 4);
+    writeLE32(file, 0);
+
+    int16_t block[AUDIO_BLOCK_SAMPLES];
+    size_t total = 0;
+    while (true) {
+        const int16_t* out = block;
+        size_t n = fn(ctx, block, AUDIO_BLOCK_SAMPLES, &out);
+        if (n == 0) {
+            break;
+        }
+        // WAVはリトルエンディアン (ESP32もリトルエンディアン)
+        file.write((const uint8_t*)out, n * sizeof(int16_t));
+        total += n;
+    }
+
+    uint32_t data_bytes = total * sizeof(int16_t);
+    size_t end_pos = file.position();
+    file.seek(header_pos + 4);
+    writeLE32(file, 36 + data_bytes);
+    file.seek(header_pos + 40);
+    writeLE32(file, data_bytes);
+    file.seek(end_pos);
+    return total;
+}
+
+void AudioOutput::printStats() {
+    uint32_t elapsed = millis() - stats.since_ms;
+    uint32_t starts = stats.starts ? stats.starts : 1;
+    Serial.printf("オーディオ (%lums): 再生 %lu回, %luブロック, %.1f秒ぶん\n",
+                  (unsigned long)elapsed, (unsigned long)stats.plays, (unsigned long)stats.blocks,
+                  stats.samples / (float)AUDIO_SAMPLE_RATE);
+    Serial.printf("  開始遅延 平均/最大: %lu / %lu us (+ DMA最大 %d us)\n",
+                  (unsigned long)(stats.start_sum_us / starts), (unsigned long)stats.start_max_us,
+                  AUDIO_DMA_BUF_LEN * 1000 / (AUDIO_SAMPLE_RATE / 1000));
+    Serial.printf("  ブロック生成 最大: %lu us, 間に合わなかった: %lu\n",
+                  (unsigned long)stats.fill_max_us, (unsigned long)stats.late_blocks);
+    Serial.printf("  書き込みから発音まで 最大: %lu us (音量はこの分遅らせて返す)\n",
+                  (unsigned long)stats.delay_max_us);
+}
+
+void AudioOutput::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+    stats.since_ms = millis();
+}
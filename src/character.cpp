@@ -0,0 +1,383 @@
+#include "character.h"
+
+// ===== カービィキャラクター =====
+static lv_obj_t *face_circle;
+static lv_obj_t *left_eye;
+static lv_obj_t *right_eye;
+static lv_obj_t *mouth;
+
+// 表情スプライト (なければウィジェットで描く)
+static FaceSprites* face_sprites = nullptr;
+static EyeState eye_state = EYE_OPEN;
+static MouthState mouth_state = MOUTH_CLOSED;
+
+// アニメーション状態
+AnimState current_anim = ANIM_IDLE;
+static lv_timer_t *blink_timer = nullptr;  // 次の自動まばたき
+static lv_timer_t *idle_timer = nullptr;   // アイドルに戻すまで
+static int32_t eye_openness = ANIM_OPEN_MAX;
+static int32_t mouth_openness = 0;
+
+// 口パク
+static lv_timer_t *lipsync_timer = nullptr;
+static TalkLevelFn talk_level_fn = nullptr;
+static void *talk_level_ctx = nullptr;
+static bool talk_heard = false;     // 今回話し始めてから音が出たか
+
+// ===== 描画範囲を最小にするためのヘルパー =====
+// スクロール可能なオブジェクトは子のサイズが変わるたびにスクロール範囲と
+// スクロールバーを再計算して親ごと無効化するので、顔のパーツでは無効にする
+static void make_static_part(lv_obj_t *obj) {
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ON_FOCUS |
+                           LV_OBJ_FLAG_SCROLL_CHAIN | LV_OBJ_FLAG_SCROLL_ELASTIC);
+    lv_obj_set_scrollbar_mode(obj, LV_SCROLLBAR_MODE_OFF);
+}
+
+// 同じサイズの再設定でも無効化が起きるので、変化がなければ何もしない
+// (変化したときはLVGLが旧・新の領域だけを無効化し、フレームごとにまとめて描画する)
+static void set_part_size(lv_obj_t *obj, lv_coord_t w, lv_coord_t h) {
+    if (lv_obj_get_style_width(obj, LV_PART_MAIN) == w &&
+        lv_obj_get_style_height(obj, LV_PART_MAIN) == h) {
+        return;
+    }
+    lv_obj_set_size(obj, w, h);
+}
+
+// ===== 表情の切り替え =====
+// スプライトなら画像を差し替えるだけ、なければウィジェットのサイズを変える
+void show_eyes(EyeState state) {
+    if (state == eye_state) return;
+    eye_state = state;
+    
+    if (face_sprites) {
+        lv_img_set_src(left_eye, face_sprites->eye(true, state));
+        lv_img_set_src(right_eye, face_sprites->eye(false, state));
+    } else {
+        SpriteShape shape = FaceSprites::eyeShape(state);
+        set_part_size(left_eye, shape.w, shape.h);
+        set_part_size(right_eye, shape.w, shape.h);
+    }
+}
+
+void show_mouth(MouthState state) {
+    if (state == mouth_state) return;
+    mouth_state = state;
+    
+    if (face_sprites) {
+        lv_img_set_src(mouth, face_sprites->mouth(state));
+    } else {
+        SpriteShape shape = FaceSprites::mouthShape(state);
+        set_part_size(mouth, shape.w, shape.h);
+    }
+}
+
+// ===== 開き具合の補間 =====
+// lv_anim から経過時間に応じた値が渡される (フレームレートに依存しない)。
+// スプライトは開き具合に近い状態を選び、ウィジェットはサイズを補間する。
+// 中間のサイズにしたときは状態を EYE_STATE_COUNT / MOUTH_STATE_COUNT にして、
+// 次の show_eyes() / show_mouth() が必ず反映されるようにする。
+static lv_coord_t lerp_coord(lv_coord_t from, lv_coord_t to, int32_t v) {
+    return from + (to - from) * v / ANIM_OPEN_MAX;
+}
+
+static void eye_openness_cb(void *var, int32_t v) {
+    eye_openness = v;
+    if (face_sprites) {
+        show_eyes(v < ANIM_OPEN_MAX / 2 ? EYE_CLOSED : EYE_OPEN);
+        return;
+    }
+    
+    SpriteShape closed = FaceSprites::eyeShape(EYE_CLOSED);
+    SpriteShape open = FaceSprites::eyeShape(EYE_OPEN);
+    lv_coord_t w = lerp_coord(closed.w, open.w, v);
+    lv_coord_t h = lerp_coord(closed.h, open.h, v);
+    set_part_size(left_eye, w, h);
+    set_part_size(right_eye, w, h);
+    eye_state = v == 0 ? EYE_CLOSED : (v == ANIM_OPEN_MAX ? EYE_OPEN : EYE_STATE_COUNT);
+}
+
+static void mouth_openness_cb(void *var, int32_t v) {
+    mouth_openness = v;
+    if (face_sprites) {
+        // 0..ANIM_OPEN_MAX を CLOSED, TALK_1, TALK_2, TALK_3 の4段階に
+        show_mouth((MouthState)(MOUTH_CLOSED + v * 4 / (ANIM_OPEN_MAX + 1)));
+        return;
+    }
+    
+    SpriteShape closed = FaceSprites::mouthShape(MOUTH_CLOSED);
+    SpriteShape open = FaceSprites::mouthShape(MOUTH_TALK_3);
+    set_part_size(mouth, lerp_coord(closed.w, open.w, v), lerp_coord(closed.h, open.h, v));
+    mouth_state = v == 0 ? MOUTH_CLOSED : MOUTH_STATE_COUNT;
+}
+
+// 一定の周期で口を開け閉めする (音量が取れないとき)
+static void start_mouth_cycle() {
+    if (lv_anim_get(&mouth_openness, mouth_openness_cb)) {
+        return;
+    }
+    lv_anim_t a;
+    lv_anim_init(&a);
+    lv_anim_set_var(&a, &mouth_openness);
+    lv_anim_set_exec_cb(&a, mouth_openness_cb);
+    lv_anim_set_values(&a, 0, ANIM_OPEN_MAX);
+    lv_anim_set_time(&a, TALK_CYCLE_MS);
+    lv_anim_set_playback_time(&a, TALK_CYCLE_MS);
+    lv_anim_set_repeat_count(&a, LV_ANIM_REPEAT_INFINITE);
+    lv_anim_set_path_cb(&a, lv_anim_path_ease_in_out);
+    lv_anim_start(&a);
+}
+
+// 音量に合わせて口を動かす (開くときはすぐ、閉じるときはゆっくり)
+static void lipsync_timer_cb(lv_timer_t *timer) {
+    int32_t level = talk_level_fn(talk_level_ctx);
+    if (level == TALK_LEVEL_SILENT && !talk_heard) {
+        // 音なしで話している (考え中など): 往復で動かす
+        start_mouth_cycle();
+        return;
+    }
+    if (level != TALK_LEVEL_SILENT && !talk_heard) {
+        talk_heard = true;
+        lv_anim_del(&mouth_openness, mouth_openness_cb);
+    }
+    
+    int32_t v = lipsync_follow(level, mouth_openness);
+    if (v != mouth_openness) {
+        mouth_openness_cb(&mouth_openness, v);
+    }
+    
+    // 音が鳴っている間はアイドルに戻さない
+    if (level > 0 && idle_timer) {
+        lv_timer_reset(idle_timer);
+    }
+}
+
+static void start_talk() {
+    if (!talk_level_fn) {
+        start_mouth_cycle();
+        return;
+    }
+    if (!lipsync_timer) {
+        lipsync_timer = lv_timer_create(lipsync_timer_cb, LIPSYNC_PERIOD_MS, nullptr);
+    }
+    lv_timer_resume(lipsync_timer);
+    if (!talk_heard) {
+        // 最初の周期まで待たずに、音がなければすぐ口を動かし始める
+        lipsync_timer_cb(lipsync_timer);
+    }
+}
+
+static void stop_talk() {
+    lv_anim_del(&mouth_openness, mouth_openness_cb);
+    if (lipsync_timer) {
+        lv_timer_pause(lipsync_timer);
+    }
+    talk_heard = false;
+    // 値だけでなくスプライト・ウィジェットも閉じた口に戻す
+    if (mouth) {
+        mouth_openness_cb(&mouth_openness, 0);
+    }
+}
+
+// 次の自動まばたきを2〜5秒後に
+static void schedule_blink() {
+    if (!blink_timer) return;
+    lv_timer_set_period(blink_timer, lv_rand(BLINK_MIN_INTERVAL_MS, BLINK_MAX_INTERVAL_MS));
+    lv_timer_reset(blink_timer);
+}
+
+static void blink_timer_cb(lv_timer_t *timer) {
+    if (current_anim == ANIM_IDLE) {
+        blink_animation();
+    } else {
+        schedule_blink();
+    }
+}
+
+static void idle_timer_cb(lv_timer_t *timer) {
+    reset_to_idle();
+}
+
+// ===== 目と口 (ウィジェット版) =====
+static lv_obj_t* create_eye_widget(lv_coord_t x_ofs) {
+    SpriteShape shape = FaceSprites::eyeShape(EYE_OPEN);
+    
+    lv_obj_t *eye = lv_obj_create(face_circle);
+    lv_obj_set_size(eye, shape.w, shape.h);
+    lv_obj_align(eye, LV_ALIGN_CENTER, x_ofs, EYE_OFFSET_Y);
+    lv_obj_set_style_bg_color(eye, lv_color_hex(EYE_COLOR), LV_PART_MAIN);
+    lv_obj_set_style_border_width(eye, 0, LV_PART_MAIN);
+    lv_obj_set_style_radius(eye, LV_RADIUS_CIRCLE, LV_PART_MAIN);
+    make_static_part(eye);
+    
+    // 白いハイライト
+    lv_obj_t *highlight = lv_obj_create(eye);
+    lv_obj_set_size(highlight, 15, 20);
+    lv_obj_align(highlight, LV_ALIGN_TOP_LEFT, 8, 8);
+    lv_obj_set_style_bg_color(highlight, lv_color_white(), LV_PART_MAIN);
+    lv_obj_set_style_radius(highlight, LV_RADIUS_CIRCLE, LV_PART_MAIN);
+    lv_obj_set_style_border_width(highlight, 0, LV_PART_MAIN);
+    make_static_part(highlight);
+    
+    return eye;
+}
+
+static lv_obj_t* create_mouth_widget() {
+    SpriteShape shape = FaceSprites::mouthShape(MOUTH_CLOSED);
+    
+    lv_obj_t *m = lv_obj_create(face_circle);
+    lv_obj_set_size(m, shape.w, shape.h);
+    lv_obj_align(m, LV_ALIGN_CENTER, 0, MOUTH_OFFSET_Y);
+    lv_obj_set_style_bg_color(m, lv_color_hex(MOUTH_COLOR), LV_PART_MAIN);
+    lv_obj_set_style_border_width(m, 0, LV_PART_MAIN);
+    lv_obj_set_style_radius(m, LV_RADIUS_CIRCLE, LV_PART_MAIN);
+    make_static_part(m);
+    return m;
+}
+
+// ===== 目と口 (スプライト版) =====
+static lv_obj_t* create_sprite_part(const lv_img_dsc_t* src, lv_coord_t x_ofs, lv_coord_t y_ofs) {
+    lv_obj_t *img = lv_img_create(face_circle);
+    lv_img_set_src(img, src);
+    lv_obj_align(img, LV_ALIGN_CENTER, x_ofs, y_ofs);
+    make_static_part(img);
+    return img;
+}
+
+static lv_obj_t* create_cheek(lv_coord_t x_ofs) {
+    lv_obj_t *cheek = lv_obj_create(face_circle);
+    lv_obj_set_size(cheek, CHEEK_WIDTH, CHEEK_HEIGHT);
+    lv_obj_align(cheek, LV_ALIGN_CENTER, x_ofs, CHEEK_OFFSET_Y);
+    lv_obj_set_style_bg_color(cheek, lv_color_hex(CHEEK_COLOR), LV_PART_MAIN);
+    lv_obj_set_style_bg_opa(cheek, LV_OPA_50, LV_PART_MAIN);
+    lv_obj_set_style_border_width(cheek, 0, LV_PART_MAIN);
+    lv_obj_set_style_radius(cheek, LV_RADIUS_CIRCLE, LV_PART_MAIN);
+    make_static_part(cheek);
+    return cheek;
+}
+
+// ===== カービィ風キャラクターの作成 =====
+void create_kirby_character(FaceSprites* sprites) {
+    // 背景をピンク系のグラデーションに
+    lv_obj_t *bg = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(bg, LV_HOR_RES, LV_VER_RES);
+    lv_obj_set_style_bg_color(bg, lv_color_hex(0xFFE8F5), LV_PART_MAIN);
+    lv_obj_set_style_bg_grad_color(bg, lv_color_hex(0xFFB3E5), LV_PART_MAIN);
+    lv_obj_set_style_bg_grad_dir(bg, LV_GRAD_DIR_VER, LV_PART_MAIN);
+    make_static_part(bg);
+    
+    // 丸い顔 (ピンク色)
+    face_circle = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(face_circle, FACE_SIZE, FACE_SIZE);
+    lv_obj_align(face_circle, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_set_style_bg_color(face_circle, lv_color_hex(FACE_COLOR), LV_PART_MAIN);
+    lv_obj_set_style_border_width(face_circle, 4, LV_PART_MAIN);
+    lv_obj_set_style_border_color(face_circle, lv_color_hex(FACE_BORDER_COLOR), LV_PART_MAIN);
+    lv_obj_set_style_radius(face_circle, LV_RADIUS_CIRCLE, LV_PART_MAIN);
+    make_static_part(face_circle);
+    
+    face_sprites = sprites;
+    if (face_sprites) {
+        // 頬はスプライトに描き込み済みなので、目と口より奥に置く
+        create_cheek(-CHEEK_OFFSET_X);
+        create_cheek(CHEEK_OFFSET_X);
+        left_eye = create_sprite_part(face_sprites->eye(true, EYE_OPEN), -EYE_OFFSET_X, EYE_OFFSET_Y);
+        right_eye = create_sprite_part(face_sprites->eye(false, EYE_OPEN), EYE_OFFSET_X, EYE_OFFSET_Y);
+        mouth = create_sprite_part(face_sprites->mouth(MOUTH_CLOSED), 0, MOUTH_OFFSET_Y);
+    } else {
+        left_eye = create_eye_widget(-EYE_OFFSET_X);
+        right_eye = create_eye_widget(EYE_OFFSET_X);
+        mouth = create_mouth_widget();
+        create_cheek(-CHEEK_OFFSET_X);
+        create_cheek(CHEEK_OFFSET_X);
+    }
+    eye_state = EYE_OPEN;
+    mouth_state = MOUTH_CLOSED;
+    
+    current_anim = ANIM_IDLE;
+    eye_openness = ANIM_OPEN_MAX;
+    mouth_openness = 0;
+    
+    if (!blink_timer) {
+        blink_timer = lv_timer_create(blink_timer_cb, BLINK_MAX_INTERVAL_MS, nullptr);
+        idle_timer = lv_timer_create(idle_timer_cb, ANIM_IDLE_RETURN_MS, nullptr);
+        lv_timer_pause(idle_timer);
+    }
+    schedule_blink();
+}
+
+// ===== アニメーション開始 =====
+// 表情は lv_anim (経過時間から補間、イージング付き) と lv_timer で動かす。
+// ループから毎回時刻を調べる必要はなく、lv_timer_handler() が次の
+// キーフレームまでの時間を返すので、呼び出し側はその間眠ってよい。
+void start_animation(AnimState anim) {
+    if (current_anim == ANIM_TALK && anim != ANIM_TALK) {
+        stop_talk();
+    }
+    current_anim = anim;
+    
+    if (anim == ANIM_TALK) {
+        start_talk();
+    }
+    
+    // 2秒後にアイドルに戻る (続けて呼ばれたら延長)
+    if (anim != ANIM_IDLE && idle_timer) {
+        lv_timer_reset(idle_timer);
+        lv_timer_resume(idle_timer);
+    }
+}
+
+// ===== まばたきアニメーション =====
+// 目の開き具合 (0 = 閉, ANIM_OPEN_MAX = 開) を素早く閉じてゆっくり開ける
+void blink_animation() {
+    lv_anim_t a;
+    lv_anim_init(&a);
+    lv_anim_set_var(&a, &eye_openness);
+    lv_anim_set_exec_cb(&a, eye_openness_cb);
+    lv_anim_set_values(&a, ANIM_OPEN_MAX, 0);
+    lv_anim_set_time(&a, BLINK_CLOSE_MS);
+    lv_anim_set_path_cb(&a, lv_anim_path_ease_in);
+    lv_anim_set_playback_time(&a, BLINK_OPEN_MS);
+    lv_anim_start(&a);
+    
+    schedule_blink();
+}
+
+// ===== 話すアニメーション =====
+// 口の開き具合を往復させ続ける (開き具合に応じて TALK_1..3 を選ぶ)。
+// 音量の取得元があれば、往復の代わりに音量で開き具合を決める
+void talk_animation() {
+    start_animation(ANIM_TALK);
+}
+
+void set_talk_level_source(TalkLevelFn fn, void *ctx) {
+    bool talking = current_anim == ANIM_TALK;
+    if (talking) {
+        stop_talk();
+    }
+    talk_level_fn = fn;
+    talk_level_ctx = ctx;
+    if (talking) {
+        start_talk();
+    }
+}
+
+// ===== 驚きアニメーション =====
+void surprise_animation() {
+    lv_anim_del(&eye_openness, eye_openness_cb);
+    eye_openness = ANIM_OPEN_MAX;
+    show_eyes(EYE_WIDE);
+    show_mouth(MOUTH_WIDE);
+}
+
+// ===== 通常状態に戻す =====
+void reset_to_idle() {
+    stop_talk();
+    lv_anim_del(&eye_openness, eye_openness_cb);
+    eye_openness = ANIM_OPEN_MAX;
+    show_eyes(EYE_OPEN);
+    show_mouth(MOUTH_CLOSED);
+    current_anim = ANIM_IDLE;
+    if (idle_timer) {
+        lv_timer_pause(idle_timer);
+    }
+}
@@ -0,0 +1,173 @@
+#include "conversation_history.h"
+
+static const char* TOPIC_SEPARATOR = " / ";
+
+ConversationHistory::ConversationHistory() {
+    turns = nullptr;
+    max_turns = 0;
+    head = 0;
+    count = 0;
+    token_budget = HISTORY_TOKEN_BUDGET;
+    total_tokens = 0;
+    summary[0] = '\0';
+    summary_tokens = 0;
+}
+
+ConversationHistory::~ConversationHistory() {
+    if (turns) {
+        free(turns);
+    }
+}
+
+bool ConversationHistory::init(int num_turns, uint16_t budget) {
+    if (turns) {
+        free(turns);
+        turns = nullptr;
+    }
+
+    size_t size = num_turns * sizeof(Turn);
+    if (psramFound()) {
+        turns = (Turn*)ps_malloc(size);
+    }
+    if (!turns) {
+        turns = (Turn*)malloc(size);
+    }
+    if (!turns) {
+        max_turns = 0;
+        return false;
+    }
+
+    max_turns = num_turns;
+    token_budget = budget;
+    clear();
+    return true;
+}
+
+void ConversationHistory::clear() {
+    head = 0;
+    count = 0;
+    total_tokens = 0;
+    summary[0] = '\0';
+    summary_tokens = 0;
+}
+
+uint16_t ConversationHistory::estimateTokens(const char* text) {
+    uint32_t ascii = 0;
+    uint32_t others = 0;
+
+    for (const uint8_t* p = (const uint8_t*)text; *p; p++) {
+        if (*p < 0x80) {
+            ascii++;
+        } else if ((*p & 0xC0) != 0x80) {
+            // マルチバイト文字の先頭バイトだけ数える
+            others++;
+        }
+    }
+
+    uint32_t tokens = others + (ascii + 3) / 4;
+    return tokens > 0xFFFF ? 0xFFFF : (uint16_t)tokens;
+}
+
+size_t ConversationHistory::copyUtf8(char* dst, const char* src, size_t dst_size) {
+    size_t len = strlen(src);
+    if (len >= dst_size) {
+        // 文字の途中で切らないように先頭バイトまで戻る
+        len = dst_size - 1;
+        while (len > 0 && ((uint8_t)src[len] & 0xC0) == 0x80) {
+            len--;
+        }
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return len;
+}
+
+void ConversationHistory::add(const char* user_msg, const char* assistant_msg) {
+    if (!turns) {
+        return;
+    }
+
+    if (count >= max_turns) {
+        evictOldest();
+    }
+
+    Turn& turn = turns[(head + count) % max_turns];
+    copyUtf8(turn.user, user_msg, sizeof(turn.user));
+    copyUtf8(turn.assistant, assistant_msg, sizeof(turn.assistant));
+    // role等のオーバーヘッドとして1メッセージ4トークン
+    turn.tokens = estimateTokens(turn.user) + estimateTokens(turn.assistant) + 8;
+
+    count++;
+    total_tokens += turn.tokens;
+
+    // 予算を超えたら古いターンを要約に回す (最新ターンは必ず残す)
+    while (count > 1 && total_tokens + summary_tokens > token_budget) {
+        evictOldest();
+    }
+}
+
+void ConversationHistory::evictOldest() {
+    if (count == 0) {
+        return;
+    }
+
+    Turn& oldest = turns[head];
+    appendTopic(oldest.user);
+
+    total_tokens -= oldest.tokens;
+    head = (head + 1) % max_turns;
+    count--;
+}
+
+void ConversationHistory::appendTopic(const char* text) {
+    // ユーザー発言の冒頭だけを話題として残す
+    char topic[HISTORY_TOPIC_BYTES + 1];
+    size_t topic_len = copyUtf8(topic, text, sizeof(topic));
+    if (topic_len == 0) {
+        return;
+    }
+
+    // 入りきらなければ古い話題から捨てる
+    size_t sep_len = strlen(TOPIC_SEPARATOR);
+    while (summary[0] != '\0' &&
+           strlen(summary) + sep_len + topic_len >= sizeof(summary)) {
+        dropOldestTopic();
+    }
+
+    if (summary[0] != '\0') {
+        strcat(summary, TOPIC_SEPARATOR);
+    }
+    strcat(summary, topic);
+    summary_tokens = estimateTokens(summary) + 4;
+
+    // 要約が予算の1/4を超えないようにする (最新の話題は残す)
+    while (summary_tokens > token_budget / 4 && strstr(summary, TOPIC_SEPARATOR)) {
+        dropOldestTopic();
+    }
+}
+
+void ConversationHistory::dropOldestTopic() {
+    char* sep = strstr(summary, TOPIC_SEPARATOR);
+    if (!sep) {
+        summary[0] = '\0';
+        summary_tokens = 0;
+        return;
+    }
+    sep += strlen(TOPIC_SEPARATOR);
+    memmove(summary, sep, strlen(sep) + 1);
+    summary_tokens = estimateTokens(summary) + 4;
+}
+
+int ConversationHistory::firstTurnWithin(uint16_t budget) {
+    uint32_t used = summary_tokens;
+    int first = count;
+
+    for (int i = count - 1; i >= 0; i--) {
+        used += turnTokens(i);
+        if (used > budget) {
+            break;
+        }
+        first = i;
+    }
+    return first;
+}
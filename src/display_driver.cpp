@@ -1,8 +1,31 @@
 #include "display_driver.h"
+#include <esp_heap_caps.h>
+#include "trace.h"
+#include "round_clip.h"
 
 // Global TFT instance for LVGL callback
 static TFT_eSPI* g_tft = nullptr;
 
+// LVGLのディスプレイと描画バッファ
+static lv_disp_t* g_disp = nullptr;
+static lv_disp_drv_t g_disp_drv;
+static lv_disp_draw_buf_t g_draw_buf;
+static lv_color_t* g_bufs[2] = {nullptr, nullptr};
+static lv_color_t* g_bounce[2] = {nullptr, nullptr};   // 内部RAM (DMA転送元)
+static int g_bounce_index = 0;
+static DisplayConfig g_config;
+static bool g_buf_internal = false;     // 描画バッファから直接DMAできるか
+
+// DMAフラッシュの状態
+static bool g_dma_enabled = false;
+static bool g_in_write = false;     // startWrite() したままか
+static DisplayFlushStats g_flush_stats;
+
+// 行ごとの表示範囲 (円の内側) [x0, x1]
+static int16_t g_span_x0[SCREEN_HEIGHT];
+static int16_t g_span_x1[SCREEN_HEIGHT];
+static bool g_span_ready = false;
+
 DisplayDriver::DisplayDriver() {
     tft = new TFT_eSPI(SCREEN_WIDTH, SCREEN_HEIGHT);
     g_tft = tft;
@@ -26,6 +49,22 @@ bool DisplayDriver::init() {
     tft->setRotation(0);  // Portrait mode
     tft->fillScreen(TFT_BLACK);
     
+    // LVGLの色は既にスワップ済み
+    tft->setSwapBytes(false);
+    
+    #if DISPLAY_USE_DMA
+    g_dma_enabled = tft->initDMA();
+    if (!g_dma_enabled) {
+        Serial.println("DMA初期化失敗 - 同期転送を使用");
+    }
+    #endif
+    
+    #if DISPLAY_ROUND_CLIP
+    buildSpanTable();
+    #endif
+    
+    resetFlushStats();
+    
     // Set brightness
     setBrightness(brightness);
     
@@ -33,6 +72,11 @@ bool DisplayDriver::init() {
     return true;
 }
 
+void DisplayDriver::buildSpanTable() {
+    round_clip_build(g_span_x0, g_span_x1, SCREEN_WIDTH, SCREEN_HEIGHT, DISPLAY_CLIP_MARGIN);
+    g_span_ready = true;
+}
+
 void DisplayDriver::setupBacklight() {
     pinMode(TFT_BL, OUTPUT);
     
@@ -51,26 +95,453 @@ uint8_t DisplayDriver::getBrightness() {
 }
 
 void DisplayDriver::fillScreen(uint16_t color) {
+    waitFlush();
     tft->fillScreen(color);
 }
 
 void DisplayDriver::clearScreen() {
+    waitFlush();
     tft->fillScreen(TFT_BLACK);
 }
 
+bool DisplayDriver::isDMAEnabled() {
+    return g_dma_enabled;
+}
+
+void DisplayDriver::waitFlush() {
+    if (!g_tft || !g_in_write) {
+        return;
+    }
+    g_tft->dmaWait();
+    g_tft->endWrite();
+    g_in_write = false;
+}
+
+// 転送中のDMAが終わるまで待つ (待った時間は統計に入れる)
+static void waitDma() {
+    if (g_dma_enabled && g_tft->dmaBusy()) {
+        uint32_t wait_start = micros();
+        g_tft->dmaWait();
+        g_flush_stats.wait_us += micros() - wait_start;
+    }
+}
+
+void DisplayDriver::pushArea(int32_t x, int32_t y, uint32_t w, uint32_t h, uint16_t* data) {
+    if (g_dma_enabled) {
+        // 前回の転送完了を待つ (アドレス設定はDMA中にできない)
+        waitDma();
+        
+        // CSはフラッシュ間で保持したまま
+        if (!g_in_write) {
+            g_tft->startWrite();
+            g_in_write = true;
+        }
+        g_tft->setAddrWindow(x, y, w, h);
+        g_tft->pushPixelsDMA(data, w * h);
+    } else {
+        g_tft->startWrite();
+        g_tft->setAddrWindow(x, y, w, h);
+        g_tft->pushColors(data, w * h, false);
+        g_tft->endWrite();
+    }
+    
+    g_flush_stats.bytes += w * h * sizeof(lv_color_t);
+}
+
+void DisplayDriver::flushStrips(const lv_area_t *area, lv_color_t *src, uint32_t stride, bool in_place) {
+    uint32_t w = (area->x2 - area->x1 + 1);
+    lv_color_t* dst = src;
+    
+    // ストリップの行数: 円のクリッピングなら数行ずつ、そうでなければ
+    // その場で送れるなら領域全体、バウンスバッファ経由なら入るだけ
+    int32_t strip_rows;
+    if (g_span_ready) {
+        strip_rows = DISPLAY_CLIP_STRIP_ROWS;
+    } else if (in_place) {
+        strip_rows = area->y2 - area->y1 + 1;
+    } else {
+        strip_rows = max((int32_t)1, (int32_t)(SCREEN_WIDTH * DISPLAY_BOUNCE_LINES / w));
+    }
+    
+    for (int32_t y = area->y1; y <= area->y2; y += strip_rows) {
+        int32_t ye = min((int32_t)(y + strip_rows - 1), (int32_t)area->y2);
+        uint32_t rows = ye - y + 1;
+        
+        // ストリップ内の行の表示範囲を合わせたもの
+        int32_t sx0 = area->x1;
+        int32_t sx1 = area->x2;
+        if (g_span_ready) {
+            sx0 = SCREEN_WIDTH;
+            sx1 = -1;
+            for (int32_t r = y; r <= ye; r++) {
+                sx0 = min(sx0, (int32_t)g_span_x0[r]);
+                sx1 = max(sx1, (int32_t)g_span_x1[r]);
+            }
+            sx0 = max(sx0, (int32_t)area->x1);
+            sx1 = min(sx1, (int32_t)area->x2);
+        }
+        
+        if (sx0 > sx1) {
+            g_flush_stats.clipped_bytes += w * rows * sizeof(lv_color_t);
+            continue;
+        }
+        uint32_t sw = sx1 - sx0 + 1;
+        
+        lv_color_t* strip;
+        if (in_place) {
+            // 表示範囲だけをバッファの前方に詰める
+            // (書き込み先は常に読み出し元以前、送信中の前のストリップより後ろ)
+            strip = dst;
+            for (int32_t r = y; r <= ye; r++) {
+                lv_color_t* from = src + (r - area->y1) * stride + (sx0 - area->x1);
+                if (from != dst) {
+                    memmove(dst, from, sw * sizeof(lv_color_t));
+                }
+                dst += sw;
+            }
+        } else {
+            // バウンスバッファに交互にコピー (もう一方は転送中でもよい)
+            strip = g_bounce[g_bounce_index];
+            g_bounce_index ^= 1;
+            lv_color_t* out = strip;
+            for (int32_t r = y; r <= ye; r++) {
+                memcpy(out, src + (r - area->y1) * stride + (sx0 - area->x1), sw * sizeof(lv_color_t));
+                out += sw;
+            }
+        }
+        
+        pushArea(sx0, y, sw, rows, (uint16_t *)&strip->full);
+        g_flush_stats.clipped_bytes += (w - sw) * rows * sizeof(lv_color_t);
+    }
+}
+
 void DisplayDriver::lvgl_flush_cb(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p) {
     if (!g_tft) {
         lv_disp_flush_ready(disp);
         return;
     }
     
-    uint32_t w = (area->x2 - area->x1 + 1);
-    uint32_t h = (area->y2 - area->y1 + 1);
+    uint32_t start = micros();
+    TRACE_SCOPE_ARG("lv_flush", area->y2 - area->y1 + 1);
     
-    g_tft->startWrite();
-    g_tft->setAddrWindow(area->x1, area->y1, w, h);
-    g_tft->pushColors((uint16_t *)&color_p->full, w * h, true);
-    g_tft->endWrite();
+    if (disp->direct_mode) {
+        // 全画面バッファ: flush_cb には画面全体が渡されるので、
+        // 最後の部分を描き終えたところで今回の無効領域だけを送る
+        if (lv_disp_flush_is_last(disp)) {
+            lv_disp_t* refr = _lv_refr_get_disp_refreshing();
+            for (uint16_t i = 0; i < refr->inv_p; i++) {
+                if (refr->inv_area_joined[i]) {
+                    continue;
+                }
+                const lv_area_t* inv = &refr->inv_areas[i];
+                flushStrips(inv, color_p + inv->y1 * SCREEN_WIDTH + inv->x1, SCREEN_WIDTH, false);
+            }
+        }
+    } else if (g_buf_internal && !g_span_ready) {
+        uint32_t w = (area->x2 - area->x1 + 1);
+        uint32_t h = (area->y2 - area->y1 + 1);
+        pushArea(area->x1, area->y1, w, h, (uint16_t *)&color_p->full);
+    } else {
+        flushStrips(area, color_p, area->x2 - area->x1 + 1, g_buf_internal);
+    }
+    
+    // 描画バッファから直接DMAしていてバッファが1枚だと、返した直後にLVGLが
+    // 同じバッファへ次のバンドを描くので送り終えるまで待つ (バウンスバッファ経由なら不要)
+    if (g_buf_internal && !g_draw_buf.buf2) {
+        waitDma();
+    }
+    
+    g_flush_stats.flushes++;
+    if (lv_disp_flush_is_last(disp)) {
+        g_flush_stats.frames++;
+    }
+    g_flush_stats.busy_us += micros() - start;
     
+    // バッファが2枚なら、LVGLはDMA中でないほうに描くのですぐに返してよい
+    // (DMA中のバッファは次のフラッシュの先頭で転送完了を待ってから渡される)
     lv_disp_flush_ready(disp);
 }
+
+void DisplayDriver::lvgl_rounder_cb(lv_disp_drv_t *disp, lv_area_t *area) {
+    if (!g_span_ready) {
+        return;
+    }
+    // 横方向だけ縮める (縦を縮めるとLVGLがバンドを1行ずつ描くようになる)
+    round_clip_area(area, g_span_x0, g_span_x1, SCREEN_HEIGHT);
+}
+
+void DisplayDriver::lvgl_monitor_cb(lv_disp_drv_t *disp, uint32_t time, uint32_t px) {
+    g_flush_stats.refreshes++;
+    g_flush_stats.rendered_px += px;
+    g_flush_stats.render_ms += time;
+}
+
+DisplayConfig DisplayDriver::defaultConfig() {
+    DisplayConfig config;
+    config.band_lines = DISPLAY_BAND_LINES;
+    config.location = DISPLAY_BUF_INTERNAL;
+    config.double_buffer = true;
+    config.full_frame = false;
+    return config;
+}
+
+const DisplayConfig& DisplayDriver::getConfig() {
+    return g_config;
+}
+
+static bool sameConfig(const DisplayConfig& a, const DisplayConfig& b) {
+    return a.band_lines == b.band_lines &&
+           a.location == b.location &&
+           a.double_buffer == b.double_buffer &&
+           a.full_frame == b.full_frame;
+}
+
+// バッファがない間はLVGLに描かせない (解放したメモリに描いてしまう)
+static void setRendering(bool enabled) {
+    if (!g_disp || !g_disp->refr_timer) {
+        return;
+    }
+    if (enabled) {
+        lv_timer_resume(g_disp->refr_timer);
+    } else {
+        lv_timer_pause(g_disp->refr_timer);
+    }
+}
+
+void DisplayDriver::freeBuffers(lv_color_t* bufs[2]) {
+    for (int i = 0; i < 2; i++) {
+        if (bufs[i]) {
+            heap_caps_free(bufs[i]);
+            bufs[i] = nullptr;
+        }
+    }
+}
+
+bool DisplayDriver::allocBuffers(const DisplayConfig& config, lv_color_t* bufs[2]) {
+    bool internal = !config.full_frame && config.location == DISPLAY_BUF_INTERNAL;
+    uint32_t caps = internal ? (MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL) : MALLOC_CAP_SPIRAM;
+    uint32_t pixels = SCREEN_WIDTH * (config.full_frame ? SCREEN_HEIGHT : config.band_lines);
+    int count = (config.double_buffer && !config.full_frame) ? 2 : 1;
+    
+    for (int i = 0; i < count; i++) {
+        bufs[i] = (lv_color_t*)heap_caps_malloc(pixels * sizeof(lv_color_t), caps);
+        if (!bufs[i]) {
+            freeBuffers(bufs);
+            return false;
+        }
+    }
+    
+    // PSRAMからはDMAできないので、転送用のバウンスバッファを用意
+    // (今の構成では使わないので、確保しておくだけなら害はない)
+    if (!internal && !g_bounce[0]) {
+        for (int i = 0; i < 2; i++) {
+            g_bounce[i] = (lv_color_t*)heap_caps_malloc(
+                SCREEN_WIDTH * DISPLAY_BOUNCE_LINES * sizeof(lv_color_t),
+                MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        }
+        if (!g_bounce[0] || !g_bounce[1]) {
+            freeBuffers(g_bounce);
+            freeBuffers(bufs);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DisplayDriver::setupLVGL(const DisplayConfig& config) {
+    // 新しいバッファを先に確保する (失敗しても今のバッファで描き続けられる)
+    lv_color_t* bufs[2] = {nullptr, nullptr};
+    bool ok = allocBuffers(config, bufs);
+    if (!ok && g_bufs[0]) {
+        // 両方を持つ空きがない: 描画を止め、今のバッファを返してから確保し直す
+        setRendering(false);
+        waitFlush();
+        freeBuffers(g_bufs);
+        ok = allocBuffers(config, bufs);
+    }
+    
+    if (!ok) {
+        Serial.printf("描画バッファ確保失敗 (%d行, %s)\n", config.band_lines,
+                      config.location == DISPLAY_BUF_PSRAM ? "PSRAM" : "内部RAM");
+        // 既定の構成に戻す
+        DisplayConfig fallback = defaultConfig();
+        if (sameConfig(config, fallback)) {
+            // バッファがないので描画は止めたまま
+            return false;
+        }
+        return setupLVGL(fallback);
+    }
+    
+    // 転送中のバッファを解放しないように
+    waitFlush();
+    freeBuffers(g_bufs);
+    g_bufs[0] = bufs[0];
+    g_bufs[1] = bufs[1];
+    
+    bool internal = !config.full_frame && config.location == DISPLAY_BUF_INTERNAL;
+    if (internal) {
+        // 内部RAMのバンドからは直接DMAするので、バウンスバッファは返す
+        freeBuffers(g_bounce);
+    }
+    uint32_t pixels = SCREEN_WIDTH * (config.full_frame ? SCREEN_HEIGHT : config.band_lines);
+    lv_disp_draw_buf_init(&g_draw_buf, g_bufs[0], g_bufs[1], pixels);
+    g_buf_internal = internal;
+    g_config = config;
+    
+    if (!g_disp) {
+        lv_disp_drv_init(&g_disp_drv);
+        g_disp_drv.hor_res = SCREEN_WIDTH;
+        g_disp_drv.ver_res = SCREEN_HEIGHT;
+        g_disp_drv.flush_cb = lvgl_flush_cb;
+        g_disp_drv.monitor_cb = lvgl_monitor_cb;
+        #if DISPLAY_ROUND_CLIP
+        g_disp_drv.rounder_cb = lvgl_rounder_cb;
+        #endif
+        g_disp_drv.draw_buf = &g_draw_buf;
+        g_disp_drv.direct_mode = config.full_frame;
+        g_disp = lv_disp_drv_register(&g_disp_drv);
+    } else {
+        g_disp_drv.draw_buf = &g_draw_buf;
+        g_disp_drv.direct_mode = config.full_frame;
+        lv_disp_drv_update(g_disp, &g_disp_drv);
+        lv_obj_invalidate(lv_scr_act());
+        setRendering(true);
+    }
+    
+    return g_disp != nullptr;
+}
+
+// 構成の比較は1フレームずつ進める (loopのタスクから少しずつ呼ぶ)
+static const DisplayConfig g_bench_configs[] = {
+    // band_lines, location, double_buffer, full_frame
+    {60, DISPLAY_BUF_INTERNAL, true,  false},
+    {30, DISPLAY_BUF_INTERNAL, true,  false},
+    {20, DISPLAY_BUF_INTERNAL, false, false},    // 1枚: フラッシュごとにDMAの完了を待つ
+    {60, DISPLAY_BUF_PSRAM,    true,  false},
+    {120, DISPLAY_BUF_PSRAM,   true,  false},
+    {0,  DISPLAY_BUF_PSRAM,    false, true},
+};
+#define BENCH_NUM_CONFIGS (int)(sizeof(g_bench_configs) / sizeof(g_bench_configs[0]))
+
+static struct {
+    bool running;
+    int frames;
+    int config;             // 計測中の構成
+    int frame;              // その構成で描いたフレーム数
+    uint32_t elapsed_us;    // 計測したフレームの時間の合計 (合間のUIの描画は含めない)
+    DisplayConfig original;
+} g_bench;
+
+bool DisplayDriver::startBenchmark(int frames) {
+    if (g_bench.running) {
+        return false;
+    }
+    g_bench.running = true;
+    g_bench.frames = frames > 0 ? frames : 1;
+    g_bench.config = 0;
+    g_bench.frame = 0;
+    g_bench.original = g_config;
+    Serial.println("描画バッファ構成ベンチマーク (全画面再描画):");
+    return true;
+}
+
+bool DisplayDriver::isBenchmarking() {
+    return g_bench.running;
+}
+
+bool DisplayDriver::benchmarkStep() {
+    if (!g_bench.running) {
+        return false;
+    }
+    
+    const DisplayConfig& cfg = g_bench_configs[g_bench.config];
+    if (g_bench.frame == 0) {
+        if (!setupLVGL(cfg) || !sameConfig(g_config, cfg)) {
+            Serial.printf("  構成%d: 確保できないのでスキップ\n", g_bench.config);
+            g_bench.frame = g_bench.frames;
+        } else {
+            // 切り替え直後の再描画は計測に入れない
+            waitFlush();
+            g_bench.elapsed_us = 0;
+        }
+    }
+    
+    if (g_bench.frame < g_bench.frames) {
+        uint32_t start = micros();
+        lv_obj_invalidate(lv_scr_act());
+        lv_refr_now(g_disp);
+        if (++g_bench.frame == g_bench.frames) {
+            waitFlush();
+        }
+        g_bench.elapsed_us += micros() - start;
+        
+        if (g_bench.frame == g_bench.frames) {
+            uint32_t elapsed_ms = g_bench.elapsed_us / 1000;
+            Serial.printf("  %s %3d行 %s%s: %.1f FPS, 内部RAM空き %d (最大ブロック %d), PSRAM空き %d\n",
+                          cfg.full_frame ? "全画面" : "バンド",
+                          cfg.full_frame ? SCREEN_HEIGHT : cfg.band_lines,
+                          cfg.location == DISPLAY_BUF_PSRAM || cfg.full_frame ? "PSRAM" : "内部RAM",
+                          cfg.double_buffer && !cfg.full_frame ? " x2" : "",
+                          g_bench.frames * 1000.0f / (elapsed_ms ? elapsed_ms : 1),
+                          (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                          (int)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+                          (int)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+        }
+    }
+    
+    if (g_bench.frame < g_bench.frames) {
+        return true;
+    }
+    g_bench.frame = 0;
+    if (++g_bench.config < BENCH_NUM_CONFIGS) {
+        return true;
+    }
+    
+    g_bench.running = false;
+    setupLVGL(g_bench.original);
+    resetFlushStats();
+    return false;
+}
+
+void DisplayDriver::benchmarkConfigs(int frames) {
+    if (!startBenchmark(frames)) {
+        return;
+    }
+    while (benchmarkStep()) {
+    }
+}
+
+void DisplayDriver::getFlushStats(DisplayFlushStats* out) {
+    *out = g_flush_stats;
+}
+
+void DisplayDriver::resetFlushStats() {
+    memset(&g_flush_stats, 0, sizeof(g_flush_stats));
+    g_flush_stats.since_ms = millis();
+}
+
+void DisplayDriver::printFlushStats() {
+    DisplayFlushStats st = g_flush_stats;
+    uint32_t elapsed_ms = millis() - st.since_ms;
+    if (elapsed_ms == 0) {
+        elapsed_ms = 1;
+    }
+    
+    float fps = st.frames * 1000.0f / elapsed_ms;
+    float cpu_load = st.busy_us / (elapsed_ms * 10.0f);  // %
+    float kbps = st.bytes / (float)elapsed_ms;            // KB/s
+    
+    float clipped = (st.bytes + st.clipped_bytes) > 0 ?
+                    st.clipped_bytes * 100.0f / (st.bytes + st.clipped_bytes) : 0.0f;
+    
+    Serial.printf("ディスプレイ(%s): %.1f FPS, フラッシュ %lu回, %.0f KB/s, CPU %.1f%% (待ち %.1f%%), 円外カット %.1f%%\n",
+                  g_dma_enabled ? "DMA" : "同期", fps, (unsigned long)st.flushes, kbps,
+                  cpu_load, st.wait_us / (elapsed_ms * 10.0f), clipped);
+    
+    // 1回の再描画あたりの画素数 (顔全体 280x280 = 78400px との比較用)
+    Serial.printf("  描画: %lu回, %.0f px/s, %lu px/回 (%lu ms/回), %.0f bytes/s 送信\n",
+                  (unsigned long)st.refreshes, st.rendered_px * 1000.0f / elapsed_ms,
+                  (unsigned long)(st.refreshes ? st.rendered_px / st.refreshes : 0),
+                  (unsigned long)(st.refreshes ? st.render_ms / st.refreshes : 0),
+                  st.bytes * 1000.0f / elapsed_ms);
+}
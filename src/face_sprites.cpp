@@ -0,0 +1,205 @@
+#include "face_sprites.h"
+#include <Arduino.h>
+#include <SPIFFS.h>
+
+// 各状態の形 (以前のウィジェットのサイズと同じ)
+static const SpriteShape EYE_SHAPES[EYE_STATE_COUNT] = {
+    {45, 65},   // EYE_OPEN
+    {45, 10},   // EYE_CLOSED
+    {55, 75},   // EYE_WIDE
+};
+
+static const SpriteShape MOUTH_SHAPES[MOUTH_STATE_COUNT] = {
+    {30, 15},   // MOUTH_CLOSED
+    {34, 22},   // MOUTH_TALK_1
+    {40, 35},   // MOUTH_TALK_2
+    {44, 40},   // MOUTH_TALK_3
+    {45, 45},   // MOUTH_WIDE
+};
+
+FaceSprites::FaceSprites() {
+    pixels = nullptr;
+    pixel_count = 0;
+    memset(eye_dsc, 0, sizeof(eye_dsc));
+    memset(mouth_dsc, 0, sizeof(mouth_dsc));
+}
+
+FaceSprites::~FaceSprites() {
+    if (pixels) {
+        free(pixels);
+    }
+}
+
+SpriteShape FaceSprites::eyeShape(EyeState state) {
+    return EYE_SHAPES[state];
+}
+
+SpriteShape FaceSprites::mouthShape(MouthState state) {
+    return MOUTH_SHAPES[state];
+}
+
+bool FaceSprites::init(const char* cache_path) {
+    pixel_count = 2 * EYE_STATE_COUNT * EYE_CELL_W * EYE_CELL_H +
+                  MOUTH_STATE_COUNT * MOUTH_CELL_W * MOUTH_CELL_H;
+
+    if (psramFound()) {
+        pixels = (lv_color_t*)ps_malloc(pixel_count * sizeof(lv_color_t));
+    }
+    if (!pixels) {
+        Serial.println("表情アトラス: PSRAM確保失敗");
+        pixel_count = 0;
+        return false;
+    }
+
+    layoutCells();
+
+    uint32_t start = millis();
+    if (cache_path && loadCache(cache_path)) {
+        Serial.printf("表情アトラス読み込み: %d bytes (%dms)\n",
+                      (int)getMemoryUsage(), (int)(millis() - start));
+        return true;
+    }
+
+    render();
+    Serial.printf("表情アトラス描画: %d bytes (%dms)\n",
+                  (int)getMemoryUsage(), (int)(millis() - start));
+
+    if (cache_path && !saveCache(cache_path)) {
+        Serial.println("表情アトラスの保存に失敗しました");
+    }
+    return true;
+}
+
+void FaceSprites::layoutCells() {
+    lv_color_t* p = pixels;
+
+    auto setup = [&p](lv_img_dsc_t* dsc, lv_coord_t w, lv_coord_t h) {
+        dsc->header.always_zero = 0;
+        dsc->header.cf = LV_IMG_CF_TRUE_COLOR;
+        dsc->header.w = w;
+        dsc->header.h = h;
+        dsc->data_size = w * h * sizeof(lv_color_t);
+        dsc->data = (const uint8_t*)p;
+        p += w * h;
+    };
+
+    for (int side = 0; side < 2; side++) {
+        for (int s = 0; s < EYE_STATE_COUNT; s++) {
+            setup(&eye_dsc[side][s], EYE_CELL_W, EYE_CELL_H);
+        }
+    }
+    for (int s = 0; s < MOUTH_STATE_COUNT; s++) {
+        setup(&mouth_dsc[s], MOUTH_CELL_W, MOUTH_CELL_H);
+    }
+}
+
+void FaceSprites::render() {
+    // 画面外のキャンバスに描いてアトラスへ直接書き込む
+    lv_obj_t* canvas = lv_canvas_create(lv_scr_act());
+    lv_obj_add_flag(canvas, LV_OBJ_FLAG_HIDDEN);
+
+    for (int side = 0; side < 2; side++) {
+        lv_coord_t x = side == 0 ? -EYE_OFFSET_X : EYE_OFFSET_X;
+        for (int s = 0; s < EYE_STATE_COUNT; s++) {
+            renderCell(canvas, &eye_dsc[side][s], x, EYE_OFFSET_Y,
+                       EYE_SHAPES[s], EYE_COLOR, s != EYE_CLOSED);
+        }
+    }
+    for (int s = 0; s < MOUTH_STATE_COUNT; s++) {
+        renderCell(canvas, &mouth_dsc[s], 0, MOUTH_OFFSET_Y,
+                   MOUTH_SHAPES[s], MOUTH_COLOR, false);
+    }
+
+    lv_obj_del(canvas);
+}
+
+void FaceSprites::renderCell(lv_obj_t* canvas, const lv_img_dsc_t* dsc,
+                             lv_coord_t cell_x, lv_coord_t cell_y,
+                             SpriteShape shape, uint32_t color, bool highlight) {
+    lv_coord_t cw = dsc->header.w;
+    lv_coord_t ch = dsc->header.h;
+    lv_canvas_set_buffer(canvas, (void*)dsc->data, cw, ch, LV_IMG_CF_TRUE_COLOR);
+
+    // 顔の地の色
+    lv_canvas_fill_bg(canvas, lv_color_hex(FACE_COLOR), LV_OPA_COVER);
+
+    lv_draw_rect_dsc_t rect;
+    lv_draw_rect_dsc_init(&rect);
+    rect.radius = LV_RADIUS_CIRCLE;
+
+    // パーツ本体 (セルの中心)
+    lv_coord_t px = (cw - shape.w) / 2;
+    lv_coord_t py = (ch - shape.h) / 2;
+    rect.bg_color = lv_color_hex(color);
+    rect.bg_opa = LV_OPA_COVER;
+    lv_canvas_draw_rect(canvas, px, py, shape.w, shape.h, &rect);
+
+    // 白いハイライト
+    if (highlight) {
+        rect.bg_color = lv_color_white();
+        lv_canvas_draw_rect(canvas, px + 8, py + 8, 15, 20, &rect);
+    }
+
+    // 頬の赤み (パーツより手前、セルにかかる部分だけ描かれる)
+    lv_coord_t left = cell_x - cw / 2;
+    lv_coord_t top = cell_y - ch / 2;
+    rect.bg_color = lv_color_hex(CHEEK_COLOR);
+    rect.bg_opa = LV_OPA_50;
+    for (int side = -1; side <= 1; side += 2) {
+        lv_coord_t cheek_x = side * CHEEK_OFFSET_X - CHEEK_WIDTH / 2 - left;
+        lv_coord_t cheek_y = CHEEK_OFFSET_Y - CHEEK_HEIGHT / 2 - top;
+        if (cheek_x + CHEEK_WIDTH <= 0 || cheek_x >= cw ||
+            cheek_y + CHEEK_HEIGHT <= 0 || cheek_y >= ch) {
+            continue;
+        }
+        lv_canvas_draw_rect(canvas, cheek_x, cheek_y, CHEEK_WIDTH, CHEEK_HEIGHT, &rect);
+    }
+}
+
+bool FaceSprites::loadCache(const char* path) {
+    if (!SPIFFS.begin(false) || !SPIFFS.exists(path)) {
+        return false;
+    }
+
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+
+    uint8_t header[12];
+    size_t bytes = getMemoryUsage();
+    bool ok = file.read(header, sizeof(header)) == sizeof(header) &&
+              memcmp(header, FACE_ATLAS_MAGIC, 4) == 0 &&
+              header[4] == FACE_ATLAS_VERSION &&
+              header[5] == LV_COLOR_16_SWAP &&
+              (header[8] | (header[9] << 8) | ((uint32_t)header[10] << 16) | ((uint32_t)header[11] << 24)) == bytes &&
+              file.read((uint8_t*)pixels, bytes) == bytes;
+
+    file.close();
+    return ok;
+}
+
+bool FaceSprites::saveCache(const char* path) {
+    if (!SPIFFS.begin(false)) {
+        return false;
+    }
+
+    File file = SPIFFS.open(path, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+
+    uint32_t bytes = getMemoryUsage();
+    uint8_t header[12] = {0};
+    memcpy(header, FACE_ATLAS_MAGIC, 4);
+    header[4] = FACE_ATLAS_VERSION;
+    header[5] = LV_COLOR_16_SWAP;   // バイト順が違うアトラスは使わない
+    for (int b = 0; b < 4; b++) {
+        header[8 + b] = (uint8_t)(bytes >> (8 * b));
+    }
+
+    bool ok = file.write(header, sizeof(header)) == sizeof(header) &&
+              file.write((const uint8_t*)pixels, bytes) == bytes;
+    file.close();
+    return ok;
+}
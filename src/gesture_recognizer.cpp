@@ -0,0 +1,186 @@
+#include "gesture_recognizer.h"
+#include <string.h>
+
+#define ANGLE_FULL          65536
+#define ANGLE_ROTATE_STEP   (GESTURE_ROTATE_STEP_DEG * ANGLE_FULL / 360)
+
+static inline int32_t iabs(int32_t v) {
+    return v < 0 ? -v : v;
+}
+
+static inline int16_t clamp16(int32_t v) {
+    return v > 32767 ? 32767 : (v < -32768 ? -32768 : (int16_t)v);
+}
+
+GestureRecognizer::GestureRecognizer() {
+    reset();
+    resetStats();
+}
+
+void GestureRecognizer::reset() {
+    count = 0;
+    active = false;
+    swiped = false;
+    rotating = false;
+    angle_accum = 0;
+    angle_total = 0;
+}
+
+uint16_t GestureRecognizer::angleOf(int32_t dx, int32_t dy) {
+    if (dx == 0 && dy == 0) {
+        return 0;
+    }
+
+    // 第1八分円 (0 <= z <= 1) に折りたたんで
+    // atan(z) ≒ π/4·z + 0.273·z(1-z) を整数で計算 (誤差 0.1度程度)
+    int32_t ax = iabs(dx);
+    int32_t ay = iabs(dy);
+    bool swap = ay > ax;
+    int32_t lo = swap ? ax : ay;
+    int32_t hi = swap ? ay : ax;
+    int32_t z = (lo << 15) / hi;                                // Q15
+    int32_t a = ((8192 * z) >> 15) + (((2847 * z) >> 15) * (32768 - z) >> 15);
+
+    if (swap) a = 16384 - a;            // |dy| > |dx|
+    if (dx < 0) a = 32768 - a;
+    if (dy < 0) a = ANGLE_FULL - a;     // 画面座標はyが下向きなので時計回りに増える
+    return (uint16_t)a;
+}
+
+bool GestureRecognizer::feed(const TouchPoint& sample, uint32_t now_us, GestureEvent* out) {
+    if (!sample.touched) {
+        reset();
+        return false;
+    }
+
+    // 直近の生座標の平均で平滑化
+    int slot = count % GESTURE_SMOOTH_SAMPLES;
+    raw_x[slot] = sample.x;
+    raw_y[slot] = sample.y;
+    int n = count < GESTURE_SMOOTH_SAMPLES ? count + 1 : GESTURE_SMOOTH_SAMPLES;
+    int32_t sx = 0;
+    int32_t sy = 0;
+    for (int i = 0; i < n; i++) {
+        sx += raw_x[i];
+        sy += raw_y[i];
+    }
+
+    Sample& s = ring[count & (GESTURE_RING_SIZE - 1)];
+    s.x = sx / n;
+    s.y = sy / n;
+    s.t_us = now_us;
+    count++;
+
+    if (!active) {
+        active = true;
+        start_x = s.x;
+        start_y = s.y;
+        start_us = now_us;
+        last_angle = angleOf(s.x - GESTURE_CENTER_X, s.y - GESTURE_CENTER_Y);
+        return false;
+    }
+
+    if (swiped) {
+        return false;
+    }
+    // 速い直線の動きはスワイプ、ゆっくり縁をなぞる動きは回転
+    if (!rotating && checkSwipe(s, out)) {
+        return true;
+    }
+    return checkRotate(s, out);
+}
+
+void GestureRecognizer::velocity(const Sample& now, int16_t* vx, int16_t* vy) const {
+    // 窓の始まりに最も近い古いサンプル (リングに残っている範囲で)
+    uint32_t window_us = GESTURE_VELOCITY_WINDOW_MS * 1000;
+    uint32_t oldest = count > GESTURE_RING_SIZE ? count - GESTURE_RING_SIZE : 0;
+    const Sample* from = &now;
+    for (uint32_t i = count - 1; i > oldest; i--) {
+        const Sample& prev = ring[(i - 1) & (GESTURE_RING_SIZE - 1)];
+        from = &prev;
+        if (now.t_us - prev.t_us >= window_us) {
+            break;
+        }
+    }
+
+    uint32_t dt = now.t_us - from->t_us;
+    if (dt == 0) {
+        *vx = 0;
+        *vy = 0;
+        return;
+    }
+    // 座標差は画面内 (±360) なので 1e6 を掛けても int32 に収まる
+    *vx = clamp16((int32_t)(now.x - from->x) * 1000000 / (int32_t)dt);
+    *vy = clamp16((int32_t)(now.y - from->y) * 1000000 / (int32_t)dt);
+}
+
+bool GestureRecognizer::checkSwipe(const Sample& now, GestureEvent* out) {
+    int32_t dx = now.x - start_x;
+    int32_t dy = now.y - start_y;
+    int32_t ax = iabs(dx);
+    int32_t ay = iabs(dy);
+    int32_t major = ax > ay ? ax : ay;
+    int32_t minor = ax > ay ? ay : ax;
+
+    if (major < GESTURE_SWIPE_MIN_DIST || major < minor * GESTURE_SWIPE_STRAIGHTNESS) {
+        return false;
+    }
+
+    int16_t vx, vy;
+    velocity(now, &vx, &vy);
+    int32_t speed = ax > ay ? iabs(vx) : iabs(vy);
+    if (speed < GESTURE_SWIPE_MIN_VELOCITY) {
+        return false;
+    }
+
+    swiped = true;
+    if (ax > ay) {
+        out->gesture = dx > 0 ? GESTURE_SWIPE_RIGHT : GESTURE_SWIPE_LEFT;
+    } else {
+        out->gesture = dy > 0 ? GESTURE_SWIPE_DOWN : GESTURE_SWIPE_UP;
+    }
+    out->x = now.x;
+    out->y = now.y;
+    out->vx = vx;
+    out->vy = vy;
+    out->angle_deg = 0;
+    out->elapsed_ms = (now.t_us - start_us) / 1000;
+
+    swipes++;
+    swipe_ms_sum += out->elapsed_ms;
+    return true;
+}
+
+bool GestureRecognizer::checkRotate(const Sample& now, GestureEvent* out) {
+    int32_t cx = now.x - GESTURE_CENTER_X;
+    int32_t cy = now.y - GESTURE_CENTER_Y;
+    uint16_t angle = angleOf(cx, cy);
+
+    // 中心付近では角度が暴れるので積算しない
+    if (cx * cx + cy * cy < GESTURE_ROTATE_MIN_RADIUS * GESTURE_ROTATE_MIN_RADIUS) {
+        last_angle = angle;
+        angle_accum = 0;
+        return false;
+    }
+
+    int32_t delta = (int16_t)(uint16_t)(angle - last_angle);
+    last_angle = angle;
+    angle_accum += delta;
+    angle_total += delta;
+
+    if (iabs(angle_accum) < ANGLE_ROTATE_STEP) {
+        return false;
+    }
+
+    rotating = true;
+    out->gesture = angle_accum > 0 ? GESTURE_ROTATE_CW : GESTURE_ROTATE_CCW;
+    angle_accum += angle_accum > 0 ? -ANGLE_ROTATE_STEP : ANGLE_ROTATE_STEP;
+    out->x = now.x;
+    out->y = now.y;
+    velocity(now, &out->vx, &out->vy);
+    out->angle_deg = (int16_t)(angle_total * 360 / ANGLE_FULL);
+    out->elapsed_ms = (now.t_us - start_us) / 1000;
+
+    rotations++;
+    return true;
+}
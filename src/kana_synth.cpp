@@ -0,0 +1,589 @@
+#include "kana_synth.h"
+#include <math.h>
+
+// 子音
+enum {
+    C_NONE, C_K, C_G, C_S, C_SH, C_Z, C_J, C_T, C_CH, C_TS, C_D,
+    C_N, C_H, C_F, C_B, C_P, C_M, C_Y, C_R, C_W,
+    C_NN,       // ん
+    C_Q,        // っ
+    C_PAUSE
+};
+
+// 母音
+enum { V_A, V_I, V_U, V_E, V_O };
+
+#define MORA_PALATAL    0x01    // きゃ など (母音の前に「い」の渡り)
+#define MORA_QUESTION   0x02    // 語尾を上げる
+#define MORA_PHRASE_END 0x04
+
+#define KM(c, v)    (uint8_t)((c) << 3 | (v))
+#define KM_SMALL    0xFF        // 小書きかな (前のモーラを書き換える)
+
+// U+3041 (ぁ) 〜 U+3096 (ゖ)。カタカナは 0x60 引いてここを引く
+static const uint8_t KANA_TABLE[] = {
+    KM_SMALL, KM(C_NONE, V_A), KM_SMALL, KM(C_NONE, V_I), KM_SMALL,                 // ぁあぃいぅ
+    KM(C_NONE, V_U), KM_SMALL, KM(C_NONE, V_E), KM_SMALL, KM(C_NONE, V_O),          // うぇえぉお
+    KM(C_K, V_A), KM(C_G, V_A), KM(C_K, V_I), KM(C_G, V_I), KM(C_K, V_U),           // かがきぎく
+    KM(C_G, V_U), KM(C_K, V_E), KM(C_G, V_E), KM(C_K, V_O), KM(C_G, V_O),           // ぐけげこご
+    KM(C_S, V_A), KM(C_Z, V_A), KM(C_SH, V_I), KM(C_J, V_I), KM(C_S, V_U),          // さざしじす
+    KM(C_Z, V_U), KM(C_S, V_E), KM(C_Z, V_E), KM(C_S, V_O), KM(C_Z, V_O),           // ずせぜそぞ
+    KM(C_T, V_A), KM(C_D, V_A), KM(C_CH, V_I), KM(C_J, V_I), KM(C_Q, V_U),          // ただちぢっ
+    KM(C_TS, V_U), KM(C_Z, V_U), KM(C_T, V_E), KM(C_D, V_E), KM(C_T, V_O),          // つづてでと
+    KM(C_D, V_O),                                                                   // ど
+    KM(C_N, V_A), KM(C_N, V_I), KM(C_N, V_U), KM(C_N, V_E), KM(C_N, V_O),           // なにぬねの
+    KM(C_H, V_A), KM(C_B, V_A), KM(C_P, V_A), KM(C_H, V_I), KM(C_B, V_I),           // はばぱひび
+    KM(C_P, V_I), KM(C_F, V_U), KM(C_B, V_U), KM(C_P, V_U), KM(C_H, V_E),           // ぴふぶぷへ
+    KM(C_B, V_E), KM(C_P, V_E), KM(C_H, V_O), KM(C_B, V_O), KM(C_P, V_O),           // べぺほぼぽ
+    KM(C_M, V_A), KM(C_M, V_I), KM(C_M, V_U), KM(C_M, V_E), KM(C_M, V_O),           // まみむめも
+    KM_SMALL, KM(C_Y, V_A), KM_SMALL, KM(C_Y, V_U), KM_SMALL, KM(C_Y, V_O),         // ゃやゅゆょよ
+    KM(C_R, V_A), KM(C_R, V_I), KM(C_R, V_U), KM(C_R, V_E), KM(C_R, V_O),           // らりるれろ
+    KM_SMALL, KM(C_W, V_A), KM(C_NONE, V_I), KM(C_NONE, V_E), KM(C_NONE, V_O),      // ゎわゐゑを
+    KM(C_NN, V_U), KM(C_B, V_U), KM(C_K, V_A), KM(C_K, V_E)                         // んゔゕゖ
+};
+
+// 母音のフォルマント (子どもっぽい高めの声)
+static const float VOWEL_FORMANTS[5][3] = {
+    { 950, 1500, 3200 },    // あ
+    { 350, 2700, 3400 },    // い
+    { 400, 1600, 3000 },    // う (唇を丸めない日本語の「う」)
+    { 550, 2300, 3200 },    // え
+    { 550, 1000, 3000 },    // お
+};
+static const float GLIDE_Y[3] = { 320, 2600, 3300 };
+static const float GLIDE_W[3] = { 380, 800, 2900 };
+static const float NASAL_N[3] = { 260, 1700, 2700 };
+static const float NASAL_M[3] = { 260, 1100, 2500 };
+static const float FLAP_R[3] = { 350, 1400, 2700 };
+static const float FORMANT_BW[3] = { 90, 110, 170 };
+
+#define MS_TO_SAMPLES(ms)   ((ms) * (AUDIO_SAMPLE_RATE / 1000))
+#define GLIDE_SAMPLES       MS_TO_SAMPLES(35)
+#define GLOTTAL_OPEN        0.6f        // 声門が開いている割合
+#define VOICE_GAIN          36000.0f
+#define NOISE_GAIN          1500.0f
+#define ASPIRATION_GAIN     2000.0f
+
+void KanaSynth::Resonator::set(float freq, float bw) {
+    float r = expf(-(float)M_PI * bw / AUDIO_SAMPLE_RATE);
+    c = -r * r;
+    b = 2.0f * r * cosf(2.0f * (float)M_PI * freq / AUDIO_SAMPLE_RATE);
+    a = 1.0f - b - c;
+}
+
+KanaSynth::KanaSynth() {
+    queue_head.store(0);
+    queue_tail.store(0);
+    reset_seq.store(0);
+    reset_to.store(0);
+    finished.store(true);
+    utf8_len = 0;
+    has_last = false;
+    memset(&last, 0, sizeof(last));
+    reset_us = 0;
+
+    seen_reset = 0;
+    active = false;
+    memset(&mora, 0, sizeof(mora));
+    mora_pos = 0;
+    mora_len = 0;
+    phrase_index = 0;
+    first_audio = false;
+
+    f0 = f0_target = KANA_PITCH_HZ;
+    glottal_phase = 0;
+    glottal_prev = 0;
+    voice_amp = voice_step = 0;
+    noise_amp = noise_step = 0;
+    asp_amp = asp_step = 0;
+    for (int i = 0; i < 3; i++) {
+        formant[i] = formant_target[i] = VOWEL_FORMANTS[V_A][i];
+    }
+    noise_seed = 0x12345678;
+    control_left = 0;
+
+    memset(&f1, 0, sizeof(f1));
+    memset(&f2, 0, sizeof(f2));
+    memset(&f3, 0, sizeof(f3));
+    memset(&fric, 0, sizeof(fric));
+    f1.set(formant[0], FORMANT_BW[0]);
+    f2.set(formant[1], FORMANT_BW[1]);
+    f3.set(formant[2], FORMANT_BW[2]);
+    fric.set(4000, 2000);
+
+    memset(&stats, 0, sizeof(stats));
+}
+
+// ===== テキスト → モーラ (feed 側) =====
+
+void KanaSynth::reset() {
+    // キューを捨てるのは再生タスク (fill) 側。ここでは捨てる位置だけ伝える
+    reset_to.store(queue_head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    reset_seq.fetch_add(1, std::memory_order_release);
+    finished.store(false);
+    utf8_len = 0;
+    has_last = false;
+    reset_us = micros();
+    stats.first_audio_us = 0;
+}
+
+void KanaSynth::push(const KanaMora& m) {
+    uint32_t head = queue_head.load(std::memory_order_relaxed);
+    if (head - queue_tail.load(std::memory_order_acquire) >= KANA_QUEUE_SIZE) {
+        stats.dropped++;
+        return;
+    }
+    queue[head & (KANA_QUEUE_SIZE - 1)] = m;
+    queue_head.store(head + 1, std::memory_order_release);
+}
+
+void KanaSynth::flushLast() {
+    if (has_last) {
+        push(last);
+        has_last = false;
+    }
+}
+
+void KanaSynth::addPause(uint16_t ms, bool question) {
+    if (has_last && last.consonant == C_PAUSE) {
+        // 「！？」のような連続は1つの間にまとめる
+        if (ms / 10 > last.length) {
+            last.length = ms / 10;
+        }
+        return;
+    }
+    if (has_last) {
+        last.flags |= MORA_PHRASE_END;
+        if (question) {
+            last.flags |= MORA_QUESTION;
+        }
+    }
+    flushLast();
+    last.consonant = C_PAUSE;
+    last.vowel = V_A;
+    last.flags = 0;
+    last.length = ms / 10;
+    has_last = true;
+}
+
+void KanaSynth::addCodepoint(uint32_t cp) {
+    // カタカナ → ひらがな
+    if (cp >= 0x30A1 && cp <= 0x30F6) {
+        cp -= 0x60;
+    }
+
+    KanaMora m;
+    m.flags = 0;
+    m.length = KANA_MORA_MS / 10;
+
+    if (cp >= 0x3041 && cp <= 0x3096) {
+        uint8_t code = KANA_TABLE[cp - 0x3041];
+        if (code == KM_SMALL) {
+            // 小書きかなは前のモーラの母音を書き換える (きゃ, ファ, ウィ)
+            uint8_t vowel;
+            bool palatal = false;
+            switch (cp) {
+                case 0x3041: vowel = V_A; break;
+                case 0x3043: vowel = V_I; break;
+                case 0x3045: vowel = V_U; break;
+                case 0x3047: vowel = V_E; break;
+                case 0x3049: vowel = V_O; break;
+                case 0x3083: vowel = V_A; palatal = true; break;
+                case 0x3085: vowel = V_U; palatal = true; break;
+                case 0x3087: vowel = V_O; palatal = true; break;
+                default:     vowel = V_A; break;     // ゎ
+            }
+            if (has_last && last.consonant != C_PAUSE && last.consonant != C_Q && last.consonant != C_NN) {
+                if (palatal && last.vowel == V_I &&
+                    last.consonant != C_SH && last.consonant != C_J && last.consonant != C_CH) {
+                    last.flags |= MORA_PALATAL;
+                }
+                if (last.consonant == C_NONE && last.vowel == V_U) {
+                    last.consonant = C_W;
+                }
+                last.vowel = vowel;
+                return;
+            }
+            m.consonant = palatal ? C_Y : C_NONE;
+            m.vowel = vowel;
+        } else {
+            m.consonant = code >> 3;
+            m.vowel = code & 7;
+            if (m.consonant == C_Q) {
+                m.length = KANA_MORA_MS * 6 / 100;
+            }
+        }
+    } else if (cp == 0x30FC || cp == 0x301C || cp == 0xFF5E) {
+        // ー 〜 ～ : 前の母音を伸ばす
+        if (has_last && last.consonant != C_PAUSE) {
+            uint16_t len = last.length + KANA_MORA_MS / 10;
+            last.length = len > 255 ? 255 : len;
+        }
+        return;
+    } else if (cp == 0x3001 || cp == 0xFF0C || cp == ',') {
+        addPause(KANA_SHORT_PAUSE_MS, false);
+        return;
+    } else if (cp == 0x3002 || cp == 0xFF0E || cp == '.' || cp == 0xFF01 || cp == '!' ||
+               cp == 0x2026 || cp == 0x2025 || cp == '\n') {
+        addPause(KANA_LONG_PAUSE_MS, false);
+        return;
+    } else if (cp == 0xFF1F || cp == '?') {
+        addPause(KANA_LONG_PAUSE_MS, true);
+        return;
+    } else if (cp == ' ' || cp == 0x3000) {
+        addPause(KANA_SHORT_PAUSE_MS / 2, false);
+        return;
+    } else if ((cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0x3400 && cp <= 0x4DBF) ||
+               (cp >= 'A' && cp <= 'Z') || (cp >= 'a' && cp <= 'z') || (cp >= '0' && cp <= '9')) {
+        // 読めない文字は「むにゃむにゃ」(文字ごとに決まった音)
+        static const uint8_t BABBLE[] = { C_K, C_T, C_N, C_M, C_R, C_S, C_P, C_NONE };
+        uint32_t h = cp * 2654435761u;
+        m.consonant = BABBLE[(h >> 24) & 7];
+        m.vowel = (h >> 16) % 5;
+    } else {
+        // 記号・絵文字は読まない
+        return;
+    }
+
+    flushLast();
+    last = m;
+    has_last = true;
+}
+
+void KanaSynth::feed(const char* text) {
+    for (const uint8_t* p = (const uint8_t*)text; *p; p++) {
+        uint8_t c = *p;
+        if (utf8_len == 0) {
+            if (c < 0x80) {
+                addCodepoint(c);
+                continue;
+            }
+            if ((c & 0xC0) == 0x80) {
+                continue;   // 途中のバイトから始まった
+            }
+        } else if ((c & 0xC0) != 0x80) {
+            utf8_len = 0;   // 壊れた文字は捨てる
+            p--;
+            continue;
+        }
+
+        utf8_pending[utf8_len++] = c;
+        uint8_t lead = utf8_pending[0];
+        uint8_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+        if (utf8_len < need) {
+            continue;
+        }
+
+        uint32_t cp = lead & (0x7F >> need);
+        for (uint8_t i = 1; i < need; i++) {
+            cp = (cp << 6) | (utf8_pending[i] & 0x3F);
+        }
+        utf8_len = 0;
+        addCodepoint(cp);
+    }
+}
+
+void KanaSynth::finish() {
+    // 最後に短い間を入れて、共振器の響きを自然に消す
+    addPause(KANA_SHORT_PAUSE_MS / 2, false);
+    flushLast();
+    finished.store(true, std::memory_order_release);
+}
+
+bool KanaSynth::isSpeaking() {
+    return active || queue_head.load() != queue_tail.load() || has_last || !finished.load();
+}
+
+// ===== 合成 (再生タスク側) =====
+
+bool KanaSynth::nextMora() {
+    uint32_t tail = queue_tail.load(std::memory_order_relaxed);
+    if (tail == queue_head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    mora = queue[tail & (KANA_QUEUE_SIZE - 1)];
+    queue_tail.store(tail + 1, std::memory_order_release);
+
+    mora_pos = 0;
+    mora_len = (uint32_t)mora.length * (AUDIO_SAMPLE_RATE / 100);
+    active = true;
+    control_left = 0;
+    stats.morae++;
+
+    if (mora.consonant == C_PAUSE) {
+        phrase_index = 0;
+    } else {
+        phrase_index++;
+    }
+    return true;
+}
+
+// 子音の長さ (この後が母音)
+static uint32_t consonantSamples(uint8_t c) {
+    switch (c) {
+        case C_K: case C_T: case C_P:   return MS_TO_SAMPLES(42);
+        case C_G: case C_D: case C_B:   return MS_TO_SAMPLES(28);
+        case C_S: case C_SH:            return MS_TO_SAMPLES(70);
+        case C_Z: case C_J:             return MS_TO_SAMPLES(55);
+        case C_CH: case C_TS:           return MS_TO_SAMPLES(70);
+        case C_H: case C_F:             return MS_TO_SAMPLES(45);
+        case C_N: case C_M:             return MS_TO_SAMPLES(45);
+        case C_R:                       return MS_TO_SAMPLES(18);
+        default:                        return 0;
+    }
+}
+
+void KanaSynth::control() {
+    float voice = 0, noise = 0, asp = 0;
+    const float* target = formant_target;
+    float fric_freq = 0, fric_bw = 0;
+
+    if (active && mora.consonant != C_PAUSE && mora.consonant != C_Q) {
+        uint8_t c = mora.consonant;
+        const float* vowel = VOWEL_FORMANTS[mora.vowel];
+        uint32_t cons = consonantSamples(c);
+        uint32_t t = mora_pos;
+
+        if (c == C_NN) {
+            voice = 0.55f;
+            target = NASAL_N;
+        } else if (t < cons) {
+            switch (c) {
+                case C_K: case C_T: case C_P:
+                    // 閉鎖 → 破裂
+                    if (t >= MS_TO_SAMPLES(30)) {
+                        noise = 0.7f;
+                        fric_freq = c == C_K ? 2200 : c == C_T ? 4000 : 900;
+                        fric_bw = 1500;
+                    }
+                    break;
+                case C_G: case C_D: case C_B:
+                    voice = 0.12f;
+                    target = NASAL_M;
+                    if (t >= MS_TO_SAMPLES(20)) {
+                        noise = 0.4f;
+                        fric_freq = c == C_G ? 2200 : c == C_D ? 4000 : 900;
+                        fric_bw = 1500;
+                    }
+                    break;
+                case C_S: case C_Z:
+                    noise = 0.45f;
+                    fric_freq = 5500;
+                    fric_bw = 2000;
+                    voice = c == C_Z ? 0.25f : 0;
+                    break;
+                case C_SH: case C_J:
+                    noise = 0.5f;
+                    fric_freq = 3200;
+                    fric_bw = 1500;
+                    voice = c == C_J ? 0.25f : 0;
+                    break;
+                case C_CH: case C_TS:
+                    if (t >= MS_TO_SAMPLES(25)) {
+                        noise = 0.5f;
+                        fric_freq = c == C_CH ? 3200 : 5500;
+                        fric_bw = c == C_CH ? 1500 : 2000;
+                    }
+                    break;
+                case C_H:
+                    // 後ろの母音のささやき
+                    asp = 0.6f;
+                    target = vowel;
+                    break;
+                case C_F:
+                    asp = 0.3f;
+                    noise = 0.3f;
+                    fric_freq = 1400;
+                    fric_bw = 2500;
+                    target = vowel;
+                    break;
+                case C_N:
+                    voice = 0.5f;
+                    target = NASAL_N;
+                    break;
+                case C_M:
+                    voice = 0.5f;
+                    target = NASAL_M;
+                    break;
+                case C_R:
+                    voice = 0.6f;
+                    target = FLAP_R;
+                    break;
+            }
+        } else {
+            voice = 1.0f;
+            target = vowel;
+            // や・わ・きゃ は母音の頭を「い」「う」から滑らせる
+            if (t - cons < GLIDE_SAMPLES) {
+                if (c == C_Y || (mora.flags & MORA_PALATAL)) {
+                    target = GLIDE_Y;
+                } else if (c == C_W) {
+                    target = GLIDE_W;
+                }
+            }
+            // フレーズの終わりは少し弱める
+            if ((mora.flags & MORA_PHRASE_END) && t > mora_len / 2) {
+                voice = 1.0f - 0.6f * (float)(t - mora_len / 2) / (mora_len / 2);
+            }
+        }
+
+        // 抑揚: 1モーラ目は低く、2モーラ目で上がってなだらかに下がる (東京式のおおまかな形)
+        float contour;
+        if (phrase_index <= 1) {
+            contour = 0.9f;
+        } else {
+            contour = 1.08f - 0.015f * (phrase_index - 2);
+            if (contour < 0.85f) contour = 0.85f;
+        }
+        if (mora.flags & MORA_QUESTION) {
+            contour = 1.0f + 0.5f * t / mora_len;
+        }
+        f0_target = KANA_PITCH_HZ * contour;
+    }
+
+    // 振幅は次の制御点まで直線で変える (プチノイズ防止)
+    voice_step = (voice - voice_amp) / KANA_CONTROL_SAMPLES;
+    noise_step = (noise - noise_amp) / KANA_CONTROL_SAMPLES;
+    asp_step = (asp - asp_amp) / KANA_CONTROL_SAMPLES;
+
+    if (fric_freq > 0) {
+        fric.set(fric_freq, fric_bw);
+    }
+
+    // フォルマントと高さは滑らかに追いかける
+    for (int i = 0; i < 3; i++) {
+        formant_target[i] = target[i];
+        formant[i] += (formant_target[i] - formant[i]) * 0.25f;
+    }
+    f1.set(formant[0], FORMANT_BW[0]);
+    f2.set(formant[1], FORMANT_BW[1]);
+    f3.set(formant[2], FORMANT_BW[2]);
+    f0 += (f0_target - f0) * 0.15f;
+}
+
+size_t KanaSynth::render(int16_t* out, size_t count) {
+    size_t i = 0;
+    while (i < count) {
+        bool starved = false;
+        if (!active && !nextMora()) {
+            // finish() の後でキューが空なら終わり
+            if (finished.load(std::memory_order_acquire) && !nextMora()) {
+                return i;
+            }
+            starved = !active;
+        }
+
+        if (control_left == 0) {
+            control();
+            control_left = KANA_CONTROL_SAMPLES;
+        }
+        control_left--;
+
+        voice_amp += voice_step;
+        noise_amp += noise_step;
+        asp_amp += asp_step;
+
+        // 声帯パルス (開いている間は sin^2、その微分を音源にする)
+        glottal_phase += f0 / AUDIO_SAMPLE_RATE;
+        if (glottal_phase >= 1.0f) {
+            glottal_phase -= 1.0f;
+        }
+        float g = 0;
+        if (glottal_phase < GLOTTAL_OPEN) {
+            float s = sinf((float)M_PI * glottal_phase / GLOTTAL_OPEN);
+            g = s * s;
+        }
+        float dg = g - glottal_prev;
+        glottal_prev = g;
+
+        noise_seed ^= noise_seed << 13;
+        noise_seed ^= noise_seed >> 17;
+        noise_seed ^= noise_seed << 5;
+        float n = (int32_t)noise_seed * (1.0f / 2147483648.0f);
+
+        float src = dg * voice_amp * VOICE_GAIN + n * asp_amp * ASPIRATION_GAIN;
+        float y = f3.process(f2.process(f1.process(src)));
+        y += fric.process(n) * noise_amp * NOISE_GAIN;
+
+        if (y > 32767.0f) y = 32767.0f;
+        if (y < -32768.0f) y = -32768.0f;
+        out[i++] = (int16_t)y;
+
+        if (starved) {
+            stats.starved_samples++;
+        } else {
+            stats.samples++;
+            if (first_audio && voice_amp + noise_amp + asp_amp > 0.01f) {
+                stats.first_audio_us = micros() - reset_us;
+                first_audio = false;
+            }
+        }
+
+        if (active && ++mora_pos >= mora_len) {
+            active = false;
+        }
+    }
+    return i;
+}
+
+size_t KanaSynth::fill(void* ctx, int16_t* scratch, size_t max_samples, const int16_t** out) {
+    KanaSynth* s = (KanaSynth*)ctx;
+
+    // reset() されていたら、その時点までのモーラを捨てる
+    uint32_t seq = s->reset_seq.load(std::memory_order_acquire);
+    if (seq != s->seen_reset) {
+        s->seen_reset = seq;
+        // 捨てる位置へは進めるだけ (戻すと読み終えたモーラや空きスロットを読み直す)
+        uint32_t to = s->reset_to.load(std::memory_order_relaxed);
+        uint32_t tail = s->queue_tail.load(std::memory_order_relaxed);
+        if ((int32_t)(to - tail) > 0) {
+            s->queue_tail.store(to, std::memory_order_release);
+        }
+        s->active = false;
+        s->phrase_index = 0;
+        s->first_audio = true;
+    }
+
+    uint32_t start = micros();
+    size_t n = s->render(scratch, max_samples);
+    s->stats.synth_us += micros() - start;
+
+    *out = scratch;
+    return n;
+}
+
+void KanaSynth::printStats() {
+    float audio_s = stats.samples / (float)AUDIO_SAMPLE_RATE;
+    Serial.printf("音声合成: %luモーラ, %.2f秒ぶん, 合成 %lums (実時間比 %.3f)\n",
+                  (unsigned long)stats.morae, audio_s, (unsigned long)(stats.synth_us / 1000),
+                  audio_s > 0 ? stats.synth_us / (audio_s * 1000000.0f) : 0.0f);
+    Serial.printf("  最初の音まで: %luus, テキスト待ち: %lums, 捨てたモーラ: %lu\n",
+                  (unsigned long)stats.first_audio_us,
+                  (unsigned long)(stats.starved_samples * 1000 / AUDIO_SAMPLE_RATE),
+                  (unsigned long)stats.dropped);
+}
+
+void KanaSynth::benchmark(const char* text) {
+    KanaSynth* s = new KanaSynth();
+    s->reset();
+    s->feed(text);
+    s->finish();
+
+    int16_t block[AUDIO_BLOCK_SAMPLES];
+    int32_t peak = 0;
+    while (true) {
+        const int16_t* out = block;
+        size_t n = fill(s, block, AUDIO_BLOCK_SAMPLES, &out);
+        if (n == 0) {
+            break;
+        }
+        for (size_t i = 0; i < n; i++) {
+            int32_t v = abs(out[i]);
+            if (v > peak) peak = v;
+        }
+    }
+
+    s->printStats();
+    Serial.printf("  ピーク: %ld\n", (long)peak);
+    delete s;
+}
@@ -0,0 +1,13 @@
+#include "lip_sync.h"
+#include "audio_output.h"
+
+int32_t audio_talk_level(void *ctx) {
+    AudioOutput* out = (AudioOutput*)ctx;
+    uint32_t now = micros();
+    uint16_t rms = out->getEnvelope(now + LIPSYNC_LEAD_MS * 1000);
+    // 再生が終わっても、DMAに積んだ分が鳴り終わるまでは「音あり」(口を閉じていく)
+    if (rms == 0 && !out->isPlaying() && out->getOutputDelayUs() == 0) {
+        return TALK_LEVEL_SILENT;
+    }
+    return lipsync_level(rms);
+}
@@ -2,10 +2,24 @@
 
 LLMHandler::LLMHandler() {
     llm_type = LLM_NONE;
-    history_count = 0;
+    if (!history.init()) {
+        Serial.println("会話履歴: メモリ割り当て失敗");
+    }
+    if (!prompt_builder.init(PROMPT_BUFFER_SIZE) ||
+        !body_builder.init(REQUEST_BUFFER_SIZE)) {
+        Serial.println("プロンプトバッファ: メモリ割り当て失敗");
+    }
     system_prompt = LLMConfig::KIRBY_SYSTEM_PROMPT;
+    persona_hash = ResponseCache::hashString(system_prompt.c_str());
     tiny_llm = nullptr;
     simple_responder = nullptr;
+    response_cache = nullptr;
+    request_failed = false;
+    token_fn = nullptr;
+    token_ctx = nullptr;
+    route_count = 0;
+    latency_budget_ms = DEFAULT_LATENCY_BUDGET;
+    request_timeout_ms = 0;
 }
 
 LLMHandler::~LLMHandler() {
@@ -18,6 +32,9 @@ LLMHandler::~LLMHandler() {
     if (simple_responder) {
         delete simple_responder;
     }
+    if (response_cache) {
+        delete response_cache;
+    }
 }
 
 bool LLMHandler::connectWiFi(const char* ssid, const char* password) {
@@ -67,16 +84,17 @@ void LLMHandler::setModelName(const String& model) {
 
 void LLMHandler::setSystemPrompt(const String& prompt) {
     system_prompt = prompt;
+    persona_hash = ResponseCache::hashString(system_prompt.c_str());
 }
 
 void LLMHandler::setupKirbyPersonality() {
-    system_prompt = LLMConfig::KIRBY_SYSTEM_PROMPT;
+    setSystemPrompt(LLMConfig::KIRBY_SYSTEM_PROMPT);
 }
 
 void LLMHandler::setupCuteAssistant() {
-    system_prompt = 
+    setSystemPrompt(
         "あなたはとってもかわいいAIアシスタントです。"
-        "短く、楽しく、親しみやすい口調で答えてください。";
+        "短く、楽しく、親しみやすい口調で答えてください。");
 }
 
 bool LLMHandler::initTinyLLM() {
@@ -112,6 +130,24 @@ bool LLMHandler::initSimpleResponder() {
     return true;
 }
 
+bool LLMHandler::initResponseCache(int entries, uint32_t ttl_ms, bool flash_tier) {
+    Serial.println("応答キャッシュ初期化中...");
+    
+    if (response_cache) {
+        delete response_cache;
+    }
+    
+    response_cache = new ResponseCache();
+    if (!response_cache->init(entries, ttl_ms, flash_tier)) {
+        delete response_cache;
+        response_cache = nullptr;
+        return false;
+    }
+    
+    Serial.println("応答キャッシュ初期化完了!");
+    return true;
+}
+
 bool LLMHandler::loadTinyModel(const char* path) {
     if (!tiny_llm) {
         Serial.println("TinyLLMが初期化されていません");
@@ -121,15 +157,23 @@ bool LLMHandler::loadTinyModel(const char* path) {
     return tiny_llm->loadModelFromSD(path);
 }
 
+bool LLMHandler::enableIntentSearch(const char* vectors_path) {
+    if (!tiny_llm || !tiny_llm->isModelLoaded() || !simple_responder) {
+        Serial.println("埋め込みモードにはTinyLLMのモデルとSimpleResponderが必要です");
+        return false;
+    }
+    
+    return simple_responder->enableEmbedding(tiny_llm, vectors_path);
+}
+
 String LLMHandler::chat(const String& user_message) {
     if (llm_type == LLM_NONE) {
         return "LLMが設定されていません";
     }
+    TRACE_SCOPE("chat");
     
-    // ローカルモード以外はWiFi必要
-    if (!isConnected() && 
-        llm_type != LLM_TINY_LOCAL && 
-        llm_type != LLM_RULE_BASED) {
+    // ローカルモード以外はWiFi必要 (ルーターは自前で判断する)
+    if (!isConnected() && routeNeedsWiFi(llm_type)) {
         return "WiFiに接続されていません";
     }
     
@@ -139,85 +183,395 @@ String LLMHandler::chat(const String& user_message) {
     uint32_t start_time = millis();
     String response;
     
-    switch (llm_type) {
+    // ルールベースは検索より速いのでキャッシュしない
+    bool cacheable = response_cache && llm_type != LLM_RULE_BASED;
+    
+    // キャッシュ確認
+    uint32_t origin_latency = 0;
+    if (cacheable &&
+        response_cache->lookup(user_message, persona_hash, response, &origin_latency)) {
+        uint32_t elapsed = millis() - start_time;
+        response_cache->recordSaving(origin_latency, elapsed);
+        addToHistory(user_message, response);
+        
+        Serial.print("アシスタント(キャッシュ): ");
+        Serial.println(response);
+        Serial.printf("応答時間: %dms (元: %dms)\n", elapsed, origin_latency);
+        response_cache->printStats();
+        return response;
+    }
+    
+    request_failed = false;
+    
+    if (llm_type == LLM_AUTO_ROUTE) {
+        response = processRouted(user_message);
+    } else {
+        response = dispatch(llm_type, user_message);
+    }
+    
+    uint32_t elapsed = millis() - start_time;
+    
+    if (response.length() > 0) {
+        addToHistory(user_message, response);
+        
+        if (cacheable && !request_failed) {
+            response_cache->store(user_message, persona_hash, response, elapsed);
+        }
+    }
+    
+    Serial.print("アシスタント: ");
+    Serial.println(response);
+    Serial.printf("応答時間: %dms\n", elapsed);
+    if (cacheable) {
+        response_cache->printStats();
+    }
+    
+    return response;
+}
+
+String LLMHandler::dispatch(LLMType type, const String& message) {
+    switch (type) {
         case LLM_CLOUD_OPENAI:
         case LLM_CLOUD_CLAUDE:
         case LLM_CLOUD_GEMINI:
-            response = sendCloudRequest(user_message);
-            break;
+            return sendCloudRequest(message);
             
         case LLM_LOCAL_SERVER:
-            response = sendLocalRequest(user_message);
-            break;
+            return sendLocalRequest(message);
             
         case LLM_TINY_LOCAL:
-            response = processTinyLocal(user_message);
-            break;
+            return processTinyLocal(message);
             
         case LLM_RULE_BASED:
-            response = processRuleBased(user_message);
-            break;
+            return processRuleBased(message);
             
         default:
-            response = "未対応のLLMタイプです";
-            break;
+            request_failed = true;
+            return "未対応のLLMタイプです";
+    }
+}
+
+bool LLMHandler::routeNeedsWiFi(LLMType type) {
+    return type != LLM_TINY_LOCAL &&
+           type != LLM_RULE_BASED &&
+           type != LLM_AUTO_ROUTE;
+}
+
+bool LLMHandler::addRoute(LLMType type, const String& endpoint,
+                          const String& key, const String& model,
+                          uint32_t deadline_ms) {
+    if (route_count >= MAX_LLM_ROUTES || type == LLM_NONE || type == LLM_AUTO_ROUTE) {
+        return false;
     }
     
-    uint32_t elapsed = millis() - start_time;
+    LLMRoute& route = routes[route_count++];
+    route.type = type;
+    route.endpoint = endpoint;
+    route.api_key = key;
+    route.model = model;
+    route.deadline_ms = deadline_ms;
+    route.avg_latency_ms = 0;
+    route.failures = 0;
+    route.skip_until = 0;
+    route.successes = 0;
+    return true;
+}
+
+void LLMHandler::clearRoutes() {
+    route_count = 0;
+}
+
+void LLMHandler::setLatencyBudget(uint32_t budget_ms) {
+    latency_budget_ms = budget_ms;
+}
+
+void LLMHandler::updateRouteStats(LLMRoute& route, uint32_t elapsed, bool failed) {
+    // 移動平均 (α = 1/4)
+    if (route.avg_latency_ms == 0) {
+        route.avg_latency_ms = elapsed;
+    } else {
+        route.avg_latency_ms = (route.avg_latency_ms * 3 + elapsed) / 4;
+    }
     
-    if (response.length() > 0) {
-        addToHistory(user_message, response);
+    if (failed) {
+        // 連続失敗するほど長く休ませる (最大16倍)
+        if (route.failures < 4) route.failures++;
+        route.skip_until = millis() + (ROUTE_BACKOFF_MS << (route.failures - 1));
+    } else {
+        route.failures = 0;
+        route.skip_until = 0;
+        route.successes++;
+    }
+}
+
+String LLMHandler::processRouted(const String& message) {
+    if (route_count == 0) {
+        return processRuleBased(message);
     }
     
-    Serial.print("アシスタント: ");
-    Serial.println(response);
-    Serial.printf("応答時間: %dms\n", elapsed);
+    uint32_t start_time = millis();
+    
+    // ヘッジ: ルールベースの答えを先に用意しておき (数十µs)、
+    // 予算内に他のバックエンドが答えられなければこれを返す
+    String hedge = processRuleBased(message);
+    
+    // 現在の設定を退避 (各ルートで一時的に書き換える)
+    LLMType saved_type = llm_type;
+    String saved_endpoint = api_endpoint;
+    String saved_key = api_key;
+    String saved_model = model_name;
+    
+    String response;
+    bool answered = false;
+    
+    for (int i = 0; i < route_count && !answered; i++) {
+        LLMRoute& route = routes[i];
+        uint32_t now = millis();
+        uint32_t spent = now - start_time;
+        
+        if (spent + MIN_ROUTE_ATTEMPT_MS > latency_budget_ms) {
+            Serial.println("ルーター: 予算切れ");
+            break;
+        }
+        uint32_t remaining = latency_budget_ms - spent;
+        
+        if (route.type == LLM_RULE_BASED) {
+            response = hedge;
+            answered = true;
+            break;
+        }
+        
+        if (routeNeedsWiFi(route.type) && !isConnected()) {
+            continue;
+        }
+        
+        if (route.skip_until != 0 && (int32_t)(now - route.skip_until) < 0) {
+            continue;
+        }
+        
+        // 最近遅いバックエンドは予算を超えそうならスキップ
+        if (route.avg_latency_ms > remaining) {
+            Serial.printf("ルーター: #%d をスキップ (平均 %dms > 残り %dms)\n",
+                          i, route.avg_latency_ms, remaining);
+            // 少しずつ平均を戻して、回復したら再び試せるようにする
+            route.avg_latency_ms = (route.avg_latency_ms * 7) / 8;
+            continue;
+        }
+        
+        llm_type = route.type;
+        if (route.endpoint.length() > 0) api_endpoint = route.endpoint;
+        if (route.api_key.length() > 0) api_key = route.api_key;
+        if (route.model.length() > 0) model_name = route.model;
+        request_timeout_ms = min(route.deadline_ms, remaining);
+        
+        uint32_t attempt_start = millis();
+        request_failed = false;
+        String attempt = dispatch(route.type, message);
+        uint32_t attempt_elapsed = millis() - attempt_start;
+        
+        bool failed = request_failed || attempt.length() == 0;
+        updateRouteStats(route, attempt_elapsed, failed);
+        
+        if (!failed) {
+            response = attempt;
+            answered = true;
+            Serial.printf("ルーター: #%d が応答 (%dms)\n", i, attempt_elapsed);
+        } else {
+            Serial.printf("ルーター: #%d 失敗 (%dms)\n", i, attempt_elapsed);
+        }
+    }
+    
+    llm_type = saved_type;
+    api_endpoint = saved_endpoint;
+    api_key = saved_key;
+    model_name = saved_model;
+    request_timeout_ms = 0;
+    
+    if (!answered) {
+        response = hedge;
+    }
+    // ヘッジの答えは状況に依存しないのでキャッシュ対象外
+    request_failed = !answered || response == hedge;
     
     return response;
 }
 
-void LLMHandler::clearHistory() {
-    history_count = 0;
-    for (int i = 0; i < MAX_HISTORY * 2; i++) {
-        conversation_history[i] = "";
+void LLMHandler::printRouteStats() {
+    Serial.printf("ルーター: 予算 %dms\n", latency_budget_ms);
+    for (int i = 0; i < route_count; i++) {
+        const LLMRoute& route = routes[i];
+        Serial.printf("  #%d type=%d 期限=%dms 平均=%dms 成功=%d 連続失敗=%d\n",
+                      i, route.type, route.deadline_ms, route.avg_latency_ms,
+                      route.successes, route.failures);
     }
 }
 
+void LLMHandler::abort() {
+    if (tiny_llm) {
+        tiny_llm->abort();
+    }
+}
+
+void LLMHandler::clearAbort() {
+    if (tiny_llm) {
+        tiny_llm->clearAbort();
+    }
+}
+
+void LLMHandler::clearHistory() {
+    history.clear();
+}
+
 void LLMHandler::addToHistory(const String& user_msg, const String& assistant_msg) {
-    if (history_count >= MAX_HISTORY) {
-        // 古い履歴を削除
-        for (int i = 0; i < (MAX_HISTORY - 1) * 2; i++) {
-            conversation_history[i] = conversation_history[i + 2];
-        }
-        history_count = MAX_HISTORY - 1;
+    // 予算を超えた古いターンはここで要約に回される
+    history.add(user_msg.c_str(), assistant_msg.c_str());
+}
+
+int LLMHandler::historyStart(const String& current_message) {
+    // 今回のメッセージぶんを差し引いた予算に収まるターンだけ送る
+    uint16_t current = ConversationHistory::estimateTokens(current_message.c_str());
+    uint16_t budget = history.getBudget();
+    budget = (current < budget) ? budget - current : 0;
+    return history.firstTurnWithin(budget);
+}
+
+const char* LLMHandler::buildPrompt(const String& current_message) {
+    prompt_builder.clear();
+    prompt_builder.append(system_prompt).append("\n\n");
+    
+    // 追い出した古い会話の要約
+    if (history.hasSummary()) {
+        prompt_builder.append("以前の話題: ").append(history.getSummary()).append('\n');
     }
     
-    int idx = history_count * 2;
-    conversation_history[idx] = user_msg;
-    conversation_history[idx + 1] = assistant_msg;
-    history_count++;
+    // 会話履歴を追加
+    for (int i = historyStart(current_message); i < history.size(); i++) {
+        prompt_builder.append("User: ").append(history.user(i));
+        prompt_builder.append("\nAssistant: ").append(history.assistant(i)).append('\n');
+    }
+    
+    prompt_builder.append("User: ").append(current_message).append("\nAssistant: ");
+    return prompt_builder.c_str();
 }
 
-String LLMHandler::buildPrompt(const String& current_message) {
-    String prompt = system_prompt + "\n\n";
+bool LLMHandler::buildCloudBody(const String& message) {
+    TextBuilder& b = body_builder;
+    b.clear();
+    
+    int first = historyStart(message);
+    
+    if (llm_type == LLM_CLOUD_GEMINI) {
+        // Gemini: contents[{role, parts[{text}]}]
+        b.append("{\"contents\":[");
+        for (int i = first; i < history.size(); i++) {
+            b.append("{\"role\":\"user\",\"parts\":[{\"text\":");
+            b.appendJsonString(history.user(i));
+            b.append("}]},{\"role\":\"model\",\"parts\":[{\"text\":");
+            b.appendJsonString(history.assistant(i));
+            b.append("}]},");
+        }
+        b.append("{\"role\":\"user\",\"parts\":[{\"text\":");
+        b.appendJsonString(message.c_str());
+        b.append("}]}],\"systemInstruction\":{\"parts\":[{\"text\":\"");
+        b.appendJsonEscaped(system_prompt.c_str());
+        if (history.hasSummary()) {
+            b.append("\\n以前の話題: ").appendJsonEscaped(history.getSummary());
+        }
+        b.append("\"}]},\"generationConfig\":{\"maxOutputTokens\":150,\"temperature\":0.8}}");
+        return !b.overflowed();
+    }
     
-    // 会話履歴を追加
-    for (int i = 0; i < history_count; i++) {
-        int idx = i * 2;
-        prompt += "User: " + conversation_history[idx] + "\n";
-        prompt += "Assistant: " + conversation_history[idx + 1] + "\n";
+    b.append("{\"model\":").appendJsonString(model_name.c_str());
+    
+    // システムプロンプト (Claudeはトップレベル、OpenAIはmessagesの先頭)
+    if (llm_type == LLM_CLOUD_CLAUDE) {
+        b.append(",\"system\":\"");
+    } else {
+        b.append(",\"messages\":[{\"role\":\"system\",\"content\":\"");
+    }
+    b.appendJsonEscaped(system_prompt.c_str());
+    if (history.hasSummary()) {
+        b.append("\\n以前の話題: ").appendJsonEscaped(history.getSummary());
+    }
+    if (llm_type == LLM_CLOUD_CLAUDE) {
+        b.append("\",\"messages\":[");
+    } else {
+        b.append("\"},");
+    }
+    
+    // 履歴追加 (トークン予算内のターンのみ)
+    for (int i = first; i < history.size(); i++) {
+        b.append("{\"role\":\"user\",\"content\":").appendJsonString(history.user(i));
+        b.append("},{\"role\":\"assistant\",\"content\":").appendJsonString(history.assistant(i));
+        b.append("},");
     }
     
-    prompt += "User: " + current_message + "\nAssistant: ";
-    return prompt;
+    b.append("{\"role\":\"user\",\"content\":").appendJsonString(message.c_str());
+    b.append("}],\"max_tokens\":150,\"temperature\":0.8}");
+    
+    return !b.overflowed();
+}
+
+// HTTP接続の準備
+// トレース時は名前解決とTCP+TLS接続を先に済ませて別々に計測し、
+// 接続済みのクライアントをHTTPClientに渡す (HTTPClientは接続済みならそのまま使う)。
+// 証明書を指定しないので、HTTPClientがURLから作る場合と同じく検証はしない。
+bool LLMHandler::beginHttp() {
+    #if ENABLE_TRACE
+    int scheme_end = api_endpoint.indexOf("://");
+    if (scheme_end > 0) {
+        bool https = api_endpoint.startsWith("https");
+        int host_start = scheme_end + 3;
+        int path_start = api_endpoint.indexOf('/', host_start);
+        String authority = api_endpoint.substring(host_start, path_start < 0 ? api_endpoint.length() : path_start);
+        int colon = authority.indexOf(':');
+        String host = colon < 0 ? authority : authority.substring(0, colon);
+        uint16_t port = colon < 0 ? (https ? 443 : 80) : authority.substring(colon + 1).toInt();
+        
+        IPAddress ip;
+        TRACE_BEGIN(dns, "http_dns");
+        bool resolved = WiFi.hostByName(host.c_str(), ip) == 1;
+        TRACE_END(dns);
+        
+        if (resolved) {
+            // SNIのためホスト名で接続 (名前解決はキャッシュから)
+            // (3引数の connect は仮想関数ではないので、それぞれの型で呼ぶ)
+            int32_t timeout = request_timeout_ms ? request_timeout_ms : 15000;
+            bool connected;
+            TRACE_BEGIN(connect, https ? "http_tls_connect" : "http_tcp_connect");
+            if (https) {
+                tls_client.setInsecure();
+                connected = tls_client.connect(host.c_str(), port, timeout);
+            } else {
+                connected = wifi_client.connect(host.c_str(), port, timeout);
+            }
+            TRACE_END(connect);
+            if (connected) {
+                return https ? http_client.begin(tls_client, api_endpoint)
+                             : http_client.begin(wifi_client, api_endpoint);
+            }
+        }
+    }
+    #endif
+    return http_client.begin(api_endpoint);
 }
 
 String LLMHandler::sendCloudRequest(const String& message) {
-    if (!http_client.begin(api_endpoint)) {
+    // リクエストボディ作成 (事前確保したバッファに直接JSONを書き込む)
+    if (!buildCloudBody(message)) {
+        request_failed = true;
+        return "リクエストが大きすぎます";
+    }
+    
+    if (!beginHttp()) {
+        request_failed = true;
         return "HTTP接続エラー";
     }
     
-    http_client.setTimeout(15000); // 15秒タイムアウト
+    // 15秒タイムアウト (ルーター経由なら残り予算まで)
+    uint32_t timeout = request_timeout_ms ? request_timeout_ms : 15000;
+    http_client.setConnectTimeout(timeout);
+    http_client.setTimeout(timeout);
     
     // ヘッダー設定
     http_client.addHeader("Content-Type", "application/json");
@@ -229,49 +583,21 @@ String LLMHandler::sendCloudRequest(const String& message) {
         http_client.addHeader("anthropic-version", "2023-06-01");
     }
     
-    // リクエストボディ作成
-    DynamicJsonDocument doc(4096);
-    
-    if (llm_type == LLM_CLOUD_OPENAI) {
-        doc["model"] = model_name;
-        JsonArray messages = doc.createNestedArray("messages");
-        
-        JsonObject system_msg = messages.createNestedObject();
-        system_msg["role"] = "system";
-        system_msg["content"] = system_prompt;
-        
-        // 履歴追加
-        for (int i = 0; i < history_count; i++) {
-            int idx = i * 2;
-            JsonObject user_msg = messages.createNestedObject();
-            user_msg["role"] = "user";
-            user_msg["content"] = conversation_history[idx];
-            
-            JsonObject asst_msg = messages.createNestedObject();
-            asst_msg["role"] = "assistant";
-            asst_msg["content"] = conversation_history[idx + 1];
-        }
-        
-        JsonObject current_msg = messages.createNestedObject();
-        current_msg["role"] = "user";
-        current_msg["content"] = message;
-        
-        doc["max_tokens"] = 150;
-        doc["temperature"] = 0.8;
-    }
-    
-    String request_body;
-    serializeJson(doc, request_body);
-    
-    Serial.println("リクエスト送信中...");
-    int http_code = http_client.POST(request_body);
+    Serial.printf("リクエスト送信中... (%d bytes)\n", body_builder.length());
+    // 送信からレスポンスヘッダーまで (接続済みでなければ接続も含む)
+    TRACE_BEGIN(first_byte, "http_first_byte");
+    int http_code = http_client.POST((uint8_t*)body_builder.c_str(), body_builder.length());
+    TRACE_END(first_byte);
     
     String response;
     if (http_code > 0) {
         if (http_code == HTTP_CODE_OK) {
+            TRACE_BEGIN(body, "http_body");
             response = http_client.getString();
+            TRACE_END(body);
             
             // レスポンス解析
+            TRACE_SCOPE("json_parse");
             if (llm_type == LLM_CLOUD_OPENAI) {
                 response = parseOpenAIResponse(response);
             } else if (llm_type == LLM_CLOUD_CLAUDE) {
@@ -281,9 +607,11 @@ String LLMHandler::sendCloudRequest(const String& message) {
             }
         } else {
             response = "HTTPエラー: " + String(http_code);
+            request_failed = true;
         }
     } else {
         response = "接続エラー";
+        request_failed = true;
     }
     
     http_client.end();
@@ -291,34 +619,48 @@ String LLMHandler::sendCloudRequest(const String& message) {
 }
 
 String LLMHandler::sendLocalRequest(const String& message) {
-    if (!http_client.begin(api_endpoint)) {
+    // Ollama形式のリクエスト
+    const char* prompt = buildPrompt(message);
+    body_builder.clear();
+    body_builder.append("{\"model\":").appendJsonString(model_name.c_str());
+    body_builder.append(",\"prompt\":").appendJsonString(prompt);
+    body_builder.append(",\"stream\":false}");
+    
+    if (prompt_builder.overflowed() || body_builder.overflowed()) {
+        request_failed = true;
+        return "リクエストが大きすぎます";
+    }
+    
+    if (!beginHttp()) {
+        request_failed = true;
         return "ローカルサーバー接続エラー";
     }
     
-    http_client.setTimeout(30000); // 30秒タイムアウト
+    // 30秒タイムアウト (ルーター経由なら残り予算まで)
+    uint32_t timeout = request_timeout_ms ? request_timeout_ms : 30000;
+    http_client.setConnectTimeout(timeout);
+    http_client.setTimeout(timeout);
     http_client.addHeader("Content-Type", "application/json");
     
-    // Ollama形式のリクエスト
-    DynamicJsonDocument doc(2048);
-    doc["model"] = model_name;
-    doc["prompt"] = buildPrompt(message);
-    doc["stream"] = false;
-    
-    String request_body;
-    serializeJson(doc, request_body);
-    
-    int http_code = http_client.POST(request_body);
+    TRACE_BEGIN(first_byte, "http_first_byte");
+    int http_code = http_client.POST((uint8_t*)body_builder.c_str(), body_builder.length());
+    TRACE_END(first_byte);
     
     String response;
     if (http_code > 0) {
         if (http_code == HTTP_CODE_OK) {
+            TRACE_BEGIN(body, "http_body");
             response = http_client.getString();
+            TRACE_END(body);
+            TRACE_SCOPE("json_parse");
             response = parseOllamaResponse(response);
         } else {
             response = "サーバーエラー: " + String(http_code);
+            request_failed = true;
         }
     } else {
         response = "接続エラー";
+        request_failed = true;
     }
     
     http_client.end();
@@ -328,22 +670,29 @@ String LLMHandler::sendLocalRequest(const String& message) {
 String LLMHandler::processTinyLocal(const String& message) {
     if (!tiny_llm) {
         Serial.println("TinyLLMが初期化されていません");
+        request_failed = true;
         return "ごめんね、今は考えられないの... 😢";
     }
     
     if (!tiny_llm->isModelLoaded()) {
         Serial.println("モデルが読み込まれていません");
+        request_failed = true;
         return "モデルを読み込んでないの... ごめんね! 💦";
     }
     
-    // 会話履歴を含めたコンテキスト構築
-    String context = buildPrompt(message);
+    // 会話履歴を含めたプロンプト構築 (末尾は "User: ...\nAssistant: ")
+    const char* prompt = buildPrompt(message);
     
-    // TinyLLMで推論
-    String response = tiny_llm->chat(message, context);
+    // TinyLLMで推論 (ルーター経由なら期限付き)
+    tiny_llm->setDeadline(request_timeout_ms ? millis() + request_timeout_ms : 0);
+    tiny_llm->setTokenCallback(token_fn, token_ctx);
+    String response = tiny_llm->generate(prompt, 50);
+    tiny_llm->setTokenCallback(nullptr, nullptr);
+    tiny_llm->setDeadline(0);
     
     // 空の場合はフォールバック
     if (response.length() == 0) {
+        request_failed = true;
         return "うーん、なんて言えばいいかな... 🤔";
     }
     
@@ -363,6 +712,7 @@ String LLMHandler::parseOpenAIResponse(const String& response) {
     DeserializationError error = deserializeJson(doc, response);
     
     if (error) {
+        request_failed = true;
         return "JSON解析エラー";
     }
     
@@ -370,6 +720,7 @@ String LLMHandler::parseOpenAIResponse(const String& response) {
         return doc["choices"][0]["message"]["content"].as<String>();
     }
     
+    request_failed = true;
     return "応答の解析に失敗しました";
 }
 
@@ -378,6 +729,7 @@ String LLMHandler::parseClaudeResponse(const String& response) {
     DeserializationError error = deserializeJson(doc, response);
     
     if (error) {
+        request_failed = true;
         return "JSON解析エラー";
     }
     
@@ -385,6 +737,7 @@ String LLMHandler::parseClaudeResponse(const String& response) {
         return doc["content"][0]["text"].as<String>();
     }
     
+    request_failed = true;
     return "応答の解析に失敗しました";
 }
 
@@ -393,6 +746,7 @@ String LLMHandler::parseGeminiResponse(const String& response) {
     DeserializationError error = deserializeJson(doc, response);
     
     if (error) {
+        request_failed = true;
         return "JSON解析エラー";
     }
     
@@ -400,6 +754,7 @@ String LLMHandler::parseGeminiResponse(const String& response) {
         return doc["candidates"][0]["content"]["parts"][0]["text"].as<String>();
     }
     
+    request_failed = true;
     return "応答の解析に失敗しました";
 }
 
@@ -408,6 +763,7 @@ String LLMHandler::parseOllamaResponse(const String& response) {
     DeserializationError error = deserializeJson(doc, response);
     
     if (error) {
+        request_failed = true;
         return "JSON解析エラー";
     }
     
@@ -415,5 +771,6 @@ String LLMHandler::parseOllamaResponse(const String& response) {
         return doc["response"].as<String>();
     }
     
+    request_failed = true;
     return "応答の解析に失敗しました";
 }
@@ -0,0 +1,213 @@
+#include "llm_worker.h"
+
+LLMWorker::LLMWorker() {
+    llm = nullptr;
+    task_handle = nullptr;
+    request_queue = nullptr;
+    result_queue = nullptr;
+    next_id = 1;
+    cancel_before = 0;
+    active_id = 0;
+    stream_len = 0;
+    stream_sent = 0;
+}
+
+LLMWorker::~LLMWorker() {
+    if (task_handle) {
+        vTaskDelete(task_handle);
+    }
+    if (request_queue) {
+        vQueueDelete(request_queue);
+    }
+    if (result_queue) {
+        vQueueDelete(result_queue);
+    }
+}
+
+bool LLMWorker::begin(LLMHandler* handler, BaseType_t core, UBaseType_t priority) {
+    if (!handler) {
+        return false;
+    }
+    llm = handler;
+    llm->setTokenCallback(onToken, this);
+
+    request_queue = xQueueCreate(LLM_WORKER_QUEUE_LEN, sizeof(LLMRequest));
+    result_queue = xQueueCreate(LLM_WORKER_QUEUE_LEN, sizeof(LLMResult));
+    if (!request_queue || !result_queue) {
+        Serial.println("LLMワーカー: キュー作成失敗");
+        return false;
+    }
+
+    BaseType_t ok = xTaskCreatePinnedToCore(
+        taskEntry, "llm_worker", LLM_WORKER_STACK_SIZE,
+        this, priority, &task_handle, core);
+
+    if (ok != pdPASS) {
+        Serial.println("LLMワーカー: タスク作成失敗");
+        task_handle = nullptr;
+        return false;
+    }
+
+    Serial.printf("LLMワーカー起動 (core %d)\n", (int)core);
+    return true;
+}
+
+uint32_t LLMWorker::submit(const String& message) {
+    if (!request_queue) {
+        return 0;
+    }
+
+    LLMRequest req;
+    req.id = next_id++;
+    strlcpy(req.message, message.c_str(), sizeof(req.message));
+
+    if (xQueueSend(request_queue, &req, 0) != pdTRUE) {
+        Serial.println("LLMワーカー: リクエストキューが満杯です");
+        return 0;
+    }
+    return req.id;
+}
+
+bool LLMWorker::poll(LLMResult* result) {
+    if (!result_queue) {
+        return false;
+    }
+
+    while (xQueueReceive(result_queue, result, 0) == pdTRUE) {
+        // キャンセル後に届いた古い結果は捨てる
+        if (!isCancelled(result->id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void LLMWorker::cancelAll() {
+    cancel_before = next_id - 1;
+
+    // 未処理のリクエストを破棄
+    if (request_queue) {
+        xQueueReset(request_queue);
+    }
+
+    // 推論中ならTinyLLMの生成ループを止める
+    // (HTTP通信は途中で中断できないので、結果を破棄するだけ)
+    if (active_id != 0 && llm) {
+        llm->abort();
+    }
+
+    Serial.println("LLMワーカー: キャンセルしました");
+}
+
+bool LLMWorker::isBusy() {
+    return active_id != 0 || pendingCount() > 0;
+}
+
+int LLMWorker::pendingCount() {
+    if (!request_queue) {
+        return 0;
+    }
+    return (int)uxQueueMessagesWaiting(request_queue);
+}
+
+void LLMWorker::taskEntry(void* arg) {
+    static_cast<LLMWorker*>(arg)->run();
+}
+
+// 句読点・改行で終わったらフレーズの区切り
+static bool endsPhrase(const char* text) {
+    static const char* const marks[] = { "、", "。", "！", "？", "!", "?", ".", ",", "\n" };
+    for (const char* mark : marks) {
+        if (strstr(text, mark)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void LLMWorker::onToken(void* ctx, const char* text) {
+    LLMWorker* self = static_cast<LLMWorker*>(ctx);
+    if (self->active_id == 0 || self->isCancelled(self->active_id)) {
+        return;
+    }
+
+    size_t len = strlen(text);
+    if (self->stream_len + len >= sizeof(self->stream_text)) {
+        return;     // 入りきらない分は最後の結果で返す
+    }
+    memcpy(self->stream_text + self->stream_len, text, len);
+    self->stream_len += len;
+    self->stream_text[self->stream_len] = '\0';
+
+    if (endsPhrase(text) || self->stream_len - self->stream_sent >= LLM_WORKER_PHRASE_MAX) {
+        self->sendPhrase();
+    }
+}
+
+void LLMWorker::sendPhrase() {
+    if (stream_len == stream_sent) {
+        return;
+    }
+    // 最後の結果のために1つは空けておく。満杯なら送らずに次のフレーズ (か最後の結果) にまとめる
+    if (uxQueueMessagesWaiting(result_queue) >= LLM_WORKER_QUEUE_LEN - 1) {
+        return;
+    }
+    LLMResult phrase;
+    phrase.id = active_id;
+    phrase.elapsed_ms = 0;
+    phrase.partial = true;
+    phrase.streamed = 0;
+    strlcpy(phrase.response, stream_text + stream_sent, sizeof(phrase.response));
+
+    if (xQueueSend(result_queue, &phrase, 0) == pdTRUE) {
+        stream_sent = stream_len;
+    }
+}
+
+void LLMWorker::run() {
+    LLMRequest req;
+    LLMResult result;
+
+    while (true) {
+        if (xQueueReceive(request_queue, &req, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        // active_id を立ててから中断フラグを下ろし、そのあとでキャンセルを判定する。
+        // 判定より後の cancelAll() は active_id を見て abort() するので取りこぼさない
+        active_id = req.id;
+        llm->clearAbort();
+
+        if (isCancelled(req.id)) {
+            active_id = 0;
+            continue;
+        }
+
+        uint32_t start_time = millis();
+        stream_len = 0;
+        stream_sent = 0;
+        stream_text[0] = '\0';
+
+        String response = llm->chat(String(req.message));
+
+        active_id = 0;
+
+        if (isCancelled(req.id)) {
+            continue;
+        }
+
+        result.id = req.id;
+        result.elapsed_ms = millis() - start_time;
+        result.partial = false;
+        // 返したフレーズが応答の先頭と食い違ったら (別のバックエンドに切り替わったなど)、
+        // 全体を読み直してもらう
+        result.streamed = stream_sent > 0 && strncmp(response.c_str(), stream_text, stream_sent) == 0 ?
+                          stream_sent : 0;
+        strlcpy(result.response, response.c_str(), sizeof(result.response));
+
+        // UI側が取りこぼしていても待たずに古い結果を優先する
+        if (xQueueSend(result_queue, &result, 0) != pdTRUE) {
+            Serial.println("LLMワーカー: 結果キューが満杯です");
+        }
+    }
+}
@@ -6,8 +6,16 @@
 #include "display_driver.h"
 #include "touch_driver.h"
 #include "llm_handler.h"
+#include "llm_worker.h"
+#include "character.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "memory_telemetry.h"
+#include "audio_output.h"
+#include "kana_synth.h"
+#include "lip_sync.h"
 
-// Audio (will be implemented with ESP32-audioI2S)
+// Audio (I2S出力は AudioOutput、マイクは未使用)
 #define I2S_BCLK   15
 #define I2S_LRCK   16
 #define I2S_DOUT   17
@@ -24,38 +32,71 @@
 #define SCREEN_HEIGHT 360
 #define CIRCLE_RADIUS 180
 
-// ===== LVGL用バッファ =====
-static lv_disp_draw_buf_t draw_buf;
-static lv_color_t buf1[SCREEN_WIDTH * 60];
-static lv_color_t buf2[SCREEN_WIDTH * 60];
-static lv_disp_drv_t disp_drv;
+// ===== メインループ =====
+// loop() は協調スケジューラで UI / シリアル / LLM のタスクを回す
+#define UI_TASK_PERIOD_MS       5       // lv_timer_handler() が時間を返さなかったとき
+#define SERIAL_TASK_PERIOD_MS   20
+#define LLM_TASK_PERIOD_MS      50
+#define UI_TASK_PRIORITY        3
+#define SERIAL_TASK_PRIORITY    1
+#define LLM_TASK_PRIORITY       2
+#define SERIAL_LINE_SIZE        256
+#define MEMORY_TASK_PRIORITY    0
+#define BENCH_TASK_PERIOD_MS    1000    // 描画ベンチマーク中は毎回すぐ次のフレーム
+#define BENCH_TASK_PRIORITY     0
+
+// 時間のかかるシリアルコマンド (ベンチマーク・ルールDB読み込み・長い出力) を実行するタスク。
+// LVGLを触らないものだけを渡す。loop と同じコアで loop より低い優先度なので、
+// loop が眠っている間だけ動き、描画やタッチを待たせない
+#define SERIAL_JOB_QUEUE_LEN    2
+#define SERIAL_JOB_STACK_SIZE   8192
+#define SERIAL_JOB_PRIORITY     0
+#define SERIAL_JOB_CORE         1
+
+struct SerialJob {
+    char cmd;
+    char arg[SERIAL_LINE_SIZE];
+};
+
+static LoopScheduler scheduler;
+static MemoryTelemetry memory_telemetry;
+static uint32_t loop_idle_ms = 0;       // 眠っていた時間の合計
+static uint32_t loop_stats_start = 0;
+static int bench_task_id = -1;
+static QueueHandle_t serial_jobs = nullptr;
+
+uint32_t ui_task(void* ctx);
+uint32_t serial_task(void* ctx);
+uint32_t llm_task(void* ctx);
+uint32_t memory_task(void* ctx);
+uint32_t bench_task(void* ctx);
+void serial_job_task(void* param);
 
 // ===== ハードウェアドライバ =====
 DisplayDriver* display;
 TouchDriver* touch;
 LLMHandler* llm;
+LLMWorker* llm_worker;
+AudioOutput* audio;
+KanaSynth* kana_synth;
 
 // ===== カービィキャラクター =====
-lv_obj_t *face_circle;
-lv_obj_t *left_eye;
-lv_obj_t *right_eye;
-lv_obj_t *mouth;
-
-// アニメーション状態
-typedef enum {
-    ANIM_IDLE,
-    ANIM_BLINK,
-    ANIM_HAPPY,
-    ANIM_SURPRISE,
-    ANIM_TALK
-} AnimState;
-
-AnimState current_anim = ANIM_IDLE;
-uint32_t last_anim_time = 0;
-uint32_t blink_timer = 0;
+FaceSprites* face_sprites = nullptr;   // 表情スプライト (確保できなければウィジェットで描く)
 
 // ===== LVGL入力デバイスコールバック =====
 void my_touchpad_read(lv_indev_drv_t *indev_driver, lv_indev_data_t *data) {
+    if (touch->isInterruptMode()) {
+        // 割り込みで読んだイベントを順に渡す (I2Cには触れない)
+        TouchPoint last;
+        if (touch->popEvent(&last)) {
+            data->continue_reading = touch->hasEvent();
+        }
+        data->state = touch->isTouched() ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
+        data->point.x = last.x;
+        data->point.y = last.y;
+        return;
+    }
+    
     if (touch->read() && touch->isTouched()) {
         data->state = LV_INDEV_STATE_PR;
         data->point.x = touch->getX();
@@ -71,16 +112,10 @@ void lvgl_init() {
     
     lv_init();
     
-    // ディスプレイバッファ設定（ダブルバッファ）
-    lv_disp_draw_buf_init(&draw_buf, buf1, buf2, SCREEN_WIDTH * 60);
-    
-    // ディスプレイドライバ登録
-    lv_disp_drv_init(&disp_drv);
-    disp_drv.hor_res = SCREEN_WIDTH;
-    disp_drv.ver_res = SCREEN_HEIGHT;
-    disp_drv.flush_cb = DisplayDriver::lvgl_flush_cb;
-    disp_drv.draw_buf = &draw_buf;
-    lv_disp_drv_register(&disp_drv);
+    // ディスプレイドライバ登録 (内部RAMに60行×2のバンド)
+    if (!DisplayDriver::setupLVGL(DisplayDriver::defaultConfig())) {
+        Serial.println("ディスプレイバッファ確保失敗");
+    }
     
     // タッチ入力ドライバ登録
     static lv_indev_drv_t indev_drv;
@@ -92,165 +127,53 @@ void lvgl_init() {
     Serial.println("LVGL初期化完了!");
 }
 
-// ===== カービィ風キャラクターの作成 =====
-void create_kirby_character() {
-    // 背景をピンク系のグラデーションに
-    lv_obj_t *bg = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(bg, SCREEN_WIDTH, SCREEN_HEIGHT);
-    lv_obj_set_style_bg_color(bg, lv_color_hex(0xFFE8F5), LV_PART_MAIN);
-    lv_obj_set_style_bg_grad_color(bg, lv_color_hex(0xFFB3E5), LV_PART_MAIN);
-    lv_obj_set_style_bg_grad_dir(bg, LV_GRAD_DIR_VER, LV_PART_MAIN);
-    
-    // 丸い顔 (ピンク色)
-    face_circle = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(face_circle, 280, 280);
-    lv_obj_align(face_circle, LV_ALIGN_CENTER, 0, 0);
-    lv_obj_set_style_bg_color(face_circle, lv_color_hex(0xFFB4D5), LV_PART_MAIN);
-    lv_obj_set_style_border_width(face_circle, 4, LV_PART_MAIN);
-    lv_obj_set_style_border_color(face_circle, lv_color_hex(0xFF8AC7), LV_PART_MAIN);
-    lv_obj_set_style_radius(face_circle, LV_RADIUS_CIRCLE, LV_PART_MAIN);
-    
-    // 左目 (楕円形)
-    left_eye = lv_obj_create(face_circle);
-    lv_obj_set_size(left_eye, 45, 65);
-    lv_obj_align(left_eye, LV_ALIGN_CENTER, -45, -20);
-    lv_obj_set_style_bg_color(left_eye, lv_color_hex(0x1A1A4D), LV_PART_MAIN);
-    lv_obj_set_style_border_width(left_eye, 0, LV_PART_MAIN);
-    lv_obj_set_style_radius(left_eye, LV_RADIUS_CIRCLE, LV_PART_MAIN);
-    
-    // 白いハイライト
-    lv_obj_t *left_highlight = lv_obj_create(left_eye);
-    lv_obj_set_size(left_highlight, 15, 20);
-    lv_obj_align(left_highlight, LV_ALIGN_TOP_LEFT, 8, 8);
-    lv_obj_set_style_bg_color(left_highlight, lv_color_white(), LV_PART_MAIN);
-    lv_obj_set_style_radius(left_highlight, LV_RADIUS_CIRCLE, LV_PART_MAIN);
-    lv_obj_set_style_border_width(left_highlight, 0, LV_PART_MAIN);
-    
-    // 右目 (楕円形)
-    right_eye = lv_obj_create(face_circle);
-    lv_obj_set_size(right_eye, 45, 65);
-    lv_obj_align(right_eye, LV_ALIGN_CENTER, 45, -20);
-    lv_obj_set_style_bg_color(right_eye, lv_color_hex(0x1A1A4D), LV_PART_MAIN);
-    lv_obj_set_style_border_width(right_eye, 0, LV_PART_MAIN);
-    lv_obj_set_style_radius(right_eye, LV_RADIUS_CIRCLE, LV_PART_MAIN);
-    
-    // 白いハイライト
-    lv_obj_t *right_highlight = lv_obj_create(right_eye);
-    lv_obj_set_size(right_highlight, 15, 20);
-    lv_obj_align(right_highlight, LV_ALIGN_TOP_LEFT, 8, 8);
-    lv_obj_set_style_bg_color(right_highlight, lv_color_white(), LV_PART_MAIN);
-    lv_obj_set_style_radius(right_highlight, LV_RADIUS_CIRCLE, LV_PART_MAIN);
-    lv_obj_set_style_border_width(right_highlight, 0, LV_PART_MAIN);
-    
-    // 口 (小さな楕円)
-    mouth = lv_obj_create(face_circle);
-    lv_obj_set_size(mouth, 30, 15);
-    lv_obj_align(mouth, LV_ALIGN_CENTER, 0, 40);
-    lv_obj_set_style_bg_color(mouth, lv_color_hex(0xD84A6F), LV_PART_MAIN);
-    lv_obj_set_style_border_width(mouth, 0, LV_PART_MAIN);
-    lv_obj_set_style_radius(mouth, LV_RADIUS_CIRCLE, LV_PART_MAIN);
-    
-    // 頬の赤み (左)
-    lv_obj_t *left_cheek = lv_obj_create(face_circle);
-    lv_obj_set_size(left_cheek, 50, 40);
-    lv_obj_align(left_cheek, LV_ALIGN_CENTER, -90, 20);
-    lv_obj_set_style_bg_color(left_cheek, lv_color_hex(0xFF80AB), LV_PART_MAIN);
-    lv_obj_set_style_bg_opa(left_cheek, LV_OPA_50, LV_PART_MAIN);
-    lv_obj_set_style_border_width(left_cheek, 0, LV_PART_MAIN);
-    lv_obj_set_style_radius(left_cheek, LV_RADIUS_CIRCLE, LV_PART_MAIN);
-    
-    // 頬の赤み (右)
-    lv_obj_t *right_cheek = lv_obj_create(face_circle);
-    lv_obj_set_size(right_cheek, 50, 40);
-    lv_obj_align(right_cheek, LV_ALIGN_CENTER, 90, 20);
-    lv_obj_set_style_bg_color(right_cheek, lv_color_hex(0xFF80AB), LV_PART_MAIN);
-    lv_obj_set_style_bg_opa(right_cheek, LV_OPA_50, LV_PART_MAIN);
-    lv_obj_set_style_border_width(right_cheek, 0, LV_PART_MAIN);
-    lv_obj_set_style_radius(right_cheek, LV_RADIUS_CIRCLE, LV_PART_MAIN);
-}
-
-// ===== まばたきアニメーション =====
-void blink_animation() {
-    static int blink_phase = 0;
-    
-    if (blink_phase == 0) {
-        // 目を閉じる
-        lv_obj_set_height(left_eye, 10);
-        lv_obj_set_height(right_eye, 10);
-        blink_phase = 1;
-    } else {
-        // 目を開ける
-        lv_obj_set_height(left_eye, 65);
-        lv_obj_set_height(right_eye, 65);
-        blink_phase = 0;
-        blink_timer = millis() + random(2000, 5000);
-    }
-}
+// ===== かわいい声でしゃべる =====
+// speak_begin() → speak_feed() を何回か → speak_end() の順に呼ぶ
+// (LLMの応答はフレーズが届くたびに speak_feed() する)
+static uint32_t speaking_id = 0;    // フレーズを読み上げている途中のLLM応答 (0 = なし)
 
-// ===== 話すアニメーション =====
-void talk_animation() {
-    static bool mouth_open = false;
-    
-    if (mouth_open) {
-        lv_obj_set_size(mouth, 30, 15);
-    } else {
-        lv_obj_set_size(mouth, 40, 35);
+void speak_begin() {
+    if (!audio || !kana_synth) {
+        // 音なし: 口は一定の周期で動かす
+        start_animation(ANIM_TALK);
+        return;
     }
-    mouth_open = !mouth_open;
-}
 
-// ===== 驚きアニメーション =====
-void surprise_animation() {
-    lv_obj_set_size(left_eye, 55, 75);
-    lv_obj_set_size(right_eye, 55, 75);
-    lv_obj_set_size(mouth, 45, 45);
+    // 口パクが最初から音を拾えるように、音を先に出す
+    // (読み上げはテキストを積んだそばから再生タスクが合成する)
+    kana_synth->reset();
+    audio->play(KanaSynth::fill, kana_synth);
+    start_animation(ANIM_TALK);
 }
 
-// ===== 通常状態に戻す =====
-void reset_to_idle() {
-    lv_obj_set_size(left_eye, 45, 65);
-    lv_obj_set_size(right_eye, 45, 65);
-    lv_obj_set_size(mouth, 30, 15);
-    current_anim = ANIM_IDLE;
+void speak_feed(const char* text) {
+    if (audio && kana_synth) {
+        kana_synth->feed(text);
+    }
 }
 
-// ===== アニメーション更新 =====
-void update_animation() {
-    uint32_t current_time = millis();
-    
-    // 自動まばたき
-    if (current_anim == ANIM_IDLE && current_time > blink_timer) {
-        blink_animation();
-    }
-    
-    // 話すアニメーション
-    if (current_anim == ANIM_TALK) {
-        if (current_time - last_anim_time > 150) {
-            talk_animation();
-            last_anim_time = current_time;
-        }
-    }
-    
-    // 2秒後にアイドルに戻る
-    if (current_anim != ANIM_IDLE && current_time - last_anim_time > 2000) {
-        reset_to_idle();
+void speak_end() {
+    if (audio && kana_synth) {
+        kana_synth->finish();
     }
 }
 
-// ===== かわいい声でしゃべる =====
 void speak_cute(const String& message) {
-    current_anim = ANIM_TALK;
-    last_anim_time = millis();
-    
     Serial.print("🎀 しゃべります: ");
     Serial.println(message);
     
-    // TODO: 実際のオーディオ出力を実装
-    // audio.connecttoFS(SD, "/cute_voice.mp3");
+    speaking_id = 0;
+    speak_begin();
+    speak_feed(message.c_str());
+    speak_end();
 }
 
 // ===== タッチイベントハンドラ =====
-void on_touch(TouchPoint point) {
+void on_touch(TouchEdge edge, TouchPoint point) {
+    // 押した/離したでは何もしない (ジェスチャーは1回のタッチで1回だけ届く)
+    if (edge != TOUCH_EDGE_GESTURE) {
+        return;
+    }
     Serial.printf("タッチ: x=%d, y=%d, gesture=%d\n", point.x, point.y, point.gesture);
     
     // ジェスチャーに応じたアクション
@@ -260,32 +183,70 @@ void on_touch(TouchPoint point) {
             break;
         case GESTURE_DOUBLE_CLICK:
             surprise_animation();
-            current_anim = ANIM_SURPRISE;
-            last_anim_time = millis();
+            start_animation(ANIM_SURPRISE);
             break;
         case GESTURE_LONG_PRESS:
             speak_cute("長押しされたよ!");
             break;
+        case GESTURE_SWIPE_UP:
+        case GESTURE_SWIPE_DOWN:
+        case GESTURE_SWIPE_LEFT:
+        case GESTURE_SWIPE_RIGHT: {
+            const GestureEvent& g = touch->getLastGesture();
+            Serial.printf("  スワイプ: %d,%d px/s (%lums)\n", g.vx, g.vy, (unsigned long)g.elapsed_ms);
+            break;
+        }
+        case GESTURE_ROTATE_CW:
+        case GESTURE_ROTATE_CCW:
+            // 縁をなぞったら目で追う
+            blink_animation();
+            break;
     }
 }
 
 // ===== LLMとの会話 =====
 void chat_with_llm(const String& message) {
-    if (!llm) {
+    if (!llm || !llm_worker) {
         Serial.println("LLMが初期化されていません");
         speak_cute("ごめんね、今は話せないの...");
         return;
     }
     
-    // 考え中アニメーション
-    current_anim = ANIM_TALK;
-    last_anim_time = millis();
-    
-    // LLMで応答生成
-    String response = llm->chat(message);
+    // LLMで応答生成 (ワーカータスクで非同期に処理)
+    if (llm_worker->submit(message) == 0) {
+        speak_cute("ちょっと待ってね、考え中なの...");
+        return;
+    }
     
-    // 応答をしゃべる
-    speak_cute(response);
+    // 考え中アニメーション
+    start_animation(ANIM_TALK);
+}
+
+// ===== LLM応答の受け取り =====
+void poll_llm_results() {
+    if (!llm_worker) return;
+    
+    static LLMResult result;    // 512バイトあるのでスタックに置かない
+    while (llm_worker->poll(&result)) {
+        if (result.partial) {
+            // 生成途中のフレーズ: 最初のフレーズで話し始め、続きは話しながら足す
+            if (result.id != speaking_id) {
+                speaking_id = result.id;
+                speak_begin();
+            }
+            Serial.print("🎀 しゃべります (途中): ");
+            Serial.println(result.response);
+            speak_feed(result.response);
+        } else if (result.id == speaking_id && result.streamed > 0) {
+            // 残りを足して終わる
+            speak_feed(result.response + result.streamed);
+            speak_end();
+            speaking_id = 0;
+        } else {
+            // 応答をしゃべる
+            speak_cute(String(result.response));
+        }
+    }
 }
 
 // ===== セットアップ =====
@@ -311,13 +272,33 @@ void setup() {
         // タッチなしでも続行可能
     } else {
         touch->setTouchCallback(on_touch);
+        if (!touch->startInterruptMode()) {
+            Serial.println("タッチはポーリングで読みます");
+        }
     }
     
     // LVGL初期化
     lvgl_init();
     
     // キャラクター作成
-    create_kirby_character();
+    // 目と口の全状態をアトラスに描いておく
+    face_sprites = new FaceSprites();
+    if (!face_sprites->init()) {
+        delete face_sprites;
+        face_sprites = nullptr;
+    }
+    create_kirby_character(face_sprites);
+    
+    // オーディオ初期化 (失敗しても音なしで続行)
+    audio = new AudioOutput();
+    if (!audio->begin(I2S_BCLK, I2S_LRCK, I2S_DOUT)) {
+        Serial.println("オーディオ初期化失敗");
+        delete audio;
+        audio = nullptr;
+    } else {
+        kana_synth = new KanaSynth();
+        set_talk_level_source(audio_talk_level, audio);
+    }
     
     // LLM初期化
     llm = new LLMHandler();
@@ -329,8 +310,19 @@ void setup() {
     
     if (wifi_connected) {
         Serial.println("WiFi接続成功! クラウドLLMが利用可能です");
+        #ifdef USE_LLM_ROUTER
+        // ローカルサーバー → クラウド → TinyLLM → ルールベースの順に予算内で試す
+        // (TinyLLMは初期化されていなければ失敗扱いでスキップされる)
+        llm->addRoute(LLM_LOCAL_SERVER, LOCAL_SERVER_URL, "", LOCAL_MODEL, 4000);
+        llm->addRoute(LLM_CLOUD_OPENAI, LLMConfig::OPENAI_ENDPOINT, OPENAI_API_KEY, OPENAI_MODEL, 6000);
+        llm->addRoute(LLM_TINY_LOCAL, "", "", "", 3000);
+        llm->addRoute(LLM_RULE_BASED);
+        llm->setLatencyBudget(LLM_LATENCY_BUDGET_MS);
+        llm->setLLMType(LLM_AUTO_ROUTE);
+        #else
         // デフォルトはルールベース（高速）
         llm->setLLMType(LLM_RULE_BASED);
+        #endif
         
         // クラウドLLMを使う場合:
         // llm->setLLMType(LLM_CLOUD_OPENAI);
@@ -352,17 +344,68 @@ void setup() {
         Serial.println("SimpleResponder初期化失敗");
     }
     
+    // 応答キャッシュ (繰り返しの挨拶などを再利用)
+    #ifdef LLM_CACHE_FLASH
+    llm->initResponseCache(RESPONSE_CACHE_ENTRIES, RESPONSE_CACHE_TTL_MS, true);
+    #else
+    llm->initResponseCache();
+    #endif
+    
     // TinyLLMを使う場合（実験的）
     // if (llm->initTinyLLM()) {
     //     llm->setLLMType(LLM_TINY_LOCAL);
     //     // SDカードからモデルを読み込む
     //     // llm->loadTinyModel("/model.bin");
+    //     // ルールの言い換えを埋め込みで拾う (意図ベクトルはSPIFFSに保存)
+    //     // llm->enableIntentSearch();
     // }
     
+    // LLMワーカー起動 (UIを止めないように別コアで推論)
+    llm_worker = new LLMWorker();
+    if (!llm_worker->begin(llm)) {
+        Serial.println("LLMワーカー起動失敗");
+        delete llm_worker;
+        llm_worker = nullptr;
+    }
+    
     Serial.println("LLM準備完了!");
     
-    // まばたきタイマー初期化
-    blink_timer = millis() + random(2000, 5000);
+    // 区間計測 (-DENABLE_TRACE=1 のときだけ)
+    Trace::begin();
+    
+    // メインループのタスク
+    scheduler.addTask("ui", ui_task, nullptr, UI_TASK_PERIOD_MS, UI_TASK_PRIORITY);
+    scheduler.addTask("llm", llm_task, nullptr, LLM_TASK_PERIOD_MS, LLM_TASK_PRIORITY);
+    scheduler.addTask("serial", serial_task, nullptr, SERIAL_TASK_PERIOD_MS, SERIAL_TASK_PRIORITY);
+    scheduler.addTask("memory", memory_task, nullptr, MEM_TELEMETRY_PERIOD_MS, MEMORY_TASK_PRIORITY);
+    bench_task_id = scheduler.addTask("bench", bench_task, nullptr, BENCH_TASK_PERIOD_MS, BENCH_TASK_PRIORITY);
+    scheduler.resetStats();
+    
+    // 重いシリアルコマンド用のタスク
+    TaskHandle_t serial_job_handle = nullptr;
+    serial_jobs = xQueueCreate(SERIAL_JOB_QUEUE_LEN, sizeof(SerialJob));
+    if (!serial_jobs ||
+        xTaskCreatePinnedToCore(serial_job_task, "serial_job", SERIAL_JOB_STACK_SIZE, nullptr,
+                                SERIAL_JOB_PRIORITY, &serial_job_handle, SERIAL_JOB_CORE) != pdPASS) {
+        Serial.println("シリアルジョブのタスク起動失敗 (重いコマンドはその場で実行)");
+        serial_job_handle = nullptr;
+    }
+    
+    // メモリ監視 (スタックを見るタスク)
+    memory_telemetry.begin();
+    memory_telemetry.addTask("loop");
+    if (llm_worker) {
+        memory_telemetry.addTask("llm", llm_worker->getTaskHandle());
+    }
+    if (touch && touch->isInterruptMode()) {
+        memory_telemetry.addTask("touch", touch->getTaskHandle());
+    }
+    if (audio) {
+        memory_telemetry.addTask("audio", audio->getTaskHandle());
+    }
+    if (serial_job_handle) {
+        memory_telemetry.addTask("serial_job", serial_job_handle);
+    }
     
     Serial.println("\n✨ 初期化完了! ✨");
     Serial.println("\nシリアルコマンド:");
@@ -375,76 +418,276 @@ void setup() {
 }
 
 // ===== メインループ =====
-void loop() {
-    // LVGL更新（UIとタッチ処理）
-    lv_timer_handler();
-    
-    // アニメーション更新
-    update_animation();
-    
-    // シリアルコマンドでテスト
-    if (Serial.available()) {
-        String input = Serial.readStringUntil('\n');
-        input.trim();
-        
-        if (input.length() == 0) return;
-        
-        char cmd = input.charAt(0);
-        
-        switch (cmd) {
-            case 'b': // まばたき
-                Serial.println("👁️ まばたき!");
-                blink_animation();
-                break;
-                
-            case 't': // 話す
-                speak_cute("テストだよ!");
-                break;
-                
-            case 's': // 驚き
-                Serial.println("😲 びっくり!");
-                surprise_animation();
-                current_anim = ANIM_SURPRISE;
-                last_anim_time = millis();
-                break;
-                
-            case 'r': // リセット
-                Serial.println("🔄 リセット");
-                reset_to_idle();
-                break;
-                
-            case 'h': // こんにちは
-                chat_with_llm("こんにちは!");
-                break;
-                
-            case '?': // ヘルプ
-                Serial.println("\n📖 コマンド一覧:");
-                Serial.println("  b - まばたき");
-                Serial.println("  t - 話す");
-                Serial.println("  s - 驚き");
-                Serial.println("  r - リセット");
-                Serial.println("  h - こんにちは");
-                Serial.println("  l <message> - LLMと会話");
-                Serial.println("  ? - このヘルプ\n");
-                break;
-                
-            case 'l': // LLMと会話
-                if (input.length() > 2) {
-                    String message = input.substring(2);
-                    chat_with_llm(message);
-                } else {
-                    Serial.println("使い方: l <メッセージ>");
-                }
-                break;
-                
-            default:
-                // その他の入力はLLMへ
-                if (llm && input.length() > 0) {
-                    chat_with_llm(input);
+// ===== シリアルコマンド =====
+// 重いコマンドの本体 (serial_job タスクで実行。LVGLは触らない)
+void run_serial_job(const SerialJob& job) {
+    switch (job.cmd) {
+        case 'p': // ルール照合ベンチマーク
+            if (llm && llm->getSimpleResponder()) {
+                llm->getSimpleResponder()->benchmark();
+                SimpleResponder::benchmarkScaling(1000);
+                SimpleResponder::benchmarkScaling(5000);
+            }
+            break;
+            
+        case 'v': // 読み上げの実時間比
+            KanaSynth::benchmark(job.arg);
+            break;
+            
+        case 'u': // ルールDB読み込み (照合中のLLMワーカーはロックで待つ)
+            if (llm && llm->getSimpleResponder()) {
+                if (llm->getSimpleResponder()->loadRulesFromSPIFFS(job.arg)) {
+                    llm->getSimpleResponder()->printStats();
                 }
-                break;
+            }
+            break;
+            
+        case 'x': // トレース出力 (記録中のコアがあっても書きかけのイベントは捨てる)
+            Trace::exportJson(Serial);
+            Trace::clear();
+            break;
+            
+        case 'm': // メモリ履歴 (loop で取った写しを出力)
+            memory_telemetry.dump();
+            break;
+    }
+}
+
+void serial_job_task(void* param) {
+    SerialJob job;
+    while (true) {
+        if (xQueueReceive(serial_jobs, &job, portMAX_DELAY) == pdTRUE) {
+            run_serial_job(job);
         }
     }
+}
+
+// 重いコマンドをタスクに渡す (タスクがなければその場で実行)。渡せなければ false
+bool submit_serial_job(char cmd, const String& arg) {
+    static SerialJob job;   // スタックに256バイト載せない
+    job.cmd = cmd;
+    strlcpy(job.arg, arg.c_str(), sizeof(job.arg));
+    if (!serial_jobs) {
+        run_serial_job(job);
+        return true;
+    }
+    if (xQueueSend(serial_jobs, &job, 0) != pdTRUE) {
+        Serial.println("前のコマンドを実行中です");
+        return false;
+    }
+    return true;
+}
+
+void handle_command(const String& input) {
+    char cmd = input.charAt(0);
     
-    delay(5);
-}
\ No newline at end of file
+    switch (cmd) {
+        case 'b': // まばたき
+            Serial.println("👁️ まばたき!");
+            blink_animation();
+            break;
+            
+        case 't': // 話す
+            speak_cute("テストだよ!");
+            break;
+            
+        case 's': // 驚き
+            Serial.println("😲 びっくり!");
+            surprise_animation();
+            start_animation(ANIM_SURPRISE);
+            break;
+            
+        case 'r': // リセット
+            Serial.println("🔄 リセット");
+            reset_to_idle();
+            break;
+            
+        case 'h': // こんにちは
+            chat_with_llm("こんにちは!");
+            break;
+            
+        case '?': // ヘルプ
+            Serial.println("\n📖 コマンド一覧:");
+            Serial.println("  b - まばたき");
+            Serial.println("  t - 話す");
+            Serial.println("  s - 驚き");
+            Serial.println("  r - リセット");
+            Serial.println("  h - こんにちは");
+            Serial.println("  l <message> - LLMと会話");
+            Serial.println("  c - LLMリクエストをキャンセル");
+            Serial.println("  p - ルール照合ベンチマーク");
+            Serial.println("  u <path> - ルールDBを読み込み (SPIFFS)");
+            Serial.println("  f - 描画FPS/CPU負荷/描画画素数 (表示後リセット)");
+            Serial.println("  d - 描画バッファ構成ごとのFPS/ヒープ比較");
+            Serial.println("  i - タッチ入力の遅延/I2C使用率 (表示後リセット)");
+            Serial.println("  j - ループのタスクごとの遅れ/実行時間 (表示後リセット)");
+            Serial.println("  x - トレースをChrome JSONで出力 (出力後クリア)");
+            Serial.println("  m - メモリ (ヒープ/PSRAM/LVGL/スタック) の履歴と傾向");
+            Serial.println("  a - オーディオの開始遅延/生成時間 (表示後リセット、テスト音)");
+            Serial.println("  v <text> - 読み上げの実時間比を測って、しゃべる");
+            Serial.println("  ? - このヘルプ\n");
+            break;
+            
+        case 'c': // キャンセル
+            if (llm_worker) {
+                llm_worker->cancelAll();
+            }
+            if (speaking_id != 0) {
+                // 最後の結果はもう届かないので、読み上げ中のフレーズで終える
+                speak_end();
+                speaking_id = 0;
+            }
+            reset_to_idle();
+            break;
+            
+        case 'p': // ルール照合ベンチマーク
+            submit_serial_job('p', "");
+            break;
+            
+        case 'f': // 描画統計
+            DisplayDriver::printFlushStats();
+            DisplayDriver::resetFlushStats();
+            {
+                uint32_t elapsed = millis() - loop_stats_start;
+                if (elapsed > 0) {
+                    Serial.printf("ループ休止率: %.1f%%\n", loop_idle_ms * 100.0f / elapsed);
+                }
+                loop_idle_ms = 0;
+                loop_stats_start = millis();
+            }
+            break;
+            
+        case 'x': // トレース出力 (80KBのJSONを書き出す間も描画を止めない)
+            submit_serial_job('x', "");
+            break;
+            
+        case 'a': // オーディオ統計
+            if (audio) {
+                audio->printStats();
+                audio->resetStats();
+                audio->playTone(1047, 150);
+            }
+            break;
+            
+        case 'v': // 読み上げ
+            if (input.length() > 2) {
+                String text = input.substring(2);
+                submit_serial_job('v', text);
+                speak_cute(text);
+            } else if (kana_synth) {
+                kana_synth->printStats();
+            }
+            break;
+            
+        case 'm': // メモリ履歴 (LVGLヒープはここで測り、出力はジョブタスクで)
+            if (memory_telemetry.snapshot() && !submit_serial_job('m', "")) {
+                memory_telemetry.releaseSnapshot();
+            }
+            break;
+            
+        case 'j': // スケジューラ統計
+            scheduler.printStats();
+            scheduler.resetStats();
+            break;
+            
+        case 'i': // タッチ統計
+            if (touch) {
+                touch->printStats();
+                touch->resetStats();
+            }
+            break;
+            
+        case 'd': // 描画バッファ構成ベンチマーク (LVGLを使うのでloopで1フレームずつ)
+            if (DisplayDriver::startBenchmark()) {
+                scheduler.wake(bench_task_id);
+            }
+            break;
+            
+        case 'u': // ルールDB読み込み
+            if (input.length() > 2 && llm && llm->getSimpleResponder()) {
+                submit_serial_job('u', input.substring(2));
+            } else {
+                Serial.println("使い方: u <ファイルパス>");
+            }
+            break;
+            
+        case 'l': // LLMと会話
+            if (input.length() > 2) {
+                String message = input.substring(2);
+                chat_with_llm(message);
+            } else {
+                Serial.println("使い方: l <メッセージ>");
+            }
+            break;
+            
+        default:
+            // その他の入力はLLMへ
+            if (llm && input.length() > 0) {
+                chat_with_llm(input);
+            }
+            break;
+    }
+}
+
+// ===== スケジューラのタスク =====
+// UI: LVGLのタイマー (描画・タッチ・表情アニメーション)。次のタイマーまでの時間を返す
+uint32_t ui_task(void* ctx) {
+    uint32_t next_ms = lv_timer_handler();
+    return next_ms > 0 ? next_ms : 1;
+}
+
+// シリアル: 届いた分だけ読み、行がそろったら実行 (待たない)
+uint32_t serial_task(void* ctx) {
+    static char line[SERIAL_LINE_SIZE];
+    static size_t line_len = 0;
+    
+    while (Serial.available()) {
+        char c = (char)Serial.read();
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (line_len < sizeof(line) - 1) {
+                line[line_len++] = c;
+            }
+            continue;
+        }
+        
+        line[line_len] = '\0';
+        line_len = 0;
+        String input(line);
+        input.trim();
+        if (input.length() > 0) {
+            handle_command(input);
+        }
+        // 1回に1行だけ (長いコマンドが続いても描画を待たせない)
+        return SERIAL_TASK_PERIOD_MS / 2;
+    }
+    return 0;
+}
+
+// LLM: ワーカーからの応答を受け取る
+uint32_t llm_task(void* ctx) {
+    poll_llm_results();
+    return 0;
+}
+
+// メモリ: ヒープ・PSRAM・LVGL・スタックを記録 (LVGLを触るのでloopで)
+uint32_t memory_task(void* ctx) {
+    memory_telemetry.sample();
+    return 0;
+}
+
+// 描画ベンチマーク: 1回に1フレームだけ描いて、ほかのタスクに順番を回す
+uint32_t bench_task(void* ctx) {
+    return DisplayDriver::benchmarkStep() ? 1 : 0;
+}
+
+void loop() {
+    // 期限が来たタスクを実行し、次の期限まで眠る
+    uint32_t idle_ms = scheduler.runOnce();
+    if (idle_ms > 0) {
+        loop_idle_ms += idle_ms;
+        delay(idle_ms);
+    }
+}
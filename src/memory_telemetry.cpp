@@ -0,0 +1,240 @@
+#include "memory_telemetry.h"
+#include <esp_heap_caps.h>
+#include <lvgl.h>
+
+MemoryTelemetry::MemoryTelemetry() {
+    short_history = nullptr;
+    long_history = nullptr;
+    snap = nullptr;
+    snap_busy = false;
+    num_tasks = 0;
+    short_count = 0;
+    long_count = 0;
+    memset(&window_worst, 0, sizeof(window_worst));
+}
+
+MemoryTelemetry::~MemoryTelemetry() {
+    free(short_history);
+    free(long_history);
+    free(snap);
+}
+
+bool MemoryTelemetry::begin() {
+    if (short_history) {
+        return true;
+    }
+    size_t short_bytes = MEM_SHORT_HISTORY * sizeof(MemorySample);
+    size_t long_bytes = MEM_LONG_HISTORY * sizeof(MemorySample);
+    if (psramFound()) {
+        short_history = (MemorySample*)ps_malloc(short_bytes);
+        long_history = (MemorySample*)ps_malloc(long_bytes);
+        snap = (MemorySnapshot*)ps_malloc(sizeof(MemorySnapshot));
+    } else {
+        short_history = (MemorySample*)malloc(short_bytes);
+        long_history = (MemorySample*)malloc(long_bytes);
+        snap = (MemorySnapshot*)malloc(sizeof(MemorySnapshot));
+    }
+    if (!short_history || !long_history || !snap) {
+        Serial.println("メモリ監視: 履歴バッファ確保失敗");
+        free(short_history);
+        free(long_history);
+        free(snap);
+        short_history = nullptr;
+        long_history = nullptr;
+        snap = nullptr;
+        return false;
+    }
+    short_count = 0;
+    long_count = 0;
+    Serial.printf("メモリ監視: %d秒ごと, 履歴 %d + %d件 (%d bytes)\n",
+                  MEM_TELEMETRY_PERIOD_MS / 1000, MEM_SHORT_HISTORY, MEM_LONG_HISTORY,
+                  (int)(short_bytes + long_bytes + sizeof(MemorySnapshot)));
+    return true;
+}
+
+bool MemoryTelemetry::addTask(const char* name, TaskHandle_t handle) {
+    if (num_tasks >= MEM_MAX_TASKS) {
+        Serial.printf("メモリ監視: タスク %s を登録できません (最大 %d)\n", name, MEM_MAX_TASKS);
+        return false;
+    }
+    tasks[num_tasks].name = name;
+    tasks[num_tasks].handle = handle ? handle : xTaskGetCurrentTaskHandle();
+    num_tasks++;
+    return true;
+}
+
+void MemoryTelemetry::capture(MemorySample* s) {
+    memset(s, 0, sizeof(*s));
+    s->uptime_s = millis() / 1000;
+
+    s->heap_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    s->heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    s->heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    s->psram_free_kb = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024;
+    s->psram_largest_kb = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) / 1024;
+
+#if !LV_MEM_CUSTOM
+    // LVGL内蔵ヒープのときだけ (LV_MEM_IN_PSRAM なら上のPSRAMに含まれる)
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    s->lv_free = mon.free_size;
+    s->lv_used_pct = mon.used_pct;
+    s->lv_frag_pct = mon.frag_pct;
+#endif
+
+    // ESP32のFreeRTOSではスタックの残りはバイト単位
+    for (int i = 0; i < num_tasks; i++) {
+        UBaseType_t free_bytes = uxTaskGetStackHighWaterMark(tasks[i].handle);
+        s->stack_free[i] = free_bytes > 0xFFFF ? 0xFFFF : free_bytes;
+    }
+}
+
+void MemoryTelemetry::mergeWorst(MemorySample* worst, const MemorySample& s) {
+    worst->uptime_s = s.uptime_s;
+    worst->heap_free = min(worst->heap_free, s.heap_free);
+    worst->heap_largest = min(worst->heap_largest, s.heap_largest);
+    worst->heap_min = min(worst->heap_min, s.heap_min);
+    worst->psram_free_kb = min(worst->psram_free_kb, s.psram_free_kb);
+    worst->psram_largest_kb = min(worst->psram_largest_kb, s.psram_largest_kb);
+    worst->lv_free = min(worst->lv_free, s.lv_free);
+    worst->lv_used_pct = max(worst->lv_used_pct, s.lv_used_pct);
+    worst->lv_frag_pct = max(worst->lv_frag_pct, s.lv_frag_pct);
+    for (int i = 0; i < MEM_MAX_TASKS; i++) {
+        worst->stack_free[i] = min(worst->stack_free[i], s.stack_free[i]);
+    }
+}
+
+void MemoryTelemetry::sample() {
+    if (!short_history) {
+        return;
+    }
+    MemorySample& s = short_history[short_count % MEM_SHORT_HISTORY];
+    capture(&s);
+
+    // 長期履歴には区間内の最悪値を残す (一時的な落ち込みも見えるように)
+    if (short_count % MEM_LONG_EVERY == 0) {
+        window_worst = s;
+    } else {
+        mergeWorst(&window_worst, s);
+    }
+    short_count++;
+
+    if (short_count % MEM_LONG_EVERY == 0) {
+        long_history[long_count % MEM_LONG_HISTORY] = window_worst;
+        long_count++;
+    }
+}
+
+bool MemoryTelemetry::latest(MemorySample* out) {
+    if (!short_history || short_count == 0) {
+        return false;
+    }
+    *out = short_history[(short_count - 1) % MEM_SHORT_HISTORY];
+    return true;
+}
+
+void MemoryTelemetry::printHeader() {
+    Serial.print("  経過(s)  内部空き  最大ブロック  最小空き  PSRAM空き/最大(KB)  LVGL空き 使用% 断片%");
+    for (int i = 0; i < num_tasks; i++) {
+        Serial.printf("  %s", tasks[i].name);
+    }
+    Serial.println();
+}
+
+void MemoryTelemetry::printSample(const MemorySample& s) {
+    Serial.printf("  %7lu  %8lu  %12lu  %8lu  %8u / %-8u  %8lu %4u%% %4u%%",
+                  (unsigned long)s.uptime_s,
+                  (unsigned long)s.heap_free, (unsigned long)s.heap_largest, (unsigned long)s.heap_min,
+                  s.psram_free_kb, s.psram_largest_kb,
+                  (unsigned long)s.lv_free, s.lv_used_pct, s.lv_frag_pct);
+    for (int i = 0; i < num_tasks; i++) {
+        Serial.printf("  %u", s.stack_free[i]);
+    }
+    Serial.println();
+}
+
+void MemoryTelemetry::printTrend(const char* label, const MemorySample& first, const MemorySample& last) {
+    uint32_t span_s = last.uptime_s - first.uptime_s;
+    if (span_s == 0) {
+        return;
+    }
+    float hours = span_s / 3600.0f;
+    Serial.printf("  %s (%.1f時間): 内部空き %+.0f B/h, 最大ブロック %+.0f B/h, PSRAM空き %+.0f KB/h, LVGL空き %+.0f B/h\n",
+                  label, hours,
+                  ((int32_t)last.heap_free - (int32_t)first.heap_free) / hours,
+                  ((int32_t)last.heap_largest - (int32_t)first.heap_largest) / hours,
+                  ((int32_t)last.psram_free_kb - (int32_t)first.psram_free_kb) / hours,
+                  ((int32_t)last.lv_free - (int32_t)first.lv_free) / hours);
+}
+
+void MemoryTelemetry::printCurrent(const MemorySample& now) {
+    printHeader();
+    printSample(now);
+
+    // 空きに対して最大ブロックが小さいほど断片化している
+    if (now.heap_free > 0) {
+        Serial.printf("  内部RAMの断片化: %u%%\n",
+                      (unsigned)(100 - (uint64_t)now.heap_largest * 100 / now.heap_free));
+    }
+}
+
+bool MemoryTelemetry::snapshot() {
+    if (!snap) {
+        Serial.println("メモリ監視: 履歴バッファがありません");
+        return false;
+    }
+    if (snap_busy) {
+        Serial.println("前のコマンドを実行中です");
+        return false;
+    }
+    snap_busy = true;
+    capture(&snap->now);
+
+    snap->n_short = min(short_count, (uint32_t)MEM_SHORT_HISTORY);
+    for (uint32_t i = 0; i < snap->n_short; i++) {
+        snap->short_history[i] = short_history[(short_count - snap->n_short + i) % MEM_SHORT_HISTORY];
+    }
+    snap->n_long = min(long_count, (uint32_t)MEM_LONG_HISTORY);
+    for (uint32_t i = 0; i < snap->n_long; i++) {
+        snap->long_history[i] = long_history[(long_count - snap->n_long + i) % MEM_LONG_HISTORY];
+    }
+    return true;
+}
+
+void MemoryTelemetry::dump() {
+    if (!snap || !snap_busy) {
+        return;
+    }
+    const MemorySnapshot& s = *snap;
+
+    Serial.println("メモリ (現在):");
+    printCurrent(s.now);
+
+    if (s.n_long > 0) {
+        Serial.printf("長期履歴 (%d分ごとの最悪値, %lu件):\n",
+                      MEM_TELEMETRY_PERIOD_MS / 60000 * MEM_LONG_EVERY, (unsigned long)s.n_long);
+        printHeader();
+        for (uint32_t i = 0; i < s.n_long; i++) {
+            printSample(s.long_history[i]);
+        }
+    }
+
+    if (s.n_short > 0) {
+        Serial.printf("短期履歴 (%d秒ごと, %lu件):\n",
+                      MEM_TELEMETRY_PERIOD_MS / 1000, (unsigned long)s.n_short);
+        printHeader();
+        for (uint32_t i = 0; i < s.n_short; i++) {
+            printSample(s.short_history[i]);
+        }
+    }
+
+    // 傾向 (減り続けていればリーク、最大ブロックだけ減っていれば断片化)
+    Serial.println("傾向:");
+    if (s.n_short > 1) {
+        printTrend("短期", s.short_history[0], s.short_history[s.n_short - 1]);
+    }
+    if (s.n_long > 1) {
+        printTrend("長期", s.long_history[0], s.long_history[s.n_long - 1]);
+    }
+    releaseSnapshot();
+}
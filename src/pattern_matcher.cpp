@@ -0,0 +1,243 @@
+#include "pattern_matcher.h"
+#include <algorithm>
+
+static void* allocTable(size_t size) {
+    void* p = nullptr;
+    if (psramFound()) {
+        p = ps_malloc(size);
+    }
+    if (!p) {
+        p = malloc(size);
+    }
+    return p;
+}
+
+PatternMatcher::PatternMatcher() {
+    edges = nullptr;
+    states = nullptr;
+    outputs = nullptr;
+    num_states = 0;
+    num_edges = 0;
+    num_outputs = 0;
+    compiled = false;
+    clear();
+}
+
+PatternMatcher::~PatternMatcher() {
+    freeTables();
+}
+
+void PatternMatcher::freeTables() {
+    if (edges) free(edges);
+    if (states) free(states);
+    if (outputs) free(outputs);
+    edges = nullptr;
+    states = nullptr;
+    outputs = nullptr;
+    num_states = 0;
+    num_edges = 0;
+    num_outputs = 0;
+    compiled = false;
+}
+
+void PatternMatcher::clear() {
+    freeTables();
+    trie.clear();
+    trie.emplace_back();  // ルート
+    for (int i = 0; i < 256; i++) {
+        root_next[i] = 0;
+    }
+}
+
+bool PatternMatcher::addPattern(const char* pattern, uint16_t pattern_id) {
+    if (!pattern || !*pattern) {
+        return false;
+    }
+    if (trie.empty()) {
+        trie.emplace_back();
+    }
+
+    int32_t node = 0;
+    for (const uint8_t* p = (const uint8_t*)pattern; *p; p++) {
+        uint8_t c = foldCase(*p);
+        int32_t child = -1;
+        for (auto& e : trie[node].next) {
+            if (e.first == c) {
+                child = e.second;
+                break;
+            }
+        }
+        if (child < 0) {
+            child = (int32_t)trie.size();
+            trie[node].next.push_back(std::make_pair(c, child));
+            trie.emplace_back();
+        }
+        node = child;
+    }
+
+    trie[node].out.push_back(pattern_id);
+    return true;
+}
+
+bool PatternMatcher::build() {
+    freeTables();
+
+    int n = (int)trie.size();
+    if (n == 0) {
+        return false;
+    }
+
+    // 遷移をバイト順に並べる (照合時に二分探索するため)
+    size_t total_edges = 0;
+    size_t total_outputs = 0;
+    for (auto& node : trie) {
+        std::sort(node.next.begin(), node.next.end());
+        total_edges += node.next.size();
+        total_outputs += node.out.size();
+    }
+
+    if (n > 0xFFFFFF) {
+        Serial.println("PatternMatcher: 状態数が多すぎます");
+        return false;
+    }
+
+    states = (State*)allocTable(n * sizeof(State));
+    edges = (uint32_t*)allocTable((total_edges ? total_edges : 1) * sizeof(uint32_t));
+    outputs = (uint16_t*)allocTable((total_outputs ? total_outputs : 1) * sizeof(uint16_t));
+    if (!states || !edges || !outputs) {
+        Serial.println("PatternMatcher: メモリ割り当て失敗");
+        freeTables();
+        return false;
+    }
+
+    // 遷移と出力をコンパクトな配列へ
+    uint32_t e_pos = 0;
+    uint32_t o_pos = 0;
+    for (int i = 0; i < n; i++) {
+        State& st = states[i];
+        st.first_edge = e_pos;
+        st.edge_count = (uint16_t)trie[i].next.size();
+        for (auto& e : trie[i].next) {
+            edges[e_pos++] = ((uint32_t)e.first << 24) | (uint32_t)e.second;
+        }
+        st.out_first = o_pos;
+        st.out_count = (uint16_t)trie[i].out.size();
+        for (uint16_t id : trie[i].out) {
+            outputs[o_pos++] = id;
+        }
+        st.fail = 0;
+        st.dict_link = -1;
+    }
+    num_states = n;
+    num_edges = (int)e_pos;
+    num_outputs = (int)o_pos;
+
+    for (int c = 0; c < 256; c++) {
+        root_next[c] = 0;
+    }
+    for (auto& e : trie[0].next) {
+        root_next[e.first] = e.second;
+    }
+
+    // 幅優先で失敗遷移と辞書リンクを計算
+    std::vector<int32_t> queue;
+    queue.reserve(n);
+    for (auto& e : trie[0].next) {
+        queue.push_back(e.second);
+    }
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        int32_t u = queue[head];
+        for (auto& e : trie[u].next) {
+            uint8_t c = e.first;
+            int32_t v = e.second;
+
+            int32_t f = states[u].fail;
+            int32_t target;
+            while (true) {
+                target = next(f, c);
+                if (target >= 0 || f == 0) break;
+                f = states[f].fail;
+            }
+            if (target < 0 || target == v) {
+                target = 0;
+            }
+
+            states[v].fail = target;
+            states[v].dict_link = (states[target].out_count > 0) ? target : states[target].dict_link;
+            queue.push_back(v);
+        }
+    }
+
+    // 構築用のトライは解放 (以後はテーブルのみ使用)
+    std::vector<BuildNode>().swap(trie);
+    compiled = true;
+    return true;
+}
+
+int32_t PatternMatcher::next(int32_t state, uint8_t c) const {
+    if (state == 0) {
+        int32_t t = root_next[c];
+        return t ? t : -1;
+    }
+
+    const State& st = states[state];
+    int lo = 0;
+    int hi = (int)st.edge_count - 1;
+    const uint32_t* e = edges + st.first_edge;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) >> 1;
+        uint8_t b = (uint8_t)(e[mid] >> 24);
+        if (b == c) {
+            return (int32_t)(e[mid] & 0xFFFFFF);
+        }
+        if (b < c) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+void PatternMatcher::match(const char* text, MatchCallback callback, void* ctx) const {
+    if (!compiled || !text) {
+        return;
+    }
+
+    int32_t s = 0;
+    for (const uint8_t* p = (const uint8_t*)text; *p; p++) {
+        uint8_t c = foldCase(*p);
+
+        while (true) {
+            if (s == 0) {
+                s = root_next[c];
+                break;
+            }
+            int32_t t = next(s, c);
+            if (t >= 0) {
+                s = t;
+                break;
+            }
+            s = states[s].fail;
+        }
+
+        // この位置で終わるすべてのパターンを通知
+        for (int32_t o = (states[s].out_count > 0) ? s : states[s].dict_link;
+             o > 0;
+             o = states[o].dict_link) {
+            const State& st = states[o];
+            for (uint16_t k = 0; k < st.out_count; k++) {
+                callback(outputs[st.out_first + k], ctx);
+            }
+        }
+    }
+}
+
+size_t PatternMatcher::getMemoryUsage() const {
+    return num_states * sizeof(State) +
+           num_edges * sizeof(uint32_t) +
+           num_outputs * sizeof(uint16_t) +
+           sizeof(root_next);
+}
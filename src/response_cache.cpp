@@ -0,0 +1,299 @@
+#include "response_cache.h"
+#include <Preferences.h>
+#include <time.h>
+
+static const char* CACHE_NVS_NAMESPACE = "llm_cache";
+
+ResponseCache::ResponseCache() {
+    entries = nullptr;
+    capacity = 0;
+    ttl_ms = RESPONSE_CACHE_TTL_MS;
+    use_counter = 0;
+    flash_tier = false;
+    hits = 0;
+    flash_hits = 0;
+    misses = 0;
+    saved_ms = 0;
+}
+
+ResponseCache::~ResponseCache() {
+    if (entries) {
+        free(entries);
+    }
+}
+
+bool ResponseCache::init(int num_entries, uint32_t ttl, bool use_flash) {
+    if (entries) {
+        free(entries);
+        entries = nullptr;
+    }
+
+    size_t size = num_entries * sizeof(Entry);
+
+    // PSRAMに確保 (なければ内部RAM)
+    if (psramFound()) {
+        entries = (Entry*)ps_malloc(size);
+    }
+    if (!entries) {
+        entries = (Entry*)malloc(size);
+    }
+    if (!entries) {
+        Serial.println("応答キャッシュ: メモリ割り当て失敗");
+        return false;
+    }
+
+    capacity = num_entries;
+    ttl_ms = ttl;
+    flash_tier = use_flash;
+    clear();
+
+    Serial.printf("応答キャッシュ: %d件 (%d bytes)%s\n",
+                  capacity, (int)size, flash_tier ? " + フラッシュ" : "");
+    return true;
+}
+
+void ResponseCache::clear() {
+    for (int i = 0; i < capacity; i++) {
+        entries[i].valid = false;
+    }
+    use_counter = 0;
+}
+
+uint32_t ResponseCache::hashString(const char* str) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*str) {
+        hash ^= (uint8_t)*str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool ResponseCache::normalize(const String& input, char* out, size_t out_size) {
+    const uint8_t* p = (const uint8_t*)input.c_str();
+    size_t len = input.length();
+    size_t o = 0;
+
+    for (size_t i = 0; i < len; ) {
+        uint8_t c = p[i];
+
+        // ASCII: 空白と記号を除去、小文字化
+        if (c < 0x80) {
+            if (isalnum(c)) {
+                if (o + 1 >= out_size) {
+                    out[o] = '\0';
+                    return false;
+                }
+                out[o++] = tolower(c);
+            }
+            i++;
+            continue;
+        }
+
+        // 全角の空白・句読点 (3バイト)
+        if (i + 2 < len) {
+            uint8_t c1 = p[i + 1], c2 = p[i + 2];
+            bool skip =
+                (c == 0xE3 && c1 == 0x80 && (c2 == 0x80 || c2 == 0x81 ||
+                                             c2 == 0x82 || c2 == 0x9C)) || // 　、。〜
+                (c == 0xEF && c1 == 0xBC && (c2 == 0x81 || c2 == 0x9F)) || // ！？
+                (c == 0xEF && c1 == 0xBD && c2 == 0x9E);                   // ～
+            if (skip) {
+                i += 3;
+                continue;
+            }
+        }
+
+        // それ以外のマルチバイト文字はそのままコピー (途中で切らない)
+        size_t n = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+        if (o + n >= out_size) {
+            out[o] = '\0';
+            return false;
+        }
+        for (size_t k = 0; k < n && i < len; k++) {
+            out[o++] = p[i++];
+        }
+    }
+    out[o] = '\0';
+    return true;
+}
+
+ResponseCache::Entry* ResponseCache::find(const char* key, uint32_t hash, uint32_t persona) {
+    for (int i = 0; i < capacity; i++) {
+        Entry* e = &entries[i];
+        if (e->valid && e->hash == hash && e->persona == persona &&
+            strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+ResponseCache::Entry* ResponseCache::victim() {
+    Entry* oldest = &entries[0];
+    for (int i = 0; i < capacity; i++) {
+        if (!entries[i].valid) {
+            return &entries[i];
+        }
+        if (entries[i].last_used < oldest->last_used) {
+            oldest = &entries[i];
+        }
+    }
+    return oldest;
+}
+
+bool ResponseCache::lookup(const String& message, uint32_t persona_hash,
+                           String& out, uint32_t* origin_latency_ms) {
+    if (!entries) {
+        return false;
+    }
+
+    // 入りきらない長いメッセージは先頭だけで比べると別の質問とぶつかるので扱わない
+    char key[RESPONSE_CACHE_KEY_SIZE];
+    if (!normalize(message, key, sizeof(key)) || key[0] == '\0') {
+        return false;
+    }
+    uint32_t hash = hashString(key);
+
+    Entry* e = find(key, hash, persona_hash);
+    if (e) {
+        if (millis() - e->created_ms > ttl_ms) {
+            // 期限切れ
+            e->valid = false;
+        } else {
+            e->last_used = ++use_counter;
+            out = e->value;
+            if (origin_latency_ms) *origin_latency_ms = e->origin_latency_ms;
+            hits++;
+            return true;
+        }
+    }
+
+    if (flash_tier && loadFromFlash(key, hash, persona_hash, out, origin_latency_ms)) {
+        hits++;
+        flash_hits++;
+
+        // PSRAM段に昇格
+        Entry* slot = victim();
+        slot->hash = hash;
+        slot->persona = persona_hash;
+        slot->created_ms = millis();
+        slot->last_used = ++use_counter;
+        slot->origin_latency_ms = origin_latency_ms ? *origin_latency_ms : 0;
+        slot->valid = true;
+        strlcpy(slot->key, key, sizeof(slot->key));
+        strlcpy(slot->value, out.c_str(), sizeof(slot->value));
+        return true;
+    }
+
+    misses++;
+    return false;
+}
+
+void ResponseCache::store(const String& message, uint32_t persona_hash,
+                          const String& response, uint32_t latency_ms) {
+    if (!entries || response.length() >= RESPONSE_CACHE_VALUE_SIZE) {
+        // 長すぎる応答は途中で切れてしまうのでキャッシュしない
+        return;
+    }
+
+    // lookup() と同じく、キーに入りきらないメッセージはキャッシュしない
+    char key[RESPONSE_CACHE_KEY_SIZE];
+    if (!normalize(message, key, sizeof(key)) || key[0] == '\0') {
+        return;
+    }
+    uint32_t hash = hashString(key);
+
+    Entry* e = find(key, hash, persona_hash);
+    if (!e) {
+        e = victim();
+    }
+
+    e->hash = hash;
+    e->persona = persona_hash;
+    e->created_ms = millis();
+    e->last_used = ++use_counter;
+    e->origin_latency_ms = latency_ms;
+    e->valid = true;
+    strlcpy(e->key, key, sizeof(e->key));
+    strlcpy(e->value, response.c_str(), sizeof(e->value));
+
+    if (flash_tier) {
+        saveToFlash(e);
+    }
+}
+
+bool ResponseCache::loadFromFlash(const char* key, uint32_t hash, uint32_t persona,
+                                  String& out, uint32_t* origin_latency_ms) {
+    Preferences prefs;
+    if (!prefs.begin(CACHE_NVS_NAMESPACE, true)) {
+        return false;
+    }
+
+    char slot_key[8];
+    snprintf(slot_key, sizeof(slot_key), "s%02u",
+             (unsigned)((hash ^ persona) % RESPONSE_CACHE_FLASH_SLOTS));
+
+    FlashRecord rec;
+    size_t read = prefs.getBytes(slot_key, &rec, sizeof(rec));
+    prefs.end();
+
+    if (read != sizeof(rec) || rec.hash != hash || rec.persona != persona ||
+        strncmp(rec.key, key, sizeof(rec.key)) != 0) {
+        return false;
+    }
+
+    // 時刻同期済みならTTLを確認 (millis()は再起動でリセットされるため)
+    time_t now = time(nullptr);
+    if (rec.saved_epoch != 0 && now > 1600000000 &&
+        (uint32_t)now - rec.saved_epoch > RESPONSE_CACHE_FLASH_TTL_S) {
+        return false;
+    }
+
+    rec.value[sizeof(rec.value) - 1] = '\0';
+    out = rec.value;
+    if (origin_latency_ms) *origin_latency_ms = rec.origin_latency_ms;
+    return true;
+}
+
+void ResponseCache::saveToFlash(const Entry* entry) {
+    Preferences prefs;
+    if (!prefs.begin(CACHE_NVS_NAMESPACE, false)) {
+        return;
+    }
+
+    char slot_key[8];
+    snprintf(slot_key, sizeof(slot_key), "s%02u",
+             (unsigned)((entry->hash ^ entry->persona) % RESPONSE_CACHE_FLASH_SLOTS));
+
+    FlashRecord rec;
+    rec.hash = entry->hash;
+    rec.persona = entry->persona;
+    time_t now = time(nullptr);
+    rec.saved_epoch = (now > 1600000000) ? (uint32_t)now : 0;
+    rec.origin_latency_ms = entry->origin_latency_ms;
+    memcpy(rec.key, entry->key, sizeof(rec.key));
+    memcpy(rec.value, entry->value, sizeof(rec.value));
+
+    prefs.putBytes(slot_key, &rec, sizeof(rec));
+    prefs.end();
+}
+
+void ResponseCache::recordSaving(uint32_t origin_latency_ms, uint32_t hit_latency_ms) {
+    if (origin_latency_ms > hit_latency_ms) {
+        saved_ms += origin_latency_ms - hit_latency_ms;
+    }
+}
+
+float ResponseCache::getHitRate() {
+    uint32_t total = hits + misses;
+    if (total == 0) {
+        return 0.0f;
+    }
+    return (float)hits / (float)total;
+}
+
+void ResponseCache::printStats() {
+    Serial.printf("キャッシュ: ヒット %u / ミス %u (ヒット率 %.1f%%, フラッシュ %u), 節約 %ums\n",
+                  hits, misses, getHitRate() * 100.0f, flash_hits, (uint32_t)saved_ms);
+}
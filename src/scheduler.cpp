@@ -0,0 +1,116 @@
+#include "scheduler.h"
+#include "trace.h"
+
+LoopScheduler::LoopScheduler() {
+    num_tasks = 0;
+    stats_since_ms = 0;
+}
+
+int LoopScheduler::addTask(const char* name, TaskFn fn, void* ctx, uint32_t period_ms, uint8_t priority) {
+    if (num_tasks >= SCHED_MAX_TASKS || !fn || period_ms == 0) {
+        return -1;
+    }
+
+    Task& t = tasks[num_tasks];
+    memset(&t, 0, sizeof(t));
+    t.name = name;
+    t.fn = fn;
+    t.ctx = ctx;
+    t.period_ms = period_ms;
+    t.priority = priority;
+    t.deadline_us = micros();
+    return num_tasks++;
+}
+
+void LoopScheduler::wake(int task_id) {
+    if (task_id >= 0 && task_id < num_tasks) {
+        tasks[task_id].deadline_us = micros();
+    }
+}
+
+uint32_t LoopScheduler::runOnce() {
+    // 各タスクは1回の runOnce() で最大1回 (低優先度のタスクが飢えないように)
+    uint32_t ran = 0;
+
+    while (true) {
+        uint32_t now = micros();
+        int best = -1;
+        for (int i = 0; i < num_tasks; i++) {
+            if ((ran & (1u << i)) || !isDue(tasks[i].deadline_us, now)) {
+                continue;
+            }
+            if (best < 0 || tasks[i].priority > tasks[best].priority) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+
+        Task& t = tasks[best];
+        ran |= 1u << best;
+
+        uint32_t late = now - t.deadline_us;
+        uint32_t next_ms;
+        {
+            TRACE_SCOPE(t.name);
+            next_ms = t.fn(t.ctx);
+        }
+        uint32_t end = micros();
+        uint32_t elapsed = end - now;
+
+        t.runs++;
+        t.late_sum_us += late;
+        if (late > t.late_max_us) t.late_max_us = late;
+        t.run_sum_us += elapsed;
+        if (elapsed > t.run_max_us) t.run_max_us = elapsed;
+
+        if (next_ms > 0) {
+            // タスクが次の時刻を指定した (LVGLのタイマーなど)
+            t.deadline_us = end + next_ms * 1000;
+        } else {
+            t.deadline_us += t.period_ms * 1000;
+            if (isDue(t.deadline_us, end)) {
+                // 1周期以上遅れたら追いつこうとせず、今から数え直す
+                t.deadline_us = end + t.period_ms * 1000;
+            }
+        }
+    }
+
+    // 次の期限まで
+    uint32_t now = micros();
+    uint32_t wait_us = UINT32_MAX;
+    for (int i = 0; i < num_tasks; i++) {
+        if (isDue(tasks[i].deadline_us, now)) {
+            return 0;
+        }
+        uint32_t d = tasks[i].deadline_us - now;
+        if (d < wait_us) wait_us = d;
+    }
+    return num_tasks ? wait_us / 1000 : 0;
+}
+
+void LoopScheduler::printStats() {
+    Serial.printf("タスク (%lums):\n", (unsigned long)(millis() - stats_since_ms));
+    Serial.println("  名前      優先度 周期   回数   遅れ平均/最大(us)   実行平均/最大(us)");
+    for (int i = 0; i < num_tasks; i++) {
+        const Task& t = tasks[i];
+        uint32_t runs = t.runs ? t.runs : 1;
+        Serial.printf("  %-9s %3d %5lums %6lu %8lu /%8lu %8lu /%8lu\n",
+                      t.name, t.priority, (unsigned long)t.period_ms, (unsigned long)t.runs,
+                      (unsigned long)(t.late_sum_us / runs), (unsigned long)t.late_max_us,
+                      (unsigned long)(t.run_sum_us / runs), (unsigned long)t.run_max_us);
+    }
+}
+
+void LoopScheduler::resetStats() {
+    for (int i = 0; i < num_tasks; i++) {
+        Task& t = tasks[i];
+        t.runs = 0;
+        t.late_sum_us = 0;
+        t.late_max_us = 0;
+        t.run_sum_us = 0;
+        t.run_max_us = 0;
+    }
+    stats_since_ms = millis();
+}
@@ -0,0 +1,1136 @@
+#include "simple_responder.h"
+#include "tiny_llm.h"
+#include <ArduinoJson.h>
+#include <SD.h>
+#include <SPIFFS.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// 組み込みルール
+struct BuiltinRule {
+    const char* pattern;
+    const char* response;
+};
+
+static const BuiltinRule BUILTIN_RULES[] = {
+    // 挨拶
+    {"こんにちは", "やっほー! 元気だよ! 🎀"},
+    {"おはよう", "おはよー! いい朝だね! ☀️"},
+    {"こんばんは", "こんばんは! 今日はどうだった? 🌙"},
+    {"hello", "Hello! Nice to meet you! 👋"},
+
+    // 感情
+    {"元気", "うん! とっても元気だよ! ✨"},
+    {"嬉しい", "わーい! 一緒に嬉しいよ! 💕"},
+    {"悲しい", "大丈夫だよ! そばにいるからね 🤗"},
+    {"疲れ", "お疲れ様! ゆっくり休んでね 😊"},
+
+    // 質問応答
+    {"名前", "ぼくはカビちゃんだよ! 🌸"},
+    {"誰", "かわいいキャラクターだよ! ピンク色なの! 💗"},
+    {"何", "楽しくおしゃべりするのが好きなんだ! 🎵"},
+    {"どこ", "この画面の中にいるよ! 👀"},
+
+    // 好き嫌い
+    {"好き", "わーい! ぼくも大好きだよ! 💖"},
+    {"嫌い", "そっか... でも仲良くしてね 😢"},
+    {"かわいい", "えへへ、ありがとう! (*´▽`*) 💗"},
+    {"すごい", "そんなことないよー! 照れちゃう! ☺️"},
+
+    // アクション
+    {"遊", "遊ぼう遊ぼう! 何して遊ぶ? 🎮"},
+    {"歌", "らんらんらーん♪ どう? 🎤"},
+    {"踊", "くるくる~♪ 一緒に踊ろう! 💃"},
+    {"食べ", "おいしいもの大好き! 何食べる? 🍰"},
+
+    // ありがとう・ごめんね
+    {"ありがとう", "どういたしまして! 💕"},
+    {"ごめん", "気にしないで! 大丈夫だよ! 😊"},
+    {"すみません", "いいのいいの! 気にしないでね! ✨"},
+
+    // 別れ
+    {"さようなら", "またね! バイバイ! 👋✨"},
+    {"バイバイ", "またねー! 楽しかったよ! 💖"},
+    {"おやすみ", "おやすみー! いい夢見てね! 🌟"},
+
+    // 天気
+    {"天気", "いい天気だといいね! ☀️"},
+    {"雨", "雨かぁ... でも雨も好きだよ! ☔"},
+
+    // その他
+    {"時間", "今を楽しもう! ⏰"},
+};
+
+// 別タスクからの同時アクセスを防ぐ
+class ResponderLock {
+private:
+    SemaphoreHandle_t sem;
+public:
+    ResponderLock(SemaphoreHandle_t s) : sem(s) {
+        if (sem) xSemaphoreTake(sem, portMAX_DELAY);
+    }
+    ~ResponderLock() {
+        if (sem) xSemaphoreGive(sem);
+    }
+};
+
+static void* allocRuleMemory(size_t size) {
+    void* p = nullptr;
+    if (psramFound()) {
+        p = ps_malloc(size);
+    }
+    if (!p) {
+        p = malloc(size);
+    }
+    return p;
+}
+
+SimpleResponder::SimpleResponder() {
+    for (int i = 0; i < MAX_RULE_CHUNKS; i++) {
+        chunks[i] = nullptr;
+    }
+    for (int i = 0; i < MAX_RULE_ARENA_BLOCKS; i++) {
+        arena_blocks[i] = nullptr;
+    }
+    num_rules = 0;
+    indexed_rules = 0;
+    arena_count = 0;
+    arena_used = 0;
+    arena_total = 0;
+    gram_keys = nullptr;
+    gram_offsets = nullptr;
+    postings = nullptr;
+    num_grams = 0;
+    num_postings = 0;
+    hit_counts = nullptr;
+    touched = nullptr;
+    embedder = nullptr;
+    intent_vectors = nullptr;
+    intent_rules = nullptr;
+    intent_inv_norms = nullptr;
+    num_intents = 0;
+    intent_dim = 0;
+    intent_threshold = INTENT_MIN_SIMILARITY;
+    lock = xSemaphoreCreateMutex();
+}
+
+SimpleResponder::~SimpleResponder() {
+    clearRules();
+    if (lock) {
+        vSemaphoreDelete(lock);
+    }
+}
+
+void SimpleResponder::init() {
+    ResponderLock guard(lock);
+    
+    int count = sizeof(BUILTIN_RULES) / sizeof(BUILTIN_RULES[0]);
+    for (int i = 0; i < count; i++) {
+        const BuiltinRule& r = BUILTIN_RULES[i];
+        appendRule(r.pattern, strlen(r.pattern), r.response, strlen(r.response), 1.0f);
+    }
+    
+    compile();
+}
+
+void SimpleResponder::clearRules() {
+    ResponderLock guard(lock);
+    
+    for (int i = 0; i < MAX_RULE_CHUNKS; i++) {
+        if (chunks[i]) {
+            free(chunks[i]);
+            chunks[i] = nullptr;
+        }
+    }
+    for (int i = 0; i < arena_count; i++) {
+        free(arena_blocks[i]);
+        arena_blocks[i] = nullptr;
+    }
+    num_rules = 0;
+    indexed_rules = 0;
+    arena_count = 0;
+    arena_used = 0;
+    arena_total = 0;
+    matcher.clear();
+    freeGramIndex();
+    freeIntents();
+}
+
+char* SimpleResponder::storeString(const char* text, size_t len) {
+    size_t need = len + 1;
+    
+    // 現在のブロックに入らなければ新しいブロックを確保
+    if (arena_count == 0 || arena_used + need > RULE_ARENA_BLOCK_SIZE) {
+        if (arena_count >= MAX_RULE_ARENA_BLOCKS) {
+            return nullptr;
+        }
+        size_t block_size = need > RULE_ARENA_BLOCK_SIZE ? need : RULE_ARENA_BLOCK_SIZE;
+        char* block = (char*)allocRuleMemory(block_size);
+        if (!block) {
+            return nullptr;
+        }
+        arena_blocks[arena_count++] = block;
+        arena_used = 0;
+        arena_total += block_size;
+    }
+    
+    char* dst = arena_blocks[arena_count - 1] + arena_used;
+    memcpy(dst, text, len);
+    dst[len] = '\0';
+    arena_used += need;
+    return dst;
+}
+
+bool SimpleResponder::appendRule(const char* pattern, size_t pattern_len,
+                                 const char* response, size_t response_len, float priority) {
+    if (pattern_len == 0 || num_rules >= MAX_RULE_CHUNKS * RULE_CHUNK_SIZE) {
+        return false;
+    }
+    
+    // チャンク単位で確保 (既存のルールは動かさない)
+    int chunk = num_rules / RULE_CHUNK_SIZE;
+    if (!chunks[chunk]) {
+        chunks[chunk] = (Rule*)allocRuleMemory(RULE_CHUNK_SIZE * sizeof(Rule));
+        if (!chunks[chunk]) {
+            return false;
+        }
+    }
+    
+    char* p = storeString(pattern, pattern_len);
+    char* r = storeString(response, response_len);
+    if (!p || !r) {
+        return false;
+    }
+    
+    // パターンは小文字化して保存 (ASCIIのみ)
+    for (char* c = p; *c; c++) {
+        *c = (char)PatternMatcher::foldCase((uint8_t)*c);
+    }
+    
+    Rule& rl = rule(num_rules);
+    rl.pattern = p;
+    rl.response = r;
+    rl.priority = priority;
+    rl.gram_count = (uint16_t)extractGrams(p, scratch_grams, MAX_QUERY_GRAMS, false);
+    num_rules++;
+    return true;
+}
+
+void SimpleResponder::addRule(const String& pattern, const String& response, float priority) {
+    ResponderLock guard(lock);
+    
+    if (!appendRule(pattern.c_str(), pattern.length(),
+                    response.c_str(), response.length(), priority)) {
+        Serial.println("SimpleResponder: ルール追加失敗");
+    }
+    // 索引には入れない (続けて追加されても再構築は次の照合で1回だけ)
+}
+
+// 新しいルールはしばらく線形に照合し、たまっていたら照合の前にまとめて索引に入れる
+void SimpleResponder::indexPendingRules() {
+    if (num_rules - indexed_rules > RULE_REBUILD_THRESHOLD) {
+        compile();
+    }
+}
+
+void SimpleResponder::rebuildIndex() {
+    ResponderLock guard(lock);
+    compile();
+}
+
+bool SimpleResponder::compile() {
+    uint32_t start = micros();
+    
+    matcher.clear();
+    for (int i = 0; i < num_rules; i++) {
+        matcher.addPattern(rule(i).pattern, (uint16_t)i);
+    }
+    
+    if (!matcher.build()) {
+        Serial.println("SimpleResponder: パターンのコンパイル失敗");
+        indexed_rules = 0;
+        freeGramIndex();
+        return false;
+    }
+    indexed_rules = num_rules;
+    
+    if (!buildGramIndex()) {
+        Serial.println("SimpleResponder: n-gram索引の構築失敗");
+    }
+    
+    Serial.printf("SimpleResponder: %dルール -> %d状態, %d n-gram (%d bytes, %dus)\n",
+                  num_rules, matcher.getStateCount(), num_grams,
+                  (int)(matcher.getMemoryUsage() + gramIndexBytes()), (int)(micros() - start));
+    return true;
+}
+
+void SimpleResponder::freeGramIndex() {
+    if (gram_keys) free(gram_keys);
+    if (gram_offsets) free(gram_offsets);
+    if (postings) free(postings);
+    if (hit_counts) free(hit_counts);
+    if (touched) free(touched);
+    gram_keys = nullptr;
+    gram_offsets = nullptr;
+    postings = nullptr;
+    hit_counts = nullptr;
+    touched = nullptr;
+    num_grams = 0;
+    num_postings = 0;
+}
+
+size_t SimpleResponder::gramIndexBytes() {
+    return num_grams * (sizeof(uint64_t) + sizeof(uint32_t)) +
+           num_postings * sizeof(uint16_t) +
+           (hit_counts ? indexed_rules * 2 * sizeof(uint16_t) : 0);
+}
+
+bool SimpleResponder::buildGramIndex() {
+    freeGramIndex();
+    
+    // (n-gram, ルール) の組を集めてキー順に並べる
+    std::vector<std::pair<uint64_t, uint16_t>> pairs;
+    for (int i = 0; i < indexed_rules; i++) {
+        int n = extractGrams(rule(i).pattern, scratch_grams, MAX_QUERY_GRAMS, false);
+        for (int g = 0; g < n; g++) {
+            pairs.push_back(std::make_pair(scratch_grams[g], (uint16_t)i));
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    
+    int keys = 0;
+    for (size_t j = 0; j < pairs.size(); j++) {
+        if (j == 0 || pairs[j].first != pairs[j - 1].first) {
+            keys++;
+        }
+    }
+    
+    gram_keys = (uint64_t*)allocRuleMemory((keys ? keys : 1) * sizeof(uint64_t));
+    gram_offsets = (uint32_t*)allocRuleMemory((keys + 1) * sizeof(uint32_t));
+    postings = (uint16_t*)allocRuleMemory((pairs.empty() ? 1 : pairs.size()) * sizeof(uint16_t));
+    hit_counts = (uint16_t*)allocRuleMemory((indexed_rules ? indexed_rules : 1) * sizeof(uint16_t));
+    touched = (uint16_t*)allocRuleMemory((indexed_rules ? indexed_rules : 1) * sizeof(uint16_t));
+    if (!gram_keys || !gram_offsets || !postings || !hit_counts || !touched) {
+        freeGramIndex();
+        return false;
+    }
+    memset(hit_counts, 0, (indexed_rules ? indexed_rules : 1) * sizeof(uint16_t));
+    
+    int k = -1;
+    for (size_t j = 0; j < pairs.size(); j++) {
+        if (j == 0 || pairs[j].first != pairs[j - 1].first) {
+            k++;
+            gram_keys[k] = pairs[j].first;
+            gram_offsets[k] = (uint32_t)j;
+        }
+        postings[j] = pairs[j].second;
+    }
+    gram_offsets[keys] = (uint32_t)pairs.size();
+    
+    num_grams = keys;
+    num_postings = pairs.size();
+    return true;
+}
+
+bool SimpleResponder::loadRulesFromSPIFFS(const char* path) {
+    if (!SPIFFS.begin(false)) {
+        Serial.println("SPIFFS初期化失敗");
+        return false;
+    }
+    
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) {
+        Serial.printf("ルールファイルが開けません: %s\n", path);
+        return false;
+    }
+    
+    bool ok = loadRules(file);
+    file.close();
+    return ok;
+}
+
+bool SimpleResponder::loadRulesFromSD(const char* path) {
+    if (!SD.begin()) {
+        Serial.println("SDカード初期化失敗");
+        return false;
+    }
+    
+    File file = SD.open(path, FILE_READ);
+    if (!file) {
+        Serial.printf("ルールファイルが開けません: %s\n", path);
+        return false;
+    }
+    
+    bool ok = loadRules(file);
+    file.close();
+    return ok;
+}
+
+bool SimpleResponder::loadRules(File& file) {
+    ResponderLock guard(lock);
+    
+    uint32_t start = millis();
+    int before = num_rules;
+    size_t mem_before = getMemoryUsage();
+    
+    // 先頭4バイトで形式を判定
+    char magic[4];
+    bool ok;
+    if (file.read((uint8_t*)magic, 4) == 4 && memcmp(magic, RULE_DB_MAGIC, 4) == 0) {
+        ok = loadBinary(file);
+    } else {
+        file.seek(0);
+        ok = loadJsonLines(file);
+    }
+    
+    compile();
+    
+    // 埋め込みモードなら追加分も含めて意図ベクトルを作り直す
+    if (embedder) {
+        buildIntentVectors();
+    }
+    
+    int added = num_rules - before;
+    size_t mem_added = getMemoryUsage() - mem_before;
+    Serial.printf("ルール読み込み: %d件 (%dms, %d bytes/ルール)\n",
+                  added, (int)(millis() - start),
+                  added > 0 ? (int)(mem_added / added) : 0);
+    return ok;
+}
+
+bool SimpleResponder::loadBinary(File& file) {
+    uint8_t header[8];
+    if (file.read(header, sizeof(header)) != sizeof(header)) {
+        return false;
+    }
+    
+    uint16_t version = header[0] | (header[1] << 8);
+    uint32_t count = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+    if (version != RULE_DB_VERSION) {
+        Serial.printf("ルールDB: 未対応のバージョン %d\n", version);
+        return false;
+    }
+    
+    char pattern[256];
+    char response[1024];
+    int errors = 0;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t len8;
+        uint8_t len16[2];
+        uint8_t prio[2];
+        
+        if (file.read(&len8, 1) != 1) return false;
+        size_t plen = len8;
+        if (file.read((uint8_t*)pattern, plen) != plen) return false;
+        
+        if (file.read(len16, 2) != 2) return false;
+        size_t rlen = len16[0] | (len16[1] << 8);
+        bool too_long = rlen >= sizeof(response);
+        if (too_long) {
+            file.seek(file.position() + rlen);
+        } else if (file.read((uint8_t*)response, rlen) != rlen) {
+            return false;
+        }
+        
+        if (file.read(prio, 2) != 2) return false;
+        float priority = (prio[0] | (prio[1] << 8)) / 1000.0f;
+        
+        // 空のパターンと長すぎる応答はそのレコードだけ読み飛ばす
+        if (plen == 0 || too_long) {
+            errors++;
+            continue;
+        }
+        if (!appendRule(pattern, plen, response, rlen, priority)) {
+            Serial.println("ルールDB: 容量不足");
+            return false;
+        }
+    }
+    
+    if (errors > 0) {
+        Serial.printf("ルールDB: %d件を読み飛ばしました\n", errors);
+    }
+    return true;
+}
+
+bool SimpleResponder::loadJsonLines(File& file) {
+    StaticJsonDocument<1024> doc;
+    int errors = 0;
+    
+    while (file.available()) {
+        DeserializationError err = deserializeJson(doc, file);
+        if (err == DeserializationError::EmptyInput) {
+            break;
+        }
+        if (err) {
+            // 壊れた行は読み飛ばす
+            errors++;
+            file.readStringUntil('\n');
+            continue;
+        }
+        
+        const char* p = doc["p"];
+        const char* r = doc["r"];
+        float w = doc["w"] | 1.0f;
+        if (!p || !r || p[0] == '\0') {
+            errors++;
+            continue;
+        }
+        
+        if (!appendRule(p, strlen(p), r, strlen(r), w)) {
+            Serial.println("ルールDB: 容量不足");
+            return false;
+        }
+    }
+    
+    if (errors > 0) {
+        Serial.printf("ルールDB: %d行を読み飛ばしました\n", errors);
+    }
+    return true;
+}
+
+size_t SimpleResponder::getMemoryUsage() {
+    size_t chunk_bytes = 0;
+    for (int i = 0; i < MAX_RULE_CHUNKS && chunks[i]; i++) {
+        chunk_bytes += RULE_CHUNK_SIZE * sizeof(Rule);
+    }
+    size_t intent_bytes = (size_t)num_intents * (intent_dim + sizeof(uint16_t) + sizeof(float));
+    return chunk_bytes + arena_total + matcher.getMemoryUsage() + gramIndexBytes() + intent_bytes;
+}
+
+void SimpleResponder::printStats() {
+    ResponderLock guard(lock);
+    
+    size_t total = getMemoryUsage();
+    Serial.printf("ルールDB: %dルール (索引済み %d), 文字列 %d bytes, 索引 %d + %d bytes, 合計 %d bytes (%d bytes/ルール)\n",
+                  num_rules, indexed_rules, (int)arena_total,
+                  (int)matcher.getMemoryUsage(), (int)gramIndexBytes(), (int)total,
+                  num_rules > 0 ? (int)(total / num_rules) : 0);
+}
+
+struct RuleMatchContext {
+    SimpleResponder* self;
+    int best_idx;
+    float best_score;
+};
+
+void SimpleResponder::onMatch(uint16_t rule_id, void* ctx) {
+    RuleMatchContext* m = (RuleMatchContext*)ctx;
+    
+    // 完全一致のスコアは1.0 × 優先度 (同点なら先に定義されたルール)
+    float score = m->self->rule(rule_id).priority;
+    if (score > m->best_score || (score == m->best_score && (int)rule_id < m->best_idx)) {
+        m->best_score = score;
+        m->best_idx = rule_id;
+    }
+}
+
+int SimpleResponder::findBestRule(const String& input, float* best_score) {
+    // 1パスで入力に含まれる索引済みパターンを列挙
+    RuleMatchContext m = {this, -1, 0.0f};
+    matcher.match(input.c_str(), onMatch, &m);
+    
+    String input_lower = input;
+    input_lower.toLowerCase();
+    
+    // 索引にまだ入っていないルールは線形に照合
+    for (int i = indexed_rules; i < num_rules; i++) {
+        if (strstr(input_lower.c_str(), rule(i).pattern)) {
+            onMatch((uint16_t)i, &m);
+        }
+    }
+    
+    if ((m.best_idx < 0 || m.best_score <= 0.3f) && isEmbeddingEnabled()) {
+        // 言い換えは意図ベクトルの最近傍で拾う
+        float similarity;
+        int idx = nearestIntent(input, &similarity);
+        if (idx >= 0 && similarity >= intent_threshold) {
+            float score = similarity * rule(idx).priority;
+            if (score > m.best_score) {
+                m.best_score = score;
+                m.best_idx = idx;
+            }
+        }
+    }
+    
+    if (m.best_idx < 0 || m.best_score <= 0.3f) {
+        // 完全一致がなければ部分マッチで探す
+        Candidate c;
+        if (scoreCandidates(input, &c, 1) > 0 && c.score > m.best_score) {
+            m.best_score = c.score;
+            m.best_idx = c.rule;
+        }
+    }
+    
+    *best_score = m.best_score;
+    return m.best_idx;
+}
+
+String SimpleResponder::respond(const String& input) {
+    ResponderLock guard(lock);
+    indexPendingRules();
+    
+    float best_score = 0.0f;
+    int best_idx = findBestRule(input, &best_score);
+    
+    if (best_idx >= 0 && best_score > 0.3f) {
+        return rule(best_idx).response;
+    }
+    
+    // デフォルト応答
+    static const char* defaults[] = {
+        "ふむふむ、なるほどね! 😊",
+        "へー、それで? 🤔",
+        "わかったよ! ✨",
+        "そうなんだ! 面白いね! 🌟",
+        "もっと教えて! 👂"
+    };
+    
+    return defaults[random(5)];
+}
+
+// UTF-8を1コードポイント読む (ASCIIは小文字化, 不正なバイトはそのまま)
+static uint32_t decodeUtf8(const uint8_t*& p) {
+    uint8_t c = *p++;
+    if (c < 0x80) {
+        return PatternMatcher::foldCase(c);
+    }
+    
+    uint32_t cp;
+    int extra;
+    if ((c & 0xE0) == 0xC0) {
+        cp = c & 0x1F;
+        extra = 1;
+    } else if ((c & 0xF0) == 0xE0) {
+        cp = c & 0x0F;
+        extra = 2;
+    } else if ((c & 0xF8) == 0xF0) {
+        cp = c & 0x07;
+        extra = 3;
+    } else {
+        return c;
+    }
+    
+    for (; extra > 0 && (*p & 0xC0) == 0x80; extra--) {
+        cp = (cp << 6) | (*p++ & 0x3F);
+    }
+    return cp;
+}
+
+int SimpleResponder::extractGrams(const char* text, uint64_t* out, int max, bool for_query) {
+    int n = 0;
+    int chars = 0;
+    uint32_t prev = 0;
+    const uint8_t* p = (const uint8_t*)text;
+    
+    // キー: 上位32bit = 1文字目, 下位32bit = 2文字目 (1文字のキーは0)
+    while (*p && n < max) {
+        uint32_t cp = decodeUtf8(p);
+        if (for_query) {
+            out[n++] = (uint64_t)cp << 32;
+        }
+        if (chars > 0 && n < max) {
+            out[n++] = ((uint64_t)prev << 32) | cp;
+        }
+        prev = cp;
+        chars++;
+    }
+    
+    if (!for_query && chars == 1) {
+        out[n++] = (uint64_t)prev << 32;
+    }
+    
+    std::sort(out, out + n);
+    return (int)(std::unique(out, out + n) - out);
+}
+
+int SimpleResponder::lookupGram(uint64_t key) {
+    int lo = 0;
+    int hi = num_grams - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) >> 1;
+        if (gram_keys[mid] == key) {
+            return mid;
+        }
+        if (gram_keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+// スコア降順 (同点なら先に定義されたルール) で上位k件を保持
+static void insertCandidate(SimpleResponder::Candidate* out, int* count, int k,
+                            int rule, float score) {
+    int pos = *count;
+    while (pos > 0 && (score > out[pos - 1].score ||
+                       (score == out[pos - 1].score && rule < out[pos - 1].rule))) {
+        pos--;
+    }
+    if (pos >= k) {
+        return;
+    }
+    
+    int last = (*count < k) ? *count : k - 1;
+    for (int i = last; i > pos; i--) {
+        out[i] = out[i - 1];
+    }
+    out[pos].rule = rule;
+    out[pos].score = score;
+    if (*count < k) {
+        (*count)++;
+    }
+}
+
+int SimpleResponder::scoreCandidates(const String& input, Candidate* out, int k) {
+    int q = extractGrams(input.c_str(), query_grams, MAX_QUERY_GRAMS, true);
+    int count = 0;
+    
+    // 索引済みルール: 入力のn-gramごとに転置リストをたどって共通数を数える
+    if (hit_counts) {
+        int num_touched = 0;
+        for (int g = 0; g < q; g++) {
+            int idx = lookupGram(query_grams[g]);
+            if (idx < 0) {
+                continue;
+            }
+            for (uint32_t j = gram_offsets[idx]; j < gram_offsets[idx + 1]; j++) {
+                uint16_t r = postings[j];
+                if (hit_counts[r]++ == 0) {
+                    touched[num_touched++] = r;
+                }
+            }
+        }
+        
+        for (int t = 0; t < num_touched; t++) {
+            uint16_t r = touched[t];
+            const Rule& rl = rule(r);
+            float score = (float)hit_counts[r] / (float)rl.gram_count * 0.5f * rl.priority;
+            hit_counts[r] = 0;
+            insertCandidate(out, &count, k, r, score);
+        }
+    }
+    
+    // 未索引のルールはソート済みn-gramを突き合わせる
+    for (int i = indexed_rules; i < num_rules; i++) {
+        int n = extractGrams(rule(i).pattern, scratch_grams, MAX_QUERY_GRAMS, false);
+        int shared = 0;
+        for (int a = 0, b = 0; a < q && b < n; ) {
+            if (query_grams[a] == scratch_grams[b]) {
+                shared++;
+                a++;
+                b++;
+            } else if (query_grams[a] < scratch_grams[b]) {
+                a++;
+            } else {
+                b++;
+            }
+        }
+        if (shared > 0) {
+            const Rule& rl = rule(i);
+            insertCandidate(out, &count, k, i, (float)shared / (float)rl.gram_count * 0.5f * rl.priority);
+        }
+    }
+    
+    return count;
+}
+
+int SimpleResponder::findCandidates(const String& input, Candidate* out, int k) {
+    ResponderLock guard(lock);
+    indexPendingRules();
+    return scoreCandidates(input, out, k);
+}
+
+const char* SimpleResponder::getRuleResponse(int rule_index) {
+    if (rule_index < 0 || rule_index >= num_rules) {
+        return nullptr;
+    }
+    return rule(rule_index).response;
+}
+
+bool SimpleResponder::enableEmbedding(TinyLLM* llm, const char* vectors_path) {
+    ResponderLock guard(lock);
+    
+    if (!llm || !llm->isModelLoaded()) {
+        Serial.println("埋め込みモード: TinyLLMのモデルが読み込まれていません");
+        return false;
+    }
+    embedder = llm;
+    
+    uint32_t start = millis();
+    if (vectors_path && loadIntentVectors(vectors_path)) {
+        Serial.printf("意図ベクトル読み込み: %d件 (%dms)\n", num_intents, (int)(millis() - start));
+        return true;
+    }
+    
+    // ファイルがなければ全ルールのパターンから計算して保存
+    if (!buildIntentVectors()) {
+        embedder = nullptr;
+        return false;
+    }
+    Serial.printf("意図ベクトル計算: %d件 (%dms)\n", num_intents, (int)(millis() - start));
+    
+    if (vectors_path && !saveIntentVectors(vectors_path)) {
+        Serial.println("意図ベクトルの保存に失敗しました");
+    }
+    return true;
+}
+
+void SimpleResponder::disableEmbedding() {
+    ResponderLock guard(lock);
+    embedder = nullptr;
+    freeIntents();
+}
+
+bool SimpleResponder::allocIntents(int count, int dim) {
+    freeIntents();
+    
+    int n = count ? count : 1;
+    intent_vectors = (int8_t*)allocRuleMemory((size_t)n * dim);
+    intent_rules = (uint16_t*)allocRuleMemory(n * sizeof(uint16_t));
+    intent_inv_norms = (float*)allocRuleMemory(n * sizeof(float));
+    if (!intent_vectors || !intent_rules || !intent_inv_norms) {
+        Serial.println("意図ベクトル: メモリ割り当て失敗");
+        freeIntents();
+        return false;
+    }
+    intent_dim = dim;
+    return true;
+}
+
+void SimpleResponder::freeIntents() {
+    if (intent_vectors) free(intent_vectors);
+    if (intent_rules) free(intent_rules);
+    if (intent_inv_norms) free(intent_inv_norms);
+    intent_vectors = nullptr;
+    intent_rules = nullptr;
+    intent_inv_norms = nullptr;
+    num_intents = 0;
+    intent_dim = 0;
+}
+
+void SimpleResponder::finishIntent(int i) {
+    const int8_t* v = intent_vectors + (size_t)i * intent_dim;
+    int32_t sq = dotInt8(v, v, intent_dim);
+    intent_inv_norms[i] = sq > 0 ? 1.0f / sqrtf((float)sq) : 0.0f;
+}
+
+bool SimpleResponder::buildIntentVectors() {
+    if (!allocIntents(num_rules, EMBED_DIM)) {
+        return false;
+    }
+    
+    for (int i = 0; i < num_rules; i++) {
+        int8_t* v = intent_vectors + (size_t)num_intents * intent_dim;
+        if (!embedder->embed(rule(i).pattern, v)) {
+            continue;
+        }
+        intent_rules[num_intents] = (uint16_t)i;
+        finishIntent(num_intents);
+        num_intents++;
+    }
+    return num_intents > 0;
+}
+
+bool SimpleResponder::saveIntentVectors(const char* path) {
+    if (!SPIFFS.begin(false)) {
+        return false;
+    }
+    
+    File file = SPIFFS.open(path, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    
+    uint8_t header[12];
+    memcpy(header, INTENT_DB_MAGIC, 4);
+    header[4] = INTENT_DB_VERSION & 0xFF;
+    header[5] = INTENT_DB_VERSION >> 8;
+    header[6] = intent_dim & 0xFF;
+    header[7] = intent_dim >> 8;
+    for (int b = 0; b < 4; b++) {
+        header[8 + b] = (uint8_t)((uint32_t)num_intents >> (8 * b));
+    }
+    bool ok = file.write(header, sizeof(header)) == sizeof(header);
+    
+    for (int i = 0; ok && i < num_intents; i++) {
+        const char* pattern = rule(intent_rules[i]).pattern;
+        uint8_t plen = (uint8_t)strlen(pattern);
+        ok = file.write(&plen, 1) == 1 &&
+             file.write((const uint8_t*)pattern, plen) == plen &&
+             file.write((const uint8_t*)(intent_vectors + (size_t)i * intent_dim), intent_dim) == (size_t)intent_dim;
+    }
+    
+    file.close();
+    return ok;
+}
+
+bool SimpleResponder::loadIntentVectors(const char* path) {
+    if (!SPIFFS.begin(false) || !SPIFFS.exists(path)) {
+        return false;
+    }
+    
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    
+    uint8_t header[12];
+    if (file.read(header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, INTENT_DB_MAGIC, 4) != 0) {
+        file.close();
+        return false;
+    }
+    uint16_t version = header[4] | (header[5] << 8);
+    uint16_t dim = header[6] | (header[7] << 8);
+    uint32_t count = header[8] | (header[9] << 8) | (header[10] << 16) | ((uint32_t)header[11] << 24);
+    if (version != INTENT_DB_VERSION || dim != EMBED_DIM || count > (uint32_t)num_rules) {
+        Serial.println("意図ベクトル: 形式が一致しません");
+        file.close();
+        return false;
+    }
+    
+    // パターン → ルール番号を二分探索するための索引
+    std::vector<uint16_t> order(num_rules);
+    for (int i = 0; i < num_rules; i++) {
+        order[i] = (uint16_t)i;
+    }
+    std::sort(order.begin(), order.end(), [this](uint16_t a, uint16_t b) {
+        return strcmp(rule(a).pattern, rule(b).pattern) < 0;
+    });
+    
+    if (!allocIntents(count, dim)) {
+        file.close();
+        return false;
+    }
+    
+    char pattern[256];
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t plen;
+        int8_t* v = intent_vectors + (size_t)num_intents * intent_dim;
+        if (file.read(&plen, 1) != 1 ||
+            file.read((uint8_t*)pattern, plen) != plen ||
+            file.read((uint8_t*)v, dim) != dim) {
+            break;
+        }
+        pattern[plen] = '\0';
+        
+        auto it = std::lower_bound(order.begin(), order.end(), pattern,
+            [this](uint16_t a, const char* p) { return strcmp(rule(a).pattern, p) < 0; });
+        if (it == order.end() || strcmp(rule(*it).pattern, pattern) != 0) {
+            continue;  // 今のルールDBにないパターン
+        }
+        
+        intent_rules[num_intents] = *it;
+        finishIntent(num_intents);
+        num_intents++;
+    }
+    
+    file.close();
+    return num_intents > 0;
+}
+
+int32_t SimpleResponder::dotInt8(const int8_t* a, const int8_t* b, int n) {
+    int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        s0 += a[i] * b[i];
+    }
+    return s0 + s1 + s2 + s3;
+}
+
+int SimpleResponder::nearestIntent(const String& input, float* similarity) {
+    int8_t q[EMBED_DIM];
+    *similarity = 0.0f;
+    if (!embedder || num_intents == 0 || intent_dim != EMBED_DIM ||
+        !embedder->embed(input.c_str(), q)) {
+        return -1;
+    }
+    
+    int32_t qq = dotInt8(q, q, intent_dim);
+    if (qq <= 0) {
+        return -1;
+    }
+    
+    // 全ベクトルとの内積 (int8 × int8 → int32) で最近傍を探す
+    int best = -1;
+    float best_sim = -1.0f;
+    const int8_t* v = intent_vectors;
+    for (int i = 0; i < num_intents; i++, v += intent_dim) {
+        float sim = (float)dotInt8(q, v, intent_dim) * intent_inv_norms[i];
+        if (sim > best_sim) {
+            best_sim = sim;
+            best = i;
+        }
+    }
+    
+    *similarity = best_sim / sqrtf((float)qq);
+    return best >= 0 ? intent_rules[best] : -1;
+}
+
+void SimpleResponder::benchmark(int iterations) {
+    static const char* queries[] = {
+        "こんにちは! 今日も元気?",
+        "ねえ、名前を教えて",
+        "Hello there, how are you?",
+        "今日は雨で疲れたよ",
+        "特に意味のない長めの入力文字列でどのルールにも当たらない場合"
+    };
+    const int num_queries = sizeof(queries) / sizeof(queries[0]);
+    
+    String inputs[num_queries];
+    for (int q = 0; q < num_queries; q++) {
+        inputs[q] = queries[q];
+    }
+    
+    float score;
+    uint32_t start = micros();
+    {
+        ResponderLock guard(lock);
+        for (int i = 0; i < iterations; i++) {
+            findBestRule(inputs[i % num_queries], &score);
+        }
+    }
+    uint32_t elapsed = micros() - start;
+    
+    Serial.printf("ルール照合: %dルール, %.2f us/クエリ\n",
+                  num_rules, (float)elapsed / iterations);
+    
+    // 部分一致の精度 (表記ゆれ・崩した言い方の日本語コーパス)
+    static const struct {
+        const char* query;
+        const char* expected;   // 期待するルールのパターン
+    } fuzzy_cases[] = {
+        {"こんにちわー", "こんにちは"},
+        {"こんばんわ", "こんばんは"},
+        {"おはよー", "おはよう"},
+        {"ありがとね", "ありがとう"},
+        {"すいません", "すみません"},
+        {"かわいーね", "かわいい"},
+        {"すごーい", "すごい"},
+        {"バイバーイ", "バイバイ"},
+        {"さよならー", "さようなら"},
+        {"Helo!", "hello"}
+    };
+    const int num_cases = sizeof(fuzzy_cases) / sizeof(fuzzy_cases[0]);
+    
+    int top1 = 0;
+    int topk = 0;
+    Candidate cand[RULE_TOP_K];
+    uint32_t fuzzy_us = 0;
+    {
+        ResponderLock guard(lock);
+        for (int c = 0; c < num_cases; c++) {
+            String q = fuzzy_cases[c].query;
+            uint32_t t0 = micros();
+            int n = scoreCandidates(q, cand, RULE_TOP_K);
+            fuzzy_us += micros() - t0;
+            
+            for (int j = 0; j < n; j++) {
+                if (strcmp(rule(cand[j].rule).pattern, fuzzy_cases[c].expected) == 0) {
+                    if (j == 0) top1++;
+                    topk++;
+                    break;
+                }
+            }
+        }
+    }
+    
+    Serial.printf("部分一致: top1 %d/%d, top%d %d/%d, %.2f us/クエリ\n",
+                  top1, num_cases, RULE_TOP_K, topk, num_cases,
+                  (float)fuzzy_us / num_cases);
+    
+    if (isEmbeddingEnabled()) {
+        float sim;
+        uint32_t embed_us = 0;
+        {
+            ResponderLock guard(lock);
+            for (int c = 0; c < num_cases; c++) {
+                String q = fuzzy_cases[c].query;
+                uint32_t t0 = micros();
+                nearestIntent(q, &sim);
+                embed_us += micros() - t0;
+            }
+        }
+        Serial.printf("意図ベクトル: %d件 x %d次元, %.2f us/クエリ\n",
+                      num_intents, intent_dim, (float)embed_us / num_cases);
+    }
+}
+
+static void countMatch(uint16_t, void* ctx) {
+    (*(uint32_t*)ctx)++;
+}
+
+void SimpleResponder::benchmarkScaling(int num_patterns, int iterations) {
+    // 合成パターン (日本語 + 英数字) でオートマトン単体の速度を測る
+    PatternMatcher m;
+    char pattern[32];
+    
+    uint32_t build_start = micros();
+    for (int i = 0; i < num_patterns; i++) {
+        snprintf(pattern, sizeof(pattern), "%sword%d",
+                 (i % 3 == 0) ? "ねこ" : (i % 3 == 1) ? "いぬ" : "", i);
+        m.addPattern(pattern, (uint16_t)i);
+    }
+    m.build();
+    uint32_t build_us = micros() - build_start;
+    
+    const char* query = "今日はねこword42といぬword1337と遊んだよ! Word999もいたね";
+    uint32_t hits = 0;
+    
+    uint32_t start = micros();
+    for (int i = 0; i < iterations; i++) {
+        m.match(query, countMatch, &hits);
+    }
+    uint32_t elapsed = micros() - start;
+    
+    Serial.printf("オートマトン: %dパターン, %d状態, %d bytes, 構築 %dms, %.2f us/クエリ (%u hits)\n",
+                  num_patterns, m.getStateCount(), (int)m.getMemoryUsage(),
+                  (int)(build_us / 1000), (float)elapsed / iterations,
+                  hits / (iterations ? iterations : 1));
+    
+    // 合成のかなパターンで部分一致 (n-gram索引) の速度を測る
+    static const char* kana[] = {
+        "あ", "い", "う", "え", "お", "か", "き", "く", "け", "こ",
+        "さ", "し", "す", "せ", "そ", "た", "ち", "つ", "て", "と",
+        "な", "に", "ぬ", "ね", "の", "は", "ひ", "ふ", "へ", "ほ"
+    };
+    const int num_kana = sizeof(kana) / sizeof(kana[0]);
+    
+    SimpleResponder* r = new SimpleResponder();
+    uint32_t seed = 12345;
+    for (int i = 0; i < num_patterns; i++) {
+        char buf[32] = "";
+        int len = 2 + (i % 4);
+        for (int j = 0; j < len; j++) {
+            seed = seed * 1103515245 + 12345;
+            strlcat(buf, kana[(seed >> 16) % num_kana], sizeof(buf));
+        }
+        r->appendRule(buf, strlen(buf), "ok", 2, 1.0f);
+    }
+    r->compile();
+    
+    String fuzzy_query = "きょうはあたたかくてさんぽにいきたいなとおもったのでこうえんにいったよ";
+    Candidate cand[RULE_TOP_K];
+    int found = 0;
+    
+    start = micros();
+    for (int i = 0; i < iterations; i++) {
+        found = r->scoreCandidates(fuzzy_query, cand, RULE_TOP_K);
+    }
+    elapsed = micros() - start;
+    
+    Serial.printf("n-gram索引: %dパターン, %d n-gram, %d bytes, %.2f us/クエリ (上位%d件, 最高 %.2f)\n",
+                  num_patterns, r->num_grams, (int)r->gramIndexBytes(),
+                  (float)elapsed / iterations, found, found > 0 ? cand[0].score : 0.0f);
+    delete r;
+}
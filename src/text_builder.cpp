@@ -0,0 +1,117 @@
+#include "text_builder.h"
+
+TextBuilder::TextBuilder() {
+    buffer = nullptr;
+    capacity = 0;
+    len = 0;
+    overflow = false;
+}
+
+TextBuilder::~TextBuilder() {
+    if (buffer) {
+        free(buffer);
+    }
+}
+
+bool TextBuilder::init(size_t size) {
+    if (buffer) {
+        free(buffer);
+        buffer = nullptr;
+    }
+
+    if (psramFound()) {
+        buffer = (char*)ps_malloc(size);
+    }
+    if (!buffer) {
+        buffer = (char*)malloc(size);
+    }
+    if (!buffer) {
+        capacity = 0;
+        return false;
+    }
+
+    capacity = size;
+    clear();
+    return true;
+}
+
+void TextBuilder::clear() {
+    len = 0;
+    overflow = false;
+    if (buffer) {
+        buffer[0] = '\0';
+    }
+}
+
+TextBuilder& TextBuilder::append(const char* text, size_t n) {
+    if (!buffer) {
+        overflow = true;
+        return *this;
+    }
+
+    if (len + n >= capacity) {
+        n = capacity - 1 - len;
+        // 文字の途中で切らない
+        while (n > 0 && ((uint8_t)text[n] & 0xC0) == 0x80) {
+            n--;
+        }
+        overflow = true;
+    }
+
+    memcpy(buffer + len, text, n);
+    len += n;
+    buffer[len] = '\0';
+    return *this;
+}
+
+TextBuilder& TextBuilder::append(const char* text) {
+    return append(text, strlen(text));
+}
+
+TextBuilder& TextBuilder::append(char c) {
+    return append(&c, 1);
+}
+
+TextBuilder& TextBuilder::appendInt(int32_t value) {
+    char tmp[12];
+    int n = snprintf(tmp, sizeof(tmp), "%ld", (long)value);
+    return append(tmp, n);
+}
+
+TextBuilder& TextBuilder::appendJsonEscaped(const char* text) {
+    const char* run = text;   // エスケープ不要な連続区間の先頭
+
+    for (const char* p = text; *p; p++) {
+        uint8_t c = (uint8_t)*p;
+        const char* esc = nullptr;
+        char ctrl[7];
+
+        switch (c) {
+            case '"':  esc = "\\\""; break;
+            case '\\': esc = "\\\\"; break;
+            case '\n': esc = "\\n";  break;
+            case '\r': esc = "\\r";  break;
+            case '\t': esc = "\\t";  break;
+            default:
+                if (c < 0x20) {
+                    snprintf(ctrl, sizeof(ctrl), "\\u%04x", c);
+                    esc = ctrl;
+                }
+                break;
+        }
+
+        if (esc) {
+            append(run, p - run);
+            append(esc);
+            run = p + 1;
+        }
+    }
+
+    return append(run);
+}
+
+TextBuilder& TextBuilder::appendJsonString(const char* text) {
+    append('"');
+    appendJsonEscaped(text);
+    return append('"');
+}
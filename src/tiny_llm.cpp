@@ -1,4 +1,5 @@
 #include "tiny_llm.h"
+#include "trace.h"
 #include <math.h>
 
 TinyLLM::TinyLLM() {
@@ -8,9 +9,14 @@ TinyLLM::TinyLLM() {
     attention_output = nullptr;
     token_ids = nullptr;
     kv_cache = nullptr;
+    allocated_bytes = 0;
     model_loaded = false;
     vocab_size = VOCAB_SIZE;
     cache_length = 0;
+    abort_requested = false;
+    deadline_at = 0;
+    token_fn = nullptr;
+    token_ctx = nullptr;
 }
 
 TinyLLM::~TinyLLM() {
@@ -39,49 +45,61 @@ bool TinyLLM::init() {
     return true;
 }
 
+void* TinyLLM::allocPSRAM(size_t size) {
+    void* p = ps_malloc(size);
+    if (p) {
+        allocated_bytes += size;
+    }
+    return p;
+}
+
 bool TinyLLM::allocateMemory() {
     // PSRAM上にメモリを確保
     
-    // モデルウェイト構造体
-    weights = (ModelWeights*)ps_malloc(sizeof(ModelWeights));
+    // モデルウェイト構造体 (途中で失敗しても freeMemory() できるようにゼロ埋め)
+    weights = (ModelWeights*)allocPSRAM(sizeof(ModelWeights));
     if (!weights) return false;
+    memset(weights, 0, sizeof(ModelWeights));
     
     // 埋め込み層 (2MB程度)
     size_t embed_size = VOCAB_SIZE * EMBED_DIM * sizeof(int8_t);
-    weights->token_embeddings = (int8_t*)ps_malloc(embed_size);
+    weights->token_embeddings = (int8_t*)allocPSRAM(embed_size);
     if (!weights->token_embeddings) return false;
     
     // アテンション重み (1MB程度)
     size_t attn_size = NUM_LAYERS * HIDDEN_DIM * HIDDEN_DIM * sizeof(int8_t);
-    weights->attention_weights = (int8_t*)ps_malloc(attn_size);
+    weights->attention_weights = (int8_t*)allocPSRAM(attn_size);
     if (!weights->attention_weights) return false;
     
     // FFN重み (1MB程度)
-    weights->ffn_weights = (int8_t*)ps_malloc(attn_size);
+    weights->ffn_weights = (int8_t*)allocPSRAM(attn_size);
     if (!weights->ffn_weights) return false;
     
     // 出力層 (256KB程度)
     size_t output_size = HIDDEN_DIM * VOCAB_SIZE * sizeof(int8_t);
-    weights->output_weights = (int8_t*)ps_malloc(output_size);
+    weights->output_weights = (int8_t*)allocPSRAM(output_size);
     if (!weights->output_weights) return false;
     
     // スケール・バイアス
-    weights->scales = (float*)ps_malloc(1024 * sizeof(float));
-    weights->biases = (float*)ps_malloc(1024 * sizeof(float));
+    weights->scales = (float*)allocPSRAM(1024 * sizeof(float));
+    weights->biases = (float*)allocPSRAM(1024 * sizeof(float));
     
     // 推論バッファ
-    hidden_states = (float*)ps_malloc(HIDDEN_DIM * sizeof(float));
-    attention_output = (float*)ps_malloc(HIDDEN_DIM * sizeof(float));
-    token_ids = (int16_t*)ps_malloc(MAX_SEQ_LENGTH * sizeof(int16_t));
+    hidden_states = (float*)allocPSRAM(HIDDEN_DIM * sizeof(float));
+    attention_output = (float*)allocPSRAM(HIDDEN_DIM * sizeof(float));
+    token_ids = (int16_t*)allocPSRAM(MAX_SEQ_LENGTH * sizeof(int16_t));
     
     // KVキャッシュ
     size_t kv_size = NUM_LAYERS * MAX_SEQ_LENGTH * HIDDEN_DIM * 2 * sizeof(float);
-    kv_cache = (float*)ps_malloc(kv_size);
+    kv_cache = (float*)allocPSRAM(kv_size);
     
     // 語彙
     vocab = new String[VOCAB_SIZE];
     
-    Serial.printf("メモリ割り当て完了: ~%d MB\n", getMemoryUsage() / (1024*1024));
+    // プロンプト組み立て用
+    if (!prompt_builder.init(PROMPT_MAX_BYTES)) return false;
+    
+    Serial.printf("メモリ割り当て完了: %d KB\n", (int)(getMemoryUsage() / 1024));
     return true;
 }
 
@@ -101,6 +119,14 @@ void TinyLLM::freeMemory() {
     if (token_ids) free(token_ids);
     if (kv_cache) free(kv_cache);
     if (vocab) delete[] vocab;
+    
+    weights = nullptr;
+    hidden_states = nullptr;
+    attention_output = nullptr;
+    token_ids = nullptr;
+    kv_cache = nullptr;
+    vocab = nullptr;
+    allocated_bytes = 0;
 }
 
 bool TinyLLM::loadModelFromSD(const char* path) {
@@ -151,23 +177,36 @@ bool TinyLLM::loadModelFromSPIFFS(const char* path) {
     return true;
 }
 
-String TinyLLM::generate(const String& prompt, int max_tokens) {
+String TinyLLM::generate(const char* prompt, int max_tokens) {
     if (!model_loaded) {
         return "モデルが読み込まれていません";
     }
+    TRACE_SCOPE("llm_generate");
     
-    // トークン化
-    int token_length = 0;
-    int* tokens = tokenize(prompt, &token_length);
+    // トークン化 (事前確保済みのtoken_idsに直接書き込む)
+    int16_t* tokens = token_ids;
+    int token_length = tokenizeInto(prompt, tokens, MAX_SEQ_LENGTH);
     
     if (token_length == 0) {
         return "";
     }
     
-    String result = "";
+    String result;
+    result.reserve(max_tokens * 4);
+    // abort_requested はここでは下ろさない (LLMWorker がキャンセル判定の前に下ろす)。
+    // ここで下ろすと、取り出してから生成を始めるまでの cancelAll() が消えてしまう
     
     // 推論ループ
     for (int i = 0; i < max_tokens; i++) {
+        if (abort_requested) {
+            break;
+        }
+        if (deadline_at != 0 && (int32_t)(millis() - deadline_at) >= 0) {
+            break;
+        }
+        
+        TRACE_SCOPE_ARG("llm_token", i);
+        
         // 最後のトークンを処理
         int current_token = tokens[token_length - 1];
         
@@ -176,11 +215,13 @@ String TinyLLM::generate(const String& prompt, int max_tokens) {
         
         // 各層を通過
         for (int layer = 0; layer < NUM_LAYERS; layer++) {
+            TRACE_SCOPE_ARG("llm_layer", layer);
             attention(hidden_states, attention_output, layer);
             feedforward(attention_output, hidden_states, layer);
         }
         
         // 出力層でlogitsを計算
+        TRACE_BEGIN(logits_span, "llm_logits");
         float logits[VOCAB_SIZE];
         for (int j = 0; j < VOCAB_SIZE; j++) {
             logits[j] = 0.0f;
@@ -190,12 +231,19 @@ String TinyLLM::generate(const String& prompt, int max_tokens) {
             }
         }
         
+        TRACE_END(logits_span);
+        
         // サンプリング
+        TRACE_BEGIN(sample_span, "llm_sample");
         int next_token = sample(logits, VOCAB_SIZE, 0.8f);
+        TRACE_END(sample_span);
         
         // デコード
         if (next_token < vocab_size) {
             result += vocab[next_token];
+            if (token_fn) {
+                token_fn(token_ctx, vocab[next_token].c_str());
+            }
         }
         
         // 終了トークンチェック
@@ -209,18 +257,17 @@ String TinyLLM::generate(const String& prompt, int max_tokens) {
         }
     }
     
-    free(tokens);
     return result;
 }
 
 String TinyLLM::chat(const String& message, const String& context) {
-    String prompt = context;
-    if (prompt.length() > 0) {
-        prompt += "\n";
+    prompt_builder.clear();
+    if (context.length() > 0) {
+        prompt_builder.append(context).append('\n');
     }
-    prompt += "User: " + message + "\nAssistant: ";
+    prompt_builder.append("User: ").append(message).append("\nAssistant: ");
     
-    return generate(prompt, 50);
+    return generate(prompt_builder.c_str(), 50);
 }
 
 int* TinyLLM::tokenize(const String& text, int* length) {
@@ -238,6 +285,16 @@ int* TinyLLM::tokenize(const String& text, int* length) {
     return tokens;
 }
 
+int TinyLLM::tokenizeInto(const char* text, int16_t* out, int max_length) {
+    // tokenize()と同じ文字ベースのマッピング
+    // (バイトは符号なしで扱う: UTF-8の2バイト目以降が負にならないように)
+    int len = 0;
+    for (const uint8_t* p = (const uint8_t*)text; *p && len < max_length; p++) {
+        out[len++] = (int16_t)(*p % VOCAB_SIZE);
+    }
+    return len;
+}
+
 String TinyLLM::detokenize(int* tokens, int length) {
     String result = "";
     for (int i = 0; i < length; i++) {
@@ -257,6 +314,42 @@ void TinyLLM::embedding(int token_id, float* output) {
     }
 }
 
+bool TinyLLM::embed(const char* text, int8_t* out) {
+    if (!model_loaded || !text) {
+        return false;
+    }
+    
+    int16_t ids[MAX_SEQ_LENGTH];
+    int len = tokenizeInto(text, ids, MAX_SEQ_LENGTH);
+    if (len == 0) {
+        return false;
+    }
+    
+    // int8のまま合計 (全トークン共通のスケールなので平均は向きを変えない)
+    int32_t sum[EMBED_DIM];
+    memset(sum, 0, sizeof(sum));
+    for (int t = 0; t < len; t++) {
+        const int8_t* row = weights->token_embeddings + ids[t] * EMBED_DIM;
+        for (int i = 0; i < EMBED_DIM; i++) {
+            sum[i] += row[i];
+        }
+    }
+    
+    int32_t max_abs = 0;
+    for (int i = 0; i < EMBED_DIM; i++) {
+        int32_t a = sum[i] < 0 ? -sum[i] : sum[i];
+        if (a > max_abs) max_abs = a;
+    }
+    if (max_abs == 0) {
+        return false;
+    }
+    
+    for (int i = 0; i < EMBED_DIM; i++) {
+        out[i] = (int8_t)((sum[i] * 127) / max_abs);
+    }
+    return true;
+}
+
 void TinyLLM::attention(float* input, float* output, int layer) {
     // 簡易的なアテンション機構
     // 実際はマルチヘッドアテンションを実装すべき
@@ -334,15 +427,18 @@ void TinyLLM::clearCache() {
 }
 
 size_t TinyLLM::getMemoryUsage() {
-    size_t total = 0;
-    
-    total += VOCAB_SIZE * EMBED_DIM;  // embeddings
-    total += NUM_LAYERS * HIDDEN_DIM * HIDDEN_DIM * 2;  // attention + ffn
-    total += HIDDEN_DIM * VOCAB_SIZE;  // output
-    total += 2048 * sizeof(float);  // scales + biases
-    total += HIDDEN_DIM * 2 * sizeof(float);  // buffers
-    total += MAX_SEQ_LENGTH * sizeof(int16_t);  // tokens
-    total += NUM_LAYERS * MAX_SEQ_LENGTH * HIDDEN_DIM * 2 * sizeof(float);  // kv cache
+    // 実際に確保した量 (推定値ではなく)
+    size_t total = allocated_bytes + prompt_builder.getCapacity();
+    
+    // 語彙の文字列 (String本体 + 中身)
+    if (vocab) {
+        total += VOCAB_SIZE * sizeof(String);
+        for (int i = 0; i < VOCAB_SIZE; i++) {
+            if (vocab[i].length() > 0) {
+                total += vocab[i].length() + 1;
+            }
+        }
+    }
     
     return total;
 }
@@ -354,125 +450,3 @@ float TinyLLM::dequantize(int8_t value, float scale) {
 int8_t TinyLLM::quantize(float value, float scale) {
     return (int8_t)(value / scale);
 }
-
-// ===== SimpleResponder実装 =====
-
-SimpleResponder::SimpleResponder() {
-    rules = nullptr;
-    num_rules = 0;
-}
-
-SimpleResponder::~SimpleResponder() {
-    if (rules) delete[] rules;
-}
-
-void SimpleResponder::init() {
-    num_rules = 30;
-    rules = new Rule[num_rules];
-    
-    int idx = 0;
-    
-    // 挨拶
-    rules[idx++] = {"こんにちは", "やっほー! 元気だよ! 🎀", 1.0f};
-    rules[idx++] = {"おはよう", "おはよー! いい朝だね! ☀️", 1.0f};
-    rules[idx++] = {"こんばんは", "こんばんは! 今日はどうだった? 🌙", 1.0f};
-    rules[idx++] = {"hello", "Hello! Nice to meet you! 👋", 1.0f};
-    
-    // 感情
-    rules[idx++] = {"元気", "うん! とっても元気だよ! ✨", 1.0f};
-    rules[idx++] = {"嬉しい", "わーい! 一緒に嬉しいよ! 💕", 1.0f};
-    rules[idx++] = {"悲しい", "大丈夫だよ! そばにいるからね 🤗", 1.0f};
-    rules[idx++] = {"疲れ", "お疲れ様! ゆっくり休んでね 😊", 1.0f};
-    
-    // 質問応答
-    rules[idx++] = {"名前", "ぼくはカビちゃんだよ! 🌸", 1.0f};
-    rules[idx++] = {"誰", "かわいいキャラクターだよ! ピンク色なの! 💗", 1.0f};
-    rules[idx++] = {"何", "楽しくおしゃべりするのが好きなんだ! 🎵", 1.0f};
-    rules[idx++] = {"どこ", "この画面の中にいるよ! 👀", 1.0f};
-    
-    // 好き嫌い
-    rules[idx++] = {"好き", "わーい! ぼくも大好きだよ! 💖", 1.0f};
-    rules[idx++] = {"嫌い", "そっか... でも仲良くしてね 😢", 1.0f};
-    rules[idx++] = {"かわいい", "えへへ、ありがとう! (*´▽`*) 💗", 1.0f};
-    rules[idx++] = {"すごい", "そんなことないよー! 照れちゃう! ☺️", 1.0f};
-    
-    // アクション
-    rules[idx++] = {"遊", "遊ぼう遊ぼう! 何して遊ぶ? 🎮", 1.0f};
-    rules[idx++] = {"歌", "らんらんらーん♪ どう? 🎤", 1.0f};
-    rules[idx++] = {"踊", "くるくる~♪ 一緒に踊ろう! 💃", 1.0f};
-    rules[idx++] = {"食べ", "おいしいもの大好き! 何食べる? 🍰", 1.0f};
-    
-    // ありがとう・ごめんね
-    rules[idx++] = {"ありがとう", "どういたしまして! 💕", 1.0f};
-    rules[idx++] = {"ごめん", "気にしないで! 大丈夫だよ! 😊", 1.0f};
-    rules[idx++] = {"すみません", "いいのいいの! 気にしないでね! ✨", 1.0f};
-    
-    // 別れ
-    rules[idx++] = {"さようなら", "またね! バイバイ! 👋✨", 1.0f};
-    rules[idx++] = {"バイバイ", "またねー! 楽しかったよ! 💖", 1.0f};
-    rules[idx++] = {"おやすみ", "おやすみー! いい夢見てね! 🌟", 1.0f};
-    
-    // 天気
-    rules[idx++] = {"天気", "いい天気だといいね! ☀️", 1.0f};
-    rules[idx++] = {"雨", "雨かぁ... でも雨も好きだよ! ☔", 1.0f};
-    
-    // その他
-    rules[idx++] = {"時間", "今を楽しもう! ⏰", 1.0f};
-}
-
-String SimpleResponder::respond(const String& input) {
-    float best_score = 0.0f;
-    int best_idx = -1;
-    
-    for (int i = 0; i < num_rules; i++) {
-        float score = matchScore(input, rules[i].pattern);
-        score *= rules[i].priority;
-        
-        if (score > best_score) {
-            best_score = score;
-            best_idx = i;
-        }
-    }
-    
-    if (best_idx >= 0 && best_score > 0.3f) {
-        return rules[best_idx].response;
-    }
-    
-    // デフォルト応答
-    String defaults[] = {
-        "ふむふむ、なるほどね! 😊",
-        "へー、それで? 🤔",
-        "わかったよ! ✨",
-        "そうなんだ! 面白いね! 🌟",
-        "もっと教えて! 👂"
-    };
-    
-    return defaults[random(5)];
-}
-
-void SimpleResponder::addRule(const String& pattern, const String& response, float priority) {
-    // TODO: 動的にルールを追加
-}
-
-float SimpleResponder::matchScore(const String& input, const String& pattern) {
-    String input_lower = input;
-    String pattern_lower = pattern;
-    input_lower.toLowerCase();
-    pattern_lower.toLowerCase();
-    
-    if (input_lower.indexOf(pattern_lower) >= 0) {
-        return 1.0f;
-    }
-    
-    // 部分マッチスコア
-    int matches = 0;
-    int pattern_len = pattern_lower.length();
-    
-    for (int i = 0; i < pattern_len; i++) {
-        if (input_lower.indexOf(pattern_lower.charAt(i)) >= 0) {
-            matches++;
-        }
-    }
-    
-    return (float)matches / (float)pattern_len * 0.5f;
-}
@@ -1,12 +1,31 @@
 #include "touch_driver.h"
+#include "trace.h"
+
+static inline void count(std::atomic<uint32_t>& counter, uint32_t n = 1) {
+    counter.fetch_add(n, std::memory_order_relaxed);
+}
 
 TouchDriver::TouchDriver() {
     wire = &Wire;
     touch_callback = nullptr;
     current_point = {0, 0, false, GESTURE_NONE};
+    touch_state.setCallback(onEdge, this);
+    software_gestures = true;
+    memset(&last_gesture, 0, sizeof(last_gesture));
+    task_handle = nullptr;
+    irq_us = 0;
+    queue_head.store(0);
+    queue_tail.store(0);
+    reset_requested.store(false);
+    resetStats();
+    applyStatsReset();
 }
 
 TouchDriver::~TouchDriver() {
+    if (task_handle) {
+        detachInterrupt(TOUCH_INT);
+        vTaskDelete(task_handle);
+    }
 }
 
 bool TouchDriver::init() {
@@ -40,15 +59,23 @@ void TouchDriver::reset() {
 }
 
 bool TouchDriver::read() {
+    TRACE_SCOPE("touch_i2c");
+    uint32_t start = micros();
+    count(counters.reads);
+    
     wire->beginTransmission(TOUCH_ADDR);
-    wire->write(0x02);  // Touch data register
+    wire->write(0x01);  // Gesture ID register (続けてタッチデータ)
     if (wire->endTransmission() != 0) {
+        count(counters.read_errors);
+        count(counters.i2c_us, micros() - start);
         return false;
     }
     
-    // Read 6 bytes: status, x_high, x_low, y_high, y_low, gesture
+    // Read 6 bytes: gesture, points, x_high, x_low, y_high, y_low
     wire->requestFrom(TOUCH_ADDR, 6);
+    count(counters.i2c_us, micros() - start);
     if (wire->available() < 6) {
+        count(counters.read_errors);
         return false;
     }
     
@@ -58,43 +85,236 @@ bool TouchDriver::read() {
     }
     
     // Parse touch data
-    uint8_t points = data[0] & 0x0F;
+    // (クリック系のジェスチャーは離した時のサンプルで報告されるので、離していても読む)
+    uint8_t points = data[1] & 0x0F;
     current_point.touched = (points > 0);
+    current_point.gesture = data[0];
     
     if (current_point.touched) {
-        current_point.x = ((data[1] & 0x0F) << 8) | data[2];
-        current_point.y = ((data[3] & 0x0F) << 8) | data[4];
-        current_point.gesture = data[5];
-        
-        // Call callback if set
+        current_point.x = ((data[2] & 0x0F) << 8) | data[3];
+        current_point.y = ((data[4] & 0x0F) << 8) | data[5];
+    }
+    
+    // ポーリングモードではここで状態を更新 (割り込みモードでは popEvent() 側)
+    if (!task_handle) {
+        processSample(current_point, micros());
+    }
+    
+    return true;
+}
+
+void TouchDriver::processSample(TouchPoint sample, uint32_t now_us) {
+    applyStatsReset();
+    if (software_gestures &&
+        sample.gesture >= GESTURE_SWIPE_UP && sample.gesture <= GESTURE_SWIPE_RIGHT) {
+        sample.gesture = GESTURE_NONE;
+    }
+    touch_state.feed(sample, now_us);
+    
+    if (software_gestures && recognizer.feed(sample, now_us, &last_gesture)) {
+        TouchPoint point = touch_state.getPoint();
+        point.gesture = last_gesture.gesture;
         if (touch_callback) {
-            touch_callback(current_point);
+            touch_callback(TOUCH_EDGE_GESTURE, point);
         }
-    } else {
-        current_point.gesture = GESTURE_NONE;
+    }
+}
+
+void TouchDriver::onEdge(TouchEdge edge, const TouchPoint& point, void* ctx) {
+    TouchDriver* self = (TouchDriver*)ctx;
+    if (self->touch_callback) {
+        self->touch_callback(edge, point);
+    }
+}
+
+// ===== 割り込みモード =====
+void IRAM_ATTR TouchDriver::onInterrupt(void* arg) {
+    TouchDriver* self = (TouchDriver*)arg;
+    self->irq_us = micros();
+    count(self->counters.interrupts);
+    
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(self->task_handle, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+bool TouchDriver::startInterruptMode(BaseType_t core, UBaseType_t priority) {
+    if (task_handle) {
+        return true;
     }
     
+    BaseType_t ok = xTaskCreatePinnedToCore(
+        taskEntry, "touch", TOUCH_TASK_STACK_SIZE,
+        this, priority, &task_handle, core);
+    if (ok != pdPASS) {
+        Serial.println("タッチ: タスク作成失敗");
+        task_handle = nullptr;
+        return false;
+    }
+    
+    pinMode(TOUCH_INT, INPUT_PULLUP);
+    attachInterruptArg(TOUCH_INT, onInterrupt, this, FALLING);
+    resetStats();
+    
+    Serial.printf("タッチ割り込みモード開始 (GPIO%d)\n", TOUCH_INT);
     return true;
 }
 
+void TouchDriver::taskEntry(void* arg) {
+    ((TouchDriver*)arg)->taskLoop();
+}
+
+void TouchDriver::taskLoop() {
+    bool last_touched = false;
+    
+    while (true) {
+        // 指が離れている間は割り込みが来るまで眠る
+        TickType_t wait = last_touched ? pdMS_TO_TICKS(TOUCH_RELEASE_TIMEOUT_MS) : portMAX_DELAY;
+        uint32_t notified = ulTaskNotifyTake(pdTRUE, wait);
+        
+        uint32_t irq_time = notified ? irq_us : micros();
+        if (!notified) {
+            count(counters.timeout_reads);
+        }
+        if (!read()) {
+            continue;
+        }
+        
+        // 離した状態は1回だけ送る
+        if (!current_point.touched && !last_touched) {
+            continue;
+        }
+        last_touched = current_point.touched;
+        pushEvent(irq_time);
+    }
+}
+
+void TouchDriver::pushEvent(uint32_t irq_time) {
+    uint32_t head = queue_head.load(std::memory_order_relaxed);
+    uint32_t tail = queue_tail.load(std::memory_order_acquire);
+    if (head - tail >= TOUCH_QUEUE_SIZE) {
+        count(counters.dropped);
+        return;
+    }
+    
+    TouchEvent& ev = queue[head & (TOUCH_QUEUE_SIZE - 1)];
+    ev.point = current_point;
+    ev.irq_us = irq_time;
+    queue_head.store(head + 1, std::memory_order_release);
+}
+
+bool TouchDriver::popEvent(TouchPoint* point) {
+    uint32_t tail = queue_tail.load(std::memory_order_relaxed);
+    uint32_t head = queue_head.load(std::memory_order_acquire);
+    if (tail == head) {
+        // 離したあとのデバウンスはサンプルが来なくても進める
+        applyStatsReset();
+        touch_state.update(micros());
+        *point = touch_state.getPoint();
+        return false;
+    }
+    
+    TouchEvent ev = queue[tail & (TOUCH_QUEUE_SIZE - 1)];
+    uint32_t latency = micros() - ev.irq_us;
+    queue_tail.store(tail + 1, std::memory_order_release);
+    
+    TRACE_INSTANT("touch_event", ev.point.touched);
+    processSample(ev.point, ev.irq_us);
+    *point = touch_state.getPoint();
+    
+    count(counters.events);
+    count(counters.latency_sum_us, latency);
+    // 最大値を書くのはこのタスクだけ (リセットと重なっても1件ずれるだけ)
+    if (latency > counters.latency_max_us.load(std::memory_order_relaxed)) {
+        counters.latency_max_us.store(latency, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void TouchDriver::getStats(TouchStats* out) {
+    out->interrupts = counters.interrupts.load(std::memory_order_relaxed);
+    out->reads = counters.reads.load(std::memory_order_relaxed);
+    out->read_errors = counters.read_errors.load(std::memory_order_relaxed);
+    out->timeout_reads = counters.timeout_reads.load(std::memory_order_relaxed);
+    out->events = counters.events.load(std::memory_order_relaxed);
+    out->dropped = counters.dropped.load(std::memory_order_relaxed);
+    out->i2c_us = counters.i2c_us.load(std::memory_order_relaxed);
+    out->latency_sum_us = counters.latency_sum_us.load(std::memory_order_relaxed);
+    out->latency_max_us = counters.latency_max_us.load(std::memory_order_relaxed);
+    out->since_ms = counters.since_ms.load(std::memory_order_relaxed);
+}
+
+void TouchDriver::printStats() {
+    TouchStats stats;
+    getStats(&stats);
+    uint32_t elapsed_ms = millis() - stats.since_ms;
+    Serial.printf("タッチ (%s, %lums):\n", task_handle ? "割り込み" : "ポーリング", (unsigned long)elapsed_ms);
+    Serial.printf("  割り込み %lu, I2C読み出し %lu (エラー %lu, 離し確認 %lu)\n",
+                  (unsigned long)stats.interrupts, (unsigned long)stats.reads,
+                  (unsigned long)stats.read_errors, (unsigned long)stats.timeout_reads);
+    Serial.printf("  I2C使用率 %.2f%% (%luus)\n",
+                  elapsed_ms ? stats.i2c_us * 0.1f / elapsed_ms : 0.0f,
+                  (unsigned long)stats.i2c_us);
+    Serial.printf("  エッジ通知 %lu (重複ジェスチャー %lu件・途切れ %lu回をまとめた)\n",
+                  (unsigned long)touch_state.getEdgeCount(),
+                  (unsigned long)touch_state.getSuppressedCount(),
+                  (unsigned long)touch_state.getBounceCount());
+    if (software_gestures) {
+        Serial.printf("  ソフトウェア判定 スワイプ %lu (平均 %lums で確定), 回転 %lu\n",
+                      (unsigned long)recognizer.getSwipeCount(),
+                      (unsigned long)recognizer.getAverageSwipeMs(),
+                      (unsigned long)recognizer.getRotateCount());
+    }
+    if (stats.events > 0) {
+        Serial.printf("  イベント %lu, 遅延 平均 %luus / 最大 %luus, 破棄 %lu\n",
+                      (unsigned long)stats.events,
+                      (unsigned long)(stats.latency_sum_us / stats.events),
+                      (unsigned long)stats.latency_max_us,
+                      (unsigned long)stats.dropped);
+    }
+}
+
+void TouchDriver::resetStats() {
+    counters.interrupts.store(0, std::memory_order_relaxed);
+    counters.reads.store(0, std::memory_order_relaxed);
+    counters.read_errors.store(0, std::memory_order_relaxed);
+    counters.timeout_reads.store(0, std::memory_order_relaxed);
+    counters.events.store(0, std::memory_order_relaxed);
+    counters.dropped.store(0, std::memory_order_relaxed);
+    counters.i2c_us.store(0, std::memory_order_relaxed);
+    counters.latency_sum_us.store(0, std::memory_order_relaxed);
+    counters.latency_max_us.store(0, std::memory_order_relaxed);
+    counters.since_ms.store(millis(), std::memory_order_relaxed);
+    reset_requested.store(true, std::memory_order_release);
+}
+
+void TouchDriver::applyStatsReset() {
+    if (reset_requested.exchange(false, std::memory_order_acquire)) {
+        touch_state.resetStats();
+        recognizer.resetStats();
+    }
+}
+
 TouchPoint TouchDriver::getPoint() {
-    return current_point;
+    return touch_state.getPoint();
 }
 
 bool TouchDriver::isTouched() {
-    return current_point.touched;
+    return touch_state.isPressed();
 }
 
 uint16_t TouchDriver::getX() {
-    return current_point.x;
+    return touch_state.getPoint().x;
 }
 
 uint16_t TouchDriver::getY() {
-    return current_point.y;
+    return touch_state.getPoint().y;
 }
 
 uint8_t TouchDriver::getGesture() {
-    return current_point.gesture;
+    return touch_state.getPoint().gesture;
 }
 
 void TouchDriver::setTouchCallback(TouchCallback callback) {
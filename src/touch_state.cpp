@@ -0,0 +1,106 @@
+#include "touch_state.h"
+#include <string.h>
+
+TouchStateMachine::TouchStateMachine() {
+    callback = nullptr;
+    callback_ctx = nullptr;
+    setDebounce(TOUCH_DEBOUNCE_DOWN_MS, TOUCH_DEBOUNCE_UP_MS);
+    reset();
+    resetStats();
+}
+
+void TouchStateMachine::setDebounce(uint32_t down_ms, uint32_t up_ms) {
+    down_us = down_ms * 1000;
+    up_us = up_ms * 1000;
+}
+
+void TouchStateMachine::setCallback(EdgeCallback cb, void* ctx) {
+    callback = cb;
+    callback_ctx = ctx;
+}
+
+void TouchStateMachine::reset() {
+    state = STATE_IDLE;
+    state_since_us = 0;
+    last_gesture = 0;
+    memset(&point, 0, sizeof(point));
+}
+
+void TouchStateMachine::enter(State next, uint32_t now_us) {
+    state = next;
+    state_since_us = now_us;
+}
+
+void TouchStateMachine::emit(TouchEdge edge) {
+    edges++;
+    if (callback) {
+        callback(edge, point, callback_ctx);
+    }
+}
+
+void TouchStateMachine::feed(const TouchPoint& sample, uint32_t now_us) {
+    if (sample.touched) {
+        point.x = sample.x;
+        point.y = sample.y;
+
+        switch (state) {
+            case STATE_IDLE:
+                // 新しいタッチ: ジェスチャーの通知済みフラグを戻す
+                last_gesture = 0;
+                enter(STATE_DOWN_PENDING, now_us);
+                break;
+            case STATE_UP_PENDING:
+                // 一瞬離れただけ
+                bounces++;
+                state = STATE_PRESSED;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // 押した状態の確定 (down_us = 0 ならここですぐ確定)
+    update(now_us);
+
+    // ジェスチャーはタッチ中か、離した時のサンプルで報告される
+    if (sample.gesture != 0 && isPressed()) {
+        if (sample.gesture != last_gesture) {
+            last_gesture = sample.gesture;
+            point.gesture = sample.gesture;
+            emit(TOUCH_EDGE_GESTURE);
+        } else {
+            suppressed++;
+        }
+    }
+
+    if (!sample.touched) {
+        switch (state) {
+            case STATE_DOWN_PENDING:
+                // デバウンス前に離れた接触はなかったことにする
+                enter(STATE_IDLE, now_us);
+                break;
+            case STATE_PRESSED:
+                enter(STATE_UP_PENDING, now_us);
+                update(now_us);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void TouchStateMachine::update(uint32_t now_us) {
+    uint32_t elapsed = now_us - state_since_us;
+
+    if (state == STATE_DOWN_PENDING && elapsed >= down_us) {
+        enter(STATE_PRESSED, now_us);
+        point.touched = true;
+        point.gesture = 0;
+        emit(TOUCH_EDGE_DOWN);
+    } else if (state == STATE_UP_PENDING && elapsed >= up_us) {
+        enter(STATE_IDLE, now_us);
+        point.touched = false;
+        point.gesture = 0;
+        emit(TOUCH_EDGE_UP);
+    }
+}
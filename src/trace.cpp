@@ -0,0 +1,135 @@
+#include "trace.h"
+
+volatile bool Trace::enabled = false;
+
+static TraceEvent* g_events = nullptr;
+static std::atomic<uint32_t> g_written(0);     // これまでに記録した数 (位置 = g_written % SIZE)
+
+bool Trace::begin() {
+#if ENABLE_TRACE
+    if (!g_events) {
+        size_t bytes = TRACE_RING_SIZE * sizeof(TraceEvent);
+        if (psramFound()) {
+            g_events = (TraceEvent*)ps_malloc(bytes);
+        }
+        if (!g_events) {
+            g_events = (TraceEvent*)malloc(bytes);
+        }
+        if (!g_events) {
+            Serial.println("トレース: バッファ確保失敗");
+            return false;
+        }
+    }
+    clear();
+    enabled = true;
+    Serial.printf("トレース有効 (%d件)\n", TRACE_RING_SIZE);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Trace::clear() {
+    g_written.store(0);
+    if (g_events) {
+        // 前の番号が残っていると、新しい書きかけを古い内容のまま読んでしまう
+        for (int i = 0; i < TRACE_RING_SIZE; i++) {
+            g_events[i].seq.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void Trace::setEnabled(bool enable) {
+    enabled = enable && g_events != nullptr;
+}
+
+void Trace::record(const char* name, uint32_t ts_us, uint32_t dur, bool dur_in_us, uint16_t arg) {
+    uint32_t slot = g_written.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent& ev = g_events[slot & (TRACE_RING_SIZE - 1)];
+    ev.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ev.name = name;
+    ev.ts_us = ts_us;
+    ev.dur = dur;
+    ev.arg = arg;
+    ev.core = (uint8_t)xPortGetCoreID();
+    ev.dur_in_us = dur_in_us;
+    ev.seq.store(slot + 1, std::memory_order_release);
+}
+
+void Trace::complete(const char* name, uint32_t ts_us, uint32_t cycles, uint16_t arg) {
+    if (!enabled) {
+        return;
+    }
+    record(name, ts_us, cycles, false, arg);
+}
+
+void Trace::completeUs(const char* name, uint32_t ts_us, uint32_t dur_us, uint16_t arg) {
+    if (!enabled) {
+        return;
+    }
+    record(name, ts_us, dur_us, true, arg);
+}
+
+void Trace::instant(const char* name, uint16_t arg) {
+    if (!enabled) {
+        return;
+    }
+    record(name, micros(), 0xFFFFFFFF, false, arg);
+}
+
+void Trace::exportJson(Print& out) {
+    if (!g_events) {
+        out.println("トレースは無効です (-DENABLE_TRACE=1 でビルド)");
+        return;
+    }
+
+    // 出力中はなるべく上書きされないよう記録を止める。
+    // ただし判定を通り過ぎた記録はもう一方のコアでまだ書いているかもしれないので、
+    // スロットの番号を前後で確かめ、書きかけ・上書きされたものは出さない
+    bool was_enabled = enabled;
+    enabled = false;
+
+    uint32_t written = g_written.load();
+    uint32_t first = written > TRACE_RING_SIZE ? written - TRACE_RING_SIZE : 0;
+    uint32_t cpu_mhz = getCpuFrequencyMhz();
+    uint32_t exported = 0;
+    uint32_t torn = 0;
+
+    out.println("=== TRACE BEGIN ===");
+    out.print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (uint32_t i = first; i < written; i++) {
+        TraceEvent& slot = g_events[i & (TRACE_RING_SIZE - 1)];
+        uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        TraceEvent ev;
+        ev.name = slot.name;
+        ev.ts_us = slot.ts_us;
+        ev.dur = slot.dur;
+        ev.arg = slot.arg;
+        ev.core = slot.core;
+        ev.dur_in_us = slot.dur_in_us;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq != i + 1 || slot.seq.load(std::memory_order_relaxed) != seq) {
+            torn++;
+            continue;
+        }
+        if (exported++ > 0) {
+            out.print(",");
+        }
+        // 1行1イベント (シリアルのバッファを溢れさせない)
+        out.println();
+        if (ev.dur == 0xFFFFFFFF) {
+            out.printf("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lu,\"pid\":1,\"tid\":%d,\"args\":{\"v\":%u}}",
+                       ev.name, (unsigned long)ev.ts_us, ev.core, ev.arg);
+        } else {
+            uint32_t dur = ev.dur_in_us ? ev.dur : ev.dur / cpu_mhz;
+            out.printf("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%lu,\"pid\":1,\"tid\":%d,\"args\":{\"v\":%u}}",
+                       ev.name, (unsigned long)ev.ts_us, (unsigned long)dur, ev.core, ev.arg);
+        }
+    }
+    out.println("\n]}");
+    out.printf("=== TRACE END (%lu件, 取りこぼし %lu件, 書き込み中で除外 %lu件) ===\n",
+               (unsigned long)exported, (unsigned long)first, (unsigned long)torn);
+
+    enabled = was_enabled;
+}
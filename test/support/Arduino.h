@@ -0,0 +1,195 @@
+/**
+ * ホストテスト用の Arduino.h
+ * [env:native] のテストが使う範囲だけを標準C++で置き換える
+ *
+ * - String は std::string の薄い包み
+ * - Serial は標準出力に書く
+ * - millis() / micros() はテストから止めたり進めたりできる時計
+ *   (既定は実時間。native_clock::freeze() 後は advance_us() / delay() でだけ進む)
+ * - ps_malloc() は malloc() (ホストにPSRAMの区別はない)
+ * - random() は rand() (テストの結果が乱数に依存しないようにする)
+ * - ESP の容量は 0 (表示にしか使わない)
+ */
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+#define PROGMEM
+#define F(x) (x)
+
+// ===== 時計 =====
+namespace native_clock {
+    inline const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    inline std::atomic<bool> frozen{false};
+    inline std::atomic<uint64_t> frozen_us{0};
+
+    inline uint64_t now_us() {
+        if (frozen.load()) {
+            return frozen_us.load();
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - origin).count();
+    }
+    // 今の時刻で止める (以後は advance_us() でだけ進む)
+    inline void freeze() { frozen_us.store(now_us()); frozen.store(true); }
+    inline void advance_us(uint64_t us) { frozen_us.fetch_add(us); }
+    inline void resume() { frozen.store(false); }
+}
+
+inline unsigned long micros() { return (uint32_t)native_clock::now_us(); }
+inline unsigned long millis() { return (uint32_t)(native_clock::now_us() / 1000); }
+
+inline void delay(unsigned long ms) {
+    if (native_clock::frozen.load()) {
+        native_clock::advance_us((uint64_t)ms * 1000);
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+inline void* ps_malloc(size_t size) { return malloc(size); }
+inline void* ps_calloc(size_t n, size_t size) { return calloc(n, size); }
+inline void* ps_realloc(void* p, size_t size) { return realloc(p, size); }
+inline bool psramFound() { return true; }
+
+// glibc 2.38 より前には strlcpy がない
+inline size_t native_strlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#define strlcpy native_strlcpy
+
+inline size_t native_strlcat(char* dst, const char* src, size_t size) {
+    size_t used = strnlen(dst, size);
+    if (used == size) {
+        return size + strlen(src);
+    }
+    return used + native_strlcpy(dst + used, src, size - used);
+}
+#define strlcat native_strlcat
+
+inline long random(long max) { return max > 0 ? rand() % max : 0; }
+inline long random(long min, long max) { return max > min ? min + rand() % (max - min) : min; }
+
+class EspClass {
+public:
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getHeapSize() { return 0; }
+    uint32_t getPsramSize() { return 0; }
+    uint32_t getFreePsram() { return 0; }
+};
+
+inline EspClass ESP;
+
+// ===== String =====
+class String {
+private:
+    std::string s;
+
+public:
+    String() {}
+    String(const char* text) : s(text ? text : "") {}
+    String(const std::string& text) : s(text) {}
+    String(char c) : s(1, c) {}
+    String(int v) : s(std::to_string(v)) {}
+    String(unsigned int v) : s(std::to_string(v)) {}
+    String(long v) : s(std::to_string(v)) {}
+    String(unsigned long v) : s(std::to_string(v)) {}
+
+    const char* c_str() const { return s.c_str(); }
+    unsigned int length() const { return (unsigned int)s.size(); }
+    bool reserve(unsigned int size) { s.reserve(size); return true; }
+    bool isEmpty() const { return s.empty(); }
+
+    String& operator+=(const String& o) { s += o.s; return *this; }
+    String& operator+=(const char* o) { s += o; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    bool concat(const char* text, unsigned int len) { s.append(text, len); return true; }
+
+    friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+    friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.s); }
+    bool operator==(const String& o) const { return s == o.s; }
+    bool operator==(const char* o) const { return s == o; }
+    bool operator!=(const String& o) const { return s != o.s; }
+    char operator[](unsigned int i) const { return i < s.size() ? s[i] : 0; }
+    char charAt(unsigned int i) const { return (*this)[i]; }
+    void toLowerCase() {
+        for (char& c : s) {
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        }
+    }
+
+    int indexOf(const char* text, unsigned int from = 0) const {
+        size_t p = s.find(text, from);
+        return p == std::string::npos ? -1 : (int)p;
+    }
+    String substring(unsigned int from, unsigned int to = 0xFFFFFFFF) const {
+        if (from > s.size()) from = s.size();
+        if (to > s.size()) to = s.size();
+        return String(s.substr(from, to > from ? to - from : 0));
+    }
+    bool startsWith(const char* prefix) const { return s.rfind(prefix, 0) == 0; }
+    int toInt() const { return atoi(s.c_str()); }
+};
+
+// ===== Serial =====
+class Print {
+public:
+    size_t write(const uint8_t* data, size_t len) { return fwrite(data, 1, len, stdout); }
+    size_t print(const char* text) { return fputs(text, stdout) < 0 ? 0 : strlen(text); }
+    size_t print(const String& text) { return print(text.c_str()); }
+    size_t print(char c) { return fputc(c, stdout) < 0 ? 0 : 1; }
+    size_t print(int v) { return printf("%d", v); }
+    size_t print(unsigned int v) { return printf("%u", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+    size_t println() { return print("\n"); }
+    template <typename T> size_t println(const T& v) { return print(v) + println(); }
+    template <typename T> size_t println(const T& v, int digits) { return print(v, digits) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        int n = vprintf(format, args);
+        va_end(args);
+        return n < 0 ? 0 : (size_t)n;
+    }
+    void flush() { fflush(stdout); }
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    operator bool() { return true; }
+};
+
+inline HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * ホストテスト用の FS.h
+ * File はホストのファイル (FILE*) をそのまま読み書きする。
+ * FS はルートのディレクトリを持ち、nullptr ならマウントされていない扱い
+ */
+
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+
+#include <Arduino.h>
+#include <sys/stat.h>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode {
+    SeekSet = SEEK_SET,
+    SeekCur = SEEK_CUR,
+    SeekEnd = SEEK_END
+};
+
+class File {
+private:
+    FILE* fp;
+
+public:
+    File(FILE* f = nullptr) : fp(f) {}
+
+    size_t write(uint8_t c) { return fp ? fwrite(&c, 1, 1, fp) : 0; }
+    size_t write(const uint8_t* data, size_t len) { return fp ? fwrite(data, 1, len, fp) : 0; }
+    int read() { return fp ? fgetc(fp) : -1; }
+    size_t read(uint8_t* buf, size_t len) { return fp ? fread(buf, 1, len, fp) : 0; }
+    size_t readBytes(char* buf, size_t len) { return read((uint8_t*)buf, len); }
+    String readStringUntil(char terminator) {
+        String line;
+        int c;
+        while ((c = read()) >= 0 && c != terminator) {
+            line += (char)c;
+        }
+        return line;
+    }
+    bool seek(uint32_t pos, SeekMode mode = SeekSet) { return fp && fseek(fp, pos, mode) == 0; }
+    size_t position() { return fp ? (size_t)ftell(fp) : 0; }
+    size_t size() {
+        if (!fp) return 0;
+        long here = ftell(fp);
+        fseek(fp, 0, SEEK_END);
+        long end = ftell(fp);
+        fseek(fp, here, SEEK_SET);
+        return (size_t)end;
+    }
+    int available() { return fp ? (int)(size() - position()) : 0; }
+    void flush() { if (fp) fflush(fp); }
+    void close() { if (fp) { fclose(fp); fp = nullptr; } }
+    operator bool() const { return fp != nullptr; }
+};
+
+class FS {
+private:
+    const char* root;
+
+    std::string hostPath(const char* path) { return std::string(root) + path; }
+
+public:
+    explicit FS(const char* root_dir = nullptr) : root(root_dir) {}
+
+    bool begin(bool format_if_failed = false, ...) { return root != nullptr; }
+    bool exists(const char* path) {
+        struct stat st;
+        return root && stat(hostPath(path).c_str(), &st) == 0;
+    }
+    File open(const char* path, const char* mode = FILE_READ) {
+        if (!root) return File();
+        // 読み書き両方できるように開く (WAVのヘッダを書き直すため)
+        const char* host_mode = mode[0] == 'w' ? "w+b" : mode[0] == 'a' ? "ab" : "rb";
+        return File(fopen(hostPath(path).c_str(), host_mode));
+    }
+    bool remove(const char* path) { return root && ::remove(hostPath(path).c_str()) == 0; }
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif
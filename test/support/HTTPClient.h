@@ -0,0 +1,15 @@
+/**
+ * ホストテスト用の HTTPClient.h (LLMHandler のメンバーを作れるだけ)
+ */
+
+#ifndef NATIVE_HTTPCLIENT_H
+#define NATIVE_HTTPCLIENT_H
+
+#include <WiFi.h>
+
+class HTTPClient {
+public:
+    void end() {}
+};
+
+#endif
@@ -0,0 +1,12 @@
+/**
+ * ホストテスト用の SD.h (マウントされていないカード)
+ */
+
+#ifndef NATIVE_SD_H
+#define NATIVE_SD_H
+
+#include <FS.h>
+
+inline fs::FS SD;
+
+#endif
@@ -0,0 +1,13 @@
+/**
+ * ホストテスト用の SPIFFS.h (マウントされていない領域)
+ * キャッシュファイルは読めず書けないので、毎回作り直す経路を通る
+ */
+
+#ifndef NATIVE_SPIFFS_H
+#define NATIVE_SPIFFS_H
+
+#include <FS.h>
+
+inline fs::FS SPIFFS;
+
+#endif
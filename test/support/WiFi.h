@@ -0,0 +1,25 @@
+/**
+ * ホストテスト用の WiFi.h (つながらないWiFi)
+ */
+
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+#include <Arduino.h>
+
+#define WL_CONNECTED 3
+
+class WiFiClient {
+public:
+    bool connected() { return false; }
+    void stop() {}
+};
+
+class WiFiClass {
+public:
+    int status() { return 0; }
+};
+
+inline WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * ホストテスト用の driver/i2s.h (旧I2Sドライバ)
+ * 初期化は常に成功し、i2s_write() は書いたことにして捨てる。
+ * 出力を確かめるテストは AudioOutput::setSink() で受け取る
+ */
+
+#ifndef NATIVE_I2S_H
+#define NATIVE_I2S_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../freertos/FreeRTOS.h"
+
+typedef int esp_err_t;
+#define ESP_OK      0
+#define ESP_FAIL    -1
+#define ESP_INTR_FLAG_LEVEL1    (1 << 1)
+#define I2S_PIN_NO_CHANGE       -1
+
+typedef enum { I2S_NUM_0 = 0, I2S_NUM_1 = 1 } i2s_port_t;
+typedef enum { I2S_MODE_MASTER = 1, I2S_MODE_SLAVE = 2, I2S_MODE_TX = 4, I2S_MODE_RX = 8 } i2s_mode_t;
+typedef enum { I2S_BITS_PER_SAMPLE_16BIT = 16, I2S_BITS_PER_SAMPLE_32BIT = 32 } i2s_bits_per_sample_t;
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT,
+    I2S_CHANNEL_FMT_ALL_RIGHT,
+    I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT,
+    I2S_CHANNEL_FMT_ONLY_LEFT
+} i2s_channel_fmt_t;
+typedef enum { I2S_COMM_FORMAT_STAND_I2S = 1 } i2s_comm_format_t;
+
+typedef struct {
+    i2s_mode_t mode;
+    uint32_t sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+    bool use_apll;
+    bool tx_desc_auto_clear;
+} i2s_config_t;
+
+typedef struct {
+    int mck_io_num;
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+} i2s_pin_config_t;
+
+inline esp_err_t i2s_driver_install(i2s_port_t, const i2s_config_t*, int, void*) { return ESP_OK; }
+inline esp_err_t i2s_driver_uninstall(i2s_port_t) { return ESP_OK; }
+inline esp_err_t i2s_set_pin(i2s_port_t, const i2s_pin_config_t*) { return ESP_OK; }
+inline esp_err_t i2s_zero_dma_buffer(i2s_port_t) { return ESP_OK; }
+
+inline esp_err_t i2s_write(i2s_port_t, const void*, size_t size, size_t* written, TickType_t) {
+    *written = size;
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * ホストテスト用の queue.h
+ * 要素はコピーで渡す (FreeRTOSと同じ)。待ち時間は tick = ms の実時間
+ */
+
+#ifndef NATIVE_QUEUE_H
+#define NATIVE_QUEUE_H
+
+#include "FreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string.h>
+#include <vector>
+
+struct NativeQueue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+
+    // 条件が成り立つまで待つ (portMAX_DELAY なら無期限)
+    template <typename Pred>
+    bool wait(std::unique_lock<std::mutex>& lock, TickType_t ticks, Pred pred) {
+        if (ticks == portMAX_DELAY) {
+            changed.wait(lock, pred);
+            return true;
+        }
+        return changed.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), pred);
+    }
+};
+typedef NativeQueue* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    NativeQueue* q = new NativeQueue();
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+inline void vQueueDelete(QueueHandle_t q) { delete q; }
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!q->wait(lock, ticks, [q] { return q->items.size() < q->length; })) {
+        return pdFALSE;
+    }
+    const uint8_t* p = (const uint8_t*)item;
+    q->items.emplace_back(p, p + q->item_size);
+    q->changed.notify_all();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t ticks) {
+    return xQueueSend(q, item, ticks);
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!q->wait(lock, ticks, [q] { return !q->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, q->items.front().data(), q->item_size);
+    q->items.pop_front();
+    q->changed.notify_all();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t q) {
+    std::lock_guard<std::mutex> lock(q->mutex);
+    q->items.clear();
+    q->changed.notify_all();
+    return pdPASS;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    std::lock_guard<std::mutex> lock(q->mutex);
+    return (UBaseType_t)q->items.size();
+}
+
+#endif
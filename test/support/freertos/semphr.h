@@ -0,0 +1,30 @@
+/**
+ * ホストテスト用の semphr.h (ミューテックスだけ)
+ */
+
+#ifndef NATIVE_SEMPHR_H
+#define NATIVE_SEMPHR_H
+
+#include "FreeRTOS.h"
+#include <chrono>
+#include <mutex>
+
+typedef std::timed_mutex* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::timed_mutex(); }
+inline void vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+    if (ticks == portMAX_DELAY) {
+        s->lock();
+        return pdTRUE;
+    }
+    return s->try_lock_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS)) ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    s->unlock();
+    return pdTRUE;
+}
+
+#endif
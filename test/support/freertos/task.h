@@ -0,0 +1,43 @@
+/**
+ * ホストテスト用の task.h
+ * タスクはデタッチしたスレッド。ホストではスレッドを外から止められないので
+ * vTaskDelete() は何もしない (テストではタスクを持つオブジェクトを破棄しない)
+ */
+
+#ifndef NATIVE_TASK_H
+#define NATIVE_TASK_H
+
+#include "FreeRTOS.h"
+#include <Arduino.h>
+#include <thread>
+
+typedef void (*TaskFunction_t)(void*);
+
+struct NativeTask {
+    const char* name;
+};
+typedef NativeTask* TaskHandle_t;
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_size,
+                                          void* param, UBaseType_t priority,
+                                          TaskHandle_t* handle, BaseType_t core) {
+    NativeTask* task = new NativeTask{name};
+    std::thread(fn, param).detach();
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_size,
+                              void* param, UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(fn, name, stack_size, param, priority, handle, tskNO_AFFINITY);
+}
+
+inline void vTaskDelete(TaskHandle_t task) {}
+
+inline void vTaskDelay(TickType_t ticks) { delay(ticks * portTICK_PERIOD_MS); }
+
+inline TickType_t xTaskGetTickCount() { return (TickType_t)(millis() / portTICK_PERIOD_MS); }
+
+#endif
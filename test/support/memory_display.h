@@ -0,0 +1,115 @@
+/**
+ * ホストテスト用の画面 (LVGLの描画をメモリ上のフレームバッファに受ける)
+ * 実機の DisplayDriver と同じく、帯状のバッファ2枚にLVGLが描き、flush_cb で画面に写す。
+ * 無効領域は実機と同じ rounder (round_clip.h) で円の内側に縮める。
+ * SPIの代わりにフレームバッファへコピーし、写した回数とバイト数を数える。
+ *
+ * - LVGLの時刻は lv_tick_inc() で進める (lv_conf.h はホストでは LV_TICK_CUSTOM 0)
+ * - savePng() で今の画面をPNGに保存する (見た目の回帰を目で確かめる用)
+ */
+
+#ifndef NATIVE_MEMORY_DISPLAY_H
+#define NATIVE_MEMORY_DISPLAY_H
+
+#include <lvgl.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "png_writer.h"
+#include "round_clip.h"
+
+#define MEMORY_DISPLAY_WIDTH        360
+#define MEMORY_DISPLAY_HEIGHT       360
+#define MEMORY_DISPLAY_BAND_LINES   60      // 実機の既定 (DISPLAY_BAND_LINES) と同じ
+#define MEMORY_DISPLAY_CLIP_MARGIN  1       // 実機の DISPLAY_CLIP_MARGIN と同じ
+
+struct MemoryDisplayStats {
+    uint32_t flushes;       // flush_cb の呼び出し回数
+    uint32_t pixels;        // 写したピクセル数
+    uint32_t bytes;         // 写したバイト数 (実機ならSPIで送る量)
+    uint32_t max_rows;      // 1回で写した最大の行数 (バンドの高さ)
+};
+
+class MemoryDisplay {
+private:
+    std::vector<lv_color_t> frame;
+    std::vector<lv_color_t> bands[2];
+    lv_disp_draw_buf_t draw_buf;
+    lv_disp_drv_t drv;
+    lv_disp_t* disp;
+    MemoryDisplayStats stats;
+    int16_t span_x0[MEMORY_DISPLAY_HEIGHT];
+    int16_t span_x1[MEMORY_DISPLAY_HEIGHT];
+
+    static void flush_cb(lv_disp_drv_t* d, const lv_area_t* area, lv_color_t* color_p) {
+        MemoryDisplay* self = (MemoryDisplay*)d->user_data;
+        int32_t w = lv_area_get_width(area);
+        for (int32_t y = area->y1; y <= area->y2; y++) {
+            memcpy(&self->frame[y * MEMORY_DISPLAY_WIDTH + area->x1], color_p, w * sizeof(lv_color_t));
+            color_p += w;
+        }
+        uint32_t rows = lv_area_get_height(area);
+        uint32_t px = (uint32_t)w * rows;
+        self->stats.flushes++;
+        if (rows > self->stats.max_rows) self->stats.max_rows = rows;
+        self->stats.pixels += px;
+        self->stats.bytes += px * sizeof(lv_color_t);
+        lv_disp_flush_ready(d);
+    }
+
+    static void rounder_cb(lv_disp_drv_t* d, lv_area_t* area) {
+        MemoryDisplay* self = (MemoryDisplay*)d->user_data;
+        round_clip_area(area, self->span_x0, self->span_x1, MEMORY_DISPLAY_HEIGHT);
+    }
+
+public:
+    MemoryDisplay() : disp(nullptr) {
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    // lv_init() のあとに呼ぶ
+    bool begin(uint32_t band_lines = MEMORY_DISPLAY_BAND_LINES) {
+        size_t band_px = (size_t)MEMORY_DISPLAY_WIDTH * band_lines;
+        frame.assign((size_t)MEMORY_DISPLAY_WIDTH * MEMORY_DISPLAY_HEIGHT, lv_color_black());
+        bands[0].resize(band_px);
+        bands[1].resize(band_px);
+        lv_disp_draw_buf_init(&draw_buf, bands[0].data(), bands[1].data(), band_px);
+        round_clip_build(span_x0, span_x1, MEMORY_DISPLAY_WIDTH, MEMORY_DISPLAY_HEIGHT,
+                         MEMORY_DISPLAY_CLIP_MARGIN);
+
+        lv_disp_drv_init(&drv);
+        drv.hor_res = MEMORY_DISPLAY_WIDTH;
+        drv.ver_res = MEMORY_DISPLAY_HEIGHT;
+        drv.flush_cb = flush_cb;
+        drv.rounder_cb = rounder_cb;
+        drv.draw_buf = &draw_buf;
+        drv.user_data = this;
+        disp = lv_disp_drv_register(&drv);
+        return disp != nullptr;
+    }
+
+    // rounder_cb と同じ規則で領域を縮める (テストで確かめる用)
+    void round(lv_area_t* area) const {
+        round_clip_area(area, span_x0, span_x1, MEMORY_DISPLAY_HEIGHT);
+    }
+
+    const lv_color_t* getFrame() const { return frame.data(); }
+    std::vector<lv_color_t> copyFrame() const { return frame; }
+
+    const MemoryDisplayStats& getStats() const { return stats; }
+    void resetStats() { memset(&stats, 0, sizeof(stats)); }
+
+    // 今の画面をPNG (RGB 8bit) で保存
+    bool savePng(const char* path) const {
+        std::vector<uint8_t> rgb(frame.size() * 3);
+        for (size_t i = 0; i < frame.size(); i++) {
+            uint32_t c = lv_color_to32(frame[i]);
+            rgb[i * 3 + 0] = (uint8_t)(c >> 16);
+            rgb[i * 3 + 1] = (uint8_t)(c >> 8);
+            rgb[i * 3 + 2] = (uint8_t)c;
+        }
+        return png_write_rgb(path, rgb.data(), MEMORY_DISPLAY_WIDTH, MEMORY_DISPLAY_HEIGHT);
+    }
+};
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * ホストテスト用のPNG書き出し (RGB 8bit、圧縮なし)
+ * zlibに頼らず、deflateの無圧縮ブロックだけで書く。
+ * 画像ビューアや差分ツールで開ければよいので、サイズは気にしない
+ */
+
+#ifndef NATIVE_PNG_WRITER_H
+#define NATIVE_PNG_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#define PNG_STORED_BLOCK_MAX    65535   // deflateの無圧縮ブロック1つの上限
+
+inline uint32_t png_crc32(const uint8_t* data, size_t len, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool ready = false;
+    if (!ready) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        ready = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline uint32_t png_adler32(const uint8_t* data, size_t len) {
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+inline void png_put32(std::vector<uint8_t>* out, uint32_t v) {
+    out->push_back((uint8_t)(v >> 24));
+    out->push_back((uint8_t)(v >> 16));
+    out->push_back((uint8_t)(v >> 8));
+    out->push_back((uint8_t)v);
+}
+
+// 長さ・種類・中身・CRC (CRCは種類と中身にかかる)
+inline void png_chunk(FILE* file, const char* type, const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> buf;
+    png_put32(&buf, (uint32_t)data.size());
+    buf.insert(buf.end(), type, type + 4);
+    buf.insert(buf.end(), data.begin(), data.end());
+    png_put32(&buf, png_crc32(buf.data() + 4, buf.size() - 4));
+    fwrite(buf.data(), 1, buf.size(), file);
+}
+
+// rgb は width × height × 3 バイト (上の行から)
+inline bool png_write_rgb(const char* path, const uint8_t* rgb, uint32_t width, uint32_t height) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 1, sizeof(signature), file);
+
+    std::vector<uint8_t> ihdr;
+    png_put32(&ihdr, width);
+    png_put32(&ihdr, height);
+    ihdr.push_back(8);      // 8bit
+    ihdr.push_back(2);      // RGB
+    ihdr.push_back(0);      // deflate
+    ihdr.push_back(0);      // フィルタ方式
+    ihdr.push_back(0);      // インターレースなし
+    png_chunk(file, "IHDR", ihdr);
+
+    // 各行の先頭にフィルタ (0 = なし) を付けた生データ
+    size_t stride = (size_t)width * 3;
+    std::vector<uint8_t> raw;
+    raw.reserve((stride + 1) * height);
+    for (uint32_t y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb + y * stride, rgb + (y + 1) * stride);
+    }
+
+    // zlibヘッダ + 無圧縮ブロック + Adler-32
+    std::vector<uint8_t> idat = { 0x78, 0x01 };
+    for (size_t pos = 0; pos < raw.size(); pos += PNG_STORED_BLOCK_MAX) {
+        size_t len = raw.size() - pos < PNG_STORED_BLOCK_MAX ? raw.size() - pos : PNG_STORED_BLOCK_MAX;
+        bool last = pos + len == raw.size();
+        idat.push_back(last ? 1 : 0);
+        idat.push_back((uint8_t)len);
+        idat.push_back((uint8_t)(len >> 8));
+        idat.push_back((uint8_t)~len);
+        idat.push_back((uint8_t)(~len >> 8));
+        idat.insert(idat.end(), raw.begin() + pos, raw.begin() + pos + len);
+    }
+    png_put32(&idat, png_adler32(raw.data(), raw.size()));
+    png_chunk(file, "IDAT", idat);
+    png_chunk(file, "IEND", std::vector<uint8_t>());
+
+    bool ok = ferror(file) == 0;
+    return fclose(file) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,254 @@
+/**
+ * AudioOutput のホストテスト
+ * PCM・ADPCM・トーンの各音源をタスク経由で再生し、I2S の代わりの出力 (setSink) に
+ * 届いたサンプルを確かめる。最初のブロックが鳴るまでの遅延が 20ms 未満であることも見る
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <mutex>
+#include <vector>
+
+#include "../../src/audio_output.cpp"
+
+#define FIRST_BLOCK_LIMIT_US    20000
+
+// ===== 出力の記録 =====
+struct SinkLog {
+    std::mutex mutex;
+    std::vector<int16_t> samples;
+    std::vector<const int16_t*> blocks;     // 渡されたポインタ (ゼロコピーの確認用)
+    uint32_t first_us;                      // 最初のブロックが鳴り始める時刻 (推定)
+};
+
+static AudioOutput* audio;      // タスクは止められないので最後まで使い回す
+static SinkLog sink_log;
+
+static void recordSink(void* ctx, const int16_t* samples, size_t count) {
+    SinkLog* log = (SinkLog*)ctx;
+    std::lock_guard<std::mutex> lock(log->mutex);
+    if (log->blocks.empty()) {
+        // 書き込んだ直後なので、このブロックの終わりまでが出力待ち
+        uint32_t block_us = (uint32_t)count * 1000000 / AUDIO_SAMPLE_RATE;
+        log->first_us = micros() + audio->getOutputDelayUs() - block_us;
+    }
+    log->blocks.push_back(samples);
+    log->samples.insert(log->samples.end(), samples, samples + count);
+}
+
+static size_t sinkCount() {
+    std::lock_guard<std::mutex> lock(sink_log.mutex);
+    return sink_log.samples.size();
+}
+
+static bool waitSamples(size_t count, uint32_t timeout_ms = 2000) {
+    uint32_t start = millis();
+    while (sinkCount() < count || audio->isPlaying()) {
+        if (millis() - start > timeout_ms) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+// ===== IMA ADPCM の参照エンコーダ (デコーダと同じ予測値を追う) =====
+static size_t encodeAdpcm(const int16_t* pcm, size_t n, uint8_t* out, std::vector<int16_t>* decoded) {
+    int32_t predictor = 0;
+    int index = 0;
+    memset(out, 0, (n + 1) / 2);
+    for (size_t i = 0; i < n; i++) {
+        int32_t step = ADPCM_STEP_TABLE[index];
+        int32_t diff = pcm[i] - predictor;
+        uint8_t code = 0;
+        if (diff < 0) {
+            code = 8;
+            diff = -diff;
+        }
+        int32_t delta = step >> 3;
+        if (diff >= step) { code |= 4; diff -= step; delta += step; }
+        if (diff >= step >> 1) { code |= 2; diff -= step >> 1; delta += step >> 1; }
+        if (diff >= step >> 2) { code |= 1; delta += step >> 2; }
+        predictor += (code & 8) ? -delta : delta;
+        if (predictor > 32767) predictor = 32767;
+        if (predictor < -32768) predictor = -32768;
+        index += ADPCM_INDEX_TABLE[code];
+        if (index < 0) index = 0;
+        if (index > 88) index = 88;
+
+        out[i >> 1] |= code << ((i & 1) * 4);
+        decoded->push_back((int16_t)predictor);
+    }
+    return (n + 1) / 2;
+}
+
+static void makeSine(int16_t* out, size_t n, float freq, float amp) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (int16_t)(amp * sinf(2.0f * (float)M_PI * freq * i / AUDIO_SAMPLE_RATE));
+    }
+}
+
+void setUp() {
+    // 前のテストで書いた音が鳴り終わったことにする (DMAのリングより先)
+    delay(AUDIO_RING_US / 1000 + 10);
+    std::lock_guard<std::mutex> lock(sink_log.mutex);
+    sink_log.samples.clear();
+    sink_log.blocks.clear();
+    audio->setVolume(AUDIO_VOLUME_MAX);
+}
+
+void tearDown() {
+    audio->stop();
+}
+
+// フラッシュ上のPCMはコピーせずにそのまま渡る
+void test_pcm_is_passed_through_without_copy() {
+    static int16_t pcm[1000];
+    makeSine(pcm, 1000, 440.0f, 12000.0f);
+
+    TEST_ASSERT_TRUE(audio->playPcm(pcm, 1000));
+    TEST_ASSERT_TRUE(waitSamples(1000));
+
+    std::lock_guard<std::mutex> lock(sink_log.mutex);
+    TEST_ASSERT_EQUAL_INT(1000, (int)sink_log.samples.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(pcm, sink_log.samples.data(), 1000);
+    // 1000 = 7 × 128 + 104
+    TEST_ASSERT_EQUAL_INT(8, (int)sink_log.blocks.size());
+    for (size_t b = 0; b < sink_log.blocks.size(); b++) {
+        TEST_ASSERT_TRUE(sink_log.blocks[b] == pcm + b * AUDIO_BLOCK_SAMPLES);
+    }
+}
+
+// 音量を下げたときだけコピーして掛ける
+void test_pcm_volume_scales_samples() {
+    static int16_t pcm[256];
+    makeSine(pcm, 256, 1000.0f, 16000.0f);
+    audio->setVolume(AUDIO_VOLUME_MAX / 2);
+
+    TEST_ASSERT_TRUE(audio->playPcm(pcm, 256));
+    TEST_ASSERT_TRUE(waitSamples(256));
+
+    std::lock_guard<std::mutex> lock(sink_log.mutex);
+    for (int i = 0; i < 256; i++) {
+        TEST_ASSERT_EQUAL_INT16((int16_t)((pcm[i] * (AUDIO_VOLUME_MAX / 2)) >> 8), sink_log.samples[i]);
+    }
+    TEST_ASSERT_TRUE(sink_log.blocks[0] != pcm);
+}
+
+// ブロックをまたいでも予測値を引き継ぎ、参照エンコーダの復元値と一致する
+void test_adpcm_decodes_reference_stream() {
+    const size_t n = 1500;
+    static int16_t pcm[n];
+    static uint8_t adpcm[(n + 1) / 2];
+    makeSine(pcm, n, 330.0f, 10000.0f);
+    std::vector<int16_t> expected;
+    encodeAdpcm(pcm, n, adpcm, &expected);
+
+    TEST_ASSERT_TRUE(audio->playAdpcm(adpcm, n));
+    TEST_ASSERT_TRUE(waitSamples(n));
+
+    std::lock_guard<std::mutex> lock(sink_log.mutex);
+    TEST_ASSERT_EQUAL_INT((int)n, (int)sink_log.samples.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), sink_log.samples.data(), n);
+
+    // 立ち上がり (ステップが小さい間) を過ぎれば元の波形に近い
+    int32_t max_err = 0;
+    for (size_t i = 200; i < n; i++) {
+        int32_t err = abs(sink_log.samples[i] - pcm[i]);
+        if (err > max_err) max_err = err;
+    }
+    TEST_ASSERT_LESS_THAN(1000, max_err);
+}
+
+void test_tone_length_pitch_and_fades() {
+    TEST_ASSERT_TRUE(audio->playTone(1000, 50));
+    const size_t n = 50 * AUDIO_SAMPLE_RATE / 1000;
+    TEST_ASSERT_TRUE(waitSamples(n));
+
+    std::lock_guard<std::mutex> lock(sink_log.mutex);
+    const std::vector<int16_t>& s = sink_log.samples;
+    TEST_ASSERT_EQUAL_INT((int)n, (int)s.size());
+
+    // 両端はフェードで 0 から始まり 0 近くで終わる
+    TEST_ASSERT_EQUAL_INT16(0, s[0]);
+    TEST_ASSERT_LESS_THAN(8000 / AUDIO_TONE_FADE_SAMPLES + 1, abs(s[n - 1]));
+
+    // 中ほどの振幅はほぼ指定どおり (既定 8000)
+    int32_t peak = 0;
+    for (size_t i = AUDIO_TONE_FADE_SAMPLES; i < n - AUDIO_TONE_FADE_SAMPLES; i++) {
+        if (abs(s[i]) > peak) peak = abs(s[i]);
+    }
+    TEST_ASSERT_INT_WITHIN(300, 8000, peak);
+
+    // 1kHz × 50ms = 50周期 → 上向きのゼロ交差が約50回
+    int rising = 0;
+    for (size_t i = 1; i < n; i++) {
+        if (s[i - 1] < 0 && s[i] >= 0) rising++;
+    }
+    TEST_ASSERT_INT_WITHIN(1, 50, rising);
+}
+
+// play() から最初のブロックが鳴り始めるまで (作る時間 + DMAの待ち)
+void test_first_block_latency() {
+    static int16_t pcm[AUDIO_BLOCK_SAMPLES * 4];
+    makeSine(pcm, AUDIO_BLOCK_SAMPLES * 4, 500.0f, 8000.0f);
+
+    audio->resetStats();
+    for (int i = 0; i < 3; i++) {
+        setUp();
+        uint32_t play_us = micros();
+        TEST_ASSERT_TRUE(audio->playPcm(pcm, AUDIO_BLOCK_SAMPLES * 4));
+        TEST_ASSERT_TRUE(waitSamples(AUDIO_BLOCK_SAMPLES * 4));
+
+        std::lock_guard<std::mutex> lock(sink_log.mutex);
+        uint32_t latency_us = sink_log.first_us - play_us;
+        TEST_ASSERT_LESS_THAN_UINT32(FIRST_BLOCK_LIMIT_US, latency_us);
+    }
+
+    const AudioStats& st = audio->getStats();
+    TEST_ASSERT_EQUAL_UINT32(3, st.starts);
+    TEST_ASSERT_LESS_THAN_UINT32(FIRST_BLOCK_LIMIT_US, st.start_max_us);
+}
+
+// 鳴っている間の play() は前の音を止めて差し替える
+void test_play_interrupts_current_sound() {
+    TEST_ASSERT_TRUE(audio->playTone(440, 2000));
+    uint32_t start = millis();
+    while (sinkCount() == 0 && millis() - start < 1000) {
+        delay(1);
+    }
+    audio->stop();
+    while (audio->isPlaying()) {
+        delay(1);
+    }
+    {
+        std::lock_guard<std::mutex> lock(sink_log.mutex);
+        sink_log.samples.clear();
+        sink_log.blocks.clear();
+    }
+
+    static int16_t pcm[200];
+    makeSine(pcm, 200, 800.0f, 5000.0f);
+    TEST_ASSERT_TRUE(audio->playPcm(pcm, 200));
+    TEST_ASSERT_TRUE(waitSamples(200));
+    std::lock_guard<std::mutex> lock(sink_log.mutex);
+    TEST_ASSERT_EQUAL_INT(200, (int)sink_log.samples.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(pcm, sink_log.samples.data(), 200);
+}
+
+int main(int argc, char** argv) {
+    audio = new AudioOutput();
+    audio->setSink(recordSink, &sink_log);
+    if (!audio->begin(0, 0, 0)) {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_pcm_is_passed_through_without_copy);
+    RUN_TEST(test_pcm_volume_scales_samples);
+    RUN_TEST(test_adpcm_decodes_reference_stream);
+    RUN_TEST(test_tone_length_pitch_and_fades);
+    RUN_TEST(test_first_block_latency);
+    RUN_TEST(test_play_interrupts_current_sound);
+    return UNITY_END();
+}
@@ -0,0 +1,121 @@
+/**
+ * 表情アニメーションのタイミングのホストテスト
+ * LVGLの時刻を lv_tick_inc() で1msずつ (または眠る分だけまとめて) 進め、
+ *   - まばたきが BLINK_CLOSE_MS で閉じ、そこから BLINK_OPEN_MS で開くこと
+ *   - 表情が ANIM_IDLE_RETURN_MS でアイドルに戻ること (続けて呼べば延長)
+ *   - アイドル中の lv_timer_handler() が次のキーフレーム (自動まばたき) までの
+ *     時間を返すこと (0や1msで回り続けない)
+ * を確かめる。lv_anim は LV_DISP_DEF_REFR_PERIOD ごとに値を進めるので、
+ * アニメーションの区切りはその周期の分だけ遅れてよい
+ */
+
+#include <unity.h>
+
+#include "../../src/character.cpp"
+#include "../../src/face_sprites.cpp"
+#include "memory_display.h"
+
+#define ANIM_FRAME_MS       LV_DISP_DEF_REFR_PERIOD     // lv_anim が値を進める周期
+#define SETTLE_MS           300                         // アイドルに戻してから落ち着くまで
+
+static MemoryDisplay display;
+
+// 1msずつ進める (タイマーとアニメーションは本来の時刻で動く)
+static void step(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        lv_tick_inc(1);
+        lv_timer_handler();
+    }
+}
+
+static bool blinking() {
+    return lv_anim_get(&eye_openness, eye_openness_cb) != nullptr;
+}
+
+void setUp() {
+    reset_to_idle();
+    step(SETTLE_MS);
+}
+
+void tearDown() {}
+
+void test_blink_timing() {
+    blink_animation();
+
+    uint32_t closed_at = 0;
+    uint32_t opened_at = 0;
+    uint32_t limit = BLINK_CLOSE_MS + BLINK_OPEN_MS + 2 * ANIM_FRAME_MS;
+    for (uint32_t t = 1; t <= limit && !opened_at; t++) {
+        step(1);
+        if (!closed_at && eye_openness == 0) {
+            closed_at = t;
+            TEST_ASSERT_EQUAL_INT(EYE_CLOSED, eye_state);
+        }
+        if (closed_at && eye_openness == ANIM_OPEN_MAX) {
+            opened_at = t;
+        }
+    }
+
+    // 閉じきるのは BLINK_CLOSE_MS (のあとの最初のフレーム)
+    TEST_ASSERT_NOT_EQUAL(0, closed_at);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(BLINK_CLOSE_MS, closed_at);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(BLINK_CLOSE_MS + ANIM_FRAME_MS, closed_at);
+
+    // 閉じてから BLINK_OPEN_MS で開ききり、アニメーションは終わる
+    TEST_ASSERT_NOT_EQUAL(0, opened_at);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(BLINK_OPEN_MS, opened_at - closed_at);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(BLINK_OPEN_MS + ANIM_FRAME_MS, opened_at - closed_at);
+    TEST_ASSERT_EQUAL_INT(EYE_OPEN, eye_state);
+    TEST_ASSERT_FALSE(blinking());
+}
+
+void test_idle_return_timing() {
+    start_animation(ANIM_HAPPY);
+    step(ANIM_IDLE_RETURN_MS - 1);
+    TEST_ASSERT_EQUAL_INT(ANIM_HAPPY, current_anim);
+    step(1);
+    TEST_ASSERT_EQUAL_INT(ANIM_IDLE, current_anim);
+
+    // 途中でもう一度呼ぶと、そこから ANIM_IDLE_RETURN_MS 延びる
+    start_animation(ANIM_SURPRISE);
+    step(ANIM_IDLE_RETURN_MS / 2);
+    start_animation(ANIM_SURPRISE);
+    step(ANIM_IDLE_RETURN_MS - 1);
+    TEST_ASSERT_EQUAL_INT(ANIM_SURPRISE, current_anim);
+    step(1);
+    TEST_ASSERT_EQUAL_INT(ANIM_IDLE, current_anim);
+}
+
+// アイドル中は描画もアニメーションも止まり、次に動くのは自動まばたきだけ
+void test_idle_sleeps_until_next_blink() {
+    schedule_blink();
+    step(SETTLE_MS);
+
+    uint32_t sleep_ms = lv_timer_handler();
+    uint32_t until_blink = blink_timer->period - lv_tick_elaps(blink_timer->last_run);
+    TEST_ASSERT_EQUAL_UINT32(until_blink, sleep_ms);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(BLINK_MIN_INTERVAL_MS - SETTLE_MS, sleep_ms);
+
+    // 返された時間だけ眠る: その直前までは何も起きず、ちょうどでまばたきが始まる
+    lv_tick_inc(sleep_ms - 1);
+    lv_timer_handler();
+    TEST_ASSERT_FALSE(blinking());
+    lv_tick_inc(1);
+    lv_timer_handler();
+    TEST_ASSERT_TRUE(blinking());
+}
+
+int main(int argc, char** argv) {
+    lv_init();
+    if (!display.begin()) {
+        return 1;
+    }
+    // ウィジェットで描く (タイミングは描き方によらない)
+    create_kirby_character(nullptr);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_blink_timing);
+    RUN_TEST(test_idle_return_timing);
+    RUN_TEST(test_idle_sleeps_until_next_blink);
+    return UNITY_END();
+}
@@ -0,0 +1,232 @@
+/**
+ * 顔の描画のホストテスト
+ * create_kirby_character() と表情アニメーションを、LVGLごとメモリ上の画面 (MemoryDisplay) に描く。
+ * 台本どおりに表情を動かして、場面ごとに
+ *   - 1フレームの描画時間 (平均・最大)
+ *   - 画面に写したバイト数 (実機ならSPIで送る量)
+ *   - LVGLヒープの最大使用量 (lv_mem_monitor)
+ * を報告し、画面を .pio/face_<描き方>_<場面>.png に保存する (見た目の回帰を目で確かめる用)。
+ * スプライト版とウィジェット版の両方を通す
+ */
+
+#include <unity.h>
+#include <sys/stat.h>
+
+#include "../../src/character.cpp"
+#include "../../src/face_sprites.cpp"
+#include "memory_display.h"
+
+#define FACE_FRAME_MS       LV_DISP_DEF_REFR_PERIOD     // 1回進めるごとに1フレーム描く
+#define FACE_SETTLE_MS      300                         // 表情を戻してから落ち着くまで
+#define FACE_FULL_BYTES     ((uint32_t)MEMORY_DISPLAY_WIDTH * MEMORY_DISPLAY_HEIGHT * sizeof(lv_color_t))
+#define SNAPSHOT_DIR        ".pio"
+
+static MemoryDisplay display;
+static FaceSprites* sprites;
+
+// 台本の1場面
+struct FaceScene {
+    const char* name;
+    void (*start)();
+    uint32_t duration_ms;
+    uint32_t snapshot_ms;       // この時刻の画面を保存する
+};
+
+struct SceneStats {
+    uint32_t frames;            // 何か描いたフレーム数
+    uint32_t total_us;
+    uint32_t max_us;
+    uint32_t bytes;
+    uint32_t max_frame_bytes;
+};
+
+// 口パク用の音量 (のこぎり波、LVGLの時刻で進む)
+static int32_t sawtooth_level(void* ctx) {
+    return (int32_t)(lv_tick_get() % 200) * ANIM_OPEN_MAX / 200;
+}
+
+static void scene_idle() {}
+
+static void scene_blink() {
+    blink_animation();
+}
+
+static void scene_talk() {
+    set_talk_level_source(nullptr, nullptr);
+    talk_animation();
+}
+
+static void scene_lipsync() {
+    set_talk_level_source(sawtooth_level, nullptr);
+    talk_animation();
+}
+
+static void scene_surprise() {
+    // main.cpp のタッチと同じ順
+    surprise_animation();
+    start_animation(ANIM_SURPRISE);
+}
+
+static const FaceScene scenes[] = {
+    { "idle",     scene_idle,     1000, 0 },
+    { "blink",    scene_blink,    300,  BLINK_CLOSE_MS },
+    { "talk",     scene_talk,     600,  TALK_CYCLE_MS },
+    { "lipsync",  scene_lipsync,  600,  180 },
+    { "surprise", scene_surprise, 500,  100 },
+};
+
+static void snapshot(const char* mode, const char* scene) {
+    char path[96];
+    snprintf(path, sizeof(path), SNAPSHOT_DIR "/face_%s_%s.png", mode, scene);
+    TEST_ASSERT_TRUE_MESSAGE(display.savePng(path), path);
+}
+
+// 時刻を ms だけ進めながら描く (snapshot_ms を過ぎた最初のフレームを保存)
+static SceneStats run_frames(uint32_t ms, const char* mode = nullptr, const FaceScene* scene = nullptr) {
+    SceneStats st;
+    memset(&st, 0, sizeof(st));
+    bool saved = false;
+    for (uint32_t t = 0; t < ms; t += FACE_FRAME_MS) {
+        uint32_t bytes_before = display.getStats().bytes;
+        uint32_t start = micros();
+        lv_tick_inc(FACE_FRAME_MS);
+        lv_timer_handler();
+        uint32_t us = micros() - start;
+
+        uint32_t bytes = display.getStats().bytes - bytes_before;
+        if (bytes > 0) {
+            st.frames++;
+            st.total_us += us;
+            if (us > st.max_us) st.max_us = us;
+            st.bytes += bytes;
+            if (bytes > st.max_frame_bytes) st.max_frame_bytes = bytes;
+        }
+        if (scene && !saved && t + FACE_FRAME_MS >= scene->snapshot_ms) {
+            snapshot(mode, scene->name);
+            saved = true;
+        }
+    }
+    return st;
+}
+
+static void report(const char* mode, const char* scene, const SceneStats& st) {
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    char msg[160];
+    snprintf(msg, sizeof(msg),
+             "%s/%s: %luフレーム, 平均 %luus, 最大 %luus, 転送 %lu bytes (1フレーム最大 %lu), LVGLヒープ最大 %lu / %lu bytes",
+             mode, scene, (unsigned long)st.frames,
+             (unsigned long)(st.frames ? st.total_us / st.frames : 0), (unsigned long)st.max_us,
+             (unsigned long)st.bytes, (unsigned long)st.max_frame_bytes,
+             (unsigned long)mon.max_used, (unsigned long)mon.total_size);
+    TEST_MESSAGE(msg);
+}
+
+static void run_face(FaceSprites* face, const char* mode) {
+    create_kirby_character(face);
+    // 自動まばたき (2〜5秒ごと) は台本の邪魔なので止める
+    lv_timer_pause(blink_timer);
+
+    // 最初のフレームは画面全体
+    display.resetStats();
+    SceneStats first = run_frames(FACE_FRAME_MS);
+    TEST_ASSERT_EQUAL_UINT32(FACE_FULL_BYTES, first.bytes);
+    // rounder を通してもバンドの高さは変わらない (1行ずつ描いていない)
+    TEST_ASSERT_EQUAL_UINT32(MEMORY_DISPLAY_BAND_LINES, display.getStats().max_rows);
+    report(mode, "create", first);
+    std::vector<lv_color_t> idle_frame = display.copyFrame();
+
+    for (const FaceScene& scene : scenes) {
+        scene.start();
+        SceneStats st = run_frames(scene.duration_ms, mode, &scene);
+        report(mode, scene.name, st);
+
+        if (scene.start == scene_idle) {
+            // 何も動いていなければ何も送らない
+            TEST_ASSERT_EQUAL_UINT32(0, st.bytes);
+        } else {
+            // 動いたのは目と口のまわりだけ
+            TEST_ASSERT_GREATER_THAN(0, st.frames);
+            TEST_ASSERT_LESS_THAN(FACE_FULL_BYTES / 4, st.max_frame_bytes);
+        }
+
+        // アイドルに戻せば最初と同じ画面
+        reset_to_idle();
+        run_frames(FACE_SETTLE_MS);
+        TEST_ASSERT_EQUAL_MEMORY(idle_frame.data(), display.getFrame(), FACE_FULL_BYTES);
+    }
+    set_talk_level_source(nullptr, nullptr);
+
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    TEST_ASSERT_LESS_THAN(mon.total_size, mon.max_used);
+}
+
+void setUp() {}
+
+void tearDown() {
+    // 次の描き方のために画面を空にする (タイマーは create_kirby_character() が使い回す)
+    reset_to_idle();
+    lv_obj_clean(lv_scr_act());
+    run_frames(FACE_FRAME_MS);
+}
+
+// rounder は横方向だけ縮め、縦は変えない
+void test_rounder_keeps_rows() {
+    // LVGLがバンドの行数を確かめる領域 (左端の1列、上の角は円の外)
+    lv_area_t probe = { 0, 0, 0, MEMORY_DISPLAY_BAND_LINES - 1 };
+    display.round(&probe);
+    TEST_ASSERT_EQUAL_INT(0, probe.y1);
+    TEST_ASSERT_EQUAL_INT(MEMORY_DISPLAY_BAND_LINES - 1, probe.y2);
+
+    // 円と交わらない角の領域はそのまま
+    lv_area_t corner = { 0, 0, 9, 9 };
+    display.round(&corner);
+    TEST_ASSERT_EQUAL_INT(0, corner.x1);
+    TEST_ASSERT_EQUAL_INT(9, corner.x2);
+    TEST_ASSERT_EQUAL_INT(0, corner.y1);
+    TEST_ASSERT_EQUAL_INT(9, corner.y2);
+
+    // 上端の帯は円の幅まで縮む
+    lv_area_t top = { 0, 0, MEMORY_DISPLAY_WIDTH - 1, 9 };
+    display.round(&top);
+    TEST_ASSERT_GREATER_THAN(0, top.x1);
+    TEST_ASSERT_LESS_THAN(MEMORY_DISPLAY_WIDTH - 1, top.x2);
+    TEST_ASSERT_EQUAL_INT(MEMORY_DISPLAY_WIDTH - 1 - top.x2, top.x1);
+    TEST_ASSERT_EQUAL_INT(0, top.y1);
+    TEST_ASSERT_EQUAL_INT(9, top.y2);
+
+    // 中央の行を含めば全幅
+    lv_area_t middle = { 0, 170, MEMORY_DISPLAY_WIDTH - 1, 190 };
+    display.round(&middle);
+    TEST_ASSERT_EQUAL_INT(0, middle.x1);
+    TEST_ASSERT_EQUAL_INT(MEMORY_DISPLAY_WIDTH - 1, middle.x2);
+}
+
+void test_face_with_sprites() {
+    run_face(sprites, "sprites");
+}
+
+void test_face_with_widgets() {
+    run_face(nullptr, "widgets");
+}
+
+int main(int argc, char** argv) {
+    mkdir(SNAPSHOT_DIR, 0755);
+    lv_init();
+    if (!display.begin()) {
+        return 1;
+    }
+
+    // キャッシュは使わず毎回アトラスを描く
+    sprites = new FaceSprites();
+    if (!sprites->init(nullptr)) {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_rounder_keeps_rows);
+    RUN_TEST(test_face_with_sprites);
+    RUN_TEST(test_face_with_widgets);
+    return UNITY_END();
+}
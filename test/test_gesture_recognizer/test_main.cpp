@@ -0,0 +1,202 @@
+/**
+ * GestureRecognizer のホストテスト
+ * 座標列を時刻つきで直接与えて、スワイプのしきい値 (4方向)、
+ * 縁の回転の積算 (両方向、0度をまたぐ場合)、新しいタッチでの平滑化のやり直しを確かめる
+ */
+
+#include <unity.h>
+#include <math.h>
+
+#include "../../src/gesture_recognizer.cpp"
+
+#define SAMPLE_MS   10
+#define RIM_RADIUS  150
+
+static GestureRecognizer* rec;
+static uint32_t now_us;
+static GestureEvent events[32];
+static int event_count;
+
+static void feedPoint(int x, int y) {
+    TouchPoint p = {(uint16_t)x, (uint16_t)y, true, GESTURE_NONE};
+    GestureEvent ev;
+    if (rec->feed(p, now_us, &ev) && event_count < 32) {
+        events[event_count++] = ev;
+    }
+    now_us += SAMPLE_MS * 1000;
+}
+
+static void lift() {
+    TouchPoint p = {0, 0, false, GESTURE_NONE};
+    GestureEvent ev;
+    TEST_ASSERT_FALSE(rec->feed(p, now_us, &ev));
+    now_us += SAMPLE_MS * 1000;
+}
+
+// (x0, y0) から (x1, y1) まで steps 回に分けて等速で動かす
+static void drag(int x0, int y0, int x1, int y1, int steps) {
+    for (int i = 0; i <= steps; i++) {
+        feedPoint(x0 + (x1 - x0) * i / steps, y0 + (y1 - y0) * i / steps);
+    }
+}
+
+// 縁を from_deg から to_deg まで 1サンプル step_deg ずつなぞる (時計回りが正)
+static void rim(float from_deg, float to_deg, float step_deg) {
+    int steps = (int)(fabsf(to_deg - from_deg) / step_deg + 0.5f);
+    for (int i = 0; i <= steps; i++) {
+        float a = (from_deg + (to_deg - from_deg) * i / steps) * (float)M_PI / 180.0f;
+        feedPoint(GESTURE_CENTER_X + (int)lroundf(RIM_RADIUS * cosf(a)),
+                  GESTURE_CENTER_Y + (int)lroundf(RIM_RADIUS * sinf(a)));
+    }
+}
+
+void setUp() {
+    rec = new GestureRecognizer();
+    now_us = 5000000;
+    event_count = 0;
+}
+
+void tearDown() {
+    delete rec;
+}
+
+// 中心を通る 120px を 80ms で (1500px/s)
+void test_swipe_in_each_direction() {
+    struct Case { int x0, y0, x1, y1; uint8_t gesture; };
+    const Case cases[] = {
+        {120, 180, 240, 180, GESTURE_SWIPE_RIGHT},
+        {240, 180, 120, 180, GESTURE_SWIPE_LEFT},
+        {180, 120, 180, 240, GESTURE_SWIPE_DOWN},
+        {180, 240, 180, 120, GESTURE_SWIPE_UP},
+    };
+    for (const Case& c : cases) {
+        event_count = 0;
+        drag(c.x0, c.y0, c.x1, c.y1, 8);
+        lift();
+        TEST_ASSERT_EQUAL_INT(1, event_count);
+        TEST_ASSERT_EQUAL_UINT8(c.gesture, events[0].gesture);
+        TEST_ASSERT_GREATER_OR_EQUAL(GESTURE_SWIPE_MIN_VELOCITY,
+                                     abs(c.x1 != c.x0 ? events[0].vx : events[0].vy));
+    }
+    TEST_ASSERT_EQUAL_UINT32(4, rec->getSwipeCount());
+}
+
+void test_swipe_needs_min_distance() {
+    drag(160, 180, 160 + GESTURE_SWIPE_MIN_DIST - 10, 180, 3);
+    lift();
+    TEST_ASSERT_EQUAL_INT(0, event_count);
+}
+
+// 同じ距離でも遅ければスワイプにしない (100px/s)
+void test_swipe_needs_min_velocity() {
+    drag(130, 180, 230, 180, 100);
+    lift();
+    TEST_ASSERT_EQUAL_INT(0, event_count);
+}
+
+void test_swipe_needs_straight_motion() {
+    drag(140, 140, 200, 190, 6);
+    lift();
+    TEST_ASSERT_EQUAL_INT(0, event_count);
+}
+
+void test_one_swipe_per_touch() {
+    drag(120, 180, 240, 180, 8);
+    drag(240, 180, 120, 180, 8);
+    lift();
+    TEST_ASSERT_EQUAL_INT(1, event_count);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_SWIPE_RIGHT, events[0].gesture);
+}
+
+// 0.5度/10ms (約130px/s の周速、スワイプには遅い) で 95度なぞると 30度ごとに3回
+void test_rim_rotation_clockwise() {
+    rim(-20.0f, 75.0f, 0.5f);
+    lift();
+    TEST_ASSERT_EQUAL_INT(3, event_count);
+    for (int i = 0; i < event_count; i++) {
+        TEST_ASSERT_EQUAL_UINT8(GESTURE_ROTATE_CW, events[i].gesture);
+        TEST_ASSERT_INT_WITHIN(3, (i + 1) * GESTURE_ROTATE_STEP_DEG, events[i].angle_deg);
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, rec->getRotateCount());
+}
+
+void test_rim_rotation_counter_clockwise() {
+    rim(200.0f, 105.0f, 0.5f);
+    lift();
+    TEST_ASSERT_EQUAL_INT(3, event_count);
+    for (int i = 0; i < event_count; i++) {
+        TEST_ASSERT_EQUAL_UINT8(GESTURE_ROTATE_CCW, events[i].gesture);
+        TEST_ASSERT_INT_WITHIN(3, -(i + 1) * GESTURE_ROTATE_STEP_DEG, events[i].angle_deg);
+    }
+}
+
+// 同じタッチで向きを変えると、戻った分だけ逆向きに通知する
+void test_rim_rotation_reverses_within_touch() {
+    rim(0.0f, 65.0f, 0.5f);
+    rim(65.0f, -5.0f, 0.5f);
+    lift();
+    TEST_ASSERT_EQUAL_INT(4, event_count);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_ROTATE_CW, events[0].gesture);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_ROTATE_CW, events[1].gesture);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_ROTATE_CCW, events[2].gesture);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_ROTATE_CCW, events[3].gesture);
+    TEST_ASSERT_INT_WITHIN(3, 0, events[3].angle_deg);
+}
+
+// 中心付近の動きは回転として積算しない
+void test_rotation_ignores_center() {
+    for (int i = 0; i <= 360; i += 2) {
+        float a = i * (float)M_PI / 180.0f;
+        feedPoint(GESTURE_CENTER_X + (int)lroundf(30 * cosf(a)),
+                  GESTURE_CENTER_Y + (int)lroundf(30 * sinf(a)));
+    }
+    lift();
+    TEST_ASSERT_EQUAL_INT(0, event_count);
+}
+
+// 前のタッチの座標が平滑化に残っていると、新しいタッチの始まりが
+// 前の位置から引き寄せられて「動いた」ように見える
+void test_smoothing_restarts_with_new_touch() {
+    for (int i = 0; i < 10; i++) {
+        feedPoint(330, 180);
+    }
+    lift();
+
+    // 離れた場所で静止したタッチ: 何も判定しない
+    for (int i = 0; i < 10; i++) {
+        feedPoint(60, 180);
+    }
+    TEST_ASSERT_EQUAL_INT(0, event_count);
+
+    // そこから右へスワイプすると、座標は新しいタッチの値だけから出る
+    drag(60, 180, 180, 180, 8);
+    lift();
+    TEST_ASSERT_EQUAL_INT(1, event_count);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_SWIPE_RIGHT, events[0].gesture);
+    TEST_ASSERT_LESS_OR_EQUAL(180, events[0].x);
+    TEST_ASSERT_EQUAL_UINT16(180, events[0].y);
+}
+
+void test_angle_of_quadrants() {
+    TEST_ASSERT_EQUAL_UINT16(0, GestureRecognizer::angleOf(100, 0));
+    TEST_ASSERT_UINT32_WITHIN(40, 16384, GestureRecognizer::angleOf(0, 100));
+    TEST_ASSERT_UINT32_WITHIN(40, 32768, GestureRecognizer::angleOf(-100, 0));
+    TEST_ASSERT_UINT32_WITHIN(40, 49152, GestureRecognizer::angleOf(0, -100));
+    TEST_ASSERT_UINT32_WITHIN(40, 8192, GestureRecognizer::angleOf(100, 100));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_swipe_in_each_direction);
+    RUN_TEST(test_swipe_needs_min_distance);
+    RUN_TEST(test_swipe_needs_min_velocity);
+    RUN_TEST(test_swipe_needs_straight_motion);
+    RUN_TEST(test_one_swipe_per_touch);
+    RUN_TEST(test_rim_rotation_clockwise);
+    RUN_TEST(test_rim_rotation_counter_clockwise);
+    RUN_TEST(test_rim_rotation_reverses_within_touch);
+    RUN_TEST(test_rotation_ignores_center);
+    RUN_TEST(test_smoothing_restarts_with_new_touch);
+    RUN_TEST(test_angle_of_quadrants);
+    return UNITY_END();
+}
@@ -0,0 +1,160 @@
+/**
+ * KanaSynth のホストテスト
+ * renderToWav() でWAVに書き出して読み直し、音が出ていること (無音でない・歪んでいない) と
+ * 合成の実時間比を確かめる。話している途中の feed() / reset() も見る
+ *
+ * WAVは .pio/kana_synth.wav に残す (耳で確かめる用)
+ */
+
+#include <unity.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "../../src/audio_output.cpp"
+#include "../../src/kana_synth.cpp"
+
+#define WAV_DIR         ".pio"
+#define WAV_PATH        "/kana_synth.wav"
+#define WAV_HEADER_SIZE 44
+
+static fs::FS wav_fs(WAV_DIR);
+
+static uint32_t readLE32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static float rmsOf(const int16_t* samples, size_t n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (double)samples[i] * samples[i];
+    }
+    return n ? (float)sqrt(sum / n) : 0.0f;
+}
+
+// fill() を直接回して、n サンプル (か終わりまで) 集める
+static size_t pull(KanaSynth* synth, std::vector<int16_t>* out, size_t n) {
+    int16_t block[AUDIO_BLOCK_SAMPLES];
+    size_t total = 0;
+    while (total < n) {
+        const int16_t* p = block;
+        size_t got = KanaSynth::fill(synth, block, AUDIO_BLOCK_SAMPLES, &p);
+        if (got == 0) {
+            break;
+        }
+        out->insert(out->end(), p, p + got);
+        total += got;
+    }
+    return total;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_render_to_wav_is_audible_and_faster_than_real_time() {
+    static KanaSynth synth;
+    synth.reset();
+    synth.feed("こんにちは、カービィだよ！");
+    synth.finish();
+
+    mkdir(WAV_DIR, 0755);
+    File file = wav_fs.open(WAV_PATH, FILE_WRITE);
+    TEST_ASSERT_TRUE_MESSAGE((bool)file, "WAVファイルが作れない");
+    size_t samples = AudioOutput::renderToWav(KanaSynth::fill, &synth, file);
+    file.close();
+
+    // 11モーラ + 読点 + 文末の間 ≒ 1.5秒
+    float audio_s = samples / (float)AUDIO_SAMPLE_RATE;
+    TEST_ASSERT_GREATER_THAN(AUDIO_SAMPLE_RATE, (int)samples);
+    TEST_ASSERT_LESS_THAN(3 * AUDIO_SAMPLE_RATE, (int)samples);
+
+    // 読み直してヘッダと中身を確かめる
+    file = wav_fs.open(WAV_PATH, FILE_READ);
+    TEST_ASSERT_TRUE((bool)file);
+    TEST_ASSERT_EQUAL_INT((int)(WAV_HEADER_SIZE + samples * 2), (int)file.size());
+    std::vector<uint8_t> bytes(file.size());
+    file.read(bytes.data(), bytes.size());
+    file.close();
+    TEST_ASSERT_EQUAL_MEMORY("RIFF", bytes.data(), 4);
+    TEST_ASSERT_EQUAL_MEMORY("WAVE", bytes.data() + 8, 4);
+    TEST_ASSERT_EQUAL_UINT32(AUDIO_SAMPLE_RATE, readLE32(bytes.data() + 24));
+    TEST_ASSERT_EQUAL_UINT32(samples * 2, readLE32(bytes.data() + 40));
+
+    const int16_t* pcm = (const int16_t*)(bytes.data() + WAV_HEADER_SIZE);
+    float rms = rmsOf(pcm, samples);
+    int32_t peak = 0;
+    size_t clipped = 0;
+    size_t voiced_blocks = 0;
+    for (size_t i = 0; i < samples; i++) {
+        int32_t v = abs(pcm[i]);
+        if (v > peak) peak = v;
+        if (v >= 32767) clipped++;
+    }
+    for (size_t b = 0; b + AUDIO_BLOCK_SAMPLES <= samples; b += AUDIO_BLOCK_SAMPLES) {
+        if (rmsOf(pcm + b, AUDIO_BLOCK_SAMPLES) > 500) voiced_blocks++;
+    }
+    TEST_ASSERT_GREATER_THAN(1000, (int)rms);
+    TEST_ASSERT_GREATER_THAN(4000, peak);
+    TEST_ASSERT_LESS_THAN((int)(samples / 100), (int)clipped);
+    // 半分以上は声が出ている (間だけではない)
+    TEST_ASSERT_GREATER_THAN((int)(samples / AUDIO_BLOCK_SAMPLES / 2), (int)voiced_blocks);
+
+    const KanaSynthStats& st = synth.getStats();
+    float rtf = st.synth_us / (audio_s * 1000000.0f);
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%.2f秒ぶん, %luモーラ, 実時間比 %.4f",
+             audio_s, (unsigned long)st.morae, rtf);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_UINT32(0, st.dropped);
+    TEST_ASSERT_TRUE(rtf < 1.0f);
+}
+
+// 最初のフレーズだけで話し始め、続きが来るまでは無音で待つ
+void test_feed_while_speaking() {
+    static KanaSynth synth;
+    std::vector<int16_t> pcm;
+    synth.reset();
+    synth.feed("やあ、");
+    pull(&synth, &pcm, AUDIO_SAMPLE_RATE);
+    TEST_ASSERT_TRUE(synth.isSpeaking());
+    TEST_ASSERT_GREATER_THAN(0, (int)synth.getStats().starved_samples);
+    TEST_ASSERT_GREATER_THAN(1000, (int)rmsOf(pcm.data(), pcm.size() / 2));
+
+    synth.feed("げんき？");
+    synth.finish();
+    pcm.clear();
+    size_t rest = pull(&synth, &pcm, 10 * AUDIO_SAMPLE_RATE);
+    TEST_ASSERT_GREATER_THAN(AUDIO_SAMPLE_RATE / 4, (int)rest);
+    TEST_ASSERT_LESS_THAN(10 * AUDIO_SAMPLE_RATE, (int)rest);
+    TEST_ASSERT_GREATER_THAN(1000, (int)rmsOf(pcm.data(), pcm.size()));
+    TEST_ASSERT_FALSE(synth.isSpeaking());
+}
+
+// reset() までに積んだテキストは読まない (何度 reset() しても前にしか進まない)
+void test_reset_drops_queued_text() {
+    static KanaSynth synth;
+    std::vector<int16_t> pcm;
+    synth.reset();
+    synth.feed("ながいながいおはなしのとちゅう");
+    pull(&synth, &pcm, AUDIO_BLOCK_SAMPLES * 4);
+    uint32_t morae_before = synth.getStats().morae;
+
+    synth.reset();
+    synth.reset();
+    synth.feed("あ");
+    synth.finish();
+    pcm.clear();
+    size_t n = pull(&synth, &pcm, 10 * AUDIO_SAMPLE_RATE);
+
+    // 「あ」+ 文末の間だけ
+    TEST_ASSERT_LESS_THAN(AUDIO_SAMPLE_RATE / 2, (int)n);
+    TEST_ASSERT_LESS_OR_EQUAL(morae_before + 2, synth.getStats().morae);
+    TEST_ASSERT_FALSE(synth.isSpeaking());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_render_to_wav_is_audible_and_faster_than_real_time);
+    RUN_TEST(test_feed_while_speaking);
+    RUN_TEST(test_reset_drops_queued_text);
+    return UNITY_END();
+}
@@ -0,0 +1,176 @@
+/**
+ * 口パクのホストテスト
+ * 音量の分かっているPCM (矩形波) を AudioOutput に流し、recordEnvelope() が記録した
+ * 鳴る時刻と音量を getEnvelope() で読み直す。さらに 16ms ごとのタイマーを時計を止めて再現し、
+ * 口が開くのが音より遅れないこと・閉じるのがゆっくりなことを確かめる
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <thread>
+
+#include "../../src/audio_output.cpp"
+#include "../../src/lip_sync.cpp"
+
+#define BLOCK_US        ((uint32_t)AUDIO_BLOCK_SAMPLES * 1000000 / AUDIO_SAMPLE_RATE)
+#define FIRST_BLOCK_US  ((uint32_t)AUDIO_DMA_BUF_LEN * 500000 / AUDIO_SAMPLE_RATE)
+#define BLOCK_COUNT     6
+#define SOUND_START_US  (FIRST_BLOCK_US + 2 * BLOCK_US)     // 無音2ブロックのあと
+#define SOUND_END_US    (FIRST_BLOCK_US + BLOCK_COUNT * BLOCK_US)
+
+static AudioOutput* audio;
+
+// ブロックごとの振幅 (矩形波なのでRMSも同じ)
+static const int16_t amplitudes[BLOCK_COUNT] = { 0, 0, 6000, 6000, 0, 3150 };
+static int16_t pcm[BLOCK_COUNT * AUDIO_BLOCK_SAMPLES];
+
+static void discardSink(void* ctx, const int16_t* samples, size_t count) {}
+
+// 時計は止めたまま、再生タスクが書き終わるのを実時間で待つ (delay() だと時計が進む)
+static bool waitWritten(uint32_t timeout_ms = 2000) {
+    for (uint32_t i = 0; i < timeout_ms; i++) {
+        if (!audio->isPlaying()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+// 止めた時計で再生し、書き込みが終わったら再生を始めた時刻を返す
+static uint32_t playBlocks() {
+    native_clock::freeze();
+    uint32_t t0 = micros();
+    TEST_ASSERT_TRUE(audio->playPcm(pcm, BLOCK_COUNT * AUDIO_BLOCK_SAMPLES));
+    TEST_ASSERT_TRUE(waitWritten());
+    return t0;
+}
+
+void setUp() {
+    // 前のテストの音が鳴り終わったことにする
+    native_clock::freeze();
+    native_clock::advance_us(AUDIO_RING_US + BLOCK_US);
+}
+
+void tearDown() {
+    native_clock::resume();
+}
+
+// 書いたブロックは、DMAの待ちのあとに隙間なく並んで鳴る
+void test_envelope_records_each_block() {
+    TEST_ASSERT_EQUAL_INT(TALK_LEVEL_SILENT, audio_talk_level(audio));
+
+    uint32_t t0 = playBlocks();
+    TEST_ASSERT_EQUAL_UINT32(SOUND_END_US, audio->getOutputDelayUs());
+
+    TEST_ASSERT_EQUAL_UINT16(0, audio->getEnvelope(t0 + FIRST_BLOCK_US - 1));
+    for (int k = 0; k < BLOCK_COUNT; k++) {
+        uint32_t start = t0 + FIRST_BLOCK_US + k * BLOCK_US;
+        TEST_ASSERT_EQUAL_UINT16(amplitudes[k], audio->getEnvelope(start));
+        TEST_ASSERT_EQUAL_UINT16(amplitudes[k], audio->getEnvelope(start + BLOCK_US - 1));
+    }
+    TEST_ASSERT_EQUAL_UINT16(0, audio->getEnvelope(t0 + SOUND_END_US));
+
+    // 鳴っている間は無音のブロックでも「音あり」(口を閉じる)
+    TEST_ASSERT_EQUAL_INT(0, audio_talk_level(audio));
+    native_clock::advance_us(SOUND_START_US - LIPSYNC_LEAD_MS * 1000);
+    TEST_ASSERT_EQUAL_INT(ANIM_OPEN_MAX, audio_talk_level(audio));
+    native_clock::advance_us(3 * BLOCK_US);
+    TEST_ASSERT_EQUAL_INT(ANIM_OPEN_MAX / 2, audio_talk_level(audio));
+
+    // DMAに積んだ分が鳴り終われば音なし (話すアニメーションは周期の口パクに戻る)
+    native_clock::advance_us(BLOCK_US + LIPSYNC_LEAD_MS * 1000);
+    TEST_ASSERT_EQUAL_UINT32(0, audio->getOutputDelayUs());
+    TEST_ASSERT_EQUAL_INT(TALK_LEVEL_SILENT, audio_talk_level(audio));
+}
+
+// 開くのは即座、閉じるのは1周期に決まった量ずつ
+void test_follow_attack_and_release() {
+    const int32_t step = ANIM_OPEN_MAX * LIPSYNC_PERIOD_MS / LIPSYNC_RELEASE_MS;
+    TEST_ASSERT_EQUAL_INT(ANIM_OPEN_MAX, lipsync_follow(ANIM_OPEN_MAX, 0));
+    TEST_ASSERT_EQUAL_INT(ANIM_OPEN_MAX, lipsync_follow(ANIM_OPEN_MAX * 3, 0));
+    TEST_ASSERT_EQUAL_INT(ANIM_OPEN_MAX - step, lipsync_follow(0, ANIM_OPEN_MAX));
+    TEST_ASSERT_EQUAL_INT(0, lipsync_follow(TALK_LEVEL_SILENT, step / 2));
+    TEST_ASSERT_EQUAL_INT(600, lipsync_follow(600, 650));
+
+    TEST_ASSERT_EQUAL_INT(0, lipsync_level(LIPSYNC_RMS_FLOOR));
+    TEST_ASSERT_EQUAL_INT(ANIM_OPEN_MAX, lipsync_level(LIPSYNC_RMS_FULL));
+    TEST_ASSERT_EQUAL_INT(ANIM_OPEN_MAX, lipsync_level(32767));
+}
+
+// タイマーの位相によらず、口が画面に出るのは音の出だしから1周期以内 (先には出ない)
+void test_mouth_offset_from_audio() {
+    const int32_t step = ANIM_OPEN_MAX * LIPSYNC_PERIOD_MS / LIPSYNC_RELEASE_MS;
+    const uint32_t period_us = LIPSYNC_PERIOD_MS * 1000;
+    const uint32_t lead_us = LIPSYNC_LEAD_MS * 1000;
+
+    for (uint32_t phase = 0; phase < period_us; phase += 3000) {
+        setUp();
+        uint32_t t0 = playBlocks();
+        native_clock::advance_us(phase);
+
+        int32_t mouth = 0;
+        uint32_t open_us = 0;
+        uint32_t close_us = 0;
+        bool opened = false;
+        for (int tick = 0; tick < 20; tick++) {
+            uint32_t now = micros() - t0;
+            int32_t level = audio_talk_level(audio);
+            int32_t next = lipsync_follow(level, mouth);
+
+            if (!opened && next > 0) {
+                opened = true;
+                open_us = now;
+                TEST_ASSERT_EQUAL_INT(ANIM_OPEN_MAX, next);
+            }
+            if (next < mouth) {
+                TEST_ASSERT_LESS_OR_EQUAL(step, mouth - next);
+            }
+            if (opened && next == 0 && close_us == 0) {
+                close_us = now;
+            }
+            if (level == TALK_LEVEL_SILENT && next == 0) {
+                break;
+            }
+            mouth = next;
+            native_clock::advance_us(period_us);
+        }
+
+        char msg[64];
+        snprintf(msg, sizeof(msg), "位相 %luus: 開く %luus, 閉じる %luus",
+                 (unsigned long)phase, (unsigned long)open_us, (unsigned long)close_us);
+        TEST_MESSAGE(msg);
+
+        // 描画した口は lead 後に画面に出る
+        TEST_ASSERT_TRUE(opened);
+        int32_t offset = (int32_t)(open_us + lead_us) - (int32_t)SOUND_START_US;
+        TEST_ASSERT_GREATER_OR_EQUAL(0, offset);
+        TEST_ASSERT_LESS_THAN((int32_t)period_us, offset);
+
+        // 音が終わってから閉じきるまで、全開からでも RELEASE_MS + 1周期
+        TEST_ASSERT_TRUE(close_us > 0);
+        TEST_ASSERT_LESS_OR_EQUAL(SOUND_END_US + (LIPSYNC_RELEASE_MS + LIPSYNC_PERIOD_MS) * 1000,
+                                  close_us + lead_us);
+        TEST_ASSERT_EQUAL_INT(TALK_LEVEL_SILENT, audio_talk_level(audio));
+    }
+}
+
+int main(int argc, char** argv) {
+    for (int k = 0; k < BLOCK_COUNT; k++) {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+            pcm[k * AUDIO_BLOCK_SAMPLES + i] = (i & 1) ? amplitudes[k] : -amplitudes[k];
+        }
+    }
+
+    audio = new AudioOutput();
+    audio->setSink(discardSink, nullptr);
+    if (!audio->begin(0, 0, 0)) {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_envelope_records_each_block);
+    RUN_TEST(test_follow_attack_and_release);
+    RUN_TEST(test_mouth_offset_from_audio);
+    return UNITY_END();
+}
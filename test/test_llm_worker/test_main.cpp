@@ -0,0 +1,317 @@
+/**
+ * LLMWorker のホストテスト
+ * 結果が投入順に返ること、cancelAll() が待機中・処理中・取り出し直後の
+ * どの時点でも取りこぼされないこと、生成途中のフレーズが先に返ることを確かめる
+ *
+ * LLMHandler は本物をリンクせず、このファイルの chat() / abort() / clearAbort() を使う。
+ * chat() は TinyLLM の生成ループと同じく、中断フラグを見ながら待つ。
+ * "stream:" で始まるメッセージは、stream_tokens をトークンとして1つずつ通知する。
+ */
+
+#include <unity.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../../src/llm_worker.cpp"
+#include "../../src/text_builder.cpp"
+#include "../../src/conversation_history.cpp"
+
+// ===== LLMHandler の代わり =====
+static std::atomic<bool> fake_abort(false);
+static std::atomic<bool> gate_open(true);       // false なら chat() は中断か開放まで返らない
+static std::atomic<int> chat_running(0);
+static std::atomic<int> aborted_chats(0);
+static std::mutex seen_mutex;
+static std::vector<std::string> seen_messages;  // chat() に届いた順
+static std::function<void()> on_clear_abort;    // 取り出し直後の割り込みを再現する
+static std::function<void()> on_chat_start;
+static std::vector<const char*> stream_tokens;
+static std::function<void(int)> on_token_sent;  // i 番目のトークンを通知した直後
+
+LLMHandler::LLMHandler() {
+    token_fn = nullptr;
+    token_ctx = nullptr;
+}
+LLMHandler::~LLMHandler() {}
+
+String LLMHandler::chat(const String& user_message) {
+    {
+        std::lock_guard<std::mutex> lock(seen_mutex);
+        seen_messages.push_back(user_message.c_str());
+    }
+    if (on_chat_start) {
+        on_chat_start();
+    }
+    chat_running++;
+    if (user_message.startsWith("stream:")) {
+        String reply;
+        for (size_t i = 0; i < stream_tokens.size() && !fake_abort; i++) {
+            reply += stream_tokens[i];
+            if (token_fn) {
+                token_fn(token_ctx, stream_tokens[i]);
+            }
+            if (on_token_sent) {
+                on_token_sent((int)i);
+            }
+        }
+        chat_running--;
+        return reply;
+    }
+    while (!gate_open && !fake_abort) {
+        delay(1);
+    }
+    chat_running--;
+    if (fake_abort) {
+        aborted_chats++;
+        return "";
+    }
+    return String("reply:") + user_message;
+}
+
+void LLMHandler::abort() { fake_abort = true; }
+
+void LLMHandler::clearAbort() {
+    fake_abort = false;
+    if (on_clear_abort) {
+        on_clear_abort();
+    }
+}
+
+// ===== テスト =====
+static LLMHandler* handler;
+static LLMWorker* worker;     // タスクは止められないので最後まで使い回す
+
+static bool waitFor(const std::function<bool()>& cond, uint32_t timeout_ms = 2000) {
+    uint32_t start = millis();
+    while (!cond()) {
+        if (millis() - start > timeout_ms) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+static bool pollWithin(LLMResult* result, uint32_t timeout_ms) {
+    return waitFor([result] { return worker->poll(result); }, timeout_ms);
+}
+
+void setUp() {
+    gate_open = true;
+    fake_abort = false;
+    aborted_chats = 0;
+    on_clear_abort = nullptr;
+    on_chat_start = nullptr;
+    on_token_sent = nullptr;
+    stream_tokens.clear();
+    std::lock_guard<std::mutex> lock(seen_mutex);
+    seen_messages.clear();
+}
+
+void tearDown() {
+    gate_open = true;
+    waitFor([] { return !worker->isBusy(); });
+    LLMResult drain;
+    while (worker->poll(&drain)) {
+    }
+}
+
+void test_results_come_back_in_submit_order() {
+    uint32_t a = worker->submit("one");
+    uint32_t b = worker->submit("two");
+    uint32_t c = worker->submit("three");
+    TEST_ASSERT_TRUE(a != 0 && a < b && b < c);
+
+    const char* expected[] = { "reply:one", "reply:two", "reply:three" };
+    uint32_t ids[] = { a, b, c };
+    for (int i = 0; i < 3; i++) {
+        LLMResult result;
+        TEST_ASSERT_TRUE_MESSAGE(pollWithin(&result, 2000), "結果が返らない");
+        TEST_ASSERT_EQUAL_UINT32(ids[i], result.id);
+        TEST_ASSERT_FALSE(result.partial);
+        TEST_ASSERT_EQUAL_UINT16(0, result.streamed);
+        TEST_ASSERT_EQUAL_STRING(expected[i], result.response);
+    }
+}
+
+void test_queue_full_rejects_submit() {
+    gate_open = false;
+    worker->submit("busy");
+    TEST_ASSERT_TRUE(waitFor([] { return chat_running > 0; }));
+
+    for (int i = 0; i < LLM_WORKER_QUEUE_LEN; i++) {
+        TEST_ASSERT_NOT_EQUAL(0, worker->submit("wait"));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, worker->submit("overflow"));
+    TEST_ASSERT_EQUAL_INT(LLM_WORKER_QUEUE_LEN, worker->pendingCount());
+    worker->cancelAll();
+}
+
+void test_cancel_aborts_active_and_drops_pending() {
+    gate_open = false;
+    worker->submit("active");
+    TEST_ASSERT_TRUE(waitFor([] { return chat_running > 0; }));
+    worker->submit("pending-1");
+    worker->submit("pending-2");
+
+    worker->cancelAll();
+
+    TEST_ASSERT_TRUE(waitFor([] { return !worker->isBusy(); }));
+    TEST_ASSERT_EQUAL_INT(1, aborted_chats.load());
+    {
+        std::lock_guard<std::mutex> lock(seen_mutex);
+        TEST_ASSERT_EQUAL_INT(1, (int)seen_messages.size());
+    }
+    LLMResult result;
+    TEST_ASSERT_FALSE(pollWithin(&result, 50));
+
+    // キャンセル後の要求は普通に処理される
+    gate_open = true;
+    uint32_t id = worker->submit("after");
+    TEST_ASSERT_TRUE(pollWithin(&result, 2000));
+    TEST_ASSERT_EQUAL_UINT32(id, result.id);
+    TEST_ASSERT_EQUAL_STRING("reply:after", result.response);
+}
+
+// 取り出してからキャンセル判定までの cancelAll() は判定で捨てられる
+void test_cancel_right_after_dequeue_skips_request() {
+    on_clear_abort = [] {
+        on_clear_abort = nullptr;
+        worker->cancelAll();
+    };
+    worker->submit("dequeued");
+
+    TEST_ASSERT_TRUE(waitFor([] { return !worker->isBusy(); }));
+    std::lock_guard<std::mutex> lock(seen_mutex);
+    TEST_ASSERT_EQUAL_INT(0, (int)seen_messages.size());
+}
+
+// 判定のあと生成が始まる前の cancelAll() も中断フラグとして残る
+void test_cancel_before_generation_starts_is_not_lost() {
+    gate_open = false;
+    on_chat_start = [] {
+        on_chat_start = nullptr;
+        worker->cancelAll();
+    };
+    worker->submit("racing");
+
+    TEST_ASSERT_TRUE(waitFor([] { return !worker->isBusy(); }));
+    TEST_ASSERT_EQUAL_INT(1, aborted_chats.load());
+    LLMResult result;
+    TEST_ASSERT_FALSE(pollWithin(&result, 50));
+}
+
+// 前の要求への中断が次の要求を止めない
+void test_stale_abort_does_not_kill_next_request() {
+    handler->abort();
+    uint32_t id = worker->submit("fresh");
+
+    LLMResult result;
+    TEST_ASSERT_TRUE(pollWithin(&result, 2000));
+    TEST_ASSERT_EQUAL_UINT32(id, result.id);
+    TEST_ASSERT_EQUAL_INT(0, aborted_chats.load());
+}
+
+// フレーズは句読点ごとに先に返り、最後の結果は全体と返した長さ
+void test_phrases_stream_before_final_result() {
+    stream_tokens = { "こんにちは", "、", "カービィ", "だよ", "！", "また", "ね" };
+    uint32_t id = worker->submit("stream:hello");
+
+    const char* phrases[] = { "こんにちは、", "カービィだよ！" };
+    LLMResult result;
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_TRUE(pollWithin(&result, 2000));
+        TEST_ASSERT_EQUAL_UINT32(id, result.id);
+        TEST_ASSERT_TRUE(result.partial);
+        TEST_ASSERT_EQUAL_STRING(phrases[i], result.response);
+    }
+
+    TEST_ASSERT_TRUE(pollWithin(&result, 2000));
+    TEST_ASSERT_FALSE(result.partial);
+    TEST_ASSERT_EQUAL_STRING("こんにちは、カービィだよ！またね", result.response);
+    TEST_ASSERT_EQUAL_UINT16(strlen("こんにちは、カービィだよ！"), result.streamed);
+    TEST_ASSERT_EQUAL_STRING("またね", result.response + result.streamed);
+}
+
+// 最初のフレーズは最後まで生成を待たずに届く
+void test_first_phrase_arrives_while_generating() {
+    stream_tokens = { "やあ", "。", "いま", "考え", "中" };
+    std::atomic<bool> seen_first(false);
+    on_token_sent = [&seen_first](int i) {
+        if (i == 1) {
+            // 最初のフレーズが取り出せるまで生成を進めない
+            LLMResult r;
+            seen_first = pollWithin(&r, 2000) && r.partial && strcmp(r.response, "やあ。") == 0;
+        }
+    };
+    worker->submit("stream:slow");
+
+    LLMResult result;
+    TEST_ASSERT_TRUE(pollWithin(&result, 2000));
+    TEST_ASSERT_TRUE(seen_first.load());
+    TEST_ASSERT_FALSE(result.partial);
+    TEST_ASSERT_EQUAL_STRING("いま考え中", result.response + result.streamed);
+}
+
+// 結果キューがいっぱいでもフレーズはまとめて送り直され、最後の結果は必ず入る
+void test_phrases_leave_room_for_final_result() {
+    stream_tokens = { "あ。", "い。", "う。", "え。", "お。", "か。" };
+    uint32_t id = worker->submit("stream:many");
+    TEST_ASSERT_TRUE(waitFor([] { return !worker->isBusy(); }));
+
+    String spoken;
+    LLMResult result;
+    int partials = 0;
+    while (worker->poll(&result)) {
+        TEST_ASSERT_EQUAL_UINT32(id, result.id);
+        if (result.partial) {
+            partials++;
+            spoken += result.response;
+        } else {
+            spoken += result.response + result.streamed;
+            break;
+        }
+    }
+    TEST_ASSERT_FALSE(result.partial);
+    TEST_ASSERT_EQUAL_INT(LLM_WORKER_QUEUE_LEN - 1, partials);
+    TEST_ASSERT_EQUAL_STRING("あ。い。う。え。お。か。", spoken.c_str());
+}
+
+// キャンセルした要求のフレーズは返らない
+void test_cancel_drops_pending_phrases() {
+    stream_tokens = { "ひとつ", "。", "ふたつ", "。" };
+    on_token_sent = [](int i) {
+        if (i == 1) {
+            worker->cancelAll();
+        }
+    };
+    worker->submit("stream:cancel");
+
+    TEST_ASSERT_TRUE(waitFor([] { return !worker->isBusy(); }));
+    LLMResult result;
+    TEST_ASSERT_FALSE(pollWithin(&result, 50));
+}
+
+int main(int argc, char** argv) {
+    handler = new LLMHandler();
+    worker = new LLMWorker();
+    if (!worker->begin(handler)) {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_results_come_back_in_submit_order);
+    RUN_TEST(test_queue_full_rejects_submit);
+    RUN_TEST(test_cancel_aborts_active_and_drops_pending);
+    RUN_TEST(test_cancel_right_after_dequeue_skips_request);
+    RUN_TEST(test_cancel_before_generation_starts_is_not_lost);
+    RUN_TEST(test_stale_abort_does_not_kill_next_request);
+    RUN_TEST(test_phrases_stream_before_final_result);
+    RUN_TEST(test_first_phrase_arrives_while_generating);
+    RUN_TEST(test_phrases_leave_room_for_final_result);
+    RUN_TEST(test_cancel_drops_pending_phrases);
+    return UNITY_END();
+}
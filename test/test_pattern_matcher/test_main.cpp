@@ -0,0 +1,177 @@
+/**
+ * PatternMatcher のホストテスト
+ * 素朴な総当たり (全位置 × 全パターンを比べる) を正解として、
+ * パターンごとの通知回数がオートマトンと一致することを確かめる。
+ *   - 重なり合うパターン (he / she / hers)
+ *   - 他のパターンの接尾辞になっているパターン (失敗遷移・dict_link で拾う分)
+ *   - ASCIIの大文字小文字 (日本語はそのまま)
+ *   - マルチバイトのUTF-8 (文字の途中からはマッチしない)
+ * 最後に乱数で作ったパターンと入力でも突き合わせる
+ */
+
+#include <unity.h>
+
+#include "../../src/pattern_matcher.cpp"
+
+#define MAX_PATTERNS    32
+
+struct MatchCounts {
+    int count[MAX_PATTERNS];
+};
+
+static void countMatch(uint16_t pattern_id, void* ctx) {
+    MatchCounts* mc = (MatchCounts*)ctx;
+    if (pattern_id < MAX_PATTERNS) {
+        mc->count[pattern_id]++;
+    }
+}
+
+// 総当たり: text のすべての位置で、ASCIIだけ大文字小文字を無視して比べる
+static int bruteForceCount(const char* text, const char* pattern) {
+    size_t n = strlen(text);
+    size_t m = strlen(pattern);
+    int count = 0;
+    for (size_t i = 0; i + m <= n; i++) {
+        size_t j = 0;
+        while (j < m && PatternMatcher::foldCase((uint8_t)text[i + j]) ==
+                        PatternMatcher::foldCase((uint8_t)pattern[j])) {
+            j++;
+        }
+        if (j == m) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// patterns[i] を ID i で登録し、texts それぞれで総当たりと突き合わせる
+static void checkAgainstOracle(const char* const* patterns, int num_patterns,
+                               const char* const* texts, int num_texts) {
+    PatternMatcher pm;
+    for (int i = 0; i < num_patterns; i++) {
+        TEST_ASSERT_TRUE(pm.addPattern(patterns[i], (uint16_t)i));
+    }
+    TEST_ASSERT_TRUE(pm.build());
+
+    for (int t = 0; t < num_texts; t++) {
+        MatchCounts mc;
+        memset(&mc, 0, sizeof(mc));
+        pm.match(texts[t], countMatch, &mc);
+        for (int i = 0; i < num_patterns; i++) {
+            char msg[160];
+            snprintf(msg, sizeof(msg), "text=\"%s\" pattern=\"%s\"", texts[t], patterns[i]);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(bruteForceCount(texts[t], patterns[i]), mc.count[i], msg);
+        }
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_overlapping_patterns() {
+    static const char* const patterns[] = { "he", "she", "his", "hers", "aa", "aaa" };
+    static const char* const texts[] = { "ushers", "shehishers", "aaaaa", "hhe", "" };
+    checkAgainstOracle(patterns, 6, texts, 5);
+
+    // 具体的な回数も1つ確かめる ("ushers" には she, he, hers が1回ずつ)
+    PatternMatcher pm;
+    for (int i = 0; i < 6; i++) {
+        pm.addPattern(patterns[i], (uint16_t)i);
+    }
+    pm.build();
+    MatchCounts mc;
+    memset(&mc, 0, sizeof(mc));
+    pm.match("ushers", countMatch, &mc);
+    TEST_ASSERT_EQUAL_INT(1, mc.count[0]);
+    TEST_ASSERT_EQUAL_INT(1, mc.count[1]);
+    TEST_ASSERT_EQUAL_INT(0, mc.count[2]);
+    TEST_ASSERT_EQUAL_INT(1, mc.count[3]);
+}
+
+// 長いパターンの途中で終わる短いパターンは、出力のない状態を挟んでも拾う
+void test_suffix_patterns() {
+    static const char* const patterns[] = { "abcd", "bcd", "cd", "d", "bc", "xabc" };
+    static const char* const texts[] = { "abcd", "xabcd", "abcabcd", "dddd", "bcbcd", "abc" };
+    checkAgainstOracle(patterns, 6, texts, 6);
+}
+
+void test_case_folded_ascii() {
+    static const char* const patterns[] = { "hello", "HeLLo World", "ok", "A1" };
+    static const char* const texts[] = { "HELLO", "hElLo wOrLd!", "OK ok Ok oK", "a1A1", "hell0" };
+    checkAgainstOracle(patterns, 4, texts, 5);
+
+    // 大文字のパターンも小文字の入力に当たる
+    PatternMatcher pm;
+    pm.addPattern("HELLO", 0);
+    pm.build();
+    MatchCounts mc;
+    memset(&mc, 0, sizeof(mc));
+    pm.match("say hello", countMatch, &mc);
+    TEST_ASSERT_EQUAL_INT(1, mc.count[0]);
+}
+
+void test_multibyte_utf8() {
+    // 「あい」(E3 81 82 E3 81 84) と「いあ」は先頭バイトを共有する
+    static const char* const patterns[] = {
+        "あい", "いあ", "い", "こんにちは", "にち", "ありがとう", "がと", "Ａ", "ｈｉ"
+    };
+    static const char* const texts[] = {
+        "あいあいあ", "こんにちは、ありがとう", "いいい", "ＡａＡ", "ｈｉＨＩhi", "ぁぃ"
+    };
+    checkAgainstOracle(patterns, 9, texts, 6);
+
+    // 全角英字は大文字小文字を同一視しない (ASCIIだけ)
+    PatternMatcher pm;
+    pm.addPattern("Ａ", 0);
+    pm.build();
+    MatchCounts mc;
+    memset(&mc, 0, sizeof(mc));
+    pm.match("ａ", countMatch, &mc);
+    TEST_ASSERT_EQUAL_INT(0, mc.count[0]);
+}
+
+// 少ない文字 (ASCIIの大小・日本語) から乱数で作ったパターンと入力で突き合わせる
+void test_random_against_oracle() {
+    static const char* const alphabet[] = { "a", "A", "b", "B", "あ", "い", "ア", "。" };
+    const int alphabet_size = 8;
+    uint32_t seed = 12345;
+    auto rnd = [&seed](int n) {
+        seed = seed * 1103515245u + 12345u;
+        return (int)((seed >> 16) % (uint32_t)n);
+    };
+    auto randomString = [&](int max_chars, std::string& out) {
+        out.clear();
+        int len = 1 + rnd(max_chars);
+        for (int i = 0; i < len; i++) {
+            out += alphabet[rnd(alphabet_size)];
+        }
+    };
+
+    for (int round = 0; round < 50; round++) {
+        std::string pattern_buf[MAX_PATTERNS];
+        const char* patterns[MAX_PATTERNS];
+        int num_patterns = 1 + rnd(MAX_PATTERNS);
+        for (int i = 0; i < num_patterns; i++) {
+            randomString(4, pattern_buf[i]);
+            patterns[i] = pattern_buf[i].c_str();
+        }
+
+        std::string text_buf[8];
+        const char* texts[8];
+        for (int i = 0; i < 8; i++) {
+            randomString(40, text_buf[i]);
+            texts[i] = text_buf[i].c_str();
+        }
+        checkAgainstOracle(patterns, num_patterns, texts, 8);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_overlapping_patterns);
+    RUN_TEST(test_suffix_patterns);
+    RUN_TEST(test_case_folded_ascii);
+    RUN_TEST(test_multibyte_utf8);
+    RUN_TEST(test_random_against_oracle);
+    return UNITY_END();
+}
@@ -0,0 +1,146 @@
+/**
+ * SimpleResponder のホストテスト
+ * 表記ゆれ・崩した言い方の日本語コーパスで、部分一致の1位が期待するルールになることと、
+ * バイグラムがバイトではなくコードポイント単位で数えられていることを確かめる。
+ * 照合の速さも報告する (実機の 'b' コマンドと同じコーパス)
+ */
+
+#include <unity.h>
+
+#include "../../src/simple_responder.cpp"
+#include "../../src/pattern_matcher.cpp"
+#include "../../src/tiny_llm.cpp"
+#include "../../src/text_builder.cpp"
+
+static SimpleResponder* builtin;    // 組み込みルールだけ
+
+// 表記ゆれ → 期待するルールのパターン (SimpleResponder::benchmark() と同じ)
+static const struct {
+    const char* query;
+    const char* expected;
+} fuzzy_cases[] = {
+    {"こんにちわー", "こんにちは"},
+    {"こんばんわ", "こんばんは"},
+    {"おはよー", "おはよう"},
+    {"ありがとね", "ありがとう"},
+    {"すいません", "すみません"},
+    {"かわいーね", "かわいい"},
+    {"すごーい", "すごい"},
+    {"バイバーイ", "バイバイ"},
+    {"さよならー", "さようなら"},
+    {"Helo!", "hello"}
+};
+
+// パターンから組み込みルールの応答を引く
+static const char* builtinResponse(const char* pattern) {
+    for (const BuiltinRule& r : BUILTIN_RULES) {
+        if (strcmp(r.pattern, pattern) == 0) {
+            return r.response;
+        }
+    }
+    return nullptr;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_fuzzy_corpus_top1() {
+    SimpleResponder::Candidate cand[RULE_TOP_K];
+    for (const auto& c : fuzzy_cases) {
+        int n = builtin->findCandidates(c.query, cand, RULE_TOP_K);
+        TEST_ASSERT_GREATER_THAN_MESSAGE(0, n, c.query);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(builtinResponse(c.expected),
+                                         builtin->getRuleResponse(cand[0].rule), c.query);
+        // スコア降順
+        for (int j = 1; j < n; j++) {
+            TEST_ASSERT_TRUE(cand[j - 1].score >= cand[j].score);
+        }
+    }
+}
+
+// 完全一致は部分一致より優先され、どれにも当たらなければ既定の応答
+void test_respond_prefers_exact_match() {
+    TEST_ASSERT_EQUAL_STRING(builtinResponse("おやすみ"), builtin->respond("そろそろおやすみするね").c_str());
+    TEST_ASSERT_EQUAL_STRING(builtinResponse("hello"), builtin->respond("HELLO there").c_str());
+    TEST_ASSERT_EQUAL_STRING(builtinResponse("こんにちは"), builtin->respond("こんにちわー").c_str());
+}
+
+// 5文字のパターン = 4バイグラム。3文字の入力と共有するのは2つ → 2/4 × 0.5
+// (バイト単位なら 15バイト = 14バイグラムになり、スコアが変わる)
+static void checkCodePointScores(SimpleResponder* r) {
+    SimpleResponder::Candidate cand[RULE_TOP_K];
+    int n = r->findCandidates("ありが", cand, RULE_TOP_K);
+    TEST_ASSERT_EQUAL_INT(1, n);
+    TEST_ASSERT_EQUAL_FLOAT(2.0f / 4.0f * 0.5f, cand[0].score);
+
+    // 1文字のパターンは1文字で数える
+    n = r->findCandidates("雨だね", cand, RULE_TOP_K);
+    TEST_ASSERT_EQUAL_INT(1, n);
+    TEST_ASSERT_EQUAL_STRING("rain", r->getRuleResponse(cand[0].rule));
+    TEST_ASSERT_EQUAL_FLOAT(0.5f, cand[0].score);
+
+    // 「いあ」と「あい」はUTF-8の先頭2バイト (E3 81) を共有するが、文字のバイグラムは共有しない
+    n = r->findCandidates("いあ", cand, RULE_TOP_K);
+    TEST_ASSERT_EQUAL_INT(0, n);
+}
+
+void test_bigrams_count_code_points() {
+    // 未索引 (線形に照合) と索引済みの両方で同じスコア
+    SimpleResponder r;
+    r.addRule("ありがとう", "thanks");
+    r.addRule("雨", "rain");
+    r.addRule("あい", "love");
+    checkCodePointScores(&r);
+
+    r.rebuildIndex();
+    checkCodePointScores(&r);
+}
+
+// addRule() を続けて呼んでも索引は作り直さず、次の照合の前に1回だけまとめて入れる
+void test_bulk_add_indexes_once() {
+    SimpleResponder r;
+    const int count = RULE_REBUILD_THRESHOLD * 10;
+    char pattern[16];
+    for (int i = 0; i < count; i++) {
+        snprintf(pattern, sizeof(pattern), "key%03d", i);
+        r.addRule(pattern, pattern);
+    }
+    TEST_ASSERT_EQUAL_INT(count, r.getRuleCount());
+    TEST_ASSERT_EQUAL_INT(0, r.getIndexedRuleCount());
+
+    // 最初の照合で全件が索引に入り、最後に追加したルールも当たる
+    TEST_ASSERT_EQUAL_STRING("key319", r.respond("KEY319").c_str());
+    TEST_ASSERT_EQUAL_INT(count, r.getIndexedRuleCount());
+
+    // しきい値以下の追加は線形に照合する
+    r.addRule("extra", "extra");
+    TEST_ASSERT_EQUAL_STRING("extra", r.respond("extra!").c_str());
+    TEST_ASSERT_EQUAL_INT(count, r.getIndexedRuleCount());
+}
+
+void test_matching_speed() {
+    const int iterations = 2000;
+    uint32_t start = micros();
+    for (int i = 0; i < iterations; i++) {
+        builtin->respond(fuzzy_cases[i % 10].query);
+    }
+    uint32_t elapsed = micros() - start;
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%dルール, %.2f us/クエリ",
+             builtin->getRuleCount(), (float)elapsed / iterations);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char** argv) {
+    builtin = new SimpleResponder();
+    builtin->init();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_fuzzy_corpus_top1);
+    RUN_TEST(test_respond_prefers_exact_match);
+    RUN_TEST(test_bigrams_count_code_points);
+    RUN_TEST(test_bulk_add_indexes_once);
+    RUN_TEST(test_matching_speed);
+    return UNITY_END();
+}
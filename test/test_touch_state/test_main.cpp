@@ -0,0 +1,204 @@
+/**
+ * TouchStateMachine のホストテスト
+ * サンプル列と時刻を直接与えて、押した・離した・ジェスチャーの通知が
+ * 1回ずつになること、デバウンスとダブルタップの間隔の扱いを確かめる
+ */
+
+#include <unity.h>
+
+#include "../../src/touch_state.cpp"
+
+#define MS  1000u   // us
+
+struct EdgeLog {
+    TouchEdge edge[32];
+    uint8_t gesture[32];
+    int count;
+};
+
+static TouchStateMachine* sm;
+static EdgeLog edge_log;
+static uint32_t now_us;
+
+static void recordEdge(TouchEdge edge, const TouchPoint& point, void* ctx) {
+    EdgeLog* log = (EdgeLog*)ctx;
+    if (log->count < 32) {
+        log->edge[log->count] = edge;
+        log->gesture[log->count] = point.gesture;
+        log->count++;
+    }
+}
+
+static void touchFor(uint32_t duration_ms, uint8_t gesture = GESTURE_NONE, uint32_t period_ms = 10) {
+    for (uint32_t t = 0; t < duration_ms; t += period_ms) {
+        TouchPoint p = {120, 200, true, gesture};
+        sm->feed(p, now_us);
+        now_us += period_ms * MS;
+    }
+}
+
+static void release(uint8_t gesture = GESTURE_NONE) {
+    TouchPoint p = {120, 200, false, gesture};
+    sm->feed(p, now_us);
+}
+
+static void idleFor(uint32_t duration_ms) {
+    for (uint32_t t = 0; t < duration_ms; t += 5) {
+        now_us += 5 * MS;
+        sm->update(now_us);
+    }
+}
+
+static void assertEdges(const TouchEdge* expected, int n) {
+    TEST_ASSERT_EQUAL_INT(n, edge_log.count);
+    for (int i = 0; i < n; i++) {
+        TEST_ASSERT_EQUAL_INT(expected[i], edge_log.edge[i]);
+    }
+}
+
+void setUp() {
+    sm = new TouchStateMachine();
+    sm->setCallback(recordEdge, &edge_log);
+    edge_log.count = 0;
+    now_us = 1000 * MS;
+}
+
+void tearDown() {
+    delete sm;
+}
+
+void test_press_reports_down_once() {
+    touchFor(200);
+    TouchEdge expected[] = { TOUCH_EDGE_DOWN };
+    assertEdges(expected, 1);
+    TEST_ASSERT_TRUE(sm->isPressed());
+    TEST_ASSERT_EQUAL_UINT16(120, sm->getPoint().x);
+}
+
+void test_release_waits_for_up_debounce() {
+    touchFor(50);
+    release();
+    idleFor(TOUCH_DEBOUNCE_UP_MS - 10);
+    TEST_ASSERT_TRUE(sm->isPressed());
+    TEST_ASSERT_EQUAL_INT(1, edge_log.count);
+
+    idleFor(20);
+    TEST_ASSERT_FALSE(sm->isPressed());
+    TouchEdge expected[] = { TOUCH_EDGE_DOWN, TOUCH_EDGE_UP };
+    assertEdges(expected, 2);
+}
+
+void test_short_gap_is_merged_into_one_press() {
+    touchFor(50);
+    release();
+    idleFor(TOUCH_DEBOUNCE_UP_MS / 2);
+    touchFor(50);
+    release();
+    idleFor(TOUCH_DEBOUNCE_UP_MS + 10);
+
+    TouchEdge expected[] = { TOUCH_EDGE_DOWN, TOUCH_EDGE_UP };
+    assertEdges(expected, 2);
+    TEST_ASSERT_EQUAL_UINT32(1, sm->getBounceCount());
+}
+
+void test_down_debounce_ignores_short_contact() {
+    sm->setDebounce(30, TOUCH_DEBOUNCE_UP_MS);
+    touchFor(20);
+    release();
+    idleFor(100);
+    TEST_ASSERT_EQUAL_INT(0, edge_log.count);
+
+    touchFor(40);
+    TouchEdge expected[] = { TOUCH_EDGE_DOWN };
+    assertEdges(expected, 1);
+}
+
+void test_long_press_gesture_is_reported_once() {
+    touchFor(100);
+    touchFor(500, GESTURE_LONG_PRESS);
+    release(GESTURE_LONG_PRESS);
+    idleFor(TOUCH_DEBOUNCE_UP_MS + 10);
+
+    TouchEdge expected[] = { TOUCH_EDGE_DOWN, TOUCH_EDGE_GESTURE, TOUCH_EDGE_UP };
+    assertEdges(expected, 3);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_LONG_PRESS, edge_log.gesture[1]);
+    // 50サンプル + 離したとき1件のうち通知は最初の1件だけ
+    TEST_ASSERT_EQUAL_UINT32(50, sm->getSuppressedCount());
+}
+
+// クリックは離したときのサンプルで報告される
+void test_click_on_release_sample() {
+    touchFor(60);
+    release(GESTURE_SINGLE_CLICK);
+    idleFor(TOUCH_DEBOUNCE_UP_MS + 10);
+
+    TouchEdge expected[] = { TOUCH_EDGE_DOWN, TOUCH_EDGE_GESTURE, TOUCH_EDGE_UP };
+    assertEdges(expected, 3);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_SINGLE_CLICK, edge_log.gesture[1]);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_NONE, sm->getPoint().gesture);
+}
+
+// 間隔がデバウンスより長い2回のタップは別々のタッチとして通知し、
+// 2回目に同じジェスチャーコードが来ても通知する (通知済みはタッチごとに戻る)
+void test_double_tap_window() {
+    touchFor(60);
+    release(GESTURE_SINGLE_CLICK);
+    idleFor(120);
+    touchFor(60);
+    release(GESTURE_DOUBLE_CLICK);
+    idleFor(TOUCH_DEBOUNCE_UP_MS + 10);
+
+    TouchEdge expected[] = {
+        TOUCH_EDGE_DOWN, TOUCH_EDGE_GESTURE, TOUCH_EDGE_UP,
+        TOUCH_EDGE_DOWN, TOUCH_EDGE_GESTURE, TOUCH_EDGE_UP
+    };
+    assertEdges(expected, 6);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_SINGLE_CLICK, edge_log.gesture[1]);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_DOUBLE_CLICK, edge_log.gesture[4]);
+
+    // 同じコードでも次のタッチでは通知する
+    edge_log.count = 0;
+    idleFor(120);
+    touchFor(60);
+    release(GESTURE_DOUBLE_CLICK);
+    idleFor(TOUCH_DEBOUNCE_UP_MS + 10);
+    TEST_ASSERT_EQUAL_INT(3, edge_log.count);
+    TEST_ASSERT_EQUAL_UINT8(GESTURE_DOUBLE_CLICK, edge_log.gesture[1]);
+}
+
+// 間隔がデバウンスより短いと1回のタッチにまとまる (ダブルタップにならない)
+void test_taps_inside_up_debounce_are_one_touch() {
+    touchFor(40);
+    release();
+    idleFor(TOUCH_DEBOUNCE_UP_MS - 20);
+    touchFor(40);
+    release(GESTURE_DOUBLE_CLICK);
+    idleFor(TOUCH_DEBOUNCE_UP_MS + 10);
+
+    TouchEdge expected[] = { TOUCH_EDGE_DOWN, TOUCH_EDGE_GESTURE, TOUCH_EDGE_UP };
+    assertEdges(expected, 3);
+}
+
+void test_time_wraps_around() {
+    now_us = 0xFFFFFFFFu - 15 * MS;
+    touchFor(50);
+    release();
+    idleFor(TOUCH_DEBOUNCE_UP_MS + 10);
+
+    TouchEdge expected[] = { TOUCH_EDGE_DOWN, TOUCH_EDGE_UP };
+    assertEdges(expected, 2);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_press_reports_down_once);
+    RUN_TEST(test_release_waits_for_up_debounce);
+    RUN_TEST(test_short_gap_is_merged_into_one_press);
+    RUN_TEST(test_down_debounce_ignores_short_contact);
+    RUN_TEST(test_long_press_gesture_is_reported_once);
+    RUN_TEST(test_click_on_release_sample);
+    RUN_TEST(test_double_tap_window);
+    RUN_TEST(test_taps_inside_up_debounce_are_one_touch);
+    RUN_TEST(test_time_wraps_around);
+    return UNITY_END();
+}